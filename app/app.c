@@ -50,6 +50,7 @@
 #include "gegl/gimp-gegl.h"
 
 #include "core/gimp.h"
+#include "core/gimp-startup-profile.h"
 #include "core/gimp-user-install.h"
 
 #include "file/file-open.h"
@@ -142,6 +143,7 @@ app_run (const gchar         *full_prog_name,
          gboolean             use_cpu_accel,
          gboolean             console_messages,
          gboolean             use_debug_handler,
+         gboolean             profile_startup,
          GimpStackTraceMode   stack_trace_mode,
          GimpPDBCompatMode    pdb_compat_mode)
 {
@@ -165,6 +167,9 @@ app_run (const gchar         *full_prog_name,
                    stack_trace_mode,
                    pdb_compat_mode);
 
+  if (profile_startup)
+    gimp_startup_profile_enable (gimp);
+
   errors_init (gimp, full_prog_name, use_debug_handler, stack_trace_mode);
 
   units_init (gimp);
@@ -187,7 +192,9 @@ app_run (const gchar         *full_prog_name,
       gimp_user_install_free (install);
     }
 
+  gimp_startup_profile_begin (gimp, "Configuration");
   gimp_load_config (gimp, alternate_system_gimprc, alternate_gimprc);
+  gimp_startup_profile_end (gimp);
 
   config = GIMP_BASE_CONFIG (gimp->config);
 
@@ -195,13 +202,19 @@ app_run (const gchar         *full_prog_name,
   language_init (gimp->config->language);
 
   /*  initialize lowlevel stuff  */
+  gimp_startup_profile_begin (gimp, "Base");
   swap_is_ok = base_init (config, be_verbose, use_cpu_accel);
 
   gimp_gegl_init (gimp);
+  gimp_startup_profile_end (gimp);
 
 #ifndef GIMP_CONSOLE_COMPILATION
   if (! no_interface)
-    update_status_func = gui_init (gimp, no_splash);
+    {
+      gimp_startup_profile_begin (gimp, "User interface");
+      update_status_func = gui_init (gimp, no_splash);
+      gimp_startup_profile_end (gimp);
+    }
 #endif
 
   if (! update_status_func)
@@ -210,11 +223,17 @@ app_run (const gchar         *full_prog_name,
   /*  Create all members of the global Gimp instance which need an already
    *  parsed gimprc, e.g. the data factories
    */
+  gimp_startup_profile_begin (gimp, "Initialization");
   gimp_initialize (gimp, update_status_func);
+  gimp_startup_profile_end (gimp);
 
   /*  Load all data files
    */
+  gimp_startup_profile_begin (gimp, "Restore");
   gimp_restore (gimp, update_status_func);
+  gimp_startup_profile_end (gimp);
+
+  gimp_startup_profile_report (gimp);
 
   /* display a warning when no test swap file could be generated */
   if (! swap_is_ok)
@@ -70,6 +70,7 @@ typedef struct _SioxState           SioxState;
 typedef struct _TempBuf             TempBuf;
 
 typedef struct _Tile                Tile;
+typedef struct _TileDelta           TileDelta;
 typedef struct _TileManager         TileManager;
 typedef struct _TilePyramid         TilePyramid;
 
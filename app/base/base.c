@@ -28,6 +28,7 @@
 #include "libgimpbase/gimpwin32-io.h"
 #endif
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpconfig/gimpconfig.h"
 
 #include "base-types.h"
@@ -49,6 +50,10 @@ static void   base_toast_old_swap_files   (const gchar *swap_path);
 static void   base_tile_cache_size_notify (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
+static void   base_compressed_tile_cache_size_notify
+                                          (GObject     *config,
+                                           GParamSpec  *param_spec,
+                                           gpointer     data);
 static void   base_num_processors_notify  (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
@@ -86,6 +91,11 @@ base_init (GimpBaseConfig *config,
 
   swap_is_ok = tile_swap_test ();
 
+  tile_swap_set_compressed_cache_size (config->compressed_tile_cache_size);
+  g_signal_connect (config, "notify::compressed-tile-cache-size",
+                    G_CALLBACK (base_compressed_tile_cache_size_notify),
+                    NULL);
+
   /*  create the temp directory if it doesn't exist  */
   if (! config->temp_path || ! *config->temp_path)
     gimp_config_reset_property (G_OBJECT (config), "temp-path");
@@ -107,6 +117,17 @@ base_init (GimpBaseConfig *config,
 
   gimp_composite_init (be_verbose, use_cpu_accel);
 
+  /*  pick the fastest compositing functions, as measured by
+   *  gimp-composite-bench on this machine
+   */
+  if (use_cpu_accel)
+    {
+      gchar *filename = gimp_personal_rc_file ("compositerc");
+
+      gimp_composite_dispatch_load (filename, be_verbose);
+      g_free (filename);
+    }
+
   paint_funcs_setup ();
 
   return swap_is_ok;
@@ -123,12 +144,16 @@ base_exit (void)
 
   pixel_processor_exit ();
   paint_funcs_free ();
+  tile_swap_set_compressed_cache_size (0);
   tile_cache_exit ();
   tile_swap_exit ();
 
   g_signal_handlers_disconnect_by_func (base_config,
                                         base_tile_cache_size_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_compressed_tile_cache_size_notify,
+                                        NULL);
 
   g_object_unref (base_config);
   base_config = NULL;
@@ -160,7 +185,8 @@ base_toast_old_swap_files (const gchar *swap_path)
     }
 
   while ((entry = g_dir_read_name (dir)) != NULL)
-    if (g_str_has_prefix (entry, "gimpswap."))
+    if (g_str_has_prefix (entry, "gimpswap.") ||
+        g_str_has_prefix (entry, "gimpundo."))
       {
         /* don't try to kill swap files of running processes
          * yes, I know they might not all be gimp processes, and when you
@@ -199,6 +225,15 @@ base_tile_cache_size_notify (GObject    *config,
   tile_cache_set_size (GIMP_BASE_CONFIG (config)->tile_cache_size);
 }
 
+static void
+base_compressed_tile_cache_size_notify (GObject    *config,
+                                        GParamSpec *param_spec,
+                                        gpointer    data)
+{
+  tile_swap_set_compressed_cache_size
+    (GIMP_BASE_CONFIG (config)->compressed_tile_cache_size);
+}
+
 static void
 base_num_processors_notify (GObject    *config,
                             GParamSpec *param_spec,
@@ -27,6 +27,7 @@
 #include "base-types.h"
 
 #include "boundary.h"
+#include "pixel-processor.h"
 #include "pixel-region.h"
 #include "tile.h"
 #include "tile-manager.h"
@@ -35,8 +36,13 @@
 /* BoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* number of tile rows thresholded at once by generate_boundary() */
+#define BAND_TILE_ROWS  4
 
-typedef struct _Boundary Boundary;
+
+typedef struct _Boundary     Boundary;
+typedef struct _BoundaryBand BoundaryBand;
+typedef struct _BoundaryEnd  BoundaryEnd;
 
 struct _Boundary
 {
@@ -55,6 +61,33 @@ struct _Boundary
   gint      max_empty_segs;
 };
 
+struct _BoundaryBand
+{
+  PixelRegion  *maskPR;
+  BoundaryType  type;
+  gint          x1, y1;
+  gint          x2, y2;
+  guchar        threshold;
+
+  /*  The area of the mask which is scanned  */
+  gint          row_x1, row_x2;
+  gint          row_y1, row_y2;
+
+  /*  The current band of thresholded mask rows, one byte per pixel
+   *  which is 1 inside the boundary and 0 outside
+   */
+  guchar       *data;
+  gint          rowstride;
+  gint          band_y1, band_y2;
+};
+
+struct _BoundaryEnd
+{
+  gint  x;
+  gint  y;
+  gint  end;  /*  segment index * 2, plus 1 for the (x2, y2) end  */
+};
+
 
 /*  local function prototypes  */
 
@@ -69,17 +102,18 @@ static void       boundary_add_seg    (Boundary        *bounrady,
                                        gint             y2,
                                        gboolean         open);
 
-static void       find_empty_segs     (PixelRegion     *maskPR,
-                                       gint             scanline,
-                                       gint             empty_segs[],
-                                       gint             max_empty,
-                                       gint            *num_empty,
-                                       BoundaryType     type,
+static void       boundary_band_threshold
+                                      (BoundaryBand    *band,
+                                       PixelRegion     *maskPR);
+static const guchar * boundary_band_get_row
+                                      (BoundaryBand    *band,
+                                       gint             scanline);
+
+static void       find_empty_segs     (const guchar    *row,
                                        gint             x1,
-                                       gint             y1,
                                        gint             x2,
-                                       gint             y2,
-                                       guchar           threshold);
+                                       gint             empty_segs[],
+                                       gint            *num_empty);
 static void       process_horiz_seg   (Boundary        *boundary,
                                        gint             x1,
                                        gint             y1,
@@ -101,26 +135,14 @@ static Boundary * generate_boundary   (PixelRegion     *PR,
                                        gint             y2,
                                        guchar           threshold);
 
-static gint       cmp_segptr_xy1_addr (const BoundSeg **seg_ptr_a,
-                                       const BoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2_addr (const BoundSeg **seg_ptr_a,
-                                       const BoundSeg **seg_ptr_b);
-
-static gint       cmp_segptr_xy1      (const BoundSeg **seg_ptr_a,
-                                       const BoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2      (const BoundSeg **seg_ptr_a,
-                                       const BoundSeg **seg_ptr_b);
-
-static const BoundSeg * find_segment  (const BoundSeg **segs_by_xy1,
-                                       const BoundSeg **segs_by_xy2,
-                                       gint             num_segs,
-                                       gint             x,
-                                       gint             y);
+static gint       cmp_boundary_end    (const BoundaryEnd *end_a,
+                                       const BoundaryEnd *end_b);
 
-static const BoundSeg * find_segment_with_func (const BoundSeg **segs,
-                                                gint             num_segs,
-                                                const BoundSeg  *search_seg,
-                                                GCompareFunc     cmp_func);
+static const BoundSeg * find_segment  (const BoundSeg    *segs,
+                                       const BoundaryEnd *ends,
+                                       gint               num_ends,
+                                       gint               run,
+                                       gboolean          *reverse);
 
 static void       simplify_subdivide  (const BoundSeg  *segs,
                                        gint             start_idx,
@@ -191,12 +213,14 @@ boundary_sort (const BoundSeg *segs,
                gint            num_segs,
                gint           *num_groups)
 {
-  Boundary        *boundary;
-  const BoundSeg **segs_ptrs_by_xy1;
-  const BoundSeg **segs_ptrs_by_xy2;
-  gint             index;
-  gint             x, y;
-  gint             startx, starty;
+  Boundary    *boundary;
+  BoundaryEnd *ends;
+  gint        *end_runs;
+  gint         num_ends;
+  gint         index;
+  gint         run;
+  gint         x, y;
+  gint         startx, starty;
 
   g_return_val_if_fail ((segs == NULL && num_segs == 0) ||
                         (segs != NULL && num_segs >  0), NULL);
@@ -207,20 +231,34 @@ boundary_sort (const BoundSeg *segs,
   if (num_segs == 0)
     return NULL;
 
-  /* prepare arrays with BoundSeg pointers sorted by xy1 and xy2 accordingly */
-  segs_ptrs_by_xy1 = g_new (const BoundSeg *, num_segs);
-  segs_ptrs_by_xy2 = g_new (const BoundSeg *, num_segs);
+  /*  sort both ends of all segments by position, so that the segments
+   *  meeting at a point form a run ordered by segment index, and
+   *  remember for each end where its run starts
+   */
+  num_ends = 2 * num_segs;
+  ends     = g_new (BoundaryEnd, num_ends);
+  end_runs = g_new (gint, num_ends);
 
   for (index = 0; index < num_segs; index++)
     {
-      segs_ptrs_by_xy1[index] = segs + index;
-      segs_ptrs_by_xy2[index] = segs + index;
+      ends[2 * index].x       = segs[index].x1;
+      ends[2 * index].y       = segs[index].y1;
+      ends[2 * index].end     = 2 * index;
+      ends[2 * index + 1].x   = segs[index].x2;
+      ends[2 * index + 1].y   = segs[index].y2;
+      ends[2 * index + 1].end = 2 * index + 1;
     }
 
-  qsort (segs_ptrs_by_xy1, num_segs, sizeof (BoundSeg *),
-         (GCompareFunc) cmp_segptr_xy1_addr);
-  qsort (segs_ptrs_by_xy2, num_segs, sizeof (BoundSeg *),
-         (GCompareFunc) cmp_segptr_xy2_addr);
+  qsort (ends, num_ends, sizeof (BoundaryEnd),
+         (GCompareFunc) cmp_boundary_end);
+
+  for (index = 0, run = 0; index < num_ends; index++)
+    {
+      if (ends[index].x != ends[run].x || ends[index].y != ends[run].y)
+        run = index;
+
+      end_runs[ends[index].end] = run;
+    }
 
   for (index = 0; index < num_segs; index++)
     ((BoundSeg *) segs)[index].visited = FALSE;
@@ -230,6 +268,7 @@ boundary_sort (const BoundSeg *segs,
   for (index = 0; index < num_segs; index++)
     {
       const BoundSeg *cur_seg;
+      gboolean        reverse;
 
       if (segs[index].visited)
         continue;
@@ -246,11 +285,15 @@ boundary_sort (const BoundSeg *segs,
       x = segs[index].x2;
       y = segs[index].y2;
 
-      while ((cur_seg = find_segment (segs_ptrs_by_xy1, segs_ptrs_by_xy2,
-                                      num_segs, x, y)) != NULL)
+      run = end_runs[2 * index + 1];
+
+      while ((cur_seg = find_segment (segs, ends, num_ends,
+                                      run, &reverse)) != NULL)
         {
+          gint cur_index = cur_seg - segs;
+
           /*  make sure ordering is correct  */
-          if (x == cur_seg->x1 && y == cur_seg->y1)
+          if (! reverse)
             {
               boundary_add_seg (boundary,
                                 cur_seg->x1, cur_seg->y1,
@@ -258,6 +301,8 @@ boundary_sort (const BoundSeg *segs,
                                 cur_seg->open);
               x = cur_seg->x2;
               y = cur_seg->y2;
+
+              run = end_runs[2 * cur_index + 1];
             }
           else
             {
@@ -267,6 +312,8 @@ boundary_sort (const BoundSeg *segs,
                                 cur_seg->open);
               x = cur_seg->x1;
               y = cur_seg->y1;
+
+              run = end_runs[2 * cur_index];
             }
 
           ((BoundSeg *) cur_seg)->visited = TRUE;
@@ -280,8 +327,8 @@ boundary_sort (const BoundSeg *segs,
       boundary_add_seg (boundary, -1, -1, -1, -1, 0);
   }
 
-  g_free (segs_ptrs_by_xy1);
-  g_free (segs_ptrs_by_xy2);
+  g_free (ends);
+  g_free (end_runs);
 
   return boundary_free (boundary, FALSE);
 }
@@ -464,148 +511,141 @@ boundary_add_seg (Boundary *boundary,
 }
 
 static void
-find_empty_segs (PixelRegion  *maskPR,
-                 gint          scanline,
-                 gint          empty_segs[],
-                 gint          max_empty,
-                 gint         *num_empty,
-                 BoundaryType  type,
-                 gint          x1,
-                 gint          y1,
-                 gint          x2,
-                 gint          y2,
-                 guchar        threshold)
+boundary_band_threshold (BoundaryBand *band,
+                         PixelRegion  *maskPR)
 {
-  const guchar *data  = NULL;
-  Tile         *tile  = NULL;
-  gint          start = 0;
-  gint          end   = 0;
-  gint          endx  = 0;
-  gint          bpp   = 0;
-  gint          tilex = -1;
-  gint          last  = -1;
-  gint          l_num_empty;
-  gint          x;
-
-  *num_empty = 0;
-
-  if (scanline < maskPR->y || scanline >= (maskPR->y + maskPR->h))
+  const guchar *src       = maskPR->data + maskPR->bytes - 1;
+  guchar       *dest      = (band->data +
+                             (maskPR->y - band->band_y1) * band->rowstride +
+                             (maskPR->x - band->row_x1));
+  const guchar  threshold = band->threshold;
+  const gint    bytes     = maskPR->bytes;
+  gint          ignore_x1 = 0;
+  gint          ignore_x2 = 0;
+  gint          x, y;
+
+  /*  pixels within the bounds are never inside when ignoring them  */
+  if (band->type == BOUNDARY_IGNORE_BOUNDS)
     {
-      empty_segs[(*num_empty)++] = 0;
-      empty_segs[(*num_empty)++] = G_MAXINT;
-      return;
+      ignore_x1 = CLAMP (band->x1, maskPR->x, maskPR->x + maskPR->w);
+      ignore_x2 = CLAMP (band->x2, maskPR->x, maskPR->x + maskPR->w);
     }
 
-  if (type == BOUNDARY_WITHIN_BOUNDS)
+  for (y = maskPR->y; y < maskPR->y + maskPR->h; y++)
     {
-      if (scanline < y1 || scanline >= y2)
+      if (bytes == 1)
         {
-          empty_segs[(*num_empty)++] = 0;
-          empty_segs[(*num_empty)++] = G_MAXINT;
-          return;
+          for (x = 0; x < maskPR->w; x++)
+            dest[x] = (src[x] > threshold);
         }
+      else
+        {
+          const guchar *s = src;
+
+          for (x = 0; x < maskPR->w; x++, s += bytes)
+            dest[x] = (*s > threshold);
+        }
+
+      if (ignore_x2 > ignore_x1 && y >= band->y1 && y < band->y2)
+        memset (dest + ignore_x1 - maskPR->x, 0, ignore_x2 - ignore_x1);
 
-      start = x1;
-      end   = x2;
+      src  += maskPR->rowstride;
+      dest += band->rowstride;
     }
-  else if (type == BOUNDARY_IGNORE_BOUNDS)
+}
+
+static const guchar *
+boundary_band_get_row (BoundaryBand *band,
+                       gint          scanline)
+{
+  if (scanline < band->row_y1 || scanline >= band->row_y2 ||
+      band->row_x2 <= band->row_x1)
+    return NULL;
+
+  /*  scanlines are requested in increasing order, so when we leave
+   *  the current band, threshold the tile rows starting at this one
+   */
+  if (scanline < band->band_y1 || scanline >= band->band_y2)
     {
-      start = maskPR->x;
-      end   = maskPR->x + maskPR->w;
-      if (scanline < y1 || scanline >= y2)
-        x2 = -1;
+      PixelRegion maskPR = *band->maskPR;
+
+      band->band_y1 = scanline;
+      band->band_y2 = MIN (band->row_y2,
+                           (scanline / TILE_HEIGHT + BAND_TILE_ROWS) *
+                           TILE_HEIGHT);
+
+      pixel_region_resize (&maskPR,
+                           band->row_x1, band->band_y1,
+                           band->row_x2 - band->row_x1,
+                           band->band_y2 - band->band_y1);
+
+      pixel_regions_process_parallel ((PixelProcessorFunc)
+                                      boundary_band_threshold,
+                                      band, 1, &maskPR);
     }
 
-  empty_segs[(*num_empty)++] = 0;
+  return band->data + (scanline - band->band_y1) * band->rowstride;
+}
 
-  l_num_empty = *num_empty;
+/*  Returns the first column at or after @x whose value differs from
+ *  @value, comparing a whole machine word of the row at a time where
+ *  possible.  Rows must be aligned to sizeof (gulong).
+ */
+static inline gint
+find_run_end (const guchar *row,
+              gint          x,
+              gint          width,
+              guchar        value)
+{
+  const gulong pattern = value ? (~0UL / 255) : 0;
 
-  bpp = maskPR->bytes;
+  for (; x < width && (x % sizeof (gulong)); x++)
+    if (row[x] != value)
+      return x;
 
-  if (! maskPR->tiles)
-    {
-      data  = maskPR->data + scanline * maskPR->rowstride;
-      endx = end;
-    }
+  for (; x + (gint) sizeof (gulong) <= width; x += sizeof (gulong))
+    if (*(const gulong *) (row + x) != pattern)
+      break;
 
-  for (x = start; x < end;)
-    {
-      /*  Check to see if we must advance to next tile  */
-      if (maskPR->tiles)
-        {
-          if ((x / TILE_WIDTH) != tilex)
-            {
-              if (tile)
-                tile_release (tile, FALSE);
+  for (; x < width; x++)
+    if (row[x] != value)
+      return x;
 
-              tile = tile_manager_get_tile (maskPR->tiles,
-                                            x, scanline, TRUE, FALSE);
-              data = ((const guchar *) tile_data_pointer (tile, x, scanline) +
-                      bpp - 1);
+  return x;
+}
 
-              tilex = x / TILE_WIDTH;
-            }
+static void
+find_empty_segs (const guchar *row,
+                 gint          x1,
+                 gint          x2,
+                 gint          empty_segs[],
+                 gint         *num_empty)
+{
+  gint width = x2 - x1;
+  gint x     = 0;
 
-          endx = x + (TILE_WIDTH - (x % TILE_WIDTH));
-          endx = MIN (end, endx);
-        }
+  *num_empty = 0;
 
-      if (type == BOUNDARY_IGNORE_BOUNDS && (endx > x1 || x < x2))
-        {
-          for (; x < endx; x++)
-            {
-              gint val;
-
-              if (*data > threshold)
-                {
-                  if (x >= x1 && x < x2)
-                    val = -1;
-                  else
-                    val = 1;
-                }
-              else
-                {
-                  val = -1;
-                }
-
-              data += bpp;
-
-              if (last != val)
-                empty_segs[l_num_empty++] = x;
-
-              last = val;
-            }
-        }
-      else
+  empty_segs[(*num_empty)++] = 0;
+
+  if (row)
+    {
+      while (x < width)
         {
-          for (; x < endx; x++)
-            {
-              gint val;
+          x = find_run_end (row, x, width, 0);
 
-              if (*data > threshold)
-                val = 1;
-              else
-                val = -1;
+          if (x == width)
+            break;
 
-              data += bpp;
+          empty_segs[(*num_empty)++] = x1 + x;
 
-              if (last != val)
-                empty_segs[l_num_empty++] = x;
+          x = find_run_end (row, x, width, 1);
 
-              last = val;
-            }
+          empty_segs[(*num_empty)++] = x1 + x;
         }
     }
 
-  *num_empty = l_num_empty;
-
-  if (last > 0)
-    empty_segs[(*num_empty)++] = x;
-
   empty_segs[(*num_empty)++] = G_MAXINT;
-
-  if (tile)
-    tile_release (tile, FALSE);
 }
 
 static void
@@ -679,18 +719,27 @@ generate_boundary (PixelRegion  *PR,
                    gint          y2,
                    guchar        threshold)
 {
-  Boundary *boundary;
-  gint      scanline;
-  gint      i;
-  gint      start, end;
-  gint     *tmp_segs;
+  Boundary     *boundary;
+  BoundaryBand  band = { 0, };
+  gint          scanline;
+  gint          i;
+  gint          start, end;
+  gint         *tmp_segs;
 
-  gint      num_empty_n = 0;
-  gint      num_empty_c = 0;
-  gint      num_empty_l = 0;
+  gint          num_empty_n = 0;
+  gint          num_empty_c = 0;
+  gint          num_empty_l = 0;
 
   boundary = boundary_new (PR);
 
+  band.maskPR    = PR;
+  band.type      = type;
+  band.x1        = x1;
+  band.y1        = y1;
+  band.x2        = x2;
+  band.y2        = y2;
+  band.threshold = threshold;
+
   start = 0;
   end   = 0;
 
@@ -698,30 +747,45 @@ generate_boundary (PixelRegion  *PR,
     {
       start = y1;
       end   = y2;
+
+      band.row_x1 = x1;
+      band.row_x2 = x2;
     }
   else if (type == BOUNDARY_IGNORE_BOUNDS)
     {
       start = PR->y;
       end   = PR->y + PR->h;
+
+      band.row_x1 = PR->x;
+      band.row_x2 = PR->x + PR->w;
+    }
+
+  /*  all scanlines outside of these are empty  */
+  band.row_y1 = MAX (start, PR->y);
+  band.row_y2 = MIN (end,   PR->y + PR->h);
+
+  if (band.row_x2 > band.row_x1 && band.row_y2 > band.row_y1)
+    {
+      band.rowstride = ((band.row_x2 - band.row_x1 + sizeof (gulong) - 1) /
+                        sizeof (gulong) * sizeof (gulong));
+      band.data      = g_malloc (band.rowstride *
+                                 BAND_TILE_ROWS * TILE_HEIGHT);
     }
 
   /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (PR, start - 1, boundary->empty_segs_l,
-                   boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
-  find_empty_segs (PR, start, boundary->empty_segs_c,
-                   boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+  find_empty_segs (boundary_band_get_row (&band, start - 1),
+                   band.row_x1, band.row_x2,
+                   boundary->empty_segs_l, &num_empty_l);
+  find_empty_segs (boundary_band_get_row (&band, start),
+                   band.row_x1, band.row_x2,
+                   boundary->empty_segs_c, &num_empty_c);
 
   for (scanline = start; scanline < end; scanline++)
     {
       /*  find the empty segment list for the next scanline  */
-      find_empty_segs (PR, scanline + 1, boundary->empty_segs_n,
-                       boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
+      find_empty_segs (boundary_band_get_row (&band, scanline + 1),
+                       band.row_x1, band.row_x2,
+                       boundary->empty_segs_n, &num_empty_n);
 
       /*  process the segments on the current scanline  */
       for (i = 1; i < num_empty_c - 1; i += 2)
@@ -747,6 +811,8 @@ generate_boundary (PixelRegion  *PR,
       boundary->empty_segs_n = tmp_segs;
     }
 
+  g_free (band.data);
+
   return boundary;
 }
 
@@ -782,139 +848,51 @@ cmp_xy (const gint ax,
 
 
 /*
- * Compares (x1, y1) pairs in specified segments, using their addresses if
- * (x1, y1) pairs are equal.
- */
-static gint
-cmp_segptr_xy1_addr (const BoundSeg **seg_ptr_a,
-                     const BoundSeg **seg_ptr_b)
-{
-  const BoundSeg *seg_a = *seg_ptr_a;
-  const BoundSeg *seg_b = *seg_ptr_b;
-
-  gint result = cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
-
-  if (result == 0)
-    {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
-    }
-
-  return result;
-}
-
-/*
- * Compares (x2, y2) pairs in specified segments, using their addresses if
- * (x2, y2) pairs are equal.
+ * Compares the positions of segment ends, using the segment order if
+ * the positions are equal.
  */
 static gint
-cmp_segptr_xy2_addr (const BoundSeg **seg_ptr_a,
-                     const BoundSeg **seg_ptr_b)
+cmp_boundary_end (const BoundaryEnd *end_a,
+                  const BoundaryEnd *end_b)
 {
-  const BoundSeg *seg_a = *seg_ptr_a;
-  const BoundSeg *seg_b = *seg_ptr_b;
-
-  gint result = cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
+  gint result = cmp_xy (end_a->x, end_a->y, end_b->x, end_b->y);
 
   if (result == 0)
-    {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
-    }
+    result = end_a->end - end_b->end;
 
   return result;
 }
 
-
 /*
- * Compares (x1, y1) pairs in specified segments.
+ * Returns the first non-visited segment of the run of segment ends
+ * starting at @run, and whether it is entered at its (x2, y2) end.
  */
-static gint
-cmp_segptr_xy1 (const BoundSeg **seg_ptr_a, const BoundSeg **seg_ptr_b)
-{
-  const BoundSeg *seg_a = *seg_ptr_a, *seg_b = *seg_ptr_b;
-
-  return cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
-}
-
-/*
- * Compares (x2, y2) pairs in specified segments.
- */
-static gint
-cmp_segptr_xy2 (const BoundSeg **seg_ptr_a,
-                const BoundSeg **seg_ptr_b)
-{
-  const BoundSeg *seg_a = *seg_ptr_a;
-  const BoundSeg *seg_b = *seg_ptr_b;
-
-  return cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
-}
-
-
 static const BoundSeg *
-find_segment (const BoundSeg **segs_by_xy1,
-              const BoundSeg **segs_by_xy2,
-              gint             num_segs,
-              gint             x,
-              gint             y)
+find_segment (const BoundSeg    *segs,
+              const BoundaryEnd *ends,
+              gint               num_ends,
+              gint               run,
+              gboolean          *reverse)
 {
-  const BoundSeg *segptr_xy1;
-  const BoundSeg *segptr_xy2;
-  BoundSeg        search_seg;
-
-  search_seg.x1 = search_seg.x2 = x;
-  search_seg.y1 = search_seg.y2 = y;
-
-  segptr_xy1 = find_segment_with_func (segs_by_xy1, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy1);
-  segptr_xy2 = find_segment_with_func (segs_by_xy2, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy2);
-
-  /* return segment with smaller address */
-  if (segptr_xy1 != NULL && segptr_xy2 != NULL)
-    return MIN(segptr_xy1, segptr_xy2);
-  else if (segptr_xy1 != NULL)
-    return segptr_xy1;
-  else if (segptr_xy2 != NULL)
-    return segptr_xy2;
-
-  return NULL;
-}
+  gint index;
 
+  for (index = run;
+       index < num_ends &&
+       ends[index].x == ends[run].x &&
+       ends[index].y == ends[run].y;
+       index++)
+    {
+      const BoundSeg *seg = segs + ends[index].end / 2;
 
-static const BoundSeg *
-find_segment_with_func (const BoundSeg **segs,
-                        gint             num_segs,
-                        const BoundSeg  *search_seg,
-                        GCompareFunc     cmp_func)
-{
-  const BoundSeg **seg;
-  const BoundSeg *found_seg = NULL;
-
-  seg = bsearch (&search_seg, segs, num_segs, sizeof (BoundSeg *), cmp_func);
+      if (! seg->visited)
+        {
+          *reverse = ends[index].end & 1;
 
-  if (seg != NULL)
-    {
-      /* find first matching segment */
-      while (seg > segs && cmp_func (seg - 1, &search_seg) == 0)
-        seg--;
-
-      /* find first non-visited segment */
-      while (seg != segs + num_segs && cmp_func (seg, &search_seg) == 0)
-        if (!(*seg)->visited)
-          {
-            found_seg = *seg;
-            break;
-          }
-        else
-          seg++;
+          return seg;
+        }
     }
 
-    return found_seg;
+  return NULL;
 }
 
 
@@ -21,7 +21,6 @@
 
 #include <string.h>
 
-#undef G_DISABLE_DEPRECATED /* GStaticMutex */
 #include <glib-object.h>
 
 #include "libgimpmath/gimpmath.h"
@@ -31,24 +30,50 @@
 #include "gimphistogram.h"
 #include "pixel-processor.h"
 #include "pixel-region.h"
+#include "tile.h"
 
 
 #ifdef ENABLE_MP
-#define NUM_SLOTS  GIMP_MAX_NUM_THREADS
+#define NUM_SLOTS  (GIMP_MAX_NUM_THREADS + 1)  /* the workers and the caller */
 #else
 #define NUM_SLOTS  1
 #endif
 
+/*  incremental histograms keep separate counts per chunk of tiles  */
+#define CHUNK_WIDTH   (8 * TILE_WIDTH)
+#define CHUNK_HEIGHT  (8 * TILE_HEIGHT)
+
+/*  the integer counters of a sub region are flushed before they can
+ *  overflow, 65536 pixels at 255 * 255 per pixel still fit
+ */
+#define BATCH_PIXELS  65536
+
 
 struct _GimpHistogram
 {
   gint           ref_count;
   gint           n_channels;
+  gdouble       *values;
+
+  /*  per-thread partial results of a calculation  */
 #ifdef ENABLE_MP
-  GStaticMutex   mutex;
-  gchar          slots[NUM_SLOTS];
+  volatile gint  busy[NUM_SLOTS];
 #endif
-  gdouble       *values[NUM_SLOTS];
+  gdouble       *partials[NUM_SLOTS];
+
+  /*  the region of the last incremental calculation  */
+  TileManager   *tiles;
+  TileManager   *mask_tiles;
+  gint           x;
+  gint           y;
+  gint           width;
+  gint           height;
+  gint           mask_x;
+  gint           mask_y;
+  gint           n_chunk_cols;
+  gint           n_chunk_rows;
+  gdouble       *chunks;
+  gboolean      *chunk_dirty;
 };
 
 
@@ -57,6 +82,14 @@ struct _GimpHistogram
 static void  gimp_histogram_alloc_values         (GimpHistogram *histogram,
                                                   gint           bytes);
 static void  gimp_histogram_free_values          (GimpHistogram *histogram);
+static void  gimp_histogram_free_chunks          (GimpHistogram *histogram);
+static void  gimp_histogram_init_chunks          (GimpHistogram *histogram,
+                                                  PixelRegion   *region,
+                                                  PixelRegion   *mask);
+static void  gimp_histogram_count                (GimpHistogram *histogram,
+                                                  PixelRegion   *region,
+                                                  PixelRegion   *mask,
+                                                  gdouble       *values);
 static void  gimp_histogram_calculate_sub_region (GimpHistogram *histogram,
                                                   PixelRegion   *region,
                                                   PixelRegion   *mask);
@@ -71,10 +104,6 @@ gimp_histogram_new (void)
 
   histogram->ref_count = 1;
 
-#ifdef ENABLE_MP
-  g_static_mutex_init (&histogram->mutex);
-#endif
-
   return histogram;
 }
 
@@ -120,18 +149,10 @@ gimp_histogram_duplicate (GimpHistogram *histogram)
 
   dup = gimp_histogram_new ();
 
-#ifdef ENABLE_MP
-  g_static_mutex_lock (&histogram->mutex);
-#endif
-
   dup->n_channels = histogram->n_channels;
-  dup->values[0]  = g_memdup (histogram->values[0],
+  dup->values     = g_memdup (histogram->values,
                               sizeof (gdouble) * dup->n_channels * 256);
 
-#ifdef ENABLE_MP
-  g_static_mutex_unlock (&histogram->mutex);
-#endif
-
   return dup;
 }
 
@@ -140,8 +161,6 @@ gimp_histogram_calculate (GimpHistogram *histogram,
                           PixelRegion   *region,
                           PixelRegion   *mask)
 {
-  gint i;
-
   g_return_if_fail (histogram != NULL);
 
   if (! region)
@@ -151,31 +170,145 @@ gimp_histogram_calculate (GimpHistogram *histogram,
     }
 
   gimp_histogram_alloc_values (histogram, region->bytes);
+  gimp_histogram_free_chunks (histogram);
 
-  for (i = 0; i < NUM_SLOTS; i++)
-    if (histogram->values[i])
-      memset (histogram->values[i],
-              0, histogram->n_channels * 256 * sizeof (gdouble));
+  memset (histogram->values, 0, histogram->n_channels * 256 * sizeof (gdouble));
 
-  pixel_regions_process_parallel ((PixelProcessorFunc)
-                                  gimp_histogram_calculate_sub_region,
-                                  histogram, 2, region, mask);
+  gimp_histogram_count (histogram, region, mask, histogram->values);
+}
 
-#ifdef ENABLE_MP
-  /* add up all slots */
-  for (i = 1; i < NUM_SLOTS; i++)
-    if (histogram->values[i])
-      {
-        gint j;
+/**
+ * gimp_histogram_calculate_incremental:
+ * @histogram: a %GimpHistogram
+ * @region:    the region to count, must be tile based
+ * @mask:      an optional mask for @region
+ *
+ * Like gimp_histogram_calculate(), but if @region and @mask are the
+ * same as in the previous call, only the areas passed to
+ * gimp_histogram_invalidate() since then are counted again.  It is
+ * up to the caller to invalidate every change of the pixels.
+ **/
+void
+gimp_histogram_calculate_incremental (GimpHistogram *histogram,
+                                      PixelRegion   *region,
+                                      PixelRegion   *mask)
+{
+  gint n_values;
+  gint n_chunks;
+  gint i, j;
 
-        for (j = 0; j < histogram->n_channels * 256; j++)
-          histogram->values[0][j] += histogram->values[i][j];
-      }
-#endif
+  g_return_if_fail (histogram != NULL);
+
+  if (! region || ! region->tiles)
+    {
+      gimp_histogram_calculate (histogram, region, mask);
+      return;
+    }
+
+  gimp_histogram_alloc_values (histogram, region->bytes);
+
+  n_values = histogram->n_channels * 256;
+
+  if (! histogram->chunks                         ||
+      histogram->tiles      != region->tiles      ||
+      histogram->x          != region->x          ||
+      histogram->y          != region->y          ||
+      histogram->width      != region->w          ||
+      histogram->height     != region->h          ||
+      histogram->mask_tiles != (mask ? mask->tiles : NULL) ||
+      (mask && (histogram->mask_x != mask->x ||
+                histogram->mask_y != mask->y)))
+    {
+      gimp_histogram_init_chunks (histogram, region, mask);
+    }
+
+  n_chunks = histogram->n_chunk_cols * histogram->n_chunk_rows;
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      const gint   col    = i % histogram->n_chunk_cols;
+      const gint   row    = i / histogram->n_chunk_cols;
+      const gint   x      = col * CHUNK_WIDTH;
+      const gint   y      = row * CHUNK_HEIGHT;
+      const gint   width  = MIN (CHUNK_WIDTH,  histogram->width  - x);
+      const gint   height = MIN (CHUNK_HEIGHT, histogram->height - y);
+      gdouble     *values = histogram->chunks + i * n_values;
+      PixelRegion  chunkPR;
+      PixelRegion  chunk_maskPR;
+
+      if (! histogram->chunk_dirty[i])
+        continue;
+
+      pixel_region_init (&chunkPR, histogram->tiles,
+                         histogram->x + x, histogram->y + y, width, height,
+                         FALSE);
+
+      if (mask)
+        pixel_region_init (&chunk_maskPR, histogram->mask_tiles,
+                           histogram->mask_x + x, histogram->mask_y + y,
+                           width, height, FALSE);
+
+      memset (values, 0, n_values * sizeof (gdouble));
+
+      gimp_histogram_count (histogram,
+                            &chunkPR, mask ? &chunk_maskPR : NULL, values);
+
+      histogram->chunk_dirty[i] = FALSE;
+    }
+
+  memset (histogram->values, 0, n_values * sizeof (gdouble));
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      const gdouble *values = histogram->chunks + i * n_values;
+
+      for (j = 0; j < n_values; j++)
+        histogram->values[j] += values[j];
+    }
+}
+
+/**
+ * gimp_histogram_invalidate:
+ * @histogram: a %GimpHistogram
+ * @x:         left edge of the changed area
+ * @y:         top edge of the changed area
+ * @width:     width of the changed area
+ * @height:    height of the changed area
+ *
+ * Marks an area, in the coordinates of the tiles the histogram was
+ * last calculated from, as changed for the next call to
+ * gimp_histogram_calculate_incremental().
+ **/
+void
+gimp_histogram_invalidate (GimpHistogram *histogram,
+                           gint           x,
+                           gint           y,
+                           gint           width,
+                           gint           height)
+{
+  gint x1, y1, x2, y2;
+  gint col, row;
+
+  g_return_if_fail (histogram != NULL);
+
+  if (! histogram->chunks)
+    return;
+
+  x1 = MAX (x - histogram->x, 0);
+  y1 = MAX (y - histogram->y, 0);
+  x2 = MIN (x - histogram->x + width,  histogram->width);
+  y2 = MIN (y - histogram->y + height, histogram->height);
+
+  if (x2 <= x1 || y2 <= y1)
+    return;
+
+  for (row = y1 / CHUNK_HEIGHT; row <= (y2 - 1) / CHUNK_HEIGHT; row++)
+    for (col = x1 / CHUNK_WIDTH; col <= (x2 - 1) / CHUNK_WIDTH; col++)
+      histogram->chunk_dirty[row * histogram->n_chunk_cols + col] = TRUE;
 }
 
 
-#define HISTOGRAM_VALUE(c,i) (histogram->values[0][(c) * 256 + (i)])
+#define HISTOGRAM_VALUE(c,i) (histogram->values[(c) * 256 + (i)])
 
 
 gdouble
@@ -191,7 +324,7 @@ gimp_histogram_get_maximum (GimpHistogram        *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
     return 0.0;
 
@@ -222,7 +355,7 @@ gimp_histogram_get_value (GimpHistogram        *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       bin < 0 || bin >= 256 ||
       (channel == GIMP_HISTOGRAM_RGB && histogram->n_channels < 4) ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
@@ -286,7 +419,7 @@ gimp_histogram_get_count (GimpHistogram        *histogram,
             gimp_histogram_get_count (histogram,
                                       GIMP_HISTOGRAM_BLUE, start, end));
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       start > end ||
       channel >= histogram->n_channels)
     return 0.0;
@@ -316,7 +449,7 @@ gimp_histogram_get_mean (GimpHistogram        *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       start > end ||
       (channel == GIMP_HISTOGRAM_RGB && histogram->n_channels < 4) ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
@@ -362,7 +495,7 @@ gimp_histogram_get_median (GimpHistogram         *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       start > end ||
       (channel == GIMP_HISTOGRAM_RGB && histogram->n_channels < 4) ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
@@ -424,7 +557,7 @@ gimp_histogram_get_threshold (GimpHistogram        *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       start > end ||
       (channel == GIMP_HISTOGRAM_RGB && histogram->n_channels < 4) ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
@@ -507,7 +640,7 @@ gimp_histogram_get_std_dev (GimpHistogram        *histogram,
   if (histogram->n_channels == 3 && channel == GIMP_HISTOGRAM_ALPHA)
     channel = 1;
 
-  if (! histogram->values[0] ||
+  if (! histogram->values ||
       start > end ||
       (channel == GIMP_HISTOGRAM_RGB && histogram->n_channels < 4) ||
       (channel != GIMP_HISTOGRAM_RGB && channel >= histogram->n_channels))
@@ -553,7 +686,7 @@ gimp_histogram_alloc_values (GimpHistogram *histogram,
 
       histogram->n_channels = bytes + 1;
 
-      histogram->values[0] = g_new (gdouble, histogram->n_channels * 256);
+      histogram->values = g_new (gdouble, histogram->n_channels * 256);
     }
 }
 
@@ -562,278 +695,351 @@ gimp_histogram_free_values (GimpHistogram *histogram)
 {
   gint i;
 
+  gimp_histogram_free_chunks (histogram);
+
+  if (histogram->values)
+    {
+      g_free (histogram->values);
+      histogram->values = NULL;
+    }
+
   for (i = 0; i < NUM_SLOTS; i++)
-    if (histogram->values[i])
+    if (histogram->partials[i])
       {
-        g_free (histogram->values[i]);
-        histogram->values[i] = NULL;
+        g_free (histogram->partials[i]);
+        histogram->partials[i] = NULL;
       }
 
   histogram->n_channels = 0;
 }
 
 static void
-gimp_histogram_calculate_sub_region (GimpHistogram *histogram,
-                                     PixelRegion   *region,
-                                     PixelRegion   *mask)
+gimp_histogram_free_chunks (GimpHistogram *histogram)
 {
-  const guchar *src, *msrc;
-  const guchar *m, *s;
-  gdouble      *values;
-  gint          h, w, max;
+  if (histogram->chunks)
+    {
+      g_free (histogram->chunks);
+      g_free (histogram->chunk_dirty);
 
-#ifdef ENABLE_MP
-  gint slot = 0;
+      histogram->chunks      = NULL;
+      histogram->chunk_dirty = NULL;
+    }
+}
+
+static void
+gimp_histogram_init_chunks (GimpHistogram *histogram,
+                            PixelRegion   *region,
+                            PixelRegion   *mask)
+{
+  gint n_chunks;
+  gint i;
 
-  /* find an unused temporary slot to put our results in and lock it */
-  g_static_mutex_lock (&histogram->mutex);
+  gimp_histogram_free_chunks (histogram);
 
-  while (histogram->slots[slot])
-    slot++;
+  histogram->tiles        = region->tiles;
+  histogram->x            = region->x;
+  histogram->y            = region->y;
+  histogram->width        = region->w;
+  histogram->height       = region->h;
+  histogram->mask_tiles   = mask ? mask->tiles : NULL;
+  histogram->mask_x       = mask ? mask->x     : 0;
+  histogram->mask_y       = mask ? mask->y     : 0;
+  histogram->n_chunk_cols = (region->w + CHUNK_WIDTH  - 1) / CHUNK_WIDTH;
+  histogram->n_chunk_rows = (region->h + CHUNK_HEIGHT - 1) / CHUNK_HEIGHT;
 
-  values = histogram->values[slot];
-  histogram->slots[slot] = 1;
+  n_chunks = histogram->n_chunk_cols * histogram->n_chunk_rows;
 
-  g_static_mutex_unlock (&histogram->mutex);
+  histogram->chunks      = g_new (gdouble,
+                                  n_chunks * histogram->n_channels * 256);
+  histogram->chunk_dirty = g_new (gboolean, n_chunks);
 
-  if (! values)
-    {
-      histogram->values[slot] = g_new0 (gdouble, histogram->n_channels * 256);
-      values = histogram->values[slot];
-    }
+  for (i = 0; i < n_chunks; i++)
+    histogram->chunk_dirty[i] = TRUE;
+}
 
-#else
-  values = histogram->values[0];
+/*  counts @region into the partial results of the threads and adds
+ *  them to @values
+ */
+static void
+gimp_histogram_count (GimpHistogram *histogram,
+                      PixelRegion   *region,
+                      PixelRegion   *mask,
+                      gdouble       *values)
+{
+  const gint n_values = histogram->n_channels * 256;
+  gint       i, j;
+
+  for (i = 0; i < NUM_SLOTS; i++)
+    if (histogram->partials[i])
+      memset (histogram->partials[i], 0, n_values * sizeof (gdouble));
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_histogram_calculate_sub_region,
+                                  histogram, 2, region, mask);
+
+  for (i = 0; i < NUM_SLOTS; i++)
+    if (histogram->partials[i])
+      {
+        const gdouble *partial = histogram->partials[i];
+
+        for (j = 0; j < n_values; j++)
+          values[j] += partial[j];
+      }
+}
+
+/*  Adds the integer counts of a sub region to a free slot.  Channels
+ *  weighted by alpha and/or the mask are counted in units of 1/255
+ *  per weight.
+ */
+static void
+gimp_histogram_flush (GimpHistogram *histogram,
+                      guint32        counts[][256],
+                      gint           bytes,
+                      gboolean       masked)
+{
+  gdouble *values;
+  gint     slot = 0;
+  gint     c, i;
+
+#ifdef ENABLE_MP
+  /*  there are never more concurrent callers than slots  */
+  while (! g_atomic_int_compare_and_exchange (&histogram->busy[slot], 0, 1))
+    slot = (slot + 1) % NUM_SLOTS;
 #endif
 
-#define VALUE(c,i) (values[(c) * 256 + (i)])
+  if (! histogram->partials[slot])
+    histogram->partials[slot] = g_new0 (gdouble, histogram->n_channels * 256);
 
-  h = region->h;
+  values = histogram->partials[slot];
 
-  if (mask)
+  for (c = 0; c < histogram->n_channels; c++, values += 256)
     {
-      src  = region->data;
-      msrc = mask->data;
+      const gboolean weighted = ((bytes == 2 && c == 0) ||
+                                 (bytes == 4 && c <  4));
+      gdouble        unit     = 1.0;
 
-      switch (region->bytes)
-        {
-        case 1:
-          while (h--)
-            {
-              s = src;
-              m = msrc;
-              w = region->w;
+      if (weighted)
+        unit /= 255.0;
 
-              while (w--)
-                {
-                  const gdouble masked = m[0] / 255.0;
+      if (masked)
+        unit /= 255.0;
 
-                  VALUE (0, s[0]) += masked;
+      for (i = 0; i < 256; i++)
+        values[i] += counts[c][i] * unit;
+    }
 
-                  s += 1;
-                  m += 1;
-                }
+#ifdef ENABLE_MP
+  g_atomic_int_set (&histogram->busy[slot], 0);
+#endif
+}
 
-              src  += region->rowstride;
-              msrc += mask->rowstride;
+static inline void
+gimp_histogram_count_row (guint32       counts[][256],
+                          const guchar *s,
+                          const guchar *m,
+                          gint          w,
+                          gint          bytes)
+{
+  gint max;
+
+  if (m)
+    {
+      switch (bytes)
+        {
+        case 1:
+          while (w--)
+            {
+              counts[0][s[0]] += m[0];
+
+              s += 1;
+              m += 1;
             }
           break;
 
         case 2:
-          while (h--)
+          while (w--)
             {
-              s = src;
-              m = msrc;
-              w = region->w;
-
-              while (w--)
-                {
-                  const gdouble masked = m[0] / 255.0;
-                  const gdouble weight = s[1] / 255.0;
-
-                  VALUE (0, s[0]) += weight * masked;
-                  VALUE (1, s[1]) += masked;
-
-                  s += 2;
-                  m += 1;
-                }
+              counts[0][s[0]] += s[1] * m[0];
+              counts[1][s[1]] += m[0];
 
-              src  += region->rowstride;
-              msrc += mask->rowstride;
+              s += 2;
+              m += 1;
             }
           break;
 
         case 3: /* calculate separate value values */
-          while (h--)
+          while (w--)
             {
-              s = src;
-              m = msrc;
-              w = region->w;
+              counts[1][s[0]] += m[0];
+              counts[2][s[1]] += m[0];
+              counts[3][s[2]] += m[0];
 
-              while (w--)
-                {
-                  const gdouble masked = m[0] / 255.0;
+              max = MAX (s[0], s[1]);
+              max = MAX (max, s[2]);
 
-                  VALUE (1, s[0]) += masked;
-                  VALUE (2, s[1]) += masked;
-                  VALUE (3, s[2]) += masked;
+              counts[0][max] += m[0];
 
-                  max = (s[0] > s[1]) ? s[0] : s[1];
-
-                  if (s[2] > max)
-                    VALUE (0, s[2]) += masked;
-                  else
-                    VALUE (0, max) += masked;
-
-                  s += 3;
-                  m += 1;
-                }
-
-              src  += region->rowstride;
-              msrc += mask->rowstride;
+              s += 3;
+              m += 1;
             }
           break;
 
         case 4: /* calculate separate value values */
-          while (h--)
+          while (w--)
             {
-              s = src;
-              m = msrc;
-              w = region->w;
-
-              while (w--)
-                {
-                  const gdouble masked = m[0] / 255.0;
-                  const gdouble weight = s[3] / 255.0;
-
-                  VALUE (1, s[0]) += weight * masked;
-                  VALUE (2, s[1]) += weight * masked;
-                  VALUE (3, s[2]) += weight * masked;
-                  VALUE (4, s[3]) += masked;
+              const guint32 weight = s[3] * m[0];
 
-                  max = (s[0] > s[1]) ? s[0] : s[1];
+              counts[1][s[0]] += weight;
+              counts[2][s[1]] += weight;
+              counts[3][s[2]] += weight;
+              counts[4][s[3]] += m[0];
 
-                  if (s[2] > max)
-                   VALUE (0, s[2]) += weight * masked;
-                  else
-                    VALUE (0, max) += weight * masked;
+              max = MAX (s[0], s[1]);
+              max = MAX (max, s[2]);
 
-                  s += 4;
-                  m += 1;
-                }
+              counts[0][max] += weight;
 
-              src  += region->rowstride;
-              msrc += mask->rowstride;
+              s += 4;
+              m += 1;
             }
           break;
         }
     }
   else /* no mask */
     {
-      src = region->data;
-
-      switch (region->bytes)
+      switch (bytes)
         {
         case 1:
-          while (h--)
+          /*  four interleaved partial histograms, so that runs of
+           *  equal pixels don't serialize on one counter; they are
+           *  folded into the first one by the caller
+           */
+          for (; w >= 4; w -= 4, s += 4)
             {
-              s = src;
-              w = region->w;
+              counts[0][s[0]]++;
+              counts[1][s[1]]++;
+              counts[2][s[2]]++;
+              counts[3][s[3]]++;
+            }
 
-              while (w--)
-                {
-                  VALUE (0, s[0]) += 1.0;
+          while (w--)
+            counts[0][*s++]++;
+          break;
 
-                  s += 1;
-                }
+        case 2:
+          while (w--)
+            {
+              counts[0][s[0]] += s[1];
+              counts[1][s[1]]++;
 
-              src += region->rowstride;
+              s += 2;
             }
           break;
 
-        case 2:
-          while (h--)
+        case 3: /* calculate separate value values */
+          while (w--)
             {
-              s = src;
-              w = region->w;
-
-              while (w--)
-                {
-                  const gdouble weight = s[1] / 255;
+              counts[1][s[0]]++;
+              counts[2][s[1]]++;
+              counts[3][s[2]]++;
 
-                  VALUE (0, s[0]) += weight;
-                  VALUE (1, s[1]) += 1.0;
+              max = MAX (s[0], s[1]);
+              max = MAX (max, s[2]);
 
-                  s += 2;
-                }
+              counts[0][max]++;
 
-              src += region->rowstride;
+              s += 3;
             }
           break;
 
-        case 3: /* calculate separate value values */
-          while (h--)
+        case 4: /* calculate separate value values */
+          while (w--)
             {
-              s = src;
-              w = region->w;
-
-              while (w--)
-                {
-                  VALUE (1, s[0]) += 1.0;
-                  VALUE (2, s[1]) += 1.0;
-                  VALUE (3, s[2]) += 1.0;
+              const guint32 weight = s[3];
 
-                  max = (s[0] > s[1]) ? s[0] : s[1];
+              counts[1][s[0]] += weight;
+              counts[2][s[1]] += weight;
+              counts[3][s[2]] += weight;
+              counts[4][s[3]]++;
 
-                  if (s[2] > max)
-                    VALUE (0, s[2]) += 1.0;
-                  else
-                    VALUE (0, max) += 1.0;
+              max = MAX (s[0], s[1]);
+              max = MAX (max, s[2]);
 
-                  s += 3;
-                }
+              counts[0][max] += weight;
 
-              src += region->rowstride;
+              s += 4;
             }
           break;
+        }
+    }
+}
 
-        case 4: /* calculate separate value values */
-          while (h--)
-            {
-              s = src;
-              w = region->w;
+static inline void
+gimp_histogram_fold (guint32 counts[][256])
+{
+  gint i;
+
+  for (i = 0; i < 256; i++)
+    {
+      counts[0][i] += counts[1][i] + counts[2][i] + counts[3][i];
+
+      counts[1][i] = counts[2][i] = counts[3][i] = 0;
+    }
+}
 
-              while (w--)
-                {
-                  const gdouble weight = s[3] / 255;
+static void
+gimp_histogram_calculate_sub_region (GimpHistogram *histogram,
+                                     PixelRegion   *region,
+                                     PixelRegion   *mask)
+{
+  guint32       counts[MAX_CHANNELS + 1][256];
+  const gint    bytes    = region->bytes;
+  const gint    n_counts = (bytes == 1) ? 4 : histogram->n_channels;
+  const guchar *src      = region->data;
+  const guchar *msrc     = mask ? mask->data : NULL;
+  gint          n_pixels = 0;
+  gint          h;
 
-                  VALUE (1, s[0]) += weight;
-                  VALUE (2, s[1]) += weight;
-                  VALUE (3, s[2]) += weight;
-                  VALUE (4, s[3]) += 1.0;
+  memset (counts, 0, n_counts * sizeof (counts[0]));
 
-                  max = (s[0] > s[1]) ? s[0] : s[1];
+  for (h = 0; h < region->h; h++)
+    {
+      gint x = 0;
 
-                  if (s[2] > max)
-                    VALUE (0, s[2]) += weight;
-                  else
-                    VALUE (0, max) += weight;
+      while (x < region->w)
+        {
+          const gint w = MIN (region->w - x, BATCH_PIXELS - n_pixels);
 
-                  s += 4;
-                }
+          gimp_histogram_count_row (counts,
+                                    src + x * bytes, msrc ? msrc + x : NULL,
+                                    w, bytes);
 
-              src += region->rowstride;
+          x        += w;
+          n_pixels += w;
+
+          if (n_pixels == BATCH_PIXELS)
+            {
+              if (bytes == 1 && ! mask)
+                gimp_histogram_fold (counts);
+
+              gimp_histogram_flush (histogram, counts, bytes, mask != NULL);
+              memset (counts, 0, n_counts * sizeof (counts[0]));
+
+              n_pixels = 0;
             }
-          break;
         }
-    }
 
-#ifdef ENABLE_MP
-  /* unlock this slot */
-  g_static_mutex_lock (&histogram->mutex);
+      src += region->rowstride;
 
-  histogram->slots[slot] = 0;
+      if (msrc)
+        msrc += mask->rowstride;
+    }
 
-  g_static_mutex_unlock (&histogram->mutex);
-#endif
+  if (n_pixels > 0)
+    {
+      if (bytes == 1 && ! mask)
+        gimp_histogram_fold (counts);
+
+      gimp_histogram_flush (histogram, counts, bytes, mask != NULL);
+    }
 }
@@ -36,14 +36,10 @@
 
 
 #define TILES_PER_THREAD  8
+#define TILES_PER_RANGE   4
 #define PROGRESS_TIMEOUT  64
 
 
-static GThreadPool *pool       = NULL;
-static GMutex      *pool_mutex = NULL;
-static GCond       *pool_cond  = NULL;
-
-
 typedef void  (* p1_func) (gpointer      data,
                            PixelRegion  *region1);
 typedef void  (* p2_func) (gpointer      data,
@@ -60,7 +56,9 @@ typedef void  (* p4_func) (gpointer      data,
                            PixelRegion  *region4);
 
 
-typedef struct _PixelProcessor PixelProcessor;
+typedef struct _PixelProcessor       PixelProcessor;
+typedef struct _PixelProcessorRange  PixelProcessorRange;
+typedef struct _PixelProcessorWorker PixelProcessorWorker;
 
 struct _PixelProcessor
 {
@@ -68,9 +66,11 @@ struct _PixelProcessor
   gpointer             data;
 
 #ifdef ENABLE_MP
-  GMutex              *mutex;
-  gint                 threads;
-  gboolean             first;
+  PixelRegion          templates[4];   /*  the regions before registering  */
+  PixelProcessorRange *ranges;
+  gint                 n_ranges;
+  volatile gint        remaining;      /*  ranges not finished yet         */
+  volatile gint        queued;         /*  ranges not taken yet            */
 #endif
 
   PixelRegionIterator *PRI;
@@ -80,114 +80,464 @@ struct _PixelProcessor
   gulong               progress;
 };
 
+#ifdef ENABLE_MP
+
+/*  The area covered by the regions is cut into ranges of up to
+ *  TILES_PER_RANGE tiles within a single row of tiles, so that every
+ *  range can be processed by its own PixelRegionIterator without any
+ *  lock shared between the threads.  x and y are offsets relative to
+ *  the origin of each region.
+ */
+struct _PixelProcessorRange
+{
+  PixelProcessor *processor;
+  gint            x;
+  gint            y;
+  gint            w;
+  gint            h;
+};
+
+/*  Every worker owns a deque of ranges.  The owner takes ranges from
+ *  the tail, idle workers steal from the head.  A caller waiting for
+ *  its job only takes ranges of that job, wherever they are queued,
+ *  so it never ends up validating tiles for an unrelated job.
+ */
+struct _PixelProcessorWorker
+{
+  GThread *thread;
+  GMutex  *mutex;
+  GQueue   ranges;
+};
+
+
+static PixelProcessorWorker *workers      = NULL;
+static gint                  n_workers    = 0;
+static gboolean              workers_quit = FALSE;
+
+static GMutex               *sched_mutex  = NULL;
+static GCond                *sched_cond   = NULL;  /*  ranges were queued  */
+static GCond                *done_cond    = NULL;  /*  a job finished      */
+static volatile gint         n_queued     = 0;
+
+static GStaticPrivate        current_worker = G_STATIC_PRIVATE_INIT;
+
+#endif
+
+
+static void
+do_parallel_regions_call (PixelProcessor  *processor,
+                          PixelRegion    **regions)
+{
+  switch (processor->num_regions)
+    {
+    case 1:
+      ((p1_func) processor->func) (processor->data,
+                                   regions[0]);
+      break;
+
+    case 2:
+      ((p2_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1]);
+      break;
+
+    case 3:
+      ((p3_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1],
+                                   regions[2]);
+      break;
+
+    case 4:
+      ((p4_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1],
+                                   regions[2],
+                                   regions[3]);
+      break;
+
+    default:
+      g_warning ("do_parallel_regions: Bad number of regions %d\n",
+                 processor->num_regions);
+      break;
+    }
+}
 
 #ifdef ENABLE_MP
 static void
-do_parallel_regions (PixelProcessor *processor)
+do_parallel_regions (PixelProcessorRange *range)
 {
-  PixelRegion tr[4];
-  gint        i;
+  PixelProcessor      *processor = range->processor;
+  PixelRegion          tr[4];
+  PixelRegion         *regions[4];
+  PixelRegionIterator *PRI;
+  gint                 i;
 
-  g_mutex_lock (processor->mutex);
+  for (i = 0; i < processor->num_regions; i++)
+    {
+      if (processor->regions[i])
+        {
+          memcpy (&tr[i], &processor->templates[i], sizeof (PixelRegion));
 
-  /*  the first thread getting here must not call pixel_regions_process()  */
-  if (! processor->first && processor->PRI)
-    processor->PRI = pixel_regions_process (processor->PRI);
-  else
-    processor->first = FALSE;
+          pixel_region_resize (&tr[i],
+                               tr[i].x + range->x, tr[i].y + range->y,
+                               range->w, range->h);
+
+          regions[i] = &tr[i];
+        }
+      else
+        {
+          regions[i] = NULL;
+        }
+    }
+
+  switch (processor->num_regions)
+    {
+    case 1:
+      PRI = pixel_regions_register (1, regions[0]);
+      break;
+
+    case 2:
+      PRI = pixel_regions_register (2, regions[0], regions[1]);
+      break;
+
+    case 3:
+      PRI = pixel_regions_register (3, regions[0], regions[1], regions[2]);
+      break;
 
-  while (processor->PRI)
+    case 4:
+      PRI = pixel_regions_register (4,
+                                    regions[0], regions[1],
+                                    regions[2], regions[3]);
+      break;
+
+    default:
+      PRI = NULL;
+      break;
+    }
+
+  for (; PRI; PRI = pixel_regions_process (PRI))
+    do_parallel_regions_call (processor, regions);
+}
+
+/*  pops a range from the tail or the head of @worker's deque, or the
+ *  range of @processor closest to that end if @processor is not NULL
+ */
+static PixelProcessorRange *
+pixel_processor_pop_range (PixelProcessorWorker *worker,
+                           PixelProcessor       *processor,
+                           gboolean              tail)
+{
+  PixelProcessorRange *range = NULL;
+
+  g_mutex_lock (worker->mutex);
+
+  if (! processor)
+    {
+      if (tail)
+        range = g_queue_pop_tail (&worker->ranges);
+      else
+        range = g_queue_pop_head (&worker->ranges);
+    }
+  else
     {
-      const guint pixels = (processor->PRI->portion_width *
-                            processor->PRI->portion_height);
+      GList *list;
 
-      for (i = 0; i < processor->num_regions; i++)
+      for (list = tail ? worker->ranges.tail : worker->ranges.head;
+           list;
+           list = tail ? g_list_previous (list) : g_list_next (list))
         {
-          if (processor->regions[i])
-            {
-              memcpy (&tr[i], processor->regions[i], sizeof (PixelRegion));
+          PixelProcessorRange *candidate = list->data;
 
-              if (tr[i].tiles)
-                tile_lock (tr[i].curtile);
+          if (candidate->processor == processor)
+            {
+              g_queue_delete_link (&worker->ranges, list);
+              range = candidate;
+              break;
             }
         }
+    }
+
+  g_mutex_unlock (worker->mutex);
+
+  return range;
+}
 
-      g_mutex_unlock (processor->mutex);
+/*  Takes a range from @self's deque or steals one from another
+ *  worker.  If @processor is not NULL, only ranges of @processor are
+ *  taken.
+ */
+static PixelProcessorRange *
+pixel_processor_take_range (PixelProcessorWorker *self,
+                            PixelProcessor       *processor)
+{
+  PixelProcessorRange *range = NULL;
+  gint                 start = 0;
+  gint                 i;
+
+  if (processor)
+    {
+      if (g_atomic_int_get (&processor->queued) <= 0)
+        return NULL;
+    }
+  else if (g_atomic_int_get (&n_queued) <= 0)
+    {
+      return NULL;
+    }
 
-      switch (processor->num_regions)
+  if (self)
+    {
+      range = pixel_processor_pop_range (self, processor, TRUE);
+
+      start = self - workers + 1;
+    }
+
+  for (i = 0; ! range && i < n_workers; i++)
+    {
+      PixelProcessorWorker *victim = &workers[(start + i) % n_workers];
+
+      if (victim == self)
+        continue;
+
+      range = pixel_processor_pop_range (victim, processor, FALSE);
+    }
+
+  if (range)
+    {
+      g_atomic_int_add (&range->processor->queued, -1);
+      g_atomic_int_add (&n_queued, -1);
+    }
+
+  return range;
+}
+
+static void
+pixel_processor_run_range (PixelProcessorRange *range)
+{
+  PixelProcessor *processor = range->processor;
+
+  do_parallel_regions (range);
+
+  /*  the processor may be gone as soon as the last range is done  */
+  if (g_atomic_int_dec_and_test (&processor->remaining))
+    {
+      g_mutex_lock (sched_mutex);
+      g_cond_broadcast (done_cond);
+      g_mutex_unlock (sched_mutex);
+    }
+}
+
+static gpointer
+pixel_processor_worker (PixelProcessorWorker *self)
+{
+  g_static_private_set (&current_worker, self, NULL);
+
+  while (TRUE)
+    {
+      PixelProcessorRange *range = pixel_processor_take_range (self, NULL);
+      gboolean             quit;
+
+      if (range)
         {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL,
-                                       processor->regions[3] ? &tr[3] : NULL);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
+          pixel_processor_run_range (range);
+          continue;
         }
 
-      g_mutex_lock (processor->mutex);
+      g_mutex_lock (sched_mutex);
+
+      while (! workers_quit && g_atomic_int_get (&n_queued) <= 0)
+        g_cond_wait (sched_cond, sched_mutex);
+
+      quit = workers_quit;
 
-      for (i = 0; i < processor->num_regions; i++)
+      g_mutex_unlock (sched_mutex);
+
+      if (quit)
+        break;
+    }
+
+  return NULL;
+}
+
+static void
+pixel_processor_split (PixelProcessor *processor,
+                       gint            width,
+                       gint            height)
+{
+  const PixelRegion *ref = NULL;
+  gint               max_width;
+  gint               x, y;
+  gint               i;
+
+  /*  align the ranges to the tiles of the first tiled region  */
+  for (i = 0; i < processor->num_regions && ! ref; i++)
+    if (processor->regions[i] && processor->templates[i].tiles)
+      ref = &processor->templates[i];
+
+  max_width = TILES_PER_RANGE * TILE_WIDTH;
+
+  processor->n_ranges = (((height + TILE_HEIGHT - 1) / TILE_HEIGHT + 1) *
+                         ((width + max_width - 1) / max_width + 1));
+  processor->ranges   = g_new (PixelProcessorRange, processor->n_ranges);
+  processor->n_ranges = 0;
+
+  for (y = 0; y < height;)
+    {
+      gint h = TILE_HEIGHT - (ref ? ref->y % TILE_HEIGHT : 0);
+
+      if (y > 0)
+        h = TILE_HEIGHT;
+
+      h = MIN (h, height - y);
+
+      for (x = 0; x < width;)
         {
-          if (processor->regions[i])
-            {
-              if (tr[i].tiles)
-                tile_release (tr[i].curtile, tr[i].dirty);
-            }
-        }
+          PixelProcessorRange *range;
+          gint                 w = max_width - (ref ? ref->x % TILE_WIDTH : 0);
 
-      processor->progress += pixels;
+          if (x > 0)
+            w = max_width;
 
-      if (processor->PRI)
-        processor->PRI = pixel_regions_process (processor->PRI);
+          w = MIN (w, width - x);
+
+          range = &processor->ranges[processor->n_ranges++];
+
+          range->processor = processor;
+          range->x         = x;
+          range->y         = y;
+          range->w         = w;
+          range->h         = h;
+
+          x += w;
+        }
+
+      y += h;
     }
 
-  processor->threads--;
+  processor->remaining = processor->n_ranges;
+  processor->queued    = processor->n_ranges;
+}
 
-  if (processor->threads == 0)
+static void
+do_parallel_regions_stealing (PixelProcessor             *processor,
+                              PixelProcessorProgressFunc  progress_func,
+                              gpointer                    progress_data)
+{
+  PixelProcessorWorker *self = g_static_private_get (&current_worker);
+  GTimeVal              last_time;
+  guint                 depth;
+  gint                  chunk;
+  gint                  first;
+  gint                  i;
+
+  /*  if we are called from a validate proc, let the other threads
+   *  validate tiles while we wait for them
+   */
+  depth = tile_validate_suspend ();
+
+  /*  hand out contiguous chunks of ranges, starting with our own
+   *  deque when called from a worker; each chunk is pushed in reverse
+   *  so that its owner walks it in order while thieves take the far end
+   */
+  chunk = (processor->n_ranges + n_workers - 1) / n_workers;
+  first = self ? self - workers : 0;
+
+  g_atomic_int_add (&n_queued, processor->n_ranges);
+
+  for (i = 0; i < n_workers; i++)
     {
-      g_mutex_unlock (processor->mutex);
+      PixelProcessorWorker *worker = &workers[(first + i) % n_workers];
+      gint                  begin  = i * chunk;
+      gint                  end    = MIN (begin + chunk, processor->n_ranges);
+      gint                  j;
+
+      if (begin >= end)
+        break;
+
+      g_mutex_lock (worker->mutex);
+
+      for (j = end - 1; j >= begin; j--)
+        g_queue_push_tail (&worker->ranges, &processor->ranges[j]);
 
-      g_mutex_lock (pool_mutex);
-      g_cond_signal  (pool_cond);
-      g_mutex_unlock (pool_mutex);
+      g_mutex_unlock (worker->mutex);
     }
-  else
+
+  g_mutex_lock (sched_mutex);
+  g_cond_broadcast (sched_cond);
+  g_mutex_unlock (sched_mutex);
+
+  if (progress_func)
+    g_get_current_time (&last_time);
+
+  /*  help out with our own ranges instead of blocking, this is what
+   *  keeps nested calls from needing any extra threads
+   */
+  while (g_atomic_int_get (&processor->remaining) > 0)
     {
-      g_mutex_unlock (processor->mutex);
+      PixelProcessorRange *range = pixel_processor_take_range (self,
+                                                               processor);
+
+      if (range)
+        {
+          pixel_processor_run_range (range);
+        }
+      else
+        {
+          g_mutex_lock (sched_mutex);
+
+          if (g_atomic_int_get (&processor->remaining) > 0 &&
+              g_atomic_int_get (&processor->queued) <= 0)
+            {
+              if (progress_func)
+                {
+                  GTimeVal timeout;
+
+                  g_get_current_time (&timeout);
+                  g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
+
+                  g_cond_timed_wait (done_cond, sched_mutex, &timeout);
+                }
+              else
+                {
+                  g_cond_wait (done_cond, sched_mutex);
+                }
+            }
+
+          g_mutex_unlock (sched_mutex);
+        }
+
+      if (progress_func)
+        {
+          GTimeVal now;
+
+          g_get_current_time (&now);
+
+          if (((now.tv_sec - last_time.tv_sec) * 1024 +
+               (now.tv_usec - last_time.tv_usec) / 1024) > PROGRESS_TIMEOUT)
+            {
+              gint remaining = g_atomic_int_get (&processor->remaining);
+
+              progress_func (progress_data,
+                             (gdouble) (processor->n_ranges - remaining) /
+                             (gdouble) processor->n_ranges);
+
+              last_time = now;
+            }
+        }
     }
+
+  g_free (processor->ranges);
+
+  tile_validate_resume (depth);
 }
 #endif
 
-/*  do_parallel_regions_single is just like do_parallel_regions
- *   except that all the mutex and tile locks have been removed
+/*  do_parallel_regions_single runs all portions of the regions in
+ *  the calling thread, using the caller's pixel regions directly.
  *
- * If we are processing with only a single thread we don't need to do
- * the mutex locks etc. and aditional tile locks even if we were
- * configured --with-mp
+ * If we are processing with only a single thread we don't need to
+ * split the regions into ranges and hand them to the workers, even if
+ * we were configured --with-mp
  */
 
 static gpointer
@@ -203,39 +553,7 @@ do_parallel_regions_single (PixelProcessor             *processor,
 
   do
     {
-      switch (processor->num_regions)
-        {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0]);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1]);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2]);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2],
-                                       processor->regions[3]);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions_single: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
-        }
+      do_parallel_regions_call (processor, processor->regions);
 
       if (progress_func)
         {
@@ -272,64 +590,18 @@ pixel_regions_do_parallel (PixelProcessor             *processor,
   gulong tiles  = pixels / (TILE_WIDTH * TILE_HEIGHT);
 
 #ifdef ENABLE_MP
-  if (pool && tiles > TILES_PER_THREAD)
+  if (n_workers > 0 && tiles > TILES_PER_THREAD)
     {
-      GError *error = NULL;
-      gint    tasks = MIN (tiles / TILES_PER_THREAD,
-                           g_thread_pool_get_max_threads (pool));
-
-      /*
-       * g_printerr ("pushing %d tasks into the thread pool (for %lu tiles)\n",
-       *             tasks, tiles);
-       */
-
-      processor->first   = TRUE;
-      processor->threads = tasks;
-      processor->mutex   = g_mutex_new();
-
-      g_mutex_lock (pool_mutex);
-
-      while (tasks--)
-        {
-          g_thread_pool_push (pool, processor, &error);
-
-          if (G_UNLIKELY (error))
-            {
-              g_warning ("thread creation failed: %s", error->message);
-              g_clear_error (&error);
-              processor->threads--;
-            }
-        }
-
-      if (progress_func)
-        {
-          while (processor->threads != 0)
-            {
-              GTimeVal timeout;
-              gulong   progress;
-
-              g_get_current_time (&timeout);
-              g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
+      gint width  = processor->PRI->region_width;
+      gint height = processor->PRI->region_height;
 
-              g_cond_timed_wait (pool_cond, pool_mutex, &timeout);
+      /*  the workers iterate over their own copies of the regions  */
+      pixel_regions_process_stop (processor->PRI);
+      processor->PRI = NULL;
 
-              g_mutex_lock (processor->mutex);
-              progress = processor->progress;
-              g_mutex_unlock (processor->mutex);
+      pixel_processor_split (processor, width, height);
 
-              progress_func (progress_data,
-                             (gdouble) progress / (gdouble) pixels);
-            }
-        }
-      else
-        {
-          while (processor->threads != 0)
-            g_cond_wait (pool_cond, pool_mutex);
-        }
-
-      g_mutex_unlock (pool_mutex);
-
-      g_mutex_free (processor->mutex);
+      do_parallel_regions_stealing (processor, progress_func, progress_data);
     }
   else
 #endif
@@ -354,7 +626,16 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
   gint            i;
 
   for (i = 0; i < num_regions; i++)
-    processor.regions[i] = va_arg (ap, PixelRegion *);
+    {
+      processor.regions[i] = va_arg (ap, PixelRegion *);
+
+#ifdef ENABLE_MP
+      /*  pixel_regions_register() modifies the regions  */
+      if (processor.regions[i])
+        memcpy (&processor.templates[i], processor.regions[i],
+                sizeof (PixelRegion));
+#endif
+    }
 
   switch (num_regions)
     {
@@ -397,10 +678,6 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
   processor.data        = data;
   processor.num_regions = num_regions;
 
-#ifdef ENABLE_MP
-  processor.threads     = 0;
-#endif
-
   processor.progress    = 0;
 
   pixel_regions_do_parallel (&processor, progress_func, progress_data);
@@ -416,45 +693,81 @@ void
 pixel_processor_set_num_threads (gint num_threads)
 {
 #ifdef ENABLE_MP
+  gint i;
 
   g_return_if_fail (num_threads > 0 && num_threads <= GIMP_MAX_NUM_THREADS);
 
+  /*  the calling thread helps out, so it needs one worker less  */
+  if (num_threads - 1 == n_workers)
+    return;
+
+  if (workers)
+    {
+      g_mutex_lock (sched_mutex);
+      workers_quit = TRUE;
+      g_cond_broadcast (sched_cond);
+      g_mutex_unlock (sched_mutex);
+
+      for (i = 0; i < n_workers; i++)
+        {
+          g_thread_join (workers[i].thread);
+          g_mutex_free (workers[i].mutex);
+        }
+
+      g_free (workers);
+      workers   = NULL;
+      n_workers = 0;
+
+      workers_quit = FALSE;
+    }
+
   if (num_threads < 2)
     {
-      if (pool)
+      if (sched_mutex)
         {
-          g_thread_pool_free (pool, TRUE, TRUE);
-          pool = NULL;
+          g_cond_free (done_cond);
+          done_cond = NULL;
 
-          g_cond_free (pool_cond);
-          pool_cond = NULL;
+          g_cond_free (sched_cond);
+          sched_cond = NULL;
 
-          g_mutex_free (pool_mutex);
-          pool_mutex = NULL;
+          g_mutex_free (sched_mutex);
+          sched_mutex = NULL;
         }
     }
   else
     {
-      GError *error = NULL;
-
-      if (pool)
+      if (! sched_mutex)
         {
-          g_thread_pool_set_max_threads (pool, num_threads, &error);
+          sched_mutex = g_mutex_new ();
+          sched_cond  = g_cond_new ();
+          done_cond   = g_cond_new ();
         }
-      else
-        {
-          pool = g_thread_pool_new ((GFunc) do_parallel_regions, NULL,
-                                    num_threads, TRUE, &error);
 
-          pool_mutex = g_mutex_new ();
-          pool_cond  = g_cond_new ();
-        }
+      workers = g_new0 (PixelProcessorWorker, num_threads - 1);
 
-      if (G_UNLIKELY (error))
+      for (i = 0; i < num_threads - 1; i++)
         {
-          g_warning ("changing the number of threads to %d failed: %s",
-                     num_threads, error->message);
-          g_clear_error (&error);
+          PixelProcessorWorker *worker = &workers[n_workers];
+          GError               *error  = NULL;
+
+          worker->mutex = g_mutex_new ();
+          g_queue_init (&worker->ranges);
+
+          worker->thread = g_thread_create ((GThreadFunc) pixel_processor_worker,
+                                            worker, TRUE, &error);
+
+          if (G_UNLIKELY (! worker->thread))
+            {
+              g_warning ("changing the number of threads to %d failed: %s",
+                         num_threads, error->message);
+              g_clear_error (&error);
+
+              g_mutex_free (worker->mutex);
+              break;
+            }
+
+          n_workers++;
         }
     }
 #endif
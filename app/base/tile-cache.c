@@ -32,6 +32,19 @@
 #define IDLE_SWAPPER_INTERVAL_MS        20
 #define IDLE_SWAPPER_TILES_PER_INTERVAL 10
 
+/*  The cache is split into a number of segments, each with its own
+ *  lock and its own LRU list.  A tile always hashes to the same
+ *  segment, so only threads touching the same segment ever contend.
+ *  The byte budget is global and only enforced approximately: each
+ *  segment evicts from its own LRU end first and only steals from
+ *  the other segments when it has nothing left to evict.
+ */
+#ifdef ENABLE_MP
+#define TILE_CACHE_N_SEGMENTS           16
+#else
+#define TILE_CACHE_N_SEGMENTS           1
+#endif
+
 
 typedef struct _TileList
 {
@@ -39,14 +52,28 @@ typedef struct _TileList
   Tile *last;
 } TileList;
 
+typedef struct _TileCacheSegment
+{
+#ifdef ENABLE_MP
+  GMutex   *mutex;
+#endif
+  TileList  list;
+  guint64   cur_size;
+  guint64   cur_dirty;
+  Tile     *idle_scan_last;
+
+  guint     n_locks;      /* lock statistics, protected by mutex */
+  guint     n_contended;
+} TileCacheSegment;
+
+
+static TileCacheSegment  segments[TILE_CACHE_N_SEGMENTS];
 
-static guint64       cur_cache_size   = 0;
-static guint64       max_cache_size   = 0;
-static guint64       cur_cache_dirty  = 0;
-static TileList      tile_list        = { NULL, NULL };
-static guint         idle_swapper     = 0;
-static guint         idle_delay       = 0;
-static Tile         *idle_scan_last   = NULL;
+static volatile gsize    cur_cache_size   = 0;
+static guint64           max_cache_size   = 0;
+static guint             idle_swapper     = 0;
+static guint             idle_delay       = 0;
+static gint              idle_segment     = 0;
 
 #ifdef TILE_PROFILING
 extern gulong        tile_idle_swapout;
@@ -59,61 +86,122 @@ extern gint          tile_exist_count;
 
 #ifdef ENABLE_MP
 
-static GMutex       *tile_cache_mutex = NULL;
+#define SEGMENT_LOCK(s)     tile_cache_segment_lock (s)
+#define SEGMENT_TRYLOCK(s)  g_mutex_trylock ((s)->mutex)
+#define SEGMENT_UNLOCK(s)   g_mutex_unlock ((s)->mutex)
 
-#define TILE_CACHE_LOCK    g_mutex_lock (tile_cache_mutex)
-#define TILE_CACHE_UNLOCK  g_mutex_unlock (tile_cache_mutex)
+#define CACHE_SIZE_GET \
+  ((guint64) GPOINTER_TO_SIZE (g_atomic_pointer_get (&cur_cache_size)))
+#define CACHE_SIZE_ADD(n)   g_atomic_pointer_add (&cur_cache_size, (n))
 
 #else
 
-#define TILE_CACHE_LOCK   /* nothing */
-#define TILE_CACHE_UNLOCK /* nothing */
+#define SEGMENT_LOCK(s)     /* nothing */
+#define SEGMENT_TRYLOCK(s)  TRUE
+#define SEGMENT_UNLOCK(s)   /* nothing */
+
+#define CACHE_SIZE_GET      ((guint64) cur_cache_size)
+#define CACHE_SIZE_ADD(n)   (cur_cache_size += (n))
 
 #endif
 
 #define PENDING_WRITE(t) ((t)->dirty || (t)->swap_offset == -1)
 
+#define TILE_SEGMENT(t) \
+  (&segments[((GPOINTER_TO_SIZE (t) >> 6) ^ \
+              (GPOINTER_TO_SIZE (t) >> 12)) % TILE_CACHE_N_SEGMENTS])
+
 
-static gboolean  tile_cache_zorch_next     (void);
-static void      tile_cache_flush_internal (Tile     *tile);
-static gboolean  tile_idle_preswap         (gpointer  data);
+static gboolean  tile_cache_zorch_next     (TileCacheSegment *segment);
+static gboolean  tile_cache_zorch_other    (TileCacheSegment *segment);
+static void      tile_cache_flush_internal (TileCacheSegment *segment,
+                                            Tile             *tile);
+static gboolean  tile_idle_preswap         (gpointer          data);
 #ifdef TILE_PROFILING
 static void      tile_verify               (void);
 #endif
 
 
+#ifdef ENABLE_MP
+static inline void
+tile_cache_segment_lock (TileCacheSegment *segment)
+{
+  if (! g_mutex_trylock (segment->mutex))
+    {
+      g_mutex_lock (segment->mutex);
+      segment->n_contended++;
+    }
+
+  segment->n_locks++;
+}
+#endif
+
 void
 tile_cache_init (guint64 tile_cache_size)
 {
+  gint i;
+
 #ifdef ENABLE_MP
-  g_return_if_fail (tile_cache_mutex == NULL);
+  g_return_if_fail (segments[0].mutex == NULL);
+#endif
+
+  for (i = 0; i < TILE_CACHE_N_SEGMENTS; i++)
+    {
+      TileCacheSegment *segment = &segments[i];
 
-  tile_cache_mutex = g_mutex_new ();
+#ifdef ENABLE_MP
+      segment->mutex = g_mutex_new ();
 #endif
 
-  tile_list.first = tile_list.last = NULL;
-  idle_scan_last = NULL;
+      segment->list.first     = segment->list.last = NULL;
+      segment->cur_size       = 0;
+      segment->cur_dirty      = 0;
+      segment->idle_scan_last = NULL;
+      segment->n_locks        = 0;
+      segment->n_contended    = 0;
+    }
 
+  cur_cache_size = 0;
   max_cache_size = tile_cache_size;
 }
 
 void
 tile_cache_exit (void)
 {
+#ifdef ENABLE_MP
+  gint i;
+#endif
+
   if (idle_swapper)
     {
       g_source_remove (idle_swapper);
       idle_swapper = 0;
     }
 
-  if (cur_cache_size > 0)
-    g_warning ("tile cache not empty (%ld bytes left)", cur_cache_size);
+  if (CACHE_SIZE_GET > 0)
+    g_warning ("tile cache not empty (%" G_GUINT64_FORMAT " bytes left)",
+               CACHE_SIZE_GET);
 
   tile_cache_set_size (0);
 
+#ifdef TILE_PROFILING
+  {
+    guint n_locks;
+    guint n_contended;
+
+    tile_cache_get_lock_stats (&n_locks, &n_contended);
+
+    g_printerr ("Tile cache segment locks: %u, contended: %u\n",
+                n_locks, n_contended);
+  }
+#endif
+
 #ifdef ENABLE_MP
-  g_mutex_free (tile_cache_mutex);
-  tile_cache_mutex = NULL;
+  for (i = 0; i < TILE_CACHE_N_SEGMENTS; i++)
+    {
+      g_mutex_free (segments[i].mutex);
+      segments[i].mutex = NULL;
+    }
 #endif
 }
 
@@ -123,11 +211,43 @@ tile_cache_suspend_idle_swapper(void)
   idle_delay = 1;
 }
 
+/*  Returns the number of times a cache segment lock was taken and how
+ *  many of those had to wait for another thread to release it.
+ */
+void
+tile_cache_get_lock_stats (guint *n_locks,
+                           guint *n_contended)
+{
+  guint locks     = 0;
+  guint contended = 0;
+  gint  i;
+
+  /*  read without locking, the numbers are only informational  */
+  for (i = 0; i < TILE_CACHE_N_SEGMENTS; i++)
+    {
+      locks     += segments[i].n_locks;
+      contended += segments[i].n_contended;
+    }
+
+  if (n_locks)
+    *n_locks = locks;
+
+  if (n_contended)
+    *n_contended = contended;
+}
+
 void
 tile_cache_insert (Tile *tile)
 {
+  TileCacheSegment *segment = TILE_SEGMENT (tile);
 
-  TILE_CACHE_LOCK;
+  /*  if tiles have to be evicted, wait for the swap I/O thread before
+   *  taking the segment lock, not while holding it
+   */
+  if (CACHE_SIZE_GET + tile->size > max_cache_size)
+    tile_swap_throttle ();
+
+  SEGMENT_LOCK (segment);
 
   if (! tile->data)
     goto out;
@@ -145,19 +265,19 @@ tile_cache_insert (Tile *tile)
       if (tile->next)
         tile->next->prev = tile->prev;
       else
-        tile_list.last = tile->prev;
+        segment->list.last = tile->prev;
 
       if(tile->prev){
 	tile->prev->next = tile->next;
       }else{
-	tile_list.first = tile->next;
+	segment->list.first = tile->next;
       }
 
       if (PENDING_WRITE(tile))
-	cur_cache_dirty -= tile->size;
+	segment->cur_dirty -= tile->size;
 
-      if(tile == idle_scan_last)
-	idle_scan_last = tile->next;
+      if(tile == segment->idle_scan_last)
+	segment->idle_scan_last = tile->next;
 
     }
   else
@@ -170,17 +290,24 @@ tile_cache_insert (Tile *tile)
        */
 
 #ifdef TILE_PROFILING
-      if ((cur_cache_size + tile->size) > max_cache_size)
+      if ((CACHE_SIZE_GET + tile->size) > max_cache_size)
         {
           GTimeVal now;
           GTimeVal later;
 
           g_get_current_time(&now);
 #endif
-          while ((cur_cache_size + tile->size) > max_cache_size)
+          while ((CACHE_SIZE_GET + tile->size) > max_cache_size)
             {
-              if (! tile_cache_zorch_next ())
+              if (! tile_cache_zorch_next (segment) &&
+                  ! tile_cache_zorch_other (segment))
                 {
+                  /*  other threads may be holding the remaining
+                   *  segments; only give up on a truly empty cache
+                   */
+                  if (CACHE_SIZE_GET > 0)
+                    break;
+
                   g_warning ("cache: unable to find room for a tile");
                   goto out;
                 }
@@ -205,29 +332,30 @@ tile_cache_insert (Tile *tile)
         }
 #endif
 
-      cur_cache_size += tile->size;
+      segment->cur_size += tile->size;
+      CACHE_SIZE_ADD (tile->size);
     }
 
   /* Put the tile at the end of the proper list */
 
   tile->next = NULL;
-  tile->prev = tile_list.last;
+  tile->prev = segment->list.last;
 
-  if (tile_list.last)
-    tile_list.last->next = tile;
+  if (segment->list.last)
+    segment->list.last->next = tile;
   else
-    tile_list.first = tile;
+    segment->list.first = tile;
 
-  tile_list.last = tile;
+  segment->list.last = tile;
   tile->cached = TRUE;
   idle_delay = 1;
 
   if (PENDING_WRITE(tile))
     {
-      cur_cache_dirty += tile->size;
+      segment->cur_dirty += tile->size;
 
-      if (! idle_scan_last)
-	idle_scan_last=tile;
+      if (! segment->idle_scan_last)
+	segment->idle_scan_last=tile;
 
       if (! idle_swapper)
         {
@@ -244,69 +372,81 @@ tile_cache_insert (Tile *tile)
     }
 
 out:
-  TILE_CACHE_UNLOCK;
+  SEGMENT_UNLOCK (segment);
 }
 
 void
 tile_cache_flush (Tile *tile)
 {
-  TILE_CACHE_LOCK;
+  TileCacheSegment *segment = TILE_SEGMENT (tile);
+
+  SEGMENT_LOCK (segment);
 
   if (tile->cached)
-    tile_cache_flush_internal (tile);
+    tile_cache_flush_internal (segment, tile);
 
-  TILE_CACHE_UNLOCK;
+  SEGMENT_UNLOCK (segment);
 }
 
 void
 tile_cache_set_size (guint64 cache_size)
 {
-  TILE_CACHE_LOCK;
+  gint i;
 
   idle_delay = 1;
   max_cache_size = cache_size;
 
-  while (cur_cache_size > max_cache_size)
+  for (i = 0; i < TILE_CACHE_N_SEGMENTS; i++)
     {
-      if (! tile_cache_zorch_next ())
-        break;
-    }
+      TileCacheSegment *segment = &segments[i];
+
+      SEGMENT_LOCK (segment);
+
+      while (CACHE_SIZE_GET > max_cache_size)
+        {
+          if (! tile_cache_zorch_next (segment))
+            break;
+        }
 
-  TILE_CACHE_UNLOCK;
+      SEGMENT_UNLOCK (segment);
+    }
 }
 
 static void
-tile_cache_flush_internal (Tile *tile)
+tile_cache_flush_internal (TileCacheSegment *segment,
+                           Tile             *tile)
 {
 
   tile->cached = FALSE;
 
   if (PENDING_WRITE(tile))
-    cur_cache_dirty -= tile->size;
+    segment->cur_dirty -= tile->size;
 
-  cur_cache_size -= tile->size;
+  segment->cur_size -= tile->size;
+  CACHE_SIZE_ADD (- tile->size);
 
   if (tile->next)
     tile->next->prev = tile->prev;
   else
-    tile_list.last = tile->prev;
+    segment->list.last = tile->prev;
 
   if (tile->prev)
     tile->prev->next = tile->next;
   else
-    tile_list.first = tile->next;
+    segment->list.first = tile->next;
 
-  if (tile == idle_scan_last)
-    idle_scan_last = tile->next;
+  if (tile == segment->idle_scan_last)
+    segment->idle_scan_last = tile->next;
 
   tile->next = tile->prev = NULL;
 }
 
+/*  called with the segment lock held  */
 static gboolean
-tile_cache_zorch_next (void)
+tile_cache_zorch_next (TileCacheSegment *segment)
 {
 
-  Tile *tile = tile_list.first;
+  Tile *tile = segment->list.first;
 
   if (! tile)
     return FALSE;
@@ -322,12 +462,23 @@ tile_cache_zorch_next (void)
     }
 #endif
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (segment, tile);
+
+  /*  keep the tile compressed in memory if it compresses well, it
+   *  will only be written to disk when the compressed cache is full
+   */
+  if (tile_swap_compress (tile))
+    {
+#ifdef TILE_PROFILING
+      tile_exist_count--;
+#endif
+      return TRUE;
+    }
 
   if (PENDING_WRITE (tile))
     {
       idle_delay = 1;
-      tile_swap_out (tile);
+      tile_swap_out_async (tile);
     }
 
   if (! tile->dirty)
@@ -345,11 +496,43 @@ tile_cache_zorch_next (void)
   return FALSE;
 }
 
+/*  Evicts one tile from any segment other than @segment.  Only
+ *  try-locks are used here because the caller already holds the lock
+ *  on @segment, and blocking on a second segment could deadlock
+ *  against a thread doing the same thing the other way round.
+ */
+static gboolean
+tile_cache_zorch_other (TileCacheSegment *segment)
+{
+  gint start = segment - segments;
+  gint i;
+
+  for (i = 1; i < TILE_CACHE_N_SEGMENTS; i++)
+    {
+      TileCacheSegment *other;
+      gboolean          zorched;
+
+      other = &segments[(start + i) % TILE_CACHE_N_SEGMENTS];
+
+      if (! other->list.first || ! SEGMENT_TRYLOCK (other))
+        continue;
+
+      zorched = tile_cache_zorch_next (other);
+
+      SEGMENT_UNLOCK (other);
+
+      if (zorched)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static gboolean
 tile_idle_preswap_run (gpointer data)
 {
-  Tile *tile;
-  int count = 0;
+  gint count = 0;
+  gint n;
 
   if (idle_delay)
     {
@@ -365,52 +548,64 @@ tile_idle_preswap_run (gpointer data)
       return FALSE;
     }
 
-  TILE_CACHE_LOCK;
-
 #ifdef TILE_PROFILING
   g_printerr(".");
 #endif
 
-  tile = idle_scan_last;
-
-  while (tile)
+  /*  walk the segments round-robin, continuing where the last run
+   *  stopped, so that no segment starves the others
+   */
+  for (n = 0; n < TILE_CACHE_N_SEGMENTS; n++)
     {
-      if (PENDING_WRITE (tile))
+      TileCacheSegment *segment = &segments[idle_segment];
+      Tile             *tile;
+
+      SEGMENT_LOCK (segment);
+
+      tile = segment->idle_scan_last;
+
+      while (tile)
         {
-          idle_scan_last = tile->next;
+          if (PENDING_WRITE (tile))
+            {
+              segment->idle_scan_last = tile->next;
 
 #ifdef TILE_PROFILING
-          tile_idle_swapout++;
+              tile_idle_swapout++;
 #endif
-          tile_swap_out (tile);
+              tile_swap_out (tile);
 
-          if (! PENDING_WRITE(tile))
-            cur_cache_dirty -= tile->size;
+              if (! PENDING_WRITE(tile))
+                segment->cur_dirty -= tile->size;
 
-          count++;
-          if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
-            {
-              TILE_CACHE_UNLOCK;
-              return TRUE;
+              count++;
+              if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
+                {
+                  SEGMENT_UNLOCK (segment);
+                  return TRUE;
+                }
             }
+
+          tile = tile->next;
         }
 
-      tile = tile->next;
+      segment->idle_scan_last = NULL;
+
+      SEGMENT_UNLOCK (segment);
+
+      idle_segment = (idle_segment + 1) % TILE_CACHE_N_SEGMENTS;
     }
 
 #ifdef TILE_PROFILING
   g_printerr ("\nidle swapper -> stopped\n");
 #endif
 
-  idle_scan_last = NULL;
   idle_swapper = 0;
 
 #ifdef TILE_PROFILING
   tile_verify ();
 #endif
 
-  TILE_CACHE_UNLOCK;
-
   return FALSE;
 }
 
@@ -442,40 +637,61 @@ tile_idle_preswap (gpointer data)
 static void
 tile_verify (void)
 {
-  /* scan list linearly, count metrics, compare to running totals */
-  const Tile *t;
-  guint64     local_size  = 0;
-  guint64     local_dirty = 0;
-  guint64     acc         = 0;
+  /* scan lists linearly, count metrics, compare to running totals */
+  guint64 total_size = 0;
+  gint    i;
 
-  for (t = tile_list.first; t; t = t->next)
+  for (i = 0; i < TILE_CACHE_N_SEGMENTS; i++)
     {
-      local_size += t->size;
+      TileCacheSegment *segment     = &segments[i];
+      const Tile       *t;
+      guint64           local_size  = 0;
+      guint64           local_dirty = 0;
+      guint64           acc         = 0;
 
-      if (PENDING_WRITE (t))
-        local_dirty += t->size;
-    }
+      SEGMENT_LOCK (segment);
 
-  if (local_size != cur_cache_size)
-    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_size,local_size);
+      for (t = segment->list.first; t; t = t->next)
+        {
+          local_size += t->size;
 
-  if (local_dirty != cur_cache_dirty)
-    g_printerr ("\nCache dirty mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_dirty,local_dirty);
+          if (PENDING_WRITE (t))
+            local_dirty += t->size;
+        }
 
-  /* scan forward from scan list */
-  for (t = idle_scan_last; t; t = t->next)
-    {
-      if (PENDING_WRITE (t))
-        acc += t->size;
+      if (local_size != segment->cur_size)
+        g_printerr ("\nCache size mismatch in segment %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, segment->cur_size, local_size);
+
+      if (local_dirty != segment->cur_dirty)
+        g_printerr ("\nCache dirty mismatch in segment %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, segment->cur_dirty, local_dirty);
+
+      /* scan forward from scan list */
+      for (t = segment->idle_scan_last; t; t = t->next)
+        {
+          if (PENDING_WRITE (t))
+            acc += t->size;
+        }
+
+      if (acc != local_dirty)
+        g_printerr ("\nDirty scan follower mismatch in segment %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, acc, local_dirty);
+
+      total_size += segment->cur_size;
+
+      SEGMENT_UNLOCK (segment);
     }
 
-  if (acc != local_dirty)
-    g_printerr ("\nDirty scan follower mismatch: running=%"G_GUINT64_FORMAT
+  if (total_size != CACHE_SIZE_GET)
+    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
                 ", tested=%"G_GUINT64_FORMAT"\n",
-                acc,local_dirty);
+                CACHE_SIZE_GET, total_size);
 }
 #endif
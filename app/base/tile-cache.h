@@ -28,4 +28,7 @@ void   tile_cache_suspend_idle_swapper (void);
 void   tile_cache_insert               (Tile   *tile);
 void   tile_cache_flush                (Tile   *tile);
 
+void   tile_cache_get_lock_stats       (guint  *n_locks,
+                                        guint  *n_contended);
+
 #endif /* __TILE_CACHE_H__ */
@@ -0,0 +1,223 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile.h"
+#include "tile-delta.h"
+#include "tile-rle.h"
+
+
+struct _TileDelta
+{
+  guint32  checksum[2];  /*  of the two versions of the tile        */
+  gboolean rle;          /*  data is run length encoded             */
+  gint     size;         /*  the size of data                       */
+  guchar   data[1];      /*  the XOR of the two versions, allocated */
+};                       /*  with the struct                        */
+
+
+/*  FNV-1a, it only needs to tell the two versions of a tile from
+ *  content that was changed behind the delta's back.
+ */
+static guint32
+tile_delta_checksum (const guchar *data,
+                     gint          size)
+{
+  guint32 hash = 2166136261u;
+  gint    i;
+
+  for (i = 0; i < size; i++)
+    {
+      hash ^= data[i];
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+/*  Returns the delta between @tile and @other, or NULL if the two
+ *  tiles have the same content.
+ */
+TileDelta *
+tile_delta_new (Tile *tile,
+                Tile *other)
+{
+  TileDelta    *delta;
+  const guchar *a;
+  const guchar *b;
+  guchar       *xor;
+  guchar       *rle;
+  gint          size;
+  gint          rle_size;
+  gint          i;
+
+  g_return_val_if_fail (tile != NULL, NULL);
+  g_return_val_if_fail (other != NULL, NULL);
+  g_return_val_if_fail (tile_size (tile) == tile_size (other), NULL);
+  g_return_val_if_fail (tile_bpp (tile) == tile_bpp (other), NULL);
+
+  a    = tile_data_pointer (tile, 0, 0);
+  b    = tile_data_pointer (other, 0, 0);
+  size = tile_size (tile);
+
+  if (memcmp (a, b, size) == 0)
+    return NULL;
+
+  xor = g_malloc (size);
+
+  for (i = 0; i < size; i++)
+    xor[i] = a[i] ^ b[i];
+
+  /*  unchanged pixels are runs of zeros  */
+  rle      = g_malloc (size);
+  rle_size = tile_rle_encode (xor, tile_bpp (tile),
+                              tile_ewidth (tile) * tile_eheight (tile),
+                              rle, size);
+
+  if (rle_size > 0)
+    {
+      delta = g_malloc (sizeof (TileDelta) + rle_size - 1);
+
+      delta->rle  = TRUE;
+      delta->size = rle_size;
+      memcpy (delta->data, rle, rle_size);
+    }
+  else
+    {
+      delta = g_malloc (sizeof (TileDelta) + size - 1);
+
+      delta->rle  = FALSE;
+      delta->size = size;
+      memcpy (delta->data, xor, size);
+    }
+
+  delta->checksum[0] = tile_delta_checksum (a, size);
+  delta->checksum[1] = tile_delta_checksum (b, size);
+
+  g_free (rle);
+  g_free (xor);
+
+  return delta;
+}
+
+void
+tile_delta_free (TileDelta *delta)
+{
+  g_return_if_fail (delta != NULL);
+
+  g_free (delta);
+}
+
+/*  Writes the other version of @src to @dest.  Returns FALSE, and
+ *  leaves @dest alone, if @src is neither version of the tile.
+ */
+gboolean
+tile_delta_apply (TileDelta *delta,
+                  Tile      *src,
+                  Tile      *dest)
+{
+  const guchar *s;
+  guchar       *d;
+  guint32       checksum;
+  gint          size;
+  gint          i;
+
+  g_return_val_if_fail (delta != NULL, FALSE);
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (dest != NULL, FALSE);
+  g_return_val_if_fail (tile_size (src) == tile_size (dest), FALSE);
+
+  s    = tile_data_pointer (src, 0, 0);
+  d    = tile_data_pointer (dest, 0, 0);
+  size = tile_size (src);
+
+  checksum = tile_delta_checksum (s, size);
+
+  if (checksum != delta->checksum[0] &&
+      checksum != delta->checksum[1])
+    return FALSE;
+
+  if (delta->rle)
+    {
+      if (! tile_rle_decode (delta->data, delta->size,
+                             tile_bpp (src),
+                             tile_ewidth (src) * tile_eheight (src),
+                             d))
+        return FALSE;
+    }
+  else
+    {
+      if (delta->size != size)
+        return FALSE;
+
+      memcpy (d, delta->data, size);
+    }
+
+  for (i = 0; i < size; i++)
+    d[i] ^= s[i];
+
+  return TRUE;
+}
+
+const guchar *
+tile_delta_get_data (TileDelta *delta,
+                     gint      *size)
+{
+  g_return_val_if_fail (delta != NULL, NULL);
+  g_return_val_if_fail (size != NULL, NULL);
+
+  *size = sizeof (TileDelta) + delta->size - 1;
+
+  return (const guchar *) delta;
+}
+
+TileDelta *
+tile_delta_new_from_data (const guchar *data,
+                          gint          size)
+{
+  TileDelta *delta;
+
+  g_return_val_if_fail (data != NULL, NULL);
+  g_return_val_if_fail (size >= sizeof (TileDelta), NULL);
+
+  delta = g_malloc (size);
+  memcpy (delta, data, size);
+
+  if (sizeof (TileDelta) + delta->size - 1 != size)
+    {
+      g_free (delta);
+      return NULL;
+    }
+
+  return delta;
+}
+
+gint64
+tile_delta_get_memsize (TileDelta *delta)
+{
+  if (! delta)
+    return 0;
+
+  return sizeof (TileDelta) + delta->size - 1;
+}
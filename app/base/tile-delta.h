@@ -0,0 +1,44 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TILE_DELTA_H__
+#define __TILE_DELTA_H__
+
+
+/*  A tile delta is the run length encoded XOR of two versions of a
+ *  tile.  Applying it to either version yields the other one, so the
+ *  same delta serves undo and redo.  The tiles must be locked.
+ */
+
+TileDelta * tile_delta_new         (Tile      *tile,
+                                    Tile      *other);
+void        tile_delta_free        (TileDelta *delta);
+
+/*  The delta as a block of memory, to store it elsewhere for a while  */
+const guchar * tile_delta_get_data      (TileDelta    *delta,
+                                         gint         *size);
+TileDelta    * tile_delta_new_from_data (const guchar *data,
+                                         gint          size);
+
+gboolean    tile_delta_apply       (TileDelta *delta,
+                                    Tile      *src,
+                                    Tile      *dest);
+
+gint64      tile_delta_get_memsize (TileDelta *delta);
+
+
+#endif /* __TILE_DELTA_H__ */
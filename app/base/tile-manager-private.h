@@ -34,10 +34,25 @@ struct _TileManager
   TileValidateProc   validate_proc; /*  this proc is called when an attempt  *
                                      *  to get an invalid tile is made       */
   gpointer           user_data;     /*  data to pass to the validate_proc    */
+  GDestroyNotify     user_data_destroy; /*  frees user_data                  */
+  gboolean           validate_threadsafe; /*  may validate_proc run in     *
+                                           *  several threads at once?     */
 
   gint               cached_num;    /*  number of cached tile                */
   Tile              *cached_tile;   /*  the actual cached tile               */
+
+  volatile gint      lock;          /*  bit lock guarding tile allocation,   *
+                                     *  copy-on-write and the cached tile    */
 };
 
 
+#ifdef ENABLE_MP
+#define TILE_MANAGER_BIT_LOCK(tm)    g_bit_lock   (&(tm)->lock, 0)
+#define TILE_MANAGER_BIT_UNLOCK(tm)  g_bit_unlock (&(tm)->lock, 0)
+#else
+#define TILE_MANAGER_BIT_LOCK(tm)
+#define TILE_MANAGER_BIT_UNLOCK(tm)
+#endif
+
+
 #endif /* __TILE_MANAGER_PVT_H__ */
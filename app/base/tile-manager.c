@@ -143,6 +143,9 @@ tile_manager_unref (TileManager *tm)
       if (tm->cached_tile)
         tile_release (tm->cached_tile, FALSE);
 
+      if (tm->user_data_destroy)
+        tm->user_data_destroy (tm->user_data);
+
       if (tm->tiles)
         {
           gint ntiles = tm->ntile_rows * tm->ntile_cols;
@@ -189,11 +192,39 @@ void
 tile_manager_set_validate_proc (TileManager      *tm,
                                 TileValidateProc  proc,
                                 gpointer          user_data)
+{
+  tile_manager_set_validate_proc_full (tm, proc, user_data, NULL);
+}
+
+void
+tile_manager_set_validate_proc_full (TileManager      *tm,
+                                     TileValidateProc  proc,
+                                     gpointer          user_data,
+                                     GDestroyNotify    destroy)
+{
+  GDestroyNotify old_destroy;
+  gpointer       old_user_data;
+
+  g_return_if_fail (tm != NULL);
+
+  old_destroy   = tm->user_data_destroy;
+  old_user_data = tm->user_data;
+
+  tm->validate_proc     = proc;
+  tm->user_data         = user_data;
+  tm->user_data_destroy = destroy;
+
+  if (old_destroy)
+    old_destroy (old_user_data);
+}
+
+void
+tile_manager_set_validate_threadsafe (TileManager *tm,
+                                      gboolean     threadsafe)
 {
   g_return_if_fail (tm != NULL);
 
-  tm->validate_proc = proc;
-  tm->user_data     = user_data;
+  tm->validate_threadsafe = threadsafe ? TRUE : FALSE;
 }
 
 Tile *
@@ -227,7 +258,14 @@ tile_manager_get (TileManager *tm,
     return NULL;
 
   if (! tm->tiles)
-    tile_manager_allocate_tiles (tm);
+    {
+      TILE_MANAGER_BIT_LOCK (tm);
+
+      if (! tm->tiles)
+        tile_manager_allocate_tiles (tm);
+
+      TILE_MANAGER_BIT_UNLOCK (tm);
+    }
 
   tile = tm->tiles[tile_num];
 
@@ -243,6 +281,13 @@ tile_manager_get (TileManager *tm,
     {
       if (wantwrite)
         {
+          /*  the copy-on-write below must not race with another
+           *  thread writing to the same tile
+           */
+          TILE_MANAGER_BIT_LOCK (tm);
+
+          tile = tm->tiles[tile_num];
+
           if (tile_num == tm->cached_num)
             {
               tile_release (tm->cached_tile, FALSE);
@@ -277,16 +322,12 @@ tile_manager_get (TileManager *tm,
                           new->eheight * sizeof (TileRowHint));
                 }
 
-              if (tile->data)
-                {
-                  memcpy (new->data, tile->data, new->size);
-                }
-              else
-                {
-                  tile_lock (tile);
-                  memcpy (new->data, tile->data, new->size);
-                  tile_release (tile, FALSE);
-                }
+              /*  lock the tile even if its data is present, the
+               *  tile cache may swap it out from another thread
+               */
+              tile_lock (tile);
+              memcpy (new->data, tile->data, new->size);
+              tile_release (tile, FALSE);
 
               tile_detach (tile, tm, tile_num);
               tile_attach (new, tm, tile_num);
@@ -295,10 +336,15 @@ tile_manager_get (TileManager *tm,
               tm->tiles[tile_num] = tile;
             }
 
+          TILE_MANAGER_BIT_UNLOCK (tm);
+
 	  /* must lock before marking dirty */
 	  tile_lock (tile);
+
+          TILE_BIT_LOCK (tile);
           tile->write_count++;
           tile->dirty = TRUE;
+          TILE_BIT_UNLOCK (tile);
         }
       else
         {
@@ -439,9 +485,9 @@ tile_manager_invalidate_tile (TileManager  *tm,
 #endif
     }
 
-  if (tile->swap_offset != -1)
+  if (tile->swap_offset != -1 || tile->zdata)
     {
-      /* If the tile is on disk, then delete its
+      /* If the tile is on disk or compressed, then delete its
        *  presence there.
        */
       tile_swap_delete (tile);
@@ -551,6 +597,41 @@ tile_manager_invalidate_area (TileManager *tm,
       }
 }
 
+gboolean
+tile_manager_area_is_valid (TileManager *tm,
+                            gint         x,
+                            gint         y,
+                            gint         w,
+                            gint         h)
+{
+  gint  i;
+  gint  j;
+
+  g_return_val_if_fail (tm != NULL, FALSE);
+
+  x = CLAMP (x, 0, tm->width);
+  y = CLAMP (y, 0, tm->height);
+  w = CLAMP (x + w, 0, tm->width)  - x;
+  h = CLAMP (y + h, 0, tm->height) - y;
+
+  if (w == 0 || h == 0)
+    return TRUE;
+
+  if (! tm->tiles)
+    return FALSE;
+
+  for (i = y; i < (y + h); i += (TILE_HEIGHT - (i % TILE_HEIGHT)))
+    for (j = x; j < (x + w); j += (TILE_WIDTH - (j % TILE_WIDTH)))
+      {
+        Tile *tile = tm->tiles[tile_manager_get_tile_num (tm, j, i)];
+
+        if (! tile->valid || g_atomic_int_get (&tile->validating))
+          return FALSE;
+      }
+
+  return TRUE;
+}
+
 gint
 tile_manager_width (const TileManager *tm)
 {
@@ -51,6 +51,24 @@ void          tile_manager_set_validate_proc (TileManager      *tm,
                                               TileValidateProc  proc,
                                               gpointer          user_data);
 
+/* Like tile_manager_set_validate_proc(), @destroy is called on
+ *  @user_data when the procedure is replaced or the tile manager is
+ *  destroyed.
+ */
+void          tile_manager_set_validate_proc_full
+                                             (TileManager      *tm,
+                                              TileValidateProc  proc,
+                                              gpointer          user_data,
+                                              GDestroyNotify    destroy);
+
+/* Declare that the validate procedure may run for several tiles of
+ *  the tile manager at once, from different threads.  Validate
+ *  procedures are serialized otherwise.
+ */
+void          tile_manager_set_validate_threadsafe
+                                             (TileManager      *tm,
+                                              gboolean          threadsafe);
+
 /* Get a specified tile from a tile manager.
  */
 Tile        * tile_manager_get_tile          (TileManager *tm,
@@ -92,6 +110,15 @@ void          tile_manager_invalidate_area   (TileManager       *tm,
                                               gint               w,
                                               gint               h);
 
+/* Check whether all tiles in an area are valid, without validating
+ *  or locking any of them.
+ */
+gboolean      tile_manager_area_is_valid     (TileManager       *tm,
+                                              gint               x,
+                                              gint               y,
+                                              gint               w,
+                                              gint               h);
+
 gint          tile_manager_width             (const TileManager *tm);
 gint          tile_manager_height            (const TileManager *tm);
 gint          tile_manager_bpp               (const TileManager *tm);
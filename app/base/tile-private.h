@@ -84,13 +84,47 @@ struct _Tile
                          * to -1.
                          */
 
+  guchar *zdata;        /* the compressed tile data while the tile is kept
+                         * in the compressed tile cache, NULL otherwise.
+                         * "data" is always NULL while "zdata" is set.
+                         */
+  gint    zsize;        /* size of the compressed tile data */
+
   TileLink *tlink;
 
-  Tile     *next;       /* List pointers for the tile cache lists */
+  volatile gint validating; /* is a thread busy validating the tile?
+                             * not in the bit field above, whose bits
+                             * are written under other locks; set under
+                             * the bit lock and read atomically
+                             */
+
+  volatile gint lock;   /* bit lock guarding the counters and the tilelink
+                         * chain while the tile is used from several
+                         * threads, see TILE_BIT_LOCK()
+                         */
+
+  Tile     *next;       /* List pointers for the tile cache lists, or for
+                         * the compressed tile cache list */
   Tile     *prev;
 };
 
 
+/*  Tiles are locked and released concurrently by the pixel processor
+ *  worker threads.  The counters and links of a tile are guarded by a
+ *  bit lock in the tile itself, so there is no lock shared between
+ *  tiles.  Never free a tile while holding its bit lock.
+ */
+#ifdef ENABLE_MP
+#define TILE_BIT_LOCK(tile)    g_bit_lock    (&(tile)->lock, 0)
+#define TILE_BIT_TRYLOCK(tile) g_bit_trylock (&(tile)->lock, 0)
+#define TILE_BIT_UNLOCK(tile)  g_bit_unlock  (&(tile)->lock, 0)
+#else
+#define TILE_BIT_LOCK(tile)
+#define TILE_BIT_TRYLOCK(tile) TRUE
+#define TILE_BIT_UNLOCK(tile)
+#endif
+
+
 /*  tile_data_pointer() as a macro so that it can be inlined
  *
  *  Note that (y) & (TILE_HEIGHT-1) is equivalent to (y) % TILE_HEIGHT
@@ -19,8 +19,15 @@
 
 #include <glib-object.h>
 
+#if defined (USE_SSE) && defined (__SSE2__)
+#define USE_SSE2_BOX_FILTER
+#include <emmintrin.h>
+#endif
+
 #include "base-types.h"
 
+#include "pixel-processor.h"
+#include "pixel-region.h"
 #include "tile.h"
 #include "tile-manager.h"
 #include "tile-pyramid.h"
@@ -37,9 +44,27 @@ struct _TilePyramid
   gint           bytes;
   TileManager   *tiles[PYRAMID_MAX_LEVELS];
   gint           top_level;
+
+  /*  the area invalidated since the upper levels were last rebuilt,
+   *  in bottom level coordinates, and the next level to rebuild
+   */
+  gint           dirty_x1;
+  gint           dirty_y1;
+  gint           dirty_x2;
+  gint           dirty_y2;
+  gint           dirty_level;
+  gboolean       dirty_skipped;  /*  tiles were left for a later pass  */
 };
 
 
+typedef struct
+{
+  TileManager   *tiles;        /*  the level to rebuild              */
+  TileManager   *tiles_below;  /*  the level it is built from        */
+  volatile gint  skipped;      /*  tiles whose source wasn't valid   */
+} TilePyramidUpdate;
+
+
 static gint  tile_pyramid_alloc_levels        (TilePyramid *pyramid,
                                                gint         top_level);
 static void  tile_pyramid_validate_tile       (TileManager *tm,
@@ -57,6 +82,13 @@ static void  tile_pyramid_write_upper_quarter (Tile        *dest,
                                                Tile        *src,
                                                const gint   i,
                                                const gint   j);
+static gint  tile_pyramid_average_row         (guchar       *dest,
+                                               const guchar *src0,
+                                               const guchar *src1,
+                                               gint          width,
+                                               gint          bpp);
+static void  tile_pyramid_update_func         (TilePyramidUpdate *update,
+                                               PixelRegion       *region);
 
 /**
  * tile_pyramid_new:
@@ -237,6 +269,23 @@ tile_pyramid_invalidate_area (TilePyramid *pyramid,
   if (width == 0 || height == 0)
     return;
 
+  if (pyramid->dirty_x1 < pyramid->dirty_x2)
+    {
+      pyramid->dirty_x1 = MIN (pyramid->dirty_x1, x);
+      pyramid->dirty_y1 = MIN (pyramid->dirty_y1, y);
+      pyramid->dirty_x2 = MAX (pyramid->dirty_x2, x + width);
+      pyramid->dirty_y2 = MAX (pyramid->dirty_y2, y + height);
+    }
+  else
+    {
+      pyramid->dirty_x1 = x;
+      pyramid->dirty_y1 = y;
+      pyramid->dirty_x2 = x + width;
+      pyramid->dirty_y2 = y + height;
+    }
+
+  pyramid->dirty_level = 1;
+
   for (level = 0; level <= pyramid->top_level; level++)
     {
       /* Tile invalidation must propagate all the way up in the pyramid,
@@ -252,6 +301,154 @@ tile_pyramid_invalidate_area (TilePyramid *pyramid,
     }
 }
 
+/**
+ * tile_pyramid_update:
+ * @pyramid: a #TilePyramid
+ * @x:       return location for the X coordinate of the rebuilt area
+ * @y:       return location for the Y coordinate of the rebuilt area
+ * @width:   return location for the width of the rebuilt area
+ * @height:  return location for the height of the rebuilt area
+ *
+ * Rebuilds the next upper level of the area invalidated by
+ * tile_pyramid_invalidate_area(), validating its tiles in parallel.
+ * Levels are rebuilt bottom-up, one per call, so that this can be
+ * driven from an idle handler.
+ *
+ * This never validates tiles of the bottom level: an upper level tile
+ * is only rebuilt if the tiles below it are valid already, the others
+ * stay invalid and are built on demand. The area is kept invalidated
+ * for the next pass if tiles were left out.
+ *
+ * Return value: %TRUE if a level was rebuilt, %FALSE if the pass over
+ *               the invalidated area is complete. The rebuilt area is
+ *               returned in bottom level coordinates.
+ **/
+gboolean
+tile_pyramid_update (TilePyramid *pyramid,
+                     gint        *x,
+                     gint        *y,
+                     gint        *width,
+                     gint        *height)
+{
+  gint level;
+  gint x1, y1, x2, y2;
+
+  g_return_val_if_fail (pyramid != NULL, FALSE);
+
+  level = pyramid->dirty_level;
+
+  if (pyramid->dirty_x1 >= pyramid->dirty_x2 ||
+      level < 1 || level > pyramid->top_level)
+    {
+      if (pyramid->dirty_skipped && pyramid->dirty_x1 < pyramid->dirty_x2)
+        {
+          /*  start over on the next call  */
+          pyramid->dirty_level   = 1;
+          pyramid->dirty_skipped = FALSE;
+        }
+      else
+        {
+          pyramid->dirty_x1 = pyramid->dirty_x2 = 0;
+          pyramid->dirty_y1 = pyramid->dirty_y2 = 0;
+          pyramid->dirty_level   = 0;
+          pyramid->dirty_skipped = FALSE;
+        }
+
+      return FALSE;
+    }
+
+  /*  round outwards, like tile_pyramid_invalidate_area() does  */
+  x1 = pyramid->dirty_x1 >> level;
+  y1 = pyramid->dirty_y1 >> level;
+  x2 = (pyramid->dirty_x2 + (1 << level) - 1) >> level;
+  y2 = (pyramid->dirty_y2 + (1 << level) - 1) >> level;
+
+  /*  and to whole tiles, so that every tile is handled by one thread  */
+  x1 = x1 - x1 % TILE_WIDTH;
+  y1 = y1 - y1 % TILE_HEIGHT;
+
+  x2 = MIN (x2, tile_manager_width  (pyramid->tiles[level]));
+  y2 = MIN (y2, tile_manager_height (pyramid->tiles[level]));
+
+  if (x1 < x2 && y1 < y2)
+    {
+      static guchar     dummy = 0;
+      TilePyramidUpdate update;
+      PixelRegion       region;
+
+      update.tiles       = pyramid->tiles[level];
+      update.tiles_below = pyramid->tiles[level - 1];
+      update.skipped     = FALSE;
+
+      /*  the region only splits the area into ranges of whole tiles,
+       *  the tiles are locked by tile_pyramid_update_func() itself
+       */
+      pixel_region_init_data (&region, &dummy, 0, 0,
+                              x1, y1, x2 - x1, y2 - y1);
+
+      pixel_regions_process_parallel ((PixelProcessorFunc)
+                                      tile_pyramid_update_func,
+                                      &update, 1, &region);
+
+      if (update.skipped)
+        pyramid->dirty_skipped = TRUE;
+    }
+
+  if (x)      *x      = pyramid->dirty_x1;
+  if (y)      *y      = pyramid->dirty_y1;
+  if (width)  *width  = pyramid->dirty_x2 - pyramid->dirty_x1;
+  if (height) *height = pyramid->dirty_y2 - pyramid->dirty_y1;
+
+  pyramid->dirty_level++;
+
+  return TRUE;
+}
+
+/**
+ * tile_pyramid_get_valid_level:
+ * @pyramid: a #TilePyramid
+ * @level:   the level that would be used for display
+ * @x:       X coordinate of the area to display
+ * @y:       Y coordinate of the area to display
+ * @width:   width of the area to display
+ * @height:  height of the area to display
+ *
+ * Looks at @level first, then at the finer levels below it, and
+ * returns the first one whose tiles are all valid in the given area
+ * (in bottom level coordinates). The area can be rendered from that
+ * level right away, without waiting for the upper levels to be
+ * rebuilt.
+ *
+ * Return value: @level or the closest finer level that is valid, or
+ *               @level if none is
+ **/
+gint
+tile_pyramid_get_valid_level (TilePyramid *pyramid,
+                              gint         level,
+                              gint         x,
+                              gint         y,
+                              gint         width,
+                              gint         height)
+{
+  gint l;
+
+  g_return_val_if_fail (pyramid != NULL, level);
+
+  for (l = MIN (level, pyramid->top_level); l >= 0; l--)
+    {
+      gint x1 = x >> l;
+      gint y1 = y >> l;
+      gint x2 = (x + width  + (1 << l) - 1) >> l;
+      gint y2 = (y + height + (1 << l) - 1) >> l;
+
+      if (tile_manager_area_is_valid (pyramid->tiles[l],
+                                      x1, y1, x2 - x1, y2 - y1))
+        return l;
+    }
+
+  return level;
+}
+
 /**
  * tile_pyramid_set_validate_proc:
  * @pyramid:   a #TilePyramid
@@ -348,6 +545,17 @@ tile_pyramid_alloc_levels (TilePyramid *pyramid,
   if (top_level <= pyramid->top_level)
     return top_level;
 
+  /*  new levels start out invalid, let tile_pyramid_update() build them  */
+  if (pyramid->dirty_x1 < pyramid->dirty_x2)
+    pyramid->dirty_level = MIN (pyramid->dirty_level, pyramid->top_level + 1);
+  else
+    pyramid->dirty_level = pyramid->top_level + 1;
+
+  pyramid->dirty_x1 = 0;
+  pyramid->dirty_y1 = 0;
+  pyramid->dirty_x2 = pyramid->width;
+  pyramid->dirty_y2 = pyramid->height;
+
   for (level = pyramid->top_level + 1; level <= top_level; level++)
     {
       TileValidateProc  proc;
@@ -375,6 +583,9 @@ tile_pyramid_alloc_levels (TilePyramid *pyramid,
       tile_manager_set_validate_proc (pyramid->tiles[level],
                                       proc,
                                       pyramid->tiles[level - 1]);
+
+      /*  upper level tiles only read the level below  */
+      tile_manager_set_validate_threadsafe (pyramid->tiles[level], TRUE);
     }
 
   return pyramid->top_level;
@@ -466,12 +677,25 @@ tile_pyramid_write_quarter (Tile       *dest,
       const guchar *src2 = src0 + bpp * src_ewidth;
       const guchar *src3 = src1 + bpp * src_ewidth;
       guchar       *dst  = dest_data;
-      gint          x;
+      gint          x    = 0;
+
+      /*  without alpha there is nothing to pre-multiply  */
+      if (bpp == 1 || bpp == 3)
+        {
+          x = tile_pyramid_average_row (dst, src0, src2,
+                                        src_ewidth / 2, bpp);
+
+          dst  += x * bpp;
+          src0 += x * bpp * 2;
+          src1 += x * bpp * 2;
+          src2 += x * bpp * 2;
+          src3 += x * bpp * 2;
+        }
 
       switch (bpp)
         {
         case 1:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
 
@@ -519,7 +743,7 @@ tile_pyramid_write_quarter (Tile       *dest,
           break;
 
         case 3:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
               dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
@@ -619,10 +843,18 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
       guchar       *dst  = dest_data;
       gint          x;
 
+      x = tile_pyramid_average_row (dst, src0, src2, src_ewidth / 2, bpp);
+
+      dst  += x * bpp;
+      src0 += x * bpp * 2;
+      src1 += x * bpp * 2;
+      src2 += x * bpp * 2;
+      src3 += x * bpp * 2;
+
       switch (bpp)
         {
         case 1:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
 
@@ -636,7 +868,7 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
           break;
 
         case 2:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
               dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
@@ -651,7 +883,7 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
           break;
 
         case 3:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
               dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
@@ -667,7 +899,7 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
           break;
 
         case 4:
-          for (x = 0; x < src_ewidth / 2; x++)
+          for (; x < src_ewidth / 2; x++)
             {
               dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
               dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
@@ -688,3 +920,106 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
       src_data += src_ewidth * bpp * 2;
     }
 }
+
+/* Average 2x2 blocks of two source rows into one destination row of
+ * @width pixels, without any alpha handling. The SSE2 version works on
+ * 16 source bytes at a time and computes the same rounded sums as the
+ * C loops. Returns the number of destination pixels written, the
+ * caller handles the rest.
+ */
+static gint
+tile_pyramid_average_row (guchar       *dest,
+                          const guchar *src0,
+                          const guchar *src1,
+                          gint          width,
+                          gint          bpp)
+{
+#ifdef USE_SSE2_BOX_FILTER
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one  = _mm_set1_epi16 (1);
+  const __m128i two  = _mm_set1_epi16 (2);
+  gint          step;
+  gint          x;
+
+  /*  three bytes per pixel don't fit the 16 byte registers  */
+  if (bpp == 3)
+    return 0;
+
+  step = 8 / bpp;
+
+  for (x = 0; x + step <= width; x += step)
+    {
+      const __m128i a  = _mm_loadu_si128 ((const __m128i *) src0);
+      const __m128i b  = _mm_loadu_si128 ((const __m128i *) src1);
+      __m128i       lo = _mm_add_epi16 (_mm_unpacklo_epi8 (a, zero),
+                                        _mm_unpacklo_epi8 (b, zero));
+      __m128i       hi = _mm_add_epi16 (_mm_unpackhi_epi8 (a, zero),
+                                        _mm_unpackhi_epi8 (b, zero));
+      __m128i       sum;
+
+      switch (bpp)
+        {
+        case 2:
+          /*  interleave the channels of neighbouring pixels  */
+          lo = _mm_shufflelo_epi16 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+          lo = _mm_shufflehi_epi16 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+          hi = _mm_shufflelo_epi16 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+          hi = _mm_shufflehi_epi16 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+          /*  fallthrough  */
+
+        case 1:
+          sum = _mm_packs_epi32 (_mm_madd_epi16 (lo, one),
+                                 _mm_madd_epi16 (hi, one));
+          break;
+
+        default:
+          sum = _mm_add_epi16 (_mm_unpacklo_epi64 (lo, hi),
+                               _mm_unpackhi_epi64 (lo, hi));
+          break;
+        }
+
+      sum = _mm_srli_epi16 (_mm_add_epi16 (sum, two), 2);
+
+      _mm_storel_epi64 ((__m128i *) dest, _mm_packus_epi16 (sum, sum));
+
+      dest += 8;
+      src0 += 16;
+      src1 += 16;
+    }
+
+  return x;
+#else
+  return 0;
+#endif
+}
+
+/* Rebuilds the tiles of an upper level in @region by locking them,
+ * which validates them. Tiles whose source tiles in the level below
+ * are not valid yet are skipped, so that nothing is validated further
+ * down than the level below.
+ */
+static void
+tile_pyramid_update_func (TilePyramidUpdate *update,
+                          PixelRegion       *region)
+{
+  gint x, y;
+
+  for (y = region->y; y < region->y + region->h; y += TILE_HEIGHT)
+    for (x = region->x; x < region->x + region->w; x += TILE_WIDTH)
+      {
+        Tile *tile;
+
+        if (! tile_manager_area_is_valid (update->tiles_below,
+                                          x * 2, y * 2,
+                                          TILE_WIDTH * 2, TILE_HEIGHT * 2))
+          {
+            g_atomic_int_set (&update->skipped, TRUE);
+            continue;
+          }
+
+        tile = tile_manager_get_tile (update->tiles, x, y, TRUE, FALSE);
+
+        if (tile)
+          tile_release (tile, FALSE);
+      }
+}
@@ -47,6 +47,19 @@ void          tile_pyramid_invalidate_area   (TilePyramid       *pyramid,
                                               gint               width,
                                               gint               height);
 
+gboolean      tile_pyramid_update            (TilePyramid       *pyramid,
+                                              gint              *x,
+                                              gint              *y,
+                                              gint              *width,
+                                              gint              *height);
+
+gint          tile_pyramid_get_valid_level   (TilePyramid       *pyramid,
+                                              gint               level,
+                                              gint               x,
+                                              gint               y,
+                                              gint               width,
+                                              gint               height);
+
 void          tile_pyramid_set_validate_proc (TilePyramid       *pyramid,
                                               TileValidateProc   proc,
                                               gpointer           user_data);
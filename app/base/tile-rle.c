@@ -0,0 +1,230 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile-rle.h"
+
+
+/*  This is the run length encoding used for tiles in XCF files, see
+ *  xcf_save_tile_rle().  Each channel is encoded separately; a run is
+ *  either a repeated value or a sequence of literal values, with long
+ *  runs (128 or more) using a two byte length.
+ */
+
+gint
+tile_rle_encode (const guchar *src,
+                 gint          bpp,
+                 gint          n_pixels,
+                 guchar       *dest,
+                 gint          dest_size)
+{
+  gint len = 0;
+  gint i, j;
+
+  g_return_val_if_fail (src != NULL, -1);
+  g_return_val_if_fail (dest != NULL, -1);
+  g_return_val_if_fail (bpp > 0 && bpp <= 4, -1);
+
+  for (i = 0; i < bpp; i++)
+    {
+      const guchar *data = src + i;
+
+      gint  state  = 0;
+      gint  length = 0;
+      gint  size   = n_pixels;
+      guint last   = -1;
+
+      while (size > 0)
+        {
+          switch (state)
+            {
+            case 0:
+              /* in state 0 we try to find a long sequence of
+               *  matching values.
+               */
+              if ((length == 32768) ||
+                  ((size - length) <= 0) ||
+                  ((length > 1) && (last != *data)))
+                {
+                  if (len + 4 > dest_size)
+                    return -1;
+
+                  if (length >= 128)
+                    {
+                      dest[len++] = 127;
+                      dest[len++] = (length >> 8);
+                      dest[len++] = length & 0x00FF;
+                      dest[len++] = last;
+                    }
+                  else
+                    {
+                      dest[len++] = length - 1;
+                      dest[len++] = last;
+                    }
+
+                  size -= length;
+                  length = 0;
+                }
+              else if ((length == 1) && (last != *data))
+                {
+                  state = 1;
+                }
+              break;
+
+            case 1:
+              /* in state 1 we try and find a long sequence of
+               *  non-matching values.
+               */
+              if ((length == 32768) ||
+                  ((size - length) == 0) ||
+                  ((length > 0) && (last == *data) &&
+                   ((size - length) == 1 || last == data[bpp])))
+                {
+                  const guchar *t;
+
+                  state = 0;
+
+                  if (len + 3 + length > dest_size)
+                    return -1;
+
+                  if (length >= 128)
+                    {
+                      dest[len++] = 255 - 127;
+                      dest[len++] = (length >> 8);
+                      dest[len++] = length & 0x00FF;
+                    }
+                  else
+                    {
+                      dest[len++] = 255 - (length - 1);
+                    }
+
+                  t = data - length * bpp;
+
+                  for (j = 0; j < length; j++)
+                    {
+                      dest[len++] = *t;
+                      t += bpp;
+                    }
+
+                  size -= length;
+                  length = 0;
+                }
+              break;
+            }
+
+          if (size > 0)
+            {
+              length += 1;
+              last = *data;
+              data += bpp;
+            }
+        }
+    }
+
+  return len;
+}
+
+gboolean
+tile_rle_decode (const guchar *src,
+                 gint          src_size,
+                 gint          bpp,
+                 gint          n_pixels,
+                 guchar       *dest)
+{
+  const guchar *limit = src + src_size;
+  gint          i, j;
+
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (dest != NULL, FALSE);
+  g_return_val_if_fail (bpp > 0 && bpp <= 4, FALSE);
+
+  for (i = 0; i < bpp; i++)
+    {
+      guchar *data = dest + i;
+      gint    size = n_pixels;
+
+      while (size > 0)
+        {
+          gint length;
+
+          if (src >= limit)
+            return FALSE;
+
+          length = *src++;
+
+          if (length >= 128)
+            {
+              length = 255 - (length - 1);
+
+              if (length == 128)
+                {
+                  if (src + 2 > limit)
+                    return FALSE;
+
+                  length = (src[0] << 8) + src[1];
+                  src += 2;
+                }
+
+              size -= length;
+
+              if (size < 0 || src + length > limit)
+                return FALSE;
+
+              for (j = 0; j < length; j++)
+                {
+                  *data = *src++;
+                  data += bpp;
+                }
+            }
+          else
+            {
+              guchar val;
+
+              length += 1;
+
+              if (length == 128)
+                {
+                  if (src + 2 > limit)
+                    return FALSE;
+
+                  length = (src[0] << 8) + src[1];
+                  src += 2;
+                }
+
+              size -= length;
+
+              if (size < 0 || src >= limit)
+                return FALSE;
+
+              val = *src++;
+
+              for (j = 0; j < length; j++)
+                {
+                  *data = val;
+                  data += bpp;
+                }
+            }
+        }
+    }
+
+  return TRUE;
+}
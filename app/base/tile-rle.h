@@ -0,0 +1,49 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TILE_RLE_H__
+#define __TILE_RLE_H__
+
+
+/*  The worst case size of RLE encoded tile data, the encoding can
+ *  grow the data slightly for noisy content.
+ */
+#define TILE_RLE_MAX_SIZE(n_bytes)  ((n_bytes) + (n_bytes) / 2 + 16)
+
+
+/*  Encodes @n_pixels pixels of @bpp bytes each, using the per-channel
+ *  run length encoding of the XCF file format.  Returns the number of
+ *  bytes written to @dest, or -1 if the result would not fit into
+ *  @dest_size bytes.
+ */
+gint       tile_rle_encode (const guchar *src,
+                            gint          bpp,
+                            gint          n_pixels,
+                            guchar       *dest,
+                            gint          dest_size);
+
+/*  Decodes data produced by tile_rle_encode().  Returns FALSE if
+ *  @src is corrupt or does not describe exactly @n_pixels pixels.
+ */
+gboolean   tile_rle_decode (const guchar *src,
+                            gint          src_size,
+                            gint          bpp,
+                            gint          n_pixels,
+                            guchar       *dest);
+
+
+#endif /* __TILE_RLE_H__ */
@@ -19,12 +19,18 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
+#if defined (HAVE_PREADV) && defined (HAVE_PWRITEV)
+#include <sys/uio.h>
+#endif
+
 #include <glib-object.h>
 #include <glib/gstdio.h>
 
@@ -47,10 +53,12 @@
 
 #include "base-utils.h"
 #include "tile.h"
+#include "tile-manager-private.h"
 #include "tile-rowhints.h"
 #include "tile-swap.h"
 #include "tile-private.h"
 #include "tile-cache.h"
+#include "tile-rle.h"
 
 #include "gimp-intl.h"
 
@@ -58,6 +66,7 @@ typedef enum
 {
   SWAP_IN = 1,
   SWAP_OUT,
+  SWAP_OUT_ASYNC,
   SWAP_DELETE
 } SwapCommand;
 
@@ -69,6 +78,60 @@ typedef gint (* SwapFunc) (gint         fd,
 
 #define MAX_OPEN_SWAP_FILES  16
 
+/*  only keep tiles in the compressed tile cache that shrink to at
+ *  least 1/ZCACHE_MIN_RATIO of their size
+ */
+#define ZCACHE_MIN_RATIO     2
+
+
+/*  With threads and positional I/O available, tiles evicted under
+ *  cache pressure are handed to a swap I/O thread instead of being
+ *  written by whoever evicted them.  The thread batches requests,
+ *  merges adjacent swap offsets into vectored reads and writes, and
+ *  reads ahead when tiles of a tile manager are swapped in in order.
+ */
+#if defined (ENABLE_MP) && defined (HAVE_PREAD) && defined (HAVE_PWRITE)
+#define TILE_SWAP_ASYNC 1
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+
+#define SWAP_IO_MAX_BATCH        64   /*  requests per I/O thread wakeup    */
+#define SWAP_IO_MAX_PENDING      (32 * 1024 * 1024) /* bytes not yet written */
+#define SWAP_IO_PREFETCH_TILES    8   /*  read-ahead window                 */
+#define SWAP_IO_MAX_PREFETCHED  256   /*  read-ahead tiles kept in memory   */
+
+typedef enum
+{
+  SWAP_IO_WRITE,
+  SWAP_IO_READ,
+  SWAP_IO_QUIT
+} SwapIOType;
+
+typedef enum
+{
+  SWAP_IO_QUEUED,
+  SWAP_IO_INFLIGHT,
+  SWAP_IO_DONE
+} SwapIOState;
+
+typedef struct _SwapIORequest SwapIORequest;
+
+struct _SwapIORequest
+{
+  SwapIOType   type;
+  SwapIOState  state;
+  gboolean     cancelled; /*  dropped from the tables while queued or in
+                           *  flight, the I/O thread frees it when done
+                           */
+  gint         error;     /*  errno of a failed transfer  */
+  gint64       offset;
+  gint         size;
+  guchar      *data;
+};
+
+#endif /* TILE_SWAP_ASYNC */
+
 
 typedef struct _SwapFile     SwapFile;
 typedef struct _SwapFileGap  SwapFileGap;
@@ -95,9 +158,30 @@ static void          tile_swap_default_in     (SwapFile    *swap_file,
                                                Tile        *tile);
 static void          tile_swap_default_out    (SwapFile    *swap_file,
                                                Tile        *tile);
+static void          tile_swap_default_write  (SwapFile    *swap_file,
+                                               Tile        *tile,
+                                               const guchar *data);
 static void          tile_swap_default_delete (SwapFile    *swap_file,
                                                Tile        *tile);
 
+#ifdef TILE_SWAP_ASYNC
+static void          tile_swap_io_init        (void);
+static void          tile_swap_io_exit        (void);
+static void          tile_swap_io_out         (SwapFile    *swap_file,
+                                               Tile        *tile);
+static gboolean      tile_swap_io_write       (SwapFile    *swap_file,
+                                               Tile        *tile,
+                                               guchar      *data);
+static gboolean      tile_swap_io_in          (Tile        *tile);
+static void          tile_swap_io_read_ahead  (Tile        *tile);
+static void          tile_swap_io_forget      (gint64       offset);
+static gpointer      tile_swap_io_thread      (gpointer     data);
+#endif
+
+static void          tile_swap_zcache_take    (Tile        *tile);
+static void          tile_swap_zcache_remove  (Tile        *tile);
+static gboolean      tile_swap_zcache_evict   (SwapFile    *swap_file);
+
 static gint64        tile_swap_find_offset    (SwapFile    *swap_file,
                                                gint64       bytes);
 static void          tile_swap_open           (SwapFile    *swap_file);
@@ -110,8 +194,42 @@ static void          tile_swap_gap_destroy    (SwapFileGap *gap);
 
 static SwapFile     * gimp_swap_file   = NULL;
 
+#ifdef ENABLE_MP
+/*  the tile cache is segmented, so several threads may swap at once  */
+static GMutex       * swap_mutex       = NULL;
+
+#define SWAP_LOCK    g_mutex_lock (swap_mutex)
+#define SWAP_UNLOCK  g_mutex_unlock (swap_mutex)
+#else
+#define SWAP_LOCK    /* nothing */
+#define SWAP_UNLOCK  /* nothing */
+#endif
+
 static const gint64   swap_file_grow   = 1024 * TILE_WIDTH * TILE_HEIGHT * 4;
 
+#ifdef TILE_SWAP_ASYNC
+static GThread      * swap_io_thread        = NULL;
+static GAsyncQueue  * swap_io_queue         = NULL;
+static GCond        * swap_io_cond          = NULL; /* requests completed */
+static GHashTable   * swap_io_writes        = NULL; /* offset -> request  */
+static GHashTable   * swap_io_reads         = NULL; /* offset -> request  */
+static GQueue         swap_io_prefetched    = G_QUEUE_INIT;
+static gint64         swap_io_pending_bytes = 0;
+static gint           swap_io_errno         = 0;
+static TileManager  * swap_io_last_tm       = NULL;
+static gint           swap_io_last_num      = -1;
+#endif
+
+/*  the compressed tile cache, least recently compressed tile first  */
+static Tile         * zcache_first     = NULL;
+static Tile         * zcache_last      = NULL;
+static guint64        zcache_size      = 0;
+static guint64        zcache_max_size  = 0;
+static guint          zcache_hits      = 0;
+static guint          zcache_misses    = 0;
+static guint          zcache_rejected  = 0;
+static guint          zcache_evicted   = 0;
+
 static gboolean       seek_err_msg     = TRUE;
 static gboolean       read_err_msg     = TRUE;
 static gboolean       write_err_msg    = TRUE;
@@ -217,6 +335,14 @@ tile_swap_init (const gchar *path)
   gimp_swap_file->cur_position  = 0;
   gimp_swap_file->fd            = -1;
 
+#ifdef ENABLE_MP
+  swap_mutex = g_mutex_new ();
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+  tile_swap_io_init ();
+#endif
+
   g_free (basename);
   g_free (dirname);
 }
@@ -251,6 +377,11 @@ tile_swap_exit (void)
               tile_total_interactive_sec +
               0.000001 * tile_total_interactive_usec);
 
+  g_printerr ("Compressed tile cache hits: %u\n", zcache_hits);
+  g_printerr ("Compressed tile cache misses: %u\n", zcache_misses);
+  g_printerr ("Tiles too large to keep compressed: %u\n", zcache_rejected);
+  g_printerr ("Compressed tiles written to disk: %u\n\n", zcache_evicted);
+
 #endif
 
   if (tile_global_refcount () != 0)
@@ -258,6 +389,10 @@ tile_swap_exit (void)
 
   g_return_if_fail (gimp_swap_file != NULL);
 
+#ifdef TILE_SWAP_ASYNC
+  tile_swap_io_exit ();
+#endif
+
 #ifdef GIMP_UNSTABLE
   if (gimp_swap_file->swap_file_end != 0)
     {
@@ -282,6 +417,11 @@ tile_swap_exit (void)
   g_slice_free (SwapFile, gimp_swap_file);
 
   gimp_swap_file = NULL;
+
+#ifdef ENABLE_MP
+  g_mutex_free (swap_mutex);
+  swap_mutex = NULL;
+#endif
 }
 
 /* check if we can open a swap file */
@@ -310,7 +450,10 @@ tile_swap_test (void)
 void
 tile_swap_in (Tile *tile)
 {
-  if (tile->swap_offset == -1)
+  /*  check zdata first, the compressed tile cache assigns a swap
+   *  offset before it drops the compressed data
+   */
+  if (! tile->zdata && tile->swap_offset == -1)
     {
       tile_alloc (tile);
       return;
@@ -325,24 +468,199 @@ tile_swap_out (Tile *tile)
   tile_swap_command (tile, SWAP_OUT);
 }
 
+/*  Like tile_swap_out(), but the write may happen later on the swap
+ *  I/O thread.  The tile's data is handed over to the swap code and
+ *  tile->data is NULL afterwards, unless the write could not be
+ *  queued, in which case this behaves exactly like tile_swap_out().
+ */
+void
+tile_swap_out_async (Tile *tile)
+{
+  tile_swap_command (tile, SWAP_OUT_ASYNC);
+}
+
 void
 tile_swap_delete (Tile *tile)
 {
   tile_swap_command (tile, SWAP_DELETE);
 }
 
+/*  Waits until the swap I/O thread has caught up with the tiles
+ *  queued for writing.  Call this before evicting tiles from the tile
+ *  cache, without holding any tile cache lock, so that the evicting
+ *  thread is slowed down instead of writing the tiles itself.
+ */
+void
+tile_swap_throttle (void)
+{
+#ifdef TILE_SWAP_ASYNC
+  if (! swap_io_thread)
+    return;
+
+  SWAP_LOCK;
+
+  while (swap_io_pending_bytes > SWAP_IO_MAX_PENDING)
+    g_cond_wait (swap_io_cond, swap_mutex);
+
+  SWAP_UNLOCK;
+#endif
+}
+
+/*  Moves the data of an unreferenced tile into the compressed tile
+ *  cache, where it stays until it is swapped in again or the
+ *  compressed cache runs out of space and writes it to disk.  Returns
+ *  FALSE, leaving the tile untouched, if the cache is disabled, the
+ *  swap file already has an up-to-date copy of the tile, or the tile
+ *  does not compress well enough.
+ */
+gboolean
+tile_swap_compress (Tile *tile)
+{
+  guchar buf[TILE_WIDTH * TILE_HEIGHT * 4 / ZCACHE_MIN_RATIO];
+  gint   zsize;
+
+  if (! zcache_max_size || ! tile->data)
+    return FALSE;
+
+  /*  a clean tile with a swap copy can simply be dropped  */
+  if (! tile->dirty && tile->swap_offset != -1)
+    return FALSE;
+
+  zsize = tile_rle_encode (tile->data, tile->bpp,
+                           tile->ewidth * tile->eheight,
+                           buf, tile->size / ZCACHE_MIN_RATIO);
+
+  SWAP_LOCK;
+
+  if (zsize < 0)
+    {
+      zcache_rejected++;
+
+      SWAP_UNLOCK;
+      return FALSE;
+    }
+
+  tile->zdata = g_memdup (buf, zsize);
+  tile->zsize = zsize;
+
+  g_free (tile->data);
+  tile->data = NULL;
+
+  tile->next = NULL;
+  tile->prev = zcache_last;
+
+  if (zcache_last)
+    zcache_last->next = tile;
+  else
+    zcache_first = tile;
+
+  zcache_last = tile;
+  zcache_size += zsize;
+
+  while (zcache_size > zcache_max_size)
+    {
+      if (! tile_swap_zcache_evict (gimp_swap_file))
+        break;
+    }
+
+  SWAP_UNLOCK;
+
+  return TRUE;
+}
+
+void
+tile_swap_set_compressed_cache_size (guint64 cache_size)
+{
+  SWAP_LOCK;
+
+  zcache_max_size = cache_size;
+
+  while (zcache_size > zcache_max_size)
+    {
+      if (! tile_swap_zcache_evict (gimp_swap_file))
+        break;
+    }
+
+  SWAP_UNLOCK;
+}
+
+void
+tile_swap_get_compressed_cache_stats (guint64 *size,
+                                      guint   *hits,
+                                      guint   *misses)
+{
+  SWAP_LOCK;
+
+  if (size)
+    *size = zcache_size;
+
+  if (hits)
+    *hits = zcache_hits;
+
+  if (misses)
+    *misses = zcache_misses;
+
+  SWAP_UNLOCK;
+}
+
 static void
 tile_swap_command (Tile *tile,
                    gint  command)
 {
+  SWAP_LOCK;
+
+  if (tile->zdata)
+    {
+      switch (command)
+        {
+        case SWAP_IN:
+          if (! tile->data)
+            {
+              tile_swap_zcache_take (tile);
+              zcache_hits++;
+            }
+
+          SWAP_UNLOCK;
+          return;
+
+        case SWAP_DELETE:
+          tile_swap_zcache_remove (tile);
+          break;
+        }
+    }
+  else if (command == SWAP_IN && zcache_max_size > 0)
+    {
+      zcache_misses++;
+    }
+
+  if (command == SWAP_DELETE && tile->swap_offset == -1)
+    {
+      SWAP_UNLOCK;
+      return;
+    }
+
   if (gimp_swap_file->fd == -1)
     {
       tile_swap_open (gimp_swap_file);
 
       if (G_UNLIKELY (gimp_swap_file->fd == -1))
-        return;
+        {
+          SWAP_UNLOCK;
+          return;
+        }
     }
 
+#ifdef TILE_SWAP_ASYNC
+  if (G_UNLIKELY (swap_io_errno))
+    {
+      if (write_err_msg)
+        g_message ("unable to write tile data to disk: %s",
+                   g_strerror (swap_io_errno));
+      write_err_msg = FALSE;
+      swap_io_errno = 0;
+    }
+#endif
+
   switch (command)
     {
     case SWAP_IN:
@@ -351,10 +669,105 @@ tile_swap_command (Tile *tile,
     case SWAP_OUT:
       tile_swap_default_out (gimp_swap_file, tile);
       break;
+    case SWAP_OUT_ASYNC:
+#ifdef TILE_SWAP_ASYNC
+      tile_swap_io_out (gimp_swap_file, tile);
+#else
+      tile_swap_default_out (gimp_swap_file, tile);
+#endif
+      break;
     case SWAP_DELETE:
       tile_swap_default_delete (gimp_swap_file, tile);
       break;
     }
+
+  SWAP_UNLOCK;
+}
+
+/*  The compressed tile cache.  Tiles in it are unreferenced and not
+ *  in the tile cache; the list reuses the tile cache's list pointers.
+ *  All of it is protected by the swap lock.
+ */
+
+static void
+tile_swap_zcache_remove (Tile *tile)
+{
+  if (tile->next)
+    tile->next->prev = tile->prev;
+  else
+    zcache_last = tile->prev;
+
+  if (tile->prev)
+    tile->prev->next = tile->next;
+  else
+    zcache_first = tile->next;
+
+  tile->next = tile->prev = NULL;
+
+  zcache_size -= tile->zsize;
+
+  g_free (tile->zdata);
+  tile->zdata = NULL;
+  tile->zsize = 0;
+}
+
+static void
+tile_swap_zcache_take (Tile *tile)
+{
+  tile_alloc (tile);
+
+  if (! tile_rle_decode (tile->zdata, tile->zsize, tile->bpp,
+                         tile->ewidth * tile->eheight, tile->data))
+    g_warning ("corrupt tile in the compressed tile cache");
+
+  tile_swap_zcache_remove (tile);
+}
+
+/*  Drops the oldest tile from the compressed cache, writing it to the
+ *  swap file first unless the swap file has an up-to-date copy.
+ */
+static gboolean
+tile_swap_zcache_evict (SwapFile *swap_file)
+{
+  Tile *tile = zcache_first;
+
+  if (! tile)
+    return FALSE;
+
+  if (tile->dirty || tile->swap_offset == -1)
+    {
+      guchar *data;
+
+      if (swap_file->fd == -1)
+        {
+          tile_swap_open (swap_file);
+
+          if (G_UNLIKELY (swap_file->fd == -1))
+            return FALSE;
+        }
+
+      data = g_malloc (tile->size);
+
+      tile_rle_decode (tile->zdata, tile->zsize, tile->bpp,
+                       tile->ewidth * tile->eheight, data);
+
+#ifdef TILE_SWAP_ASYNC
+      if (! swap_io_thread || ! tile_swap_io_write (swap_file, tile, data))
+#endif
+        {
+          tile_swap_default_write (swap_file, tile, data);
+          g_free (data);
+        }
+
+      /*  keep the tile compressed if it couldn't be written  */
+      if (tile->dirty || tile->swap_offset == -1)
+        return FALSE;
+    }
+
+  tile_swap_zcache_remove (tile);
+  zcache_evicted++;
+
+  return TRUE;
 }
 
 /* The actual swap file code. The swap file consists of tiles
@@ -395,6 +808,13 @@ tile_swap_default_in (SwapFile *swap_file,
   tile->inonce = TRUE;
 #endif
 
+#ifdef TILE_SWAP_ASYNC
+  tile_swap_io_read_ahead (tile);
+
+  if (tile_swap_io_in (tile))
+    return;
+#endif
+
   if (swap_file->cur_position != tile->swap_offset)
     {
       swap_file->cur_position = tile->swap_offset;
@@ -487,6 +907,15 @@ tile_swap_default_in (SwapFile *swap_file,
 static void
 tile_swap_default_out (SwapFile *swap_file,
                        Tile     *tile)
+{
+  tile_swap_default_write (swap_file, tile, tile->data);
+}
+
+/*  writes @data as the contents of @tile, which need not be tile->data  */
+static void
+tile_swap_default_write (SwapFile     *swap_file,
+                         Tile         *tile,
+                         const guchar *data)
 {
   gint   bytes;
   gint   nleft;
@@ -512,6 +941,10 @@ tile_swap_default_out (SwapFile *swap_file,
   else
     newpos = tile->swap_offset;
 
+#ifdef TILE_SWAP_ASYNC
+  tile_swap_io_forget (newpos);
+#endif
+
   if (swap_file->cur_position != newpos)
     {
 
@@ -536,7 +969,7 @@ tile_swap_default_out (SwapFile *swap_file,
   nleft = tile->size;
   while (nleft > 0)
     {
-      gint err = write (swap_file->fd, tile->data + tile->size - nleft, nleft);
+      gint err = write (swap_file->fd, data + tile->size - nleft, nleft);
 
       if (err <= 0)
         {
@@ -607,6 +1040,11 @@ tile_swap_default_delete (SwapFile *swap_file,
   end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
   tile->swap_offset = -1;
 
+#ifdef TILE_SWAP_ASYNC
+  /*  the space may be handed out again right away  */
+  tile_swap_io_forget (start);
+#endif
+
   tmp = swap_file->gaps;
   while (tmp)
     {
@@ -791,3 +1229,512 @@ tile_swap_gap_destroy (SwapFileGap *gap)
 {
   g_slice_free (SwapFileGap, gap);
 }
+
+
+#ifdef TILE_SWAP_ASYNC
+
+/*  The swap I/O thread.
+ *
+ *  All tables below are protected by swap_mutex.  A write request is
+ *  in swap_io_writes from the moment it is queued until its data has
+ *  reached the file; there is never more than one write per offset.
+ *  A read-ahead request stays in swap_io_reads until a tile takes its
+ *  data, it gets evicted, or the offset is written or freed.
+ */
+
+#ifndef HAVE_PREADV
+struct iovec
+{
+  void   *iov_base;
+  size_t  iov_len;
+};
+
+/*  transfer only the first vector, the caller loops over short I/O  */
+#define preadv(fd, iov, n, offset)  pread  (fd, (iov)->iov_base, (iov)->iov_len, offset)
+#define pwritev(fd, iov, n, offset) pwrite (fd, (iov)->iov_base, (iov)->iov_len, offset)
+#endif
+
+static void
+tile_swap_io_init (void)
+{
+  GError *error = NULL;
+
+  swap_io_queue  = g_async_queue_new ();
+  swap_io_cond   = g_cond_new ();
+  swap_io_writes = g_hash_table_new (g_int64_hash, g_int64_equal);
+  swap_io_reads  = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+  swap_io_thread = g_thread_create (tile_swap_io_thread, NULL, TRUE, &error);
+
+  if (! swap_io_thread)
+    {
+      g_warning ("unable to create swap I/O thread: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+static void
+tile_swap_io_request_free (SwapIORequest *request)
+{
+  g_free (request->data);
+  g_slice_free (SwapIORequest, request);
+}
+
+static void
+tile_swap_io_exit (void)
+{
+  SwapIORequest *request;
+
+  if (swap_io_thread)
+    {
+      request = g_slice_new0 (SwapIORequest);
+      request->type = SWAP_IO_QUIT;
+
+      g_async_queue_push (swap_io_queue, request);
+      g_thread_join (swap_io_thread);
+
+      swap_io_thread = NULL;
+    }
+
+  while ((request = g_queue_pop_head (&swap_io_prefetched)))
+    tile_swap_io_request_free (request);
+
+  g_hash_table_destroy (swap_io_reads);
+  g_hash_table_destroy (swap_io_writes);
+  g_async_queue_unref (swap_io_queue);
+  g_cond_free (swap_io_cond);
+
+  swap_io_reads  = NULL;
+  swap_io_writes = NULL;
+  swap_io_queue  = NULL;
+  swap_io_cond   = NULL;
+}
+
+/*  Makes sure nothing queued for @offset touches the swap file any
+ *  more, waiting for a write that is already in flight.
+ */
+static void
+tile_swap_io_forget (gint64 offset)
+{
+  SwapIORequest *request;
+
+  while ((request = g_hash_table_lookup (swap_io_writes, &offset)) &&
+         request->state == SWAP_IO_INFLIGHT)
+    {
+      g_cond_wait (swap_io_cond, swap_mutex);
+    }
+
+  if (request)
+    {
+      g_hash_table_remove (swap_io_writes, &offset);
+
+      swap_io_pending_bytes -= request->size;
+      request->cancelled = TRUE;
+    }
+
+  request = g_hash_table_lookup (swap_io_reads, &offset);
+
+  if (request)
+    {
+      g_hash_table_remove (swap_io_reads, &offset);
+
+      if (request->state == SWAP_IO_DONE)
+        {
+          g_queue_remove (&swap_io_prefetched, request);
+          tile_swap_io_request_free (request);
+        }
+      else
+        {
+          request->cancelled = TRUE;
+        }
+    }
+}
+
+static void
+tile_swap_io_out (SwapFile *swap_file,
+                  Tile     *tile)
+{
+  if (swap_io_thread && tile_swap_io_write (swap_file, tile, tile->data))
+    tile->data = NULL;
+  else
+    tile_swap_default_out (swap_file, tile);
+}
+
+/*  Queues @data to be written as the contents of @tile, the swap code
+ *  takes ownership of @data.  Never waits for the I/O thread, because
+ *  the caller may hold a tile cache segment lock.  Returns FALSE if
+ *  too much data is waiting to be written already, the caller has to
+ *  write the tile itself then.
+ */
+static gboolean
+tile_swap_io_write (SwapFile *swap_file,
+                    Tile     *tile,
+                    guchar   *data)
+{
+  SwapIORequest *request;
+  gint64         offset;
+
+  /*  don't let unwritten tiles pile up faster than the disk takes
+   *  them, see tile_swap_throttle()
+   */
+  if (swap_io_pending_bytes > SWAP_IO_MAX_PENDING)
+    return FALSE;
+
+#ifdef TILE_PROFILING
+  tile_total_swapout++;
+
+  if (! tile->outonce)
+    tile_unique_swapout++;
+
+  tile->outonce = TRUE;
+#endif
+
+  if (tile->swap_offset == -1)
+    offset = tile_swap_find_offset (swap_file,
+                                    TILE_WIDTH * TILE_HEIGHT * tile->bpp);
+  else
+    offset = tile->swap_offset;
+
+  tile_swap_io_forget (offset);
+
+  request = g_slice_new0 (SwapIORequest);
+
+  request->type   = SWAP_IO_WRITE;
+  request->state  = SWAP_IO_QUEUED;
+  request->offset = offset;
+  request->size   = tile->size;
+  request->data   = data;
+
+  tile->dirty       = FALSE;
+  tile->swap_offset = offset;
+
+  g_hash_table_insert (swap_io_writes, &request->offset, request);
+  swap_io_pending_bytes += request->size;
+
+  g_async_queue_push (swap_io_queue, request);
+
+  return TRUE;
+}
+
+/*  Fills the tile from a pending write or a completed read-ahead,
+ *  returns FALSE if the data has to come from the file.
+ */
+static gboolean
+tile_swap_io_in (Tile *tile)
+{
+  SwapIORequest *request;
+  gint64         offset = tile->swap_offset;
+
+  request = g_hash_table_lookup (swap_io_writes, &offset);
+
+  if (request)
+    {
+      tile_alloc (tile);
+      memcpy (tile->data, request->data, tile->size);
+
+      return TRUE;
+    }
+
+  /*  a read-ahead of this tile is on its way, no point reading twice  */
+  while ((request = g_hash_table_lookup (swap_io_reads, &offset)) &&
+         request->state != SWAP_IO_DONE)
+    {
+      g_cond_wait (swap_io_cond, swap_mutex);
+    }
+
+  if (request)
+    {
+      g_hash_table_remove (swap_io_reads, &offset);
+      g_queue_remove (&swap_io_prefetched, request);
+
+      tile_alloc (tile);
+      memcpy (tile->data, request->data, tile->size);
+
+      tile_swap_io_request_free (request);
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*  If tiles of one tile manager are swapped in in order, queue reads
+ *  for the next few tiles that are on disk.
+ */
+static void
+tile_swap_io_read_ahead (Tile *tile)
+{
+  TileManager *tm;
+  gint         tile_num;
+  gint         ntiles;
+  gint         i;
+
+  if (! swap_io_thread || ! tile->tlink)
+    return;
+
+  tm       = tile->tlink->tm;
+  tile_num = tile->tlink->tile_num;
+
+  if (tm != swap_io_last_tm || tile_num != swap_io_last_num + 1)
+    {
+      swap_io_last_tm  = tm;
+      swap_io_last_num = tile_num;
+
+      return;
+    }
+
+  swap_io_last_num = tile_num;
+
+  if (! tm->tiles)
+    return;
+
+  ntiles = tm->ntile_rows * tm->ntile_cols;
+
+  for (i = tile_num + 1;
+       i <= tile_num + SWAP_IO_PREFETCH_TILES && i < ntiles;
+       i++)
+    {
+      Tile          *next = g_atomic_pointer_get (&tm->tiles[i]);
+      SwapIORequest *request;
+      gint64         offset;
+      gint           size;
+
+      /*  the caller holds the bit lock of @tile and the swap lock, so
+       *  only try-lock the other tiles, see tile_lock()
+       */
+      if (! next || ! TILE_BIT_TRYLOCK (next))
+        continue;
+
+      if (next->data || next->zdata || next->swap_offset == -1)
+        {
+          TILE_BIT_UNLOCK (next);
+          continue;
+        }
+
+      offset = next->swap_offset;
+      size   = next->size;
+
+      TILE_BIT_UNLOCK (next);
+
+      if (g_hash_table_lookup (swap_io_writes, &offset) ||
+          g_hash_table_lookup (swap_io_reads,  &offset))
+        continue;
+
+      request = g_slice_new0 (SwapIORequest);
+
+      request->type   = SWAP_IO_READ;
+      request->state  = SWAP_IO_QUEUED;
+      request->offset = offset;
+      request->size   = size;
+
+      g_hash_table_insert (swap_io_reads, &request->offset, request);
+
+      g_async_queue_push (swap_io_queue, request);
+    }
+}
+
+static gint
+tile_swap_io_request_compare (gconstpointer a,
+                              gconstpointer b)
+{
+  const SwapIORequest *r1 = *(const SwapIORequest **) a;
+  const SwapIORequest *r2 = *(const SwapIORequest **) b;
+
+  if (r1->type != r2->type)
+    return r1->type - r2->type;
+
+  if (r1->offset < r2->offset)
+    return -1;
+
+  return r1->offset > r2->offset;
+}
+
+/*  Reads or writes @n requests that are contiguous in the swap file
+ *  with as few system calls as possible.  Returns 0 or an errno value.
+ */
+static gint
+tile_swap_io_transfer (gint            fd,
+                       SwapIORequest **requests,
+                       gint            n)
+{
+  struct iovec  iov[SWAP_IO_MAX_BATCH];
+  struct iovec *vec    = iov;
+  gint64        offset = requests[0]->offset;
+  gboolean      write  = requests[0]->type == SWAP_IO_WRITE;
+  gint          i;
+
+  for (i = 0; i < n; i++)
+    {
+      iov[i].iov_base = requests[i]->data;
+      iov[i].iov_len  = requests[i]->size;
+    }
+
+  while (n > 0)
+    {
+      gssize err;
+
+      do
+        {
+          if (write)
+            err = pwritev (fd, vec, n, offset);
+          else
+            err = preadv (fd, vec, n, offset);
+        }
+      while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
+
+      if (err < 0)
+        return errno;
+
+      if (err == 0)
+        return EIO;
+
+      offset += err;
+
+      while (n > 0 && (gsize) err >= vec->iov_len)
+        {
+          err -= vec->iov_len;
+          vec++;
+          n--;
+        }
+
+      if (n > 0)
+        {
+          vec->iov_base  = (guchar *) vec->iov_base + err;
+          vec->iov_len  -= err;
+        }
+    }
+
+  return 0;
+}
+
+static void
+tile_swap_io_complete (SwapIORequest *request)
+{
+  if (request->type == SWAP_IO_WRITE)
+    {
+      if (request->error)
+        swap_io_errno = request->error;
+
+      if (! request->cancelled)
+        {
+          g_hash_table_remove (swap_io_writes, &request->offset);
+          swap_io_pending_bytes -= request->size;
+        }
+
+      tile_swap_io_request_free (request);
+    }
+  else if (request->cancelled || request->error)
+    {
+      if (! request->cancelled)
+        g_hash_table_remove (swap_io_reads, &request->offset);
+
+      tile_swap_io_request_free (request);
+    }
+  else
+    {
+      request->state = SWAP_IO_DONE;
+
+      g_queue_push_tail (&swap_io_prefetched, request);
+
+      if (g_queue_get_length (&swap_io_prefetched) > SWAP_IO_MAX_PREFETCHED)
+        {
+          request = g_queue_pop_head (&swap_io_prefetched);
+
+          g_hash_table_remove (swap_io_reads, &request->offset);
+          tile_swap_io_request_free (request);
+        }
+    }
+}
+
+static gpointer
+tile_swap_io_thread (gpointer data)
+{
+  SwapIORequest *batch[SWAP_IO_MAX_BATCH];
+  gboolean       quit = FALSE;
+
+  while (! quit)
+    {
+      SwapIORequest *request;
+      gint           n_requests = 0;
+      gint           n          = 0;
+      gint           i;
+
+      batch[n_requests++] = g_async_queue_pop (swap_io_queue);
+
+      while (n_requests < SWAP_IO_MAX_BATCH &&
+             (request = g_async_queue_try_pop (swap_io_queue)))
+        {
+          batch[n_requests++] = request;
+        }
+
+      g_mutex_lock (swap_mutex);
+
+      for (i = 0; i < n_requests; i++)
+        {
+          request = batch[i];
+
+          if (request->type == SWAP_IO_QUIT)
+            {
+              quit = TRUE;
+              g_slice_free (SwapIORequest, request);
+            }
+          else if (request->cancelled)
+            {
+              tile_swap_io_request_free (request);
+            }
+          else
+            {
+              request->state = SWAP_IO_INFLIGHT;
+              batch[n++] = request;
+            }
+        }
+
+      g_mutex_unlock (swap_mutex);
+
+      for (i = 0; i < n; i++)
+        {
+          if (batch[i]->type == SWAP_IO_READ)
+            batch[i]->data = g_malloc (batch[i]->size);
+        }
+
+      qsort (batch, n, sizeof (SwapIORequest *), tile_swap_io_request_compare);
+
+      for (i = 0; i < n; )
+        {
+          gint error;
+          gint j;
+
+          for (j = i + 1; j < n; j++)
+            {
+              if (batch[j]->type   != batch[i]->type ||
+                  batch[j]->offset != batch[j - 1]->offset + batch[j - 1]->size)
+                break;
+            }
+
+          error = tile_swap_io_transfer (gimp_swap_file->fd, batch + i, j - i);
+
+          if (error)
+            {
+              gint k;
+
+              for (k = i; k < j; k++)
+                batch[k]->error = error;
+            }
+
+          i = j;
+        }
+
+      g_mutex_lock (swap_mutex);
+
+      for (i = 0; i < n; i++)
+        tile_swap_io_complete (batch[i]);
+
+      g_cond_broadcast (swap_io_cond);
+
+      g_mutex_unlock (swap_mutex);
+    }
+
+  return NULL;
+}
+
+#endif /* TILE_SWAP_ASYNC */
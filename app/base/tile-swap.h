@@ -19,14 +19,23 @@
 #define __TILE_SWAP_H__
 
 
-void     tile_swap_init     (const gchar *path);
-void     tile_swap_exit     (void);
+void     tile_swap_init      (const gchar *path);
+void     tile_swap_exit      (void);
 
-gboolean tile_swap_test     (void);
+gboolean tile_swap_test      (void);
 
-void     tile_swap_in       (Tile        *tile);
-void     tile_swap_out      (Tile        *tile);
-void     tile_swap_delete   (Tile        *tile);
+void     tile_swap_in        (Tile        *tile);
+void     tile_swap_out       (Tile        *tile);
+void     tile_swap_out_async (Tile        *tile);
+void     tile_swap_delete    (Tile        *tile);
+void     tile_swap_throttle  (void);
+
+gboolean tile_swap_compress  (Tile        *tile);
+
+void     tile_swap_set_compressed_cache_size  (guint64  cache_size);
+void     tile_swap_get_compressed_cache_stats (guint64 *size,
+                                               guint   *hits,
+                                               guint   *misses);
 
 
 #endif /* __TILE_SWAP_H__ */
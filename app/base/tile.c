@@ -24,6 +24,7 @@
 #include "tile.h"
 #include "tile-cache.h"
 #include "tile-manager.h"
+#include "tile-manager-private.h"
 #include "tile-rowhints.h"
 #include "tile-swap.h"
 #include "tile-private.h"
@@ -33,7 +34,17 @@
 /*  #define TILE_DEBUG  */
 
 /*  This is being used from tile-swap, but just for debugging purposes.  */
-static gint tile_ref_count    = 0;
+static volatile gint tile_ref_count = 0;
+
+#ifdef ENABLE_MP
+/*  Validate procs are not thread-safe, so only one thread at a time
+ *  may validate tiles.  The lock is recursive because validating a
+ *  tile usually means locking (and validating) other tiles.
+ */
+static GStaticRecMutex validate_mutex = G_STATIC_REC_MUTEX_INIT;
+static GThread        *validate_owner = NULL;
+static guint           validate_depth = 0;
+#endif
 
 
 #ifdef TILE_PROFILING
@@ -48,7 +59,9 @@ gint tile_exist_count         = 0;
 #endif
 
 
-static void  tile_destroy (Tile *tile);
+static void  tile_destroy       (Tile *tile);
+static void  tile_validate      (Tile *tile);
+static void  tile_validate_wait (Tile *tile);
 
 
 Tile *
@@ -71,9 +84,14 @@ tile_new (gint bpp)
 void
 tile_lock (Tile *tile)
 {
+  gboolean validate;
+  gboolean validator;
+
   /* Increment the global reference count.
    */
-  tile_ref_count++;
+  g_atomic_int_inc (&tile_ref_count);
+
+  TILE_BIT_LOCK (tile);
 
   /* Increment this tile's reference count.
    */
@@ -95,12 +113,34 @@ tile_lock (Tile *tile)
       tile_swap_in (tile);
     }
 
-  /* Call 'tile_manager_validate' if the tile was invalid.
+  /* If the tile is invalid, or another thread is still validating
+   * it, we must not touch its data before it has been validated.
+   * The first thread to find it invalid does the validation, the
+   * others wait for it in tile_validate_wait(): on thread-safe tile
+   * managers they poll the validating flag, otherwise they queue up
+   * on the validate lock the validator holds, and find the tile valid
+   * once they get it.
    */
-  if (! tile->valid)
+  validator = (! tile->valid && ! g_atomic_int_get (&tile->validating));
+
+  if (validator)
+    g_atomic_int_set (&tile->validating, TRUE);
+
+  validate = (! tile->valid || g_atomic_int_get (&tile->validating));
+
+  TILE_BIT_UNLOCK (tile);
+
+  if (validator)
     {
-      /* an invalid tile should never be shared, so this should work */
-      tile_manager_validate_tile (tile->tlink->tm, tile);
+      tile_validate (tile);
+
+      TILE_BIT_LOCK (tile);
+      g_atomic_int_set (&tile->validating, FALSE);
+      TILE_BIT_UNLOCK (tile);
+    }
+  else if (validate)
+    {
+      tile_validate_wait (tile);
     }
 }
 
@@ -108,9 +148,13 @@ void
 tile_release (Tile     *tile,
               gboolean  dirty)
 {
+  gboolean destroy = FALSE;
+
   /* Decrement the global reference count.
    */
-  tile_ref_count--;
+  g_atomic_int_add (&tile_ref_count, -1);
+
+  TILE_BIT_LOCK (tile);
 
   /* Decrement this tile's reference count.
    */
@@ -140,8 +184,7 @@ tile_release (Tile     *tile,
       if (tile->share_count == 0)
         {
           /* tile is truly dead */
-          tile_destroy (tile);
-          return;                        /* skip terminal unlock */
+          destroy = TRUE;
         }
       else
         {
@@ -150,6 +193,11 @@ tile_release (Tile     *tile,
           tile_cache_insert (tile);
         }
     }
+
+  TILE_BIT_UNLOCK (tile);
+
+  if (destroy)
+    tile_destroy (tile);
 }
 
 void
@@ -184,6 +232,21 @@ tile_destroy (Tile *tile)
       return;
     }
 
+  /* must flush before deleting swap, and before freeing the data:
+   *  once the tile is out of its cache segment, no other thread can
+   *  zorch it any more
+   */
+  tile_cache_flush (tile);
+
+  if (tile->swap_offset != -1 || tile->zdata)
+    {
+      /* If the tile is on disk or compressed, then delete its
+       *  presence there. This also waits for swap I/O that is still
+       *  in flight for the tile.
+       */
+      tile_swap_delete (tile);
+    }
+
   if (tile->data)
     {
       g_free (tile->data);
@@ -200,17 +263,6 @@ tile_destroy (Tile *tile)
       tile->rowhint = NULL;
     }
 
-  /* must flush before deleting swap */
-  tile_cache_flush (tile);
-
-  if (tile->swap_offset != -1)
-    {
-      /* If the tile is on disk, then delete its
-       *  presence there.
-       */
-      tile_swap_delete (tile);
-    }
-
   g_slice_free (Tile, tile);
 
 #ifdef TILE_PROFILING
@@ -261,9 +313,17 @@ tile_attach (Tile *tile,
   if ((tile->share_count > 0) && (! tile->valid))
     {
       /* trying to share invalid tiles is problematic, not to mention silly */
-      tile_manager_validate_tile (tile->tlink->tm, tile);
+      tile_validate (tile);
     }
 
+  /* link this tile into the tile's tilelink chain */
+  new = g_slice_new (TileLink);
+
+  new->tm       = tm;
+  new->tile_num = tile_num;
+
+  TILE_BIT_LOCK (tile);
+
   tile->share_count++;
 
 #ifdef TILE_PROFILING
@@ -275,14 +335,10 @@ tile_attach (Tile *tile,
               tile, tm, tile_num, tile->share_count);
 #endif
 
-  /* link this tile into the tile's tilelink chain */
-  new = g_slice_new (TileLink);
-
-  new->tm       = tm;
-  new->tile_num = tile_num;
-  new->next     = tile->tlink;
-
+  new->next   = tile->tlink;
   tile->tlink = new;
+
+  TILE_BIT_UNLOCK (tile);
 }
 
 void
@@ -292,12 +348,15 @@ tile_detach (Tile *tile,
 {
   TileLink **link;
   TileLink  *tmp;
+  gboolean   destroy;
 
 #ifdef TILE_DEBUG
   g_printerr ("tile_detach: %p ~> (%p,%d) r%d *%d\n",
               tile, tm, tile_num, tile->ref_count, tile->share_count);
 #endif
 
+  TILE_BIT_LOCK (tile);
+
   for (link = &tile->tlink;
        *link != NULL;
        link = &(*link)->next)
@@ -308,6 +367,8 @@ tile_detach (Tile *tile,
 
   if (G_UNLIKELY (*link == NULL))
     {
+      TILE_BIT_UNLOCK (tile);
+
       g_warning ("Tried to detach a nonattached tile -- TILE BUG!");
       return;
     }
@@ -315,15 +376,19 @@ tile_detach (Tile *tile,
   tmp = *link;
   *link = tmp->next;
 
-  g_slice_free (TileLink, tmp);
-
 #ifdef TILE_PROFILING
   tile_share_count--;
 #endif
 
   tile->share_count--;
 
-  if (tile->share_count == 0 && tile->ref_count == 0)
+  destroy = (tile->share_count == 0 && tile->ref_count == 0);
+
+  TILE_BIT_UNLOCK (tile);
+
+  g_slice_free (TileLink, tmp);
+
+  if (destroy)
     tile_destroy (tile);
 }
 
@@ -338,5 +403,107 @@ tile_data_pointer (Tile *tile,
 gint
 tile_global_refcount (void)
 {
-  return tile_ref_count;
+  return g_atomic_int_get (&tile_ref_count);
+}
+
+/*  tile_validate_suspend() temporarily gives up the validate lock if
+ *  it is held by the calling thread, so that the threads of a nested
+ *  pixel_regions_process_parallel() call can validate tiles while the
+ *  caller waits for them.  The return value must be passed to
+ *  tile_validate_resume() afterwards.
+ */
+guint
+tile_validate_suspend (void)
+{
+  guint depth = 0;
+
+#ifdef ENABLE_MP
+  if (validate_owner == g_thread_self ())
+    {
+      depth = validate_depth;
+
+      validate_owner = NULL;
+      validate_depth = 0;
+
+      g_static_rec_mutex_unlock_full (&validate_mutex);
+    }
+#endif
+
+  return depth;
+}
+
+void
+tile_validate_resume (guint depth)
+{
+#ifdef ENABLE_MP
+  if (depth > 0)
+    {
+      g_static_rec_mutex_lock_full (&validate_mutex, depth);
+
+      validate_owner = g_thread_self ();
+      validate_depth = depth;
+    }
+#endif
+}
+
+static void
+tile_validate (Tile *tile)
+{
+  TileManager *tm = tile->tlink->tm;
+
+#ifdef ENABLE_MP
+  /*  thread-safe validate procs only need the validating flag  */
+  if (tm->validate_threadsafe)
+    {
+      tile_manager_validate_tile (tm, tile);
+      return;
+    }
+
+  g_static_rec_mutex_lock (&validate_mutex);
+
+  validate_owner = g_thread_self ();
+  validate_depth++;
+#endif
+
+  /* another thread may have validated the tile while we waited */
+  if (! tile->valid)
+    {
+      /* an invalid tile should never be shared, so this should work */
+      tile_manager_validate_tile (tm, tile);
+    }
+
+#ifdef ENABLE_MP
+  if (--validate_depth == 0)
+    validate_owner = NULL;
+
+  g_static_rec_mutex_unlock (&validate_mutex);
+#endif
+}
+
+/*  Wait for another thread to finish validating the tile. Called
+ *  without the tile's bit lock, by every thread that locked the tile
+ *  while it was being validated.
+ */
+static void
+tile_validate_wait (Tile *tile)
+{
+#ifdef ENABLE_MP
+  if (tile->tlink->tm->validate_threadsafe)
+    {
+      gboolean busy;
+
+      do
+        {
+          g_thread_yield ();
+
+          busy = g_atomic_int_get (&tile->validating);
+        }
+      while (busy);
+
+      return;
+    }
+#endif
+
+  /*  the validator holds the validate lock while it works  */
+  tile_validate (tile);
 }
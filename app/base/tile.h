@@ -61,6 +61,13 @@ void      * tile_data_pointer    (Tile     *tile,
 
 gint        tile_global_refcount (void);
 
+/* tile_validate_suspend releases the validate lock if the calling
+ * thread holds it, tile_validate_resume takes it back.  Used by the
+ * pixel processor around nested parallel calls from validate procs.
+ */
+guint       tile_validate_suspend (void);
+void        tile_validate_resume  (guint     depth);
+
 /* tile_attach attaches a tile to a tile manager: this function
  * increments the tile's share count and inserts a tilelink into the
  * tile's link list.  tile_detach reverses the process.
@@ -0,0 +1,70 @@
+/* THIS FILE IS AUTOMATICALLY GENERATED.  DO NOT EDIT */
+/* REGENERATE BY USING make-installer.py */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <glib-object.h>
+#include "libgimpbase/gimpbase.h"
+#include "base/base-types.h"
+#include "gimp-composite.h"
+
+#include "gimp-composite-avx2.h"
+
+static const struct install_table {
+  GimpCompositeOperation mode;
+  GimpPixelFormat A;
+  GimpPixelFormat B;
+  GimpPixelFormat D;
+  void (*function)(GimpCompositeContext *);
+} _gimp_composite_avx2[] = {
+#if defined(COMPILE_AVX2_IS_OKAY)
+ { GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_multiply_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_screen_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_overlay_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_difference_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_addition_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_subtract_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_darken_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_lighten_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_divide_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_dodge_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_burn_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_softlight_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_swap_rgba8_rgba8_rgba8_avx2 },
+ { GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, gimp_composite_scale_rgba8_rgba8_rgba8_avx2 },
+#endif
+ { 0, 0, 0, 0, NULL }
+};
+
+gboolean
+gimp_composite_avx2_install (void)
+{
+  static const struct install_table *t = _gimp_composite_avx2;
+
+  if (gimp_composite_avx2_init ())
+    {
+      for (t = &_gimp_composite_avx2[0]; t->function != NULL; t++)
+        {
+          gimp_composite_function[t->mode][t->A][t->B][t->D] = t->function;
+        }
+      return (TRUE);
+    }
+
+  return (FALSE);
+}
+
+gboolean
+gimp_composite_avx2_init (void)
+{
+#if defined(COMPILE_AVX2_IS_OKAY)
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_AVX2)
+    {
+      return (TRUE);
+    }
+#endif
+
+  return (FALSE);
+}
@@ -0,0 +1,544 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Gimp image compositing
+ * Copyright (C) 2003  Helvetix Victorinox, a pseudonym, <helvetix@gimp.org>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-avx2.h"
+
+#ifdef COMPILE_AVX2_IS_OKAY
+
+#include <immintrin.h>
+
+/*
+ * Unlike the older x86 backends this one is written with compiler
+ * intrinsics rather than inline assembly, so gcc does the register
+ * allocation for the 16 ymm registers.
+ *
+ * Every function processes eight RGBA8 pixels per iteration.  The
+ * 0 to 7 trailing pixels are handled with masked loads and stores of
+ * the same kernel, so the results are bit-exact with the generic
+ * implementation for every n_pixels.
+ */
+
+#define rgba8_alpha_mask_256  _mm256_set1_epi32 (0xFF000000)
+#define rgba8_w128_256        _mm256_set1_epi16 (0x0080)
+#define rgba8_w255_256        _mm256_set1_epi16 (0x00FF)
+#define rgba8_d255_256        _mm256_set1_epi32 (0x000000FF)
+#define rgba8_b255_256        _mm256_set1_epi8  ((gchar) 0xFF)
+
+
+/*  Widening and narrowing.  unpack/pack work within each 128 bit lane,
+ *  so packing undoes unpacking without any lane permutes.
+ */
+#define avx2_lo_w(x)      _mm256_unpacklo_epi8  ((x), _mm256_setzero_si256 ())
+#define avx2_hi_w(x)      _mm256_unpackhi_epi8  ((x), _mm256_setzero_si256 ())
+#define avx2_lo_d(x)      _mm256_unpacklo_epi16 ((x), _mm256_setzero_si256 ())
+#define avx2_hi_d(x)      _mm256_unpackhi_epi16 ((x), _mm256_setzero_si256 ())
+#define avx2_pack_w(l, h) _mm256_packus_epi16 ((l), (h))
+#define avx2_pack_d(l, h) _mm256_packus_epi32 ((l), (h))
+
+/*  The alpha channel of the arithmetic modes is MIN(A_a, B_a).  */
+#define avx2_alpha_min(d, a, b) \
+  _mm256_blendv_epi8 ((d), _mm256_min_epu8 ((a), (b)), rgba8_alpha_mask_256)
+
+
+/*  INT_MULT(a,b) on 16 bit words; a * b must fit in 16 bits.  */
+static inline __m256i
+avx2_int_mult_w (__m256i a,
+                 __m256i b)
+{
+  __m256i t = _mm256_add_epi16 (_mm256_mullo_epi16 (a, b), rgba8_w128_256);
+
+  return _mm256_srli_epi16 (_mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8)), 8);
+}
+
+/*  INT_MULT(a,b) on 32 bit words.  */
+static inline __m256i
+avx2_int_mult_d (__m256i a,
+                 __m256i b)
+{
+  __m256i t = _mm256_add_epi32 (_mm256_mullo_epi32 (a, b),
+                                _mm256_set1_epi32 (0x80));
+
+  return _mm256_srli_epi32 (_mm256_add_epi32 (t, _mm256_srli_epi32 (t, 8)), 8);
+}
+
+/*  Truncating n / d for 0 <= n < 2^24 and 0 < d < 2^24.  The single
+ *  precision quotient is off by at most one, which the remainder
+ *  check corrects.
+ */
+static inline __m256i
+avx2_div_d (__m256i n,
+            __m256i d)
+{
+  __m256i q = _mm256_cvttps_epi32 (_mm256_div_ps (_mm256_cvtepi32_ps (n),
+                                                  _mm256_cvtepi32_ps (d)));
+  __m256i r = _mm256_sub_epi32 (n, _mm256_mullo_epi32 (q, d));
+
+  /* compares yield -1 where true */
+  q = _mm256_add_epi32 (q, _mm256_cmpgt_epi32 (_mm256_setzero_si256 (), r));
+  q = _mm256_sub_epi32 (q, _mm256_cmpgt_epi32 (r, _mm256_sub_epi32 (d, _mm256_set1_epi32 (1))));
+
+  return q;
+}
+
+/*  Mask selecting the first n (< 8) pixels, for the tail.  */
+static inline __m256i
+avx2_tail_mask (gulong n)
+{
+  return _mm256_cmpgt_epi32 (_mm256_set1_epi32 (n),
+                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+#define GIMP_COMPOSITE_AVX2_RGBA8_LOOP(ctx, kernel)                         \
+  G_STMT_START                                                              \
+    {                                                                       \
+      const guchar *A = (ctx)->A;                                           \
+      const guchar *B = (ctx)->B;                                           \
+      guchar       *D = (ctx)->D;                                           \
+      gulong        n = (ctx)->n_pixels;                                    \
+                                                                            \
+      for (; n >= 8; n -= 8, A += 32, B += 32, D += 32)                     \
+        {                                                                   \
+          __m256i a = _mm256_loadu_si256 ((const __m256i *) A);             \
+          __m256i b = _mm256_loadu_si256 ((const __m256i *) B);             \
+                                                                            \
+          _mm256_storeu_si256 ((__m256i *) D, kernel (a, b));               \
+        }                                                                   \
+                                                                            \
+      if (n)                                                                \
+        {                                                                   \
+          __m256i m = avx2_tail_mask (n);                                   \
+          __m256i a = _mm256_maskload_epi32 ((const gint *) A, m);          \
+          __m256i b = _mm256_maskload_epi32 ((const gint *) B, m);          \
+                                                                            \
+          _mm256_maskstore_epi32 ((gint *) D, m, kernel (a, b));            \
+        }                                                                   \
+                                                                            \
+      _mm256_zeroupper ();                                                  \
+    }                                                                       \
+  G_STMT_END
+
+
+/*
+ * The kernels.  Each one is the vector form of the corresponding
+ * gimp_composite_*_any_any_any_generic() inner loop, operating on
+ * eight pixels.
+ */
+
+static inline __m256i
+avx2_addition (__m256i a,
+               __m256i b)
+{
+  return avx2_alpha_min (_mm256_adds_epu8 (a, b), a, b);
+}
+
+static inline __m256i
+avx2_subtract (__m256i a,
+               __m256i b)
+{
+  return avx2_alpha_min (_mm256_subs_epu8 (a, b), a, b);
+}
+
+static inline __m256i
+avx2_difference (__m256i a,
+                 __m256i b)
+{
+  __m256i d = _mm256_or_si256 (_mm256_subs_epu8 (a, b), _mm256_subs_epu8 (b, a));
+
+  return avx2_alpha_min (d, a, b);
+}
+
+static inline __m256i
+avx2_darken (__m256i a,
+             __m256i b)
+{
+  return _mm256_min_epu8 (a, b);
+}
+
+static inline __m256i
+avx2_lighten (__m256i a,
+              __m256i b)
+{
+  return avx2_alpha_min (_mm256_max_epu8 (a, b), a, b);
+}
+
+static inline __m256i
+avx2_multiply (__m256i a,
+               __m256i b)
+{
+  __m256i lo = avx2_int_mult_w (avx2_lo_w (a), avx2_lo_w (b));
+  __m256i hi = avx2_int_mult_w (avx2_hi_w (a), avx2_hi_w (b));
+
+  return avx2_alpha_min (avx2_pack_w (lo, hi), a, b);
+}
+
+static inline __m256i
+avx2_screen (__m256i a,
+             __m256i b)
+{
+  __m256i na = _mm256_xor_si256 (a, rgba8_b255_256);
+  __m256i nb = _mm256_xor_si256 (b, rgba8_b255_256);
+  __m256i lo = avx2_int_mult_w (avx2_lo_w (na), avx2_lo_w (nb));
+  __m256i hi = avx2_int_mult_w (avx2_hi_w (na), avx2_hi_w (nb));
+  __m256i d  = _mm256_xor_si256 (avx2_pack_w (lo, hi), rgba8_b255_256);
+
+  return avx2_alpha_min (d, a, b);
+}
+
+static inline __m256i
+avx2_grain_extract_w (__m256i a,
+                      __m256i b)
+{
+  return _mm256_add_epi16 (_mm256_sub_epi16 (a, b), rgba8_w128_256);
+}
+
+static inline __m256i
+avx2_grain_extract (__m256i a,
+                    __m256i b)
+{
+  /* packus clamps the signed words to 0..255 */
+  __m256i d = avx2_pack_w (avx2_grain_extract_w (avx2_lo_w (a), avx2_lo_w (b)),
+                           avx2_grain_extract_w (avx2_hi_w (a), avx2_hi_w (b)));
+
+  return avx2_alpha_min (d, a, b);
+}
+
+static inline __m256i
+avx2_grain_merge_w (__m256i a,
+                    __m256i b)
+{
+  return _mm256_sub_epi16 (_mm256_add_epi16 (a, b), rgba8_w128_256);
+}
+
+static inline __m256i
+avx2_grain_merge (__m256i a,
+                  __m256i b)
+{
+  __m256i d = avx2_pack_w (avx2_grain_merge_w (avx2_lo_w (a), avx2_lo_w (b)),
+                           avx2_grain_merge_w (avx2_hi_w (a), avx2_hi_w (b)));
+
+  return avx2_alpha_min (d, a, b);
+}
+
+static inline __m256i
+avx2_hardlight_w (__m256i a,
+                  __m256i b)
+{
+  /* B > 128:  255 - ((255 - A) * (255 - ((B - 128) << 1)) >> 8)
+   * else:     (A * (B << 1)) >> 8
+   */
+  __m256i high = _mm256_cmpgt_epi16 (b, rgba8_w128_256);
+  __m256i t1   = _mm256_mullo_epi16 (_mm256_sub_epi16 (rgba8_w255_256, a),
+                                     _mm256_sub_epi16 (rgba8_w255_256,
+                                                       _mm256_slli_epi16 (_mm256_sub_epi16 (b, rgba8_w128_256), 1)));
+  __m256i t2   = _mm256_mullo_epi16 (a, _mm256_slli_epi16 (b, 1));
+
+  return _mm256_blendv_epi8 (_mm256_srli_epi16 (t2, 8),
+                             _mm256_sub_epi16 (rgba8_w255_256,
+                                               _mm256_srli_epi16 (t1, 8)),
+                             high);
+}
+
+static inline __m256i
+avx2_hardlight (__m256i a,
+                __m256i b)
+{
+  __m256i d = avx2_pack_w (avx2_hardlight_w (avx2_lo_w (a), avx2_lo_w (b)),
+                           avx2_hardlight_w (avx2_hi_w (a), avx2_hi_w (b)));
+
+  return avx2_alpha_min (d, a, b);
+}
+
+static inline __m256i
+avx2_softlight_w (__m256i a,
+                  __m256i b)
+{
+  __m256i na = _mm256_sub_epi16 (rgba8_w255_256, a);
+  __m256i m  = avx2_int_mult_w (a, b);
+  __m256i s  = _mm256_sub_epi16 (rgba8_w255_256,
+                                 avx2_int_mult_w (na,
+                                                  _mm256_sub_epi16 (rgba8_w255_256, b)));
+  __m256i d  = _mm256_add_epi16 (avx2_int_mult_w (na, m),
+                                 avx2_int_mult_w (a, s));
+
+  /* the generic code stores this into a guchar */
+  return _mm256_and_si256 (d, rgba8_w255_256);
+}
+
+static inline __m256i
+avx2_softlight (__m256i a,
+                __m256i b)
+{
+  __m256i d = avx2_pack_w (avx2_softlight_w (avx2_lo_w (a), avx2_lo_w (b)),
+                           avx2_softlight_w (avx2_hi_w (a), avx2_hi_w (b)));
+
+  return avx2_alpha_min (d, a, b);
+}
+
+/*
+ * The remaining kernels need more than 16 bits of intermediate
+ * precision, so they widen each byte to a 32 bit word.  f is
+ * applied to the four groups of eight channels.
+ */
+#define AVX2_RGBA8_KERNEL_D(a, b, f)                                        \
+  ({                                                                        \
+    __m256i _al = avx2_lo_w (a);                                            \
+    __m256i _ah = avx2_hi_w (a);                                            \
+    __m256i _bl = avx2_lo_w (b);                                            \
+    __m256i _bh = avx2_hi_w (b);                                            \
+                                                                            \
+    avx2_pack_w (avx2_pack_d (f (avx2_lo_d (_al), avx2_lo_d (_bl)),         \
+                              f (avx2_hi_d (_al), avx2_hi_d (_bl))),        \
+                 avx2_pack_d (f (avx2_lo_d (_ah), avx2_lo_d (_bh)),         \
+                              f (avx2_hi_d (_ah), avx2_hi_d (_bh))));       \
+  })
+
+static inline __m256i
+avx2_overlay_d (__m256i a,
+                __m256i b)
+{
+  /* INT_MULT(A, A + INT_MULT(2 * B, 255 - A)), truncated to 8 bits */
+  __m256i t = avx2_int_mult_d (_mm256_slli_epi32 (b, 1),
+                               _mm256_sub_epi32 (rgba8_d255_256, a));
+
+  return _mm256_and_si256 (avx2_int_mult_d (a, _mm256_add_epi32 (a, t)),
+                           rgba8_d255_256);
+}
+
+static inline __m256i
+avx2_overlay (__m256i a,
+              __m256i b)
+{
+  return avx2_alpha_min (AVX2_RGBA8_KERNEL_D (a, b, avx2_overlay_d), a, b);
+}
+
+static inline __m256i
+avx2_dodge_d (__m256i a,
+              __m256i b)
+{
+  /* MIN((A << 8) / (256 - B), 255) */
+  __m256i q = avx2_div_d (_mm256_slli_epi32 (a, 8),
+                          _mm256_sub_epi32 (_mm256_set1_epi32 (256), b));
+
+  return _mm256_min_epi32 (q, rgba8_d255_256);
+}
+
+static inline __m256i
+avx2_dodge (__m256i a,
+            __m256i b)
+{
+  return avx2_alpha_min (AVX2_RGBA8_KERNEL_D (a, b, avx2_dodge_d), a, b);
+}
+
+static inline __m256i
+avx2_burn_d (__m256i a,
+             __m256i b)
+{
+  /* CLAMP(255 - ((255 - A) << 8) / (B + 1), 0, 255) */
+  __m256i q = avx2_div_d (_mm256_slli_epi32 (_mm256_sub_epi32 (rgba8_d255_256, a), 8),
+                          _mm256_add_epi32 (b, _mm256_set1_epi32 (1)));
+
+  return _mm256_max_epi32 (_mm256_sub_epi32 (rgba8_d255_256, q),
+                           _mm256_setzero_si256 ());
+}
+
+static inline __m256i
+avx2_burn (__m256i a,
+           __m256i b)
+{
+  return avx2_alpha_min (AVX2_RGBA8_KERNEL_D (a, b, avx2_burn_d), a, b);
+}
+
+static inline __m256i
+avx2_divide_d (__m256i a,
+               __m256i b)
+{
+  /* MIN((A * 256) / (1 + B), 255) */
+  __m256i q = avx2_div_d (_mm256_slli_epi32 (a, 8),
+                          _mm256_add_epi32 (b, _mm256_set1_epi32 (1)));
+
+  return _mm256_min_epi32 (q, rgba8_d255_256);
+}
+
+static inline __m256i
+avx2_divide (__m256i a,
+             __m256i b)
+{
+  return avx2_alpha_min (AVX2_RGBA8_KERNEL_D (a, b, avx2_divide_d), a, b);
+}
+
+
+void
+gimp_composite_addition_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_addition);
+}
+
+void
+gimp_composite_burn_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_burn);
+}
+
+void
+gimp_composite_darken_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_darken);
+}
+
+void
+gimp_composite_difference_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_difference);
+}
+
+void
+gimp_composite_divide_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_divide);
+}
+
+void
+gimp_composite_dodge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_dodge);
+}
+
+void
+gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_grain_extract);
+}
+
+void
+gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_grain_merge);
+}
+
+void
+gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_hardlight);
+}
+
+void
+gimp_composite_lighten_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_lighten);
+}
+
+void
+gimp_composite_multiply_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_multiply);
+}
+
+void
+gimp_composite_overlay_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_overlay);
+}
+
+void
+gimp_composite_screen_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_screen);
+}
+
+void
+gimp_composite_softlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_softlight);
+}
+
+void
+gimp_composite_subtract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  GIMP_COMPOSITE_AVX2_RGBA8_LOOP (_op, avx2_subtract);
+}
+
+void
+gimp_composite_scale_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  const guchar *A = _op->A;
+  guchar       *D = _op->D;
+  gulong        n = _op->n_pixels;
+  __m256i       s = _mm256_set1_epi16 (_op->scale.scale);
+
+  /* like the mmx version, this assumes 0 <= scale <= 255 */
+  for (; n >= 8; n -= 8, A += 32, D += 32)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) A);
+
+      _mm256_storeu_si256 ((__m256i *) D,
+                           avx2_pack_w (avx2_int_mult_w (avx2_lo_w (a), s),
+                                        avx2_int_mult_w (avx2_hi_w (a), s)));
+    }
+
+  if (n)
+    {
+      __m256i m = avx2_tail_mask (n);
+      __m256i a = _mm256_maskload_epi32 ((const gint *) A, m);
+
+      _mm256_maskstore_epi32 ((gint *) D, m,
+                              avx2_pack_w (avx2_int_mult_w (avx2_lo_w (a), s),
+                                           avx2_int_mult_w (avx2_hi_w (a), s)));
+    }
+
+  _mm256_zeroupper ();
+}
+
+void
+gimp_composite_swap_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *_op)
+{
+  guchar *A = _op->A;
+  guchar *B = _op->B;
+  gulong  n = _op->n_pixels;
+
+  for (; n >= 8; n -= 8, A += 32, B += 32)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) A);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) B);
+
+      _mm256_storeu_si256 ((__m256i *) A, b);
+      _mm256_storeu_si256 ((__m256i *) B, a);
+    }
+
+  if (n)
+    {
+      __m256i m = avx2_tail_mask (n);
+      __m256i a = _mm256_maskload_epi32 ((const gint *) A, m);
+      __m256i b = _mm256_maskload_epi32 ((const gint *) B, m);
+
+      _mm256_maskstore_epi32 ((gint *) A, m, b);
+      _mm256_maskstore_epi32 ((gint *) B, m, a);
+    }
+
+  _mm256_zeroupper ();
+}
+
+#endif /* COMPILE_AVX2_IS_OKAY */
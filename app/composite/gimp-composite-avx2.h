@@ -0,0 +1,41 @@
+#ifndef gimp_composite_avx2_h
+#define gimp_composite_avx2_h
+
+extern gboolean gimp_composite_avx2_init (void);
+
+/*
+ * The function gimp_composite_*_install() is defined in the code generated by make-install.py
+ * I hate to create a .h file just for that declaration, so I do it here (for now).
+ */
+extern gboolean gimp_composite_avx2_install (void);
+
+#if !defined(__INTEL_COMPILER) || defined(USE_INTEL_COMPILER_ANYWAY)
+#if defined(USE_AVX2)
+#if defined(ARCH_X86_64)
+#if __GNUC__ >= 4
+#define COMPILE_AVX2_IS_OKAY (1)
+#endif /* __GNUC__ >= 4 */
+#endif /* defined(ARCH_X86_64) */
+#endif /* defined(USE_AVX2) */
+#endif /* !defined(__INTEL_COMPILER) */
+
+#ifdef COMPILE_AVX2_IS_OKAY
+extern void gimp_composite_addition_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_burn_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_darken_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_difference_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_divide_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_dodge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_lighten_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_multiply_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_overlay_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_scale_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_screen_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_softlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_subtract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_swap_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+#endif
+#endif
@@ -0,0 +1,318 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gimp-composite-bench times every compositing function of every
+ * backend available on the running processor, checks its result
+ * against the generic implementation, and prints one CSV line per
+ * (operation, pixel format, backend).
+ *
+ * With --output it also writes the fastest correct backend for each
+ * operation to a dispatch file, which GIMP reads at startup from
+ * ~/.gimp-2.x/compositerc, see gimp_composite_dispatch_load().
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-regression.h"
+
+
+typedef struct
+{
+  gulong   n_bytes;
+  guchar  *A;        /* pristine sources      */
+  guchar  *B;
+  guchar  *work_A;   /* what the function sees */
+  guchar  *work_B;
+  guchar  *D;
+  guchar  *ref_A;    /* generic results       */
+  guchar  *ref_B;
+  guchar  *ref_D;
+} BenchBuffers;
+
+
+static void
+bench_reset (BenchBuffers *buffers)
+{
+  memcpy (buffers->work_A, buffers->A, buffers->n_bytes);
+  memcpy (buffers->work_B, buffers->B, buffers->n_bytes);
+}
+
+static GimpCompositeContext *
+bench_context (GimpCompositeContext   *ctx,
+               GimpCompositeOperation  op,
+               GimpPixelFormat         format,
+               gulong                  n_pixels,
+               BenchBuffers           *buffers)
+{
+  return gimp_composite_context_init (ctx, op, format, format, format, format,
+                                      n_pixels,
+                                      buffers->work_A, buffers->work_B,
+                                      buffers->work_B, buffers->D);
+}
+
+static void
+bench_reference (GimpCompositeOperation  op,
+                 GimpPixelFormat         format,
+                 gulong                  n_pixels,
+                 BenchBuffers           *buffers)
+{
+  GimpCompositeContext ctx;
+  gulong               n = n_pixels * gimp_composite_pixel_bpp[format];
+
+  bench_reset (buffers);
+  bench_context (&ctx, op, format, n_pixels, buffers);
+
+  gimp_composite_backend_lookup (0, op, format, format, format) (&ctx);
+
+  /*  some functions just redirect ctx->D, compare what it points to  */
+  memcpy (buffers->ref_A, buffers->work_A, n);
+  memcpy (buffers->ref_B, buffers->work_B, n);
+  memcpy (buffers->ref_D, ctx.D, n);
+}
+
+static gboolean
+bench_check (GimpCompositeFunction   function,
+             GimpCompositeOperation  op,
+             GimpPixelFormat         format,
+             gulong                  n_pixels,
+             BenchBuffers           *buffers)
+{
+  GimpCompositeContext ctx;
+  gulong               n = n_pixels * gimp_composite_pixel_bpp[format];
+
+  bench_reset (buffers);
+  bench_context (&ctx, op, format, n_pixels, buffers);
+
+  function (&ctx);
+
+  return (memcmp (buffers->ref_A, buffers->work_A, n) == 0 &&
+          memcmp (buffers->ref_B, buffers->work_B, n) == 0 &&
+          memcmp (buffers->ref_D, ctx.D,           n) == 0);
+}
+
+static double
+bench_time (GimpCompositeFunction   function,
+            GimpCompositeOperation  op,
+            GimpPixelFormat         format,
+            gulong                  iterations,
+            gulong                  n_pixels,
+            BenchBuffers           *buffers)
+{
+  GimpCompositeContext ctx;
+
+  bench_reset (buffers);
+  bench_context (&ctx, op, format, n_pixels, buffers);
+
+  return gimp_composite_regression_time_function (iterations, function, &ctx);
+}
+
+static int
+gimp_composite_bench (gulong       iterations,
+                      gulong       n_pixels,
+                      const gchar *output)
+{
+  BenchBuffers  buffers;
+  GString      *dispatch;
+  gint          n_backends = gimp_composite_n_backends ();
+  gint          n_failed   = 0;
+  gint          op;
+  gint          format;
+  gulong        i;
+
+  buffers.n_bytes = n_pixels * 4;
+  buffers.A       = g_malloc (buffers.n_bytes);
+  buffers.B       = g_malloc (buffers.n_bytes);
+  buffers.work_A  = g_malloc (buffers.n_bytes);
+  buffers.work_B  = g_malloc (buffers.n_bytes);
+  buffers.D       = g_malloc (buffers.n_bytes);
+  buffers.ref_A   = g_malloc (buffers.n_bytes);
+  buffers.ref_B   = g_malloc (buffers.n_bytes);
+  buffers.ref_D   = g_malloc (buffers.n_bytes);
+
+  for (i = 0; i < buffers.n_bytes; i++)
+    {
+      buffers.A[i] = rand ();
+      buffers.B[i] = rand ();
+    }
+
+  dispatch = g_string_new (NULL);
+
+  g_string_append_printf (dispatch,
+                          "# GIMP compositing dispatch, "
+                          "written by gimp-composite-bench\n"
+                          "# %lu iterations of %lu pixels\n"
+                          "cpu,0x%08x\n",
+                          iterations, n_pixels,
+                          (guint) gimp_cpu_accel_get_support ());
+
+  printf ("op,A,B,D,backend,iterations,n_pixels,seconds,mpixels_per_second,correct\n");
+
+  for (op = 0; op < GIMP_COMPOSITE_N; op++)
+    for (format = 0; format < GIMP_PIXELFORMAT_ANY; format++)
+      {
+        gint    backend;
+        gint    n_special = 0;
+        gint    best      = -1;
+        double  best_time = 0.0;
+
+        if (! gimp_composite_backend_lookup (0, op, format, format, format))
+          continue;
+
+        for (backend = 1; backend < n_backends; backend++)
+          if (gimp_composite_backend_lookup (backend, op, format, format, format))
+            n_special++;
+
+        /*  nothing to choose from  */
+        if (n_special == 0)
+          continue;
+
+        bench_reference (op, format, n_pixels, &buffers);
+
+        for (backend = 0; backend < n_backends; backend++)
+          {
+            GimpCompositeFunction function;
+            gboolean              correct;
+            double                t;
+
+            function = gimp_composite_backend_lookup (backend, op,
+                                                      format, format, format);
+            if (! function)
+              continue;
+
+            correct = bench_check (function, op, format, n_pixels, &buffers);
+            t = bench_time (function, op, format, iterations, n_pixels,
+                            &buffers);
+
+            printf ("%s,%s,%s,%s,%s,%lu,%lu,%.6f,%.2f,%s\n",
+                    gimp_composite_mode_astext (op),
+                    gimp_composite_pixelformat_astext (format),
+                    gimp_composite_pixelformat_astext (format),
+                    gimp_composite_pixelformat_astext (format),
+                    gimp_composite_backend_name (backend),
+                    iterations, n_pixels, t,
+                    t > 0.0 ? (iterations * n_pixels) / t / 1e6 : 0.0,
+                    correct ? "yes" : "no");
+
+            if (! correct)
+              {
+                n_failed++;
+                continue;
+              }
+
+            if (best < 0 || t < best_time)
+              {
+                best      = backend;
+                best_time = t;
+              }
+          }
+
+        if (best >= 0)
+          g_string_append_printf (dispatch, "%s,%s,%s,%s,%s\n",
+                                  gimp_composite_mode_astext (op),
+                                  gimp_composite_pixelformat_astext (format),
+                                  gimp_composite_pixelformat_astext (format),
+                                  gimp_composite_pixelformat_astext (format),
+                                  gimp_composite_backend_name (best));
+      }
+
+  if (output)
+    {
+      GError *error = NULL;
+
+      if (! g_file_set_contents (output, dispatch->str, dispatch->len, &error))
+        {
+          g_printerr ("gimp-composite-bench: %s\n", error->message);
+          g_clear_error (&error);
+          n_failed++;
+        }
+    }
+
+  g_string_free (dispatch, TRUE);
+
+  g_free (buffers.A);
+  g_free (buffers.B);
+  g_free (buffers.work_A);
+  g_free (buffers.work_B);
+  g_free (buffers.D);
+  g_free (buffers.ref_A);
+  g_free (buffers.ref_B);
+  g_free (buffers.ref_D);
+
+  return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gulong       iterations;
+  gulong       n_pixels;
+  const gchar *output = NULL;
+
+  srand (314159);
+
+  g_setenv ("GIMP_COMPOSITE", "0x1", TRUE);
+
+  /*  one tile per call, which is what the paint-funcs pass in  */
+  iterations = 2000;
+  n_pixels = 64 * 64;
+
+  argv++, argc--;
+  while (argc >= 2)
+    {
+      if (strcmp (argv[0], "--iterations") == 0 || strcmp (argv[0], "-i") == 0)
+        {
+          iterations = atol (argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else if (strcmp (argv[0], "--n-pixels") == 0 || strcmp (argv[0], "-n") == 0)
+        {
+          n_pixels = atol (argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else if (strcmp (argv[0], "--output") == 0 || strcmp (argv[0], "-o") == 0)
+        {
+          output = argv[1];
+          argc -= 2, argv++; argv++;
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  if (argc != 0 || iterations == 0 || n_pixels == 0)
+    {
+      g_print ("Usage: gimp-composite-bench [-i|--iterations n] [-n|--n-pixels n] [-o|--output compositerc]\n");
+      return EXIT_FAILURE;
+    }
+
+  gimp_composite_init (FALSE, TRUE);
+
+  return gimp_composite_bench (iterations, n_pixels, output);
+}
@@ -21,9 +21,12 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <glib-object.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "base/base-types.h"
 
 #include "gimp-composite.h"
@@ -160,6 +163,94 @@ const gchar * gimp_composite_function_name[GIMP_COMPOSITE_N][GIMP_PIXELFORMAT_N]
 
 void (* gimp_composite_function[GIMP_COMPOSITE_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N])(GimpCompositeContext *);
 
+
+/*
+ * The set of compositing backends, in the order they are installed.
+ * A later backend overrides the functions of an earlier one, unless
+ * a dispatch file says otherwise, see gimp_composite_dispatch_load().
+ *
+ * The functions each backend provided are remembered, so that
+ * benchmarks and the dispatch file can pick any of them, not just the
+ * one that ended up in gimp_composite_function[].
+ */
+typedef struct
+{
+  GimpCompositeOperation op;
+  GimpPixelFormat        A;
+  GimpPixelFormat        B;
+  GimpPixelFormat        D;
+  GimpCompositeFunction  function;
+} GimpCompositeBackendEntry;
+
+typedef struct
+{
+  const gchar  *name;
+  gboolean    (*install) (void);
+  gboolean      installed;
+  GArray       *entries;
+} GimpCompositeBackend;
+
+extern gboolean gimp_composite_mmx_install (void);
+extern gboolean gimp_composite_sse_install (void);
+extern gboolean gimp_composite_sse2_install (void);
+extern gboolean gimp_composite_avx2_install (void);
+extern gboolean gimp_composite_3dnow_install (void);
+extern gboolean gimp_composite_altivec_install (void);
+extern gboolean gimp_composite_vis_install (void);
+
+static GimpCompositeBackend gimp_composite_backends[] =
+{
+  { "generic", gimp_composite_generic_install, FALSE, NULL },
+  { "mmx",     gimp_composite_mmx_install,     FALSE, NULL },
+  { "sse",     gimp_composite_sse_install,     FALSE, NULL },
+  { "sse2",    gimp_composite_sse2_install,    FALSE, NULL },
+  { "avx2",    gimp_composite_avx2_install,    FALSE, NULL },
+  { "3dnow",   gimp_composite_3dnow_install,   FALSE, NULL },
+  { "altivec", gimp_composite_altivec_install, FALSE, NULL },
+  { "vis",     gimp_composite_vis_install,     FALSE, NULL }
+};
+
+
+static gboolean
+gimp_composite_backend_install (GimpCompositeBackend *backend)
+{
+  gpointer old_table;
+  gint     op, a, b, d;
+
+  old_table = g_memdup (gimp_composite_function,
+                        sizeof (gimp_composite_function));
+
+  backend->installed = backend->install ();
+
+  if (backend->installed && ! backend->entries)
+    {
+      GimpCompositeFunction (* old)[GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N] = old_table;
+
+      backend->entries = g_array_new (FALSE, FALSE,
+                                      sizeof (GimpCompositeBackendEntry));
+
+      /*  whatever the installer changed belongs to this backend  */
+      for (op = 0; op < GIMP_COMPOSITE_N; op++)
+        for (a = 0; a < GIMP_PIXELFORMAT_N; a++)
+          for (b = 0; b < GIMP_PIXELFORMAT_N; b++)
+            for (d = 0; d < GIMP_PIXELFORMAT_N; d++)
+              {
+                GimpCompositeFunction function = gimp_composite_function[op][a][b][d];
+
+                if (function && function != old[op][a][b][d])
+                  {
+                    GimpCompositeBackendEntry entry = { op, a, b, d, function };
+
+                    g_array_append_val (backend->entries, entry);
+                  }
+              }
+    }
+
+  g_free (old_table);
+
+  return backend->installed;
+}
+
 /**
  * gimp_composite_dispatch:
  * @ctx: The compositing context
@@ -342,13 +433,13 @@ gimp_composite_init (gboolean  be_verbose,
                 (gimp_composite_options.bits & GIMP_COMPOSITE_OPTION_VERBOSE) ?
                 "yes" : "no");
 
-  gimp_composite_generic_install ();
+  gimp_composite_backend_install (&gimp_composite_backends[0]);
 
   /*
    * Here is where you "glue" in the initialisation of your
    * optimisations.
    *
-   * Declare the install() function external, and then call it.  A
+   * Add the install() function to gimp_composite_backends[].  A
    * return value of TRUE from the install function means the
    * installer was successful in instantiating itself.  For example,
    * it succeeded in hooking in the functions with the special
@@ -356,29 +447,22 @@ gimp_composite_init (gboolean  be_verbose,
    */
   if (! (gimp_composite_options.bits & GIMP_COMPOSITE_OPTION_NOEXTENSIONS))
     {
-      extern gboolean gimp_composite_mmx_install (void);
-      extern gboolean gimp_composite_sse_install (void);
-      extern gboolean gimp_composite_sse2_install (void);
-      extern gboolean gimp_composite_3dnow_install (void);
-      extern gboolean gimp_composite_altivec_install (void);
-      extern gboolean gimp_composite_vis_install (void);
-
-      gboolean can_use_mmx     = gimp_composite_mmx_install ();
-      gboolean can_use_sse     = gimp_composite_sse_install ();
-      gboolean can_use_sse2    = gimp_composite_sse2_install ();
-      gboolean can_use_3dnow   = gimp_composite_3dnow_install ();
-      gboolean can_use_altivec = gimp_composite_altivec_install ();
-      gboolean can_use_vis     = gimp_composite_vis_install ();
+      gint i;
+
+      for (i = 1; i < G_N_ELEMENTS (gimp_composite_backends); i++)
+        gimp_composite_backend_install (&gimp_composite_backends[i]);
 
       if (be_verbose)
-        g_printerr ("Processor instruction sets: "
-                    "%cmmx %csse %csse2 %c3dnow %caltivec %cvis\n",
-                    can_use_mmx     ? '+' : '-',
-                    can_use_sse     ? '+' : '-',
-                    can_use_sse2    ? '+' : '-',
-                    can_use_3dnow   ? '+' : '-',
-                    can_use_altivec ? '+' : '-',
-                    can_use_vis     ? '+' : '-');
+        {
+          g_printerr ("Processor instruction sets:");
+
+          for (i = 1; i < G_N_ELEMENTS (gimp_composite_backends); i++)
+            g_printerr (" %c%s",
+                        gimp_composite_backends[i].installed ? '+' : '-',
+                        gimp_composite_backends[i].name);
+
+          g_printerr ("\n");
+        }
     }
 }
 
@@ -387,3 +471,214 @@ gimp_composite_use_cpu_accel (void)
 {
   return ! (gimp_composite_options.bits & GIMP_COMPOSITE_OPTION_NOEXTENSIONS);
 }
+
+/**
+ * gimp_composite_n_backends:
+ *
+ * Returns: the number of compositing backends, installed or not.
+ *          Backend 0 is always the generic one.
+ **/
+gint
+gimp_composite_n_backends (void)
+{
+  return G_N_ELEMENTS (gimp_composite_backends);
+}
+
+/**
+ * gimp_composite_backend_name:
+ * @backend: The backend index.
+ *
+ * Returns: the name of the backend, like "generic" or "sse2".
+ **/
+const gchar *
+gimp_composite_backend_name (gint backend)
+{
+  g_return_val_if_fail (backend >= 0 &&
+                        backend < G_N_ELEMENTS (gimp_composite_backends), NULL);
+
+  return gimp_composite_backends[backend].name;
+}
+
+/**
+ * gimp_composite_backend_lookup:
+ * @backend: The backend index.
+ * @op:      The compositing operation.
+ * @A:       The pixel format of source A.
+ * @B:       The pixel format of source B.
+ * @D:       The pixel format of the destination.
+ *
+ * Look up the function a backend provides for an operation, whether
+ * or not it is the one currently installed in the dispatch table.
+ *
+ * Returns: the function, or %NULL if the backend is not available on
+ *          this processor or doesn't implement the operation.
+ **/
+GimpCompositeFunction
+gimp_composite_backend_lookup (gint                   backend,
+                               GimpCompositeOperation op,
+                               GimpPixelFormat        A,
+                               GimpPixelFormat        B,
+                               GimpPixelFormat        D)
+{
+  GArray *entries;
+  guint   i;
+
+  g_return_val_if_fail (backend >= 0 &&
+                        backend < G_N_ELEMENTS (gimp_composite_backends), NULL);
+
+  entries = gimp_composite_backends[backend].entries;
+
+  if (! gimp_composite_backends[backend].installed || ! entries)
+    return NULL;
+
+  for (i = 0; i < entries->len; i++)
+    {
+      GimpCompositeBackendEntry *entry = &g_array_index (entries,
+                                                         GimpCompositeBackendEntry,
+                                                         i);
+
+      if (entry->op == op && entry->A == A && entry->B == B && entry->D == D)
+        return entry->function;
+    }
+
+  return NULL;
+}
+
+static gboolean
+gimp_composite_mode_from_text (const gchar            *text,
+                               GimpCompositeOperation *op)
+{
+  gint i;
+
+  for (i = 0; i < GIMP_COMPOSITE_N; i++)
+    if (! strcmp (text, gimp_composite_mode_astext (i)))
+      {
+        *op = i;
+        return TRUE;
+      }
+
+  return FALSE;
+}
+
+static gboolean
+gimp_composite_pixelformat_from_text (const gchar     *text,
+                                      GimpPixelFormat *format)
+{
+  gint i;
+
+  for (i = 0; i < GIMP_PIXELFORMAT_ANY; i++)
+    if (! strcmp (text, gimp_composite_pixelformat_astext (i)))
+      {
+        *format = i;
+        return TRUE;
+      }
+
+  return FALSE;
+}
+
+static gint
+gimp_composite_backend_from_text (const gchar *text)
+{
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (gimp_composite_backends); i++)
+    if (! strcmp (text, gimp_composite_backends[i].name))
+      return i;
+
+  return -1;
+}
+
+/**
+ * gimp_composite_dispatch_load:
+ * @filename:   The dispatch file, as written by gimp-composite-bench.
+ * @be_verbose: whether to report what was changed on stderr
+ *
+ * Override the default choice of compositing functions with the
+ * fastest ones measured on this machine.  The file is a list of
+ * lines of the form
+ *
+ *   GIMP_COMPOSITE_ADDITION,RGBA8,RGBA8,RGBA8,sse2
+ *
+ * and an optional "cpu,<flags>" line.  If the #GimpCpuAccelFlags in
+ * the file don't match the running processor the whole file is
+ * ignored.  Entries naming a backend that isn't available here are
+ * skipped.
+ *
+ * Returns: %TRUE if the file was read and applied.
+ **/
+gboolean
+gimp_composite_dispatch_load (const gchar *filename,
+                              gboolean     be_verbose)
+{
+  gchar  *contents;
+  gchar **lines;
+  gint    n_applied = 0;
+  gint    i;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  if (gimp_composite_options.bits & GIMP_COMPOSITE_OPTION_NOEXTENSIONS)
+    return FALSE;
+
+  if (! g_file_get_contents (filename, &contents, NULL, NULL))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  for (i = 0; lines[i]; i++)
+    {
+      g_strstrip (lines[i]);
+
+      if (g_str_has_prefix (lines[i], "cpu,") &&
+          strtoul (lines[i] + strlen ("cpu,"), NULL, 16) !=
+          gimp_cpu_accel_get_support ())
+        {
+          if (be_verbose)
+            g_printerr ("gimp_composite: ignoring '%s', "
+                        "it was made for a different processor\n",
+                        gimp_filename_to_utf8 (filename));
+
+          g_strfreev (lines);
+
+          return FALSE;
+        }
+    }
+
+  for (i = 0; lines[i]; i++)
+    {
+      gchar                  **fields;
+      GimpCompositeOperation   op;
+      GimpPixelFormat          A, B, D;
+      GimpCompositeFunction    function;
+      gint                     backend;
+
+      if (lines[i][0] == '\0' || lines[i][0] == '#')
+        continue;
+
+      fields = g_strsplit (lines[i], ",", -1);
+
+      if (g_strv_length (fields) == 5                                    &&
+          gimp_composite_mode_from_text        (fields[0], &op)          &&
+          gimp_composite_pixelformat_from_text (fields[1], &A)           &&
+          gimp_composite_pixelformat_from_text (fields[2], &B)           &&
+          gimp_composite_pixelformat_from_text (fields[3], &D)           &&
+          (backend = gimp_composite_backend_from_text (fields[4])) >= 0 &&
+          (function = gimp_composite_backend_lookup (backend,
+                                                     op, A, B, D)))
+        {
+          gimp_composite_function[op][A][B][D] = function;
+          n_applied++;
+        }
+
+      g_strfreev (fields);
+    }
+
+  g_strfreev (lines);
+
+  if (be_verbose)
+    g_printerr ("gimp_composite: %d functions selected by '%s'\n",
+                n_applied, gimp_filename_to_utf8 (filename));
+
+  return TRUE;
+}
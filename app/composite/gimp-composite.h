@@ -143,6 +143,9 @@ typedef struct
 } GimpCompositeContext;
 
 
+typedef void (* GimpCompositeFunction) (GimpCompositeContext *ctx);
+
+
 struct GimpCompositeOptions
 {
   gulong  bits;
@@ -164,6 +167,18 @@ void          gimp_composite_context_print      (GimpCompositeContext   *ctx);
 const gchar * gimp_composite_mode_astext        (GimpCompositeOperation  op);
 const gchar * gimp_composite_pixelformat_astext (GimpPixelFormat         format);
 
+gint          gimp_composite_n_backends         (void);
+const gchar * gimp_composite_backend_name       (gint                    backend);
+GimpCompositeFunction
+              gimp_composite_backend_lookup     (gint                    backend,
+                                                 GimpCompositeOperation  op,
+                                                 GimpPixelFormat         A,
+                                                 GimpPixelFormat         B,
+                                                 GimpPixelFormat         D);
+
+gboolean      gimp_composite_dispatch_load      (const gchar            *filename,
+                                                 gboolean                be_verbose);
+
 extern const gchar *gimp_composite_function_name[GIMP_COMPOSITE_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N];
 extern void (*gimp_composite_function[GIMP_COMPOSITE_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N][GIMP_PIXELFORMAT_N])(GimpCompositeContext *);
 
@@ -50,6 +50,7 @@ enum
   PROP_SWAP_PATH,
   PROP_NUM_PROCESSORS,
   PROP_TILE_CACHE_SIZE,
+  PROP_COMPRESSED_TILE_CACHE_SIZE,
 
   /* ignored, only for backward compatibility: */
   PROP_STINGY_MEMORY_USE
@@ -144,6 +145,13 @@ gimp_base_config_class_init (GimpBaseConfigClass *klass)
                                     1 << 30, /* 1GB */
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class,
+                                    PROP_COMPRESSED_TILE_CACHE_SIZE,
+                                    "compressed-tile-cache-size",
+                                    COMPRESSED_TILE_CACHE_SIZE_BLURB,
+                                    0, MIN (G_MAXSIZE, GIMP_MAX_MEMSIZE),
+                                    1 << 28, /* 256MB */
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_STINGY_MEMORY_USE,
@@ -196,6 +204,9 @@ gimp_base_config_set_property (GObject      *object,
     case PROP_TILE_CACHE_SIZE:
       base_config->tile_cache_size = g_value_get_uint64 (value);
       break;
+    case PROP_COMPRESSED_TILE_CACHE_SIZE:
+      base_config->compressed_tile_cache_size = g_value_get_uint64 (value);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
@@ -229,6 +240,9 @@ gimp_base_config_get_property (GObject    *object,
     case PROP_TILE_CACHE_SIZE:
       g_value_set_uint64 (value, base_config->tile_cache_size);
       break;
+    case PROP_COMPRESSED_TILE_CACHE_SIZE:
+      g_value_set_uint64 (value, base_config->compressed_tile_cache_size);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
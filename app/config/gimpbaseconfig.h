@@ -41,6 +41,7 @@ struct _GimpBaseConfig
   gchar    *swap_path;
   guint     num_processors;
   guint64   tile_cache_size;
+  guint64   compressed_tile_cache_size;
 };
 
 struct _GimpBaseConfigClass
@@ -88,8 +88,11 @@ enum
   PROP_DEFAULT_GRID,
   PROP_UNDO_LEVELS,
   PROP_UNDO_SIZE,
+  PROP_UNDO_JOURNAL,
   PROP_UNDO_PREVIEW_SIZE,
   PROP_PLUG_IN_HISTORY_SIZE,
+  PROP_PLUG_IN_RESIDENT_MAX,
+  PROP_PLUG_IN_RESIDENT_TIMEOUT,
   PROP_PLUGINRC_PATH,
   PROP_LAYER_PREVIEWS,
   PROP_LAYER_PREVIEW_SIZE,
@@ -98,6 +101,8 @@ enum
   PROP_COLOR_MANAGEMENT,
   PROP_COLOR_PROFILE_POLICY,
   PROP_SAVE_DOCUMENT_HISTORY,
+  PROP_XCF_ZLIB_COMPRESSION,
+  PROP_XCF_LAZY_LOAD,
   PROP_USE_GEGL,
 
   /* ignored, only for backward compatibility: */
@@ -376,6 +381,10 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     0, GIMP_MAX_MEMSIZE, 1 << 26, /* 64MB */
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_UNDO_JOURNAL,
+                                    "undo-journal", UNDO_JOURNAL_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_ENUM (object_class, PROP_UNDO_PREVIEW_SIZE,
                                  "undo-preview-size", UNDO_PREVIEW_SIZE_BLURB,
                                  GIMP_TYPE_VIEW_SIZE,
@@ -388,6 +397,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 0, 256, 10,
                                 GIMP_PARAM_STATIC_STRINGS |
                                 GIMP_CONFIG_PARAM_RESTART);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_RESIDENT_MAX,
+                                "plug-in-resident-max",
+                                PLUG_IN_RESIDENT_MAX_BLURB,
+                                0, 64, 0,
+                                GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_RESIDENT_TIMEOUT,
+                                "plug-in-resident-timeout",
+                                PLUG_IN_RESIDENT_TIMEOUT_BLURB,
+                                1, 3600, 60,
+                                GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_PATH (object_class,
                                  PROP_PLUGINRC_PATH,
                                  "pluginrc-path", PLUGINRC_PATH_BLURB,
@@ -430,6 +449,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     SAVE_DOCUMENT_HISTORY_BLURB,
                                     TRUE,
                                     GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_ZLIB_COMPRESSION,
+                                    "xcf-zlib-compression",
+                                    XCF_ZLIB_COMPRESSION_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOAD,
+                                    "xcf-lazy-load",
+                                    XCF_LAZY_LOAD_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  not serialized  */
   g_object_class_install_property (object_class, PROP_USE_GEGL,
@@ -672,12 +701,21 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       core_config->plug_in_history_size = g_value_get_int (value);
       break;
+    case PROP_PLUG_IN_RESIDENT_MAX:
+      core_config->plug_in_resident_max = g_value_get_int (value);
+      break;
+    case PROP_PLUG_IN_RESIDENT_TIMEOUT:
+      core_config->plug_in_resident_timeout = g_value_get_int (value);
+      break;
     case PROP_UNDO_LEVELS:
       core_config->levels_of_undo = g_value_get_int (value);
       break;
     case PROP_UNDO_SIZE:
       core_config->undo_size = g_value_get_uint64 (value);
       break;
+    case PROP_UNDO_JOURNAL:
+      core_config->undo_journal = g_value_get_boolean (value);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       core_config->undo_preview_size = g_value_get_enum (value);
       break;
@@ -708,6 +746,12 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       core_config->save_document_history = g_value_get_boolean (value);
       break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      core_config->xcf_zlib_compression = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_LAZY_LOAD:
+      core_config->xcf_lazy_load = g_value_get_boolean (value);
+      break;
     case PROP_USE_GEGL:
       core_config->use_gegl = g_value_get_boolean (value);
       break;
@@ -844,12 +888,21 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       g_value_set_int (value, core_config->plug_in_history_size);
       break;
+    case PROP_PLUG_IN_RESIDENT_MAX:
+      g_value_set_int (value, core_config->plug_in_resident_max);
+      break;
+    case PROP_PLUG_IN_RESIDENT_TIMEOUT:
+      g_value_set_int (value, core_config->plug_in_resident_timeout);
+      break;
     case PROP_UNDO_LEVELS:
       g_value_set_int (value, core_config->levels_of_undo);
       break;
     case PROP_UNDO_SIZE:
       g_value_set_uint64 (value, core_config->undo_size);
       break;
+    case PROP_UNDO_JOURNAL:
+      g_value_set_boolean (value, core_config->undo_journal);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       g_value_set_enum (value, core_config->undo_preview_size);
       break;
@@ -877,6 +930,12 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       g_value_set_boolean (value, core_config->save_document_history);
       break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_zlib_compression);
+      break;
+    case PROP_XCF_LAZY_LOAD:
+      g_value_set_boolean (value, core_config->xcf_lazy_load);
+      break;
     case PROP_USE_GEGL:
       g_value_set_boolean (value, core_config->use_gegl);
       break;
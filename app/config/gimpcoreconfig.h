@@ -77,8 +77,11 @@ struct _GimpCoreConfig
   GimpGrid               *default_grid;
   gint                    levels_of_undo;
   guint64                 undo_size;
+  gboolean                undo_journal;
   GimpViewSize            undo_preview_size;
   gint                    plug_in_history_size;
+  gint                    plug_in_resident_max;
+  gint                    plug_in_resident_timeout;
   gchar                  *plug_in_rc_path;
   gboolean                layer_previews;
   GimpViewSize            layer_preview_size;
@@ -87,6 +90,8 @@ struct _GimpCoreConfig
   GimpColorConfig        *color_management;
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
+  gboolean                xcf_zlib_compression;
+  gboolean                xcf_lazy_load;
   gboolean                use_gegl;
 };
 
@@ -42,6 +42,11 @@ N_("Specifies how the area around the image should be drawn.")
 #define COLOR_PROFILE_POLICY_BLURB \
 N_("How to handle embedded color profiles when opening a file.")
 
+#define COMPRESSED_TILE_CACHE_SIZE_BLURB \
+N_("Tiles pushed out of the tile cache are kept compressed in memory, " \
+   "up to this limit, before they are written to the swap file.  Set " \
+   "this to zero to swap tiles to disk right away.")
+
 #define CONFIRM_ON_CLOSE_BLURB \
 N_("Ask for confirmation before closing an image without saving.")
 
@@ -268,6 +273,15 @@ N_("When enabled, the X server is queried for the mouse's current position " \
 #define PLUG_IN_HISTORY_SIZE_BLURB \
 "How many recently used plug-ins to keep on the Filters menu."
 
+#define PLUG_IN_RESIDENT_MAX_BLURB \
+"How many plug-in processes may stay alive after returning, waiting to " \
+"serve the next call of one of their procedures without being started " \
+"again.  Zero disables resident plug-ins."
+
+#define PLUG_IN_RESIDENT_TIMEOUT_BLURB \
+"How many seconds an idle resident plug-in is kept alive before it is " \
+"told to quit."
+
 #define PLUG_IN_PATH_BLURB \
 "Sets the plug-in search path."
 
@@ -450,6 +464,11 @@ N_("Sets an upper limit to the memory that is used per image to keep " \
    "operations on the undo stack. Regardless of this setting, at least " \
    "as many undo-levels as configured can be undone.")
 
+#define UNDO_JOURNAL_BLURB \
+N_("When the undo-size limit is reached, move the pixel data of the " \
+   "oldest operations to a file in the swap folder instead of dropping " \
+   "them from the undo stack.")
+
 #define UNDO_PREVIEW_SIZE_BLURB \
 N_("Sets the size of the previews in the Undo History.")
 
@@ -464,6 +483,18 @@ N_("When enabled, pressing F1 will open the help browser.")
 "The location of the online user manual. This is used if " \
 "'user-manual-online' is enabled."
 
+#define XCF_LAZY_LOAD_BLURB \
+N_("Read the pixel data of XCF files only when it is first needed, which " \
+   "opens large files faster. The file stays mapped into memory while the " \
+   "image is open and must not be changed by other programs meanwhile. " \
+   "If it is, the pixel data not read yet is lost, and if the file is " \
+   "truncated at the wrong moment, GIMP crashes.")
+
+#define XCF_ZLIB_COMPRESSION_BLURB \
+N_("Compress the pixel data of XCF files with zlib instead of run length " \
+   "encoding. Such files are smaller, but older versions of GIMP cannot " \
+   "open them.")
+
 #define ZOOM_QUALITY_BLURB \
 "There's a tradeoff between speed and quality of the zoomed-out display."
 
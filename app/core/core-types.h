@@ -161,6 +161,7 @@ typedef struct _GimpInterpreterDB   GimpInterpreterDB;
 typedef struct _GimpParasiteList    GimpParasiteList;
 typedef struct _GimpPdbProgress     GimpPdbProgress;
 typedef struct _GimpProjection      GimpProjection;
+typedef struct _GimpStartupProfile  GimpStartupProfile;
 typedef struct _GimpSubProgress     GimpSubProgress;
 typedef struct _GimpTag             GimpTag;
 typedef struct _GimpTreeHandler     GimpTreeHandler;
@@ -182,6 +183,7 @@ typedef struct _GimpGradientSegment GimpGradientSegment;
 typedef struct _GimpPaletteEntry    GimpPaletteEntry;
 typedef struct _GimpSamplePoint     GimpSamplePoint;
 typedef struct _GimpScanConvert     GimpScanConvert;
+typedef struct _GimpUndoJournal     GimpUndoJournal;
 typedef         guint32             GimpTattoo;
 
 /* The following hack is made so that we can reuse the definition
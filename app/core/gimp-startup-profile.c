@@ -0,0 +1,277 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "gimp.h"
+#include "gimp-startup-profile.h"
+
+
+typedef struct _GimpStartupPhase GimpStartupPhase;
+typedef struct _GimpStartupFile  GimpStartupFile;
+
+struct _GimpStartupProfile
+{
+  GTimer *timer;
+
+  GList  *phases;  /*  all phases, latest first     */
+  GList  *stack;   /*  running phases, innermost first  */
+  GList  *files;
+};
+
+struct _GimpStartupPhase
+{
+  gchar   *name;
+  gint     depth;
+  gdouble  start;
+  gdouble  seconds;
+
+  gint     n_files;
+  gdouble  files_seconds;
+};
+
+struct _GimpStartupFile
+{
+  gchar            *filename;
+  gdouble           seconds;
+  GimpStartupPhase *phase;
+};
+
+
+static gint   gimp_startup_file_compare (const GimpStartupFile *file1,
+                                         const GimpStartupFile *file2);
+
+
+/*  public functions  */
+
+void
+gimp_startup_profile_enable (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  if (gimp->startup_profile)
+    return;
+
+  gimp->startup_profile = g_slice_new0 (GimpStartupProfile);
+
+  gimp->startup_profile->timer = g_timer_new ();
+}
+
+gboolean
+gimp_startup_profile_enabled (Gimp *gimp)
+{
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
+
+  return gimp->startup_profile != NULL;
+}
+
+/**
+ * gimp_startup_profile_begin:
+ * @gimp:  a #Gimp object
+ * @phase: the name of the startup phase
+ *
+ * Starts timing @phase, which lasts until the matching call of
+ * gimp_startup_profile_end(). Phases can be nested. Does nothing
+ * unless the startup profile was enabled.
+ **/
+void
+gimp_startup_profile_begin (Gimp        *gimp,
+                            const gchar *phase)
+{
+  GimpStartupProfile *profile;
+  GimpStartupPhase   *new_phase;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (phase != NULL);
+
+  profile = gimp->startup_profile;
+
+  if (! profile)
+    return;
+
+  new_phase = g_slice_new0 (GimpStartupPhase);
+
+  new_phase->name  = g_strdup (phase);
+  new_phase->depth = g_list_length (profile->stack);
+  new_phase->start = g_timer_elapsed (profile->timer, NULL);
+
+  profile->phases = g_list_prepend (profile->phases, new_phase);
+  profile->stack  = g_list_prepend (profile->stack,  new_phase);
+}
+
+void
+gimp_startup_profile_end (Gimp *gimp)
+{
+  GimpStartupProfile *profile;
+  GimpStartupPhase   *phase;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  profile = gimp->startup_profile;
+
+  if (! profile)
+    return;
+
+  g_return_if_fail (profile->stack != NULL);
+
+  phase = profile->stack->data;
+
+  phase->seconds = g_timer_elapsed (profile->timer, NULL) - phase->start;
+
+  profile->stack = g_list_delete_link (profile->stack, profile->stack);
+}
+
+/**
+ * gimp_startup_profile_add_file:
+ * @gimp:     a #Gimp object
+ * @filename: the file that was loaded
+ * @seconds:  the time it took to load @filename
+ *
+ * Accounts @filename to the innermost running phase. The time is
+ * passed in, because files may be loaded in worker threads, but this
+ * function must be called from the main thread.
+ **/
+void
+gimp_startup_profile_add_file (Gimp        *gimp,
+                               const gchar *filename,
+                               gdouble      seconds)
+{
+  GimpStartupProfile *profile;
+  GimpStartupFile    *file;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (filename != NULL);
+
+  profile = gimp->startup_profile;
+
+  if (! profile || ! profile->stack)
+    return;
+
+  file = g_slice_new (GimpStartupFile);
+
+  file->filename = g_strdup (filename);
+  file->seconds  = seconds;
+  file->phase    = profile->stack->data;
+
+  file->phase->n_files++;
+  file->phase->files_seconds += seconds;
+
+  profile->files = g_list_prepend (profile->files, file);
+}
+
+/**
+ * gimp_startup_profile_report:
+ * @gimp: a #Gimp object
+ *
+ * Prints the time taken by each phase, followed by all loaded files
+ * ordered by the time they took, and disables the startup profile.
+ **/
+void
+gimp_startup_profile_report (Gimp *gimp)
+{
+  GimpStartupProfile *profile;
+  GList              *list;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  profile = gimp->startup_profile;
+
+  if (! profile)
+    return;
+
+  g_print ("Startup profile: %.3f s\n",
+           g_timer_elapsed (profile->timer, NULL));
+
+  profile->phases = g_list_reverse (profile->phases);
+
+  for (list = profile->phases; list; list = g_list_next (list))
+    {
+      GimpStartupPhase *phase = list->data;
+
+      if (phase->n_files)
+        g_print ("%9.3f s  %*s%s (%d files, %.3f s)\n",
+                 phase->seconds, 2 * phase->depth, "", phase->name,
+                 phase->n_files, phase->files_seconds);
+      else
+        g_print ("%9.3f s  %*s%s\n",
+                 phase->seconds, 2 * phase->depth, "", phase->name);
+    }
+
+  if (profile->files)
+    {
+      profile->files = g_list_sort (profile->files,
+                                    (GCompareFunc) gimp_startup_file_compare);
+
+      g_print ("\nFiles, slowest first:\n");
+
+      for (list = profile->files; list; list = g_list_next (list))
+        {
+          GimpStartupFile *file = list->data;
+
+          g_print ("%9.3f s  %s (%s)\n",
+                   file->seconds,
+                   gimp_filename_to_utf8 (file->filename),
+                   file->phase->name);
+        }
+    }
+
+  for (list = profile->files; list; list = g_list_next (list))
+    {
+      GimpStartupFile *file = list->data;
+
+      g_free (file->filename);
+      g_slice_free (GimpStartupFile, file);
+    }
+
+  for (list = profile->phases; list; list = g_list_next (list))
+    {
+      GimpStartupPhase *phase = list->data;
+
+      g_free (phase->name);
+      g_slice_free (GimpStartupPhase, phase);
+    }
+
+  g_list_free (profile->files);
+  g_list_free (profile->phases);
+  g_list_free (profile->stack);
+  g_timer_destroy (profile->timer);
+
+  g_slice_free (GimpStartupProfile, profile);
+
+  gimp->startup_profile = NULL;
+}
+
+
+/*  private functions  */
+
+static gint
+gimp_startup_file_compare (const GimpStartupFile *file1,
+                           const GimpStartupFile *file2)
+{
+  if (file1->seconds > file2->seconds)
+    return -1;
+  else if (file1->seconds < file2->seconds)
+    return 1;
+
+  return 0;
+}
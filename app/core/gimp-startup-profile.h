@@ -0,0 +1,36 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_STARTUP_PROFILE_H__
+#define __GIMP_STARTUP_PROFILE_H__
+
+
+void       gimp_startup_profile_enable    (Gimp        *gimp);
+gboolean   gimp_startup_profile_enabled   (Gimp        *gimp);
+
+void       gimp_startup_profile_begin     (Gimp        *gimp,
+                                           const gchar *phase);
+void       gimp_startup_profile_end       (Gimp        *gimp);
+
+void       gimp_startup_profile_add_file  (Gimp        *gimp,
+                                           const gchar *filename,
+                                           gdouble      seconds);
+
+void       gimp_startup_profile_report    (Gimp        *gimp);
+
+
+#endif  /*  __GIMP_STARTUP_PROFILE_H__  */
@@ -46,6 +46,7 @@
 #include "gimp-gradients.h"
 #include "gimp-modules.h"
 #include "gimp-parasites.h"
+#include "gimp-startup-profile.h"
 #include "gimp-templates.h"
 #include "gimp-units.h"
 #include "gimp-utils.h"
@@ -202,6 +203,7 @@ gimp_init (Gimp *gimp)
   gimp->pdb_compat_mode  = GIMP_PDB_COMPAT_OFF;
 
   gimp->restored         = FALSE;
+  gimp->startup_profile  = NULL;
 
   gimp_gui_init (gimp);
 
@@ -549,41 +551,42 @@ gimp_real_initialize (Gimp               *gimp,
 {
   static const GimpDataFactoryLoaderEntry brush_loader_entries[] =
   {
-    { gimp_brush_load,           GIMP_BRUSH_FILE_EXTENSION,           FALSE },
-    { gimp_brush_load,           GIMP_BRUSH_PIXMAP_FILE_EXTENSION,    FALSE },
-    { gimp_brush_load_abr,       GIMP_BRUSH_PS_FILE_EXTENSION,        FALSE },
-    { gimp_brush_load_abr,       GIMP_BRUSH_PSP_FILE_EXTENSION,       FALSE },
-    { gimp_brush_generated_load, GIMP_BRUSH_GENERATED_FILE_EXTENSION, TRUE  },
-    { gimp_brush_pipe_load,      GIMP_BRUSH_PIPE_FILE_EXTENSION,      FALSE }
+    { gimp_brush_load,           GIMP_BRUSH_FILE_EXTENSION,           FALSE, TRUE  },
+    { gimp_brush_load,           GIMP_BRUSH_PIXMAP_FILE_EXTENSION,    FALSE, TRUE  },
+    { gimp_brush_load_abr,       GIMP_BRUSH_PS_FILE_EXTENSION,        FALSE, TRUE  },
+    { gimp_brush_load_abr,       GIMP_BRUSH_PSP_FILE_EXTENSION,       FALSE, TRUE  },
+    { gimp_brush_generated_load, GIMP_BRUSH_GENERATED_FILE_EXTENSION, TRUE,  TRUE  },
+    { gimp_brush_pipe_load,      GIMP_BRUSH_PIPE_FILE_EXTENSION,      FALSE, TRUE  }
   };
 
   static const GimpDataFactoryLoaderEntry dynamics_loader_entries[] =
   {
-    { gimp_dynamics_load,        GIMP_DYNAMICS_FILE_EXTENSION,        TRUE  }
+    { gimp_dynamics_load,        GIMP_DYNAMICS_FILE_EXTENSION,        TRUE,  FALSE }
   };
 
   static const GimpDataFactoryLoaderEntry pattern_loader_entries[] =
   {
-    { gimp_pattern_load,         GIMP_PATTERN_FILE_EXTENSION,         FALSE },
-    { gimp_pattern_load_pixbuf,  NULL,                                FALSE }
+    { gimp_pattern_load,         GIMP_PATTERN_FILE_EXTENSION,         FALSE, TRUE  },
+    { gimp_pattern_load_pixbuf,  NULL,                                FALSE, FALSE }
   };
 
   static const GimpDataFactoryLoaderEntry gradient_loader_entries[] =
   {
-    { gimp_gradient_load,        GIMP_GRADIENT_FILE_EXTENSION,        TRUE  },
-    { gimp_gradient_load_svg,    GIMP_GRADIENT_SVG_FILE_EXTENSION,    FALSE },
-    { gimp_gradient_load,        NULL /* legacy loader */,            TRUE  }
+    { gimp_gradient_load,        GIMP_GRADIENT_FILE_EXTENSION,        TRUE,  TRUE  },
+    { gimp_gradient_load_svg,    GIMP_GRADIENT_SVG_FILE_EXTENSION,    FALSE, TRUE  },
+    { gimp_gradient_load,        NULL /* legacy loader */,            TRUE,  TRUE  }
   };
 
+  /*  the palette loader reports problems with g_message()  */
   static const GimpDataFactoryLoaderEntry palette_loader_entries[] =
   {
-    { gimp_palette_load,         GIMP_PALETTE_FILE_EXTENSION,         TRUE  },
-    { gimp_palette_load,         NULL /* legacy loader */,            TRUE  }
+    { gimp_palette_load,         GIMP_PALETTE_FILE_EXTENSION,         TRUE,  FALSE },
+    { gimp_palette_load,         NULL /* legacy loader */,            TRUE,  FALSE }
   };
 
   static const GimpDataFactoryLoaderEntry tool_preset_loader_entries[] =
   {
-    { gimp_tool_preset_load,     GIMP_TOOL_PRESET_FILE_EXTENSION,     TRUE  }
+    { gimp_tool_preset_load,     GIMP_TOOL_PRESET_FILE_EXTENSION,     TRUE,  FALSE }
   };
 
   GimpData *clipboard_brush;
@@ -709,8 +712,10 @@ gimp_real_restore (Gimp               *gimp,
   if (gimp->be_verbose)
     g_print ("INIT: %s\n", G_STRFUNC);
 
+  gimp_startup_profile_begin (gimp, "Plug-ins");
   gimp_plug_in_manager_restore (gimp->plug_in_manager,
                                 gimp_get_user_context (gimp), status_callback);
+  gimp_startup_profile_end (gimp);
 
   gimp->restored = TRUE;
 }
@@ -943,58 +948,85 @@ gimp_restore (Gimp               *gimp,
   if (gimp->be_verbose)
     g_print ("INIT: %s\n", G_STRFUNC);
 
+  /*  let fontconfig scan the font directories while the data files
+   *  are loaded, the fonts are only needed by the user interface
+   */
+  if (! gimp->no_fonts)
+    gimp_fonts_scan_start (gimp);
+
   /*  initialize  the global parasite table  */
   status_callback (_("Looking for data files"), _("Parasites"), 0.0);
+  gimp_startup_profile_begin (gimp, "Parasites");
   gimp_parasiterc_load (gimp);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp brushes    */
   status_callback (NULL, _("Brushes"), 0.1);
+  gimp_startup_profile_begin (gimp, "Brushes");
   gimp_data_factory_data_init (gimp->brush_factory, gimp->user_context,
                                gimp->no_data);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp dynamics   */
   status_callback (NULL, _("Dynamics"), 0.2);
+  gimp_startup_profile_begin (gimp, "Dynamics");
   gimp_data_factory_data_init (gimp->dynamics_factory, gimp->user_context,
                                gimp->no_data);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp patterns   */
   status_callback (NULL, _("Patterns"), 0.3);
+  gimp_startup_profile_begin (gimp, "Patterns");
   gimp_data_factory_data_init (gimp->pattern_factory, gimp->user_context,
                                gimp->no_data);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp palettes   */
   status_callback (NULL, _("Palettes"), 0.4);
+  gimp_startup_profile_begin (gimp, "Palettes");
   gimp_data_factory_data_init (gimp->palette_factory, gimp->user_context,
                                gimp->no_data);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp gradients  */
   status_callback (NULL, _("Gradients"), 0.5);
+  gimp_startup_profile_begin (gimp, "Gradients");
   gimp_data_factory_data_init (gimp->gradient_factory, gimp->user_context,
                                gimp->no_data);
-
-  /*  initialize the list of fonts  */
-  status_callback (NULL, _("Fonts (this may take a while)"), 0.6);
-  if (! gimp->no_fonts)
-    gimp_fonts_load (gimp);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the list of gimp tool presets if we have a GUI  */
   if (! gimp->no_interface)
     {
-      status_callback (NULL, _("Tool Presets"), 0.65);
+      status_callback (NULL, _("Tool Presets"), 0.6);
+      gimp_startup_profile_begin (gimp, "Tool Presets");
       gimp_data_factory_data_init (gimp->tool_preset_factory, gimp->user_context,
                                    gimp->no_data);
+      gimp_startup_profile_end (gimp);
     }
 
   /*  initialize the template list  */
-  status_callback (NULL, _("Templates"), 0.7);
+  status_callback (NULL, _("Templates"), 0.65);
+  gimp_startup_profile_begin (gimp, "Templates");
   gimp_templates_load (gimp);
+  gimp_startup_profile_end (gimp);
 
   /*  initialize the module list  */
-  status_callback (NULL, _("Modules"), 0.8);
+  status_callback (NULL, _("Modules"), 0.7);
+  gimp_startup_profile_begin (gimp, "Modules");
   gimp_modules_load (gimp);
+  gimp_startup_profile_end (gimp);
+
+  /*  initialize the list of fonts, waiting for the scan started above  */
+  status_callback (NULL, _("Fonts (this may take a while)"), 0.8);
+  gimp_startup_profile_begin (gimp, "Fonts");
+  if (! gimp->no_fonts)
+    gimp_fonts_load (gimp);
+  gimp_startup_profile_end (gimp);
 
   /* update tag cache */
   status_callback (NULL, _("Updating tag cache"), 0.9);
+  gimp_startup_profile_begin (gimp, "Tag cache");
   gimp_tag_cache_load (gimp->tag_cache);
   gimp_tag_cache_add_container (gimp->tag_cache,
                                 gimp_data_factory_get_container (gimp->brush_factory));
@@ -1008,6 +1040,7 @@ gimp_restore (Gimp               *gimp,
                                 gimp_data_factory_get_container (gimp->palette_factory));
   gimp_tag_cache_add_container (gimp->tag_cache,
                                 gimp_data_factory_get_container (gimp->tool_preset_factory));
+  gimp_startup_profile_end (gimp);
 
   g_signal_emit (gimp, gimp_signals[RESTORE], 0, status_callback);
 }
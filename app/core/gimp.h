@@ -57,6 +57,8 @@ struct _Gimp
 
   gboolean                restored;    /* becomes TRUE in gimp_restore() */
 
+  GimpStartupProfile     *startup_profile;
+
   gint                    busy;
   guint                   busy_idle_id;
 
@@ -31,7 +31,10 @@
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "gimp.h"
+#include "gimp-startup-profile.h"
 #include "gimpcontext.h"
 #include "gimpdata.h"
 #include "gimpdatafactory.h"
@@ -89,6 +92,14 @@ static void    gimp_data_factory_load_data  (const GimpDatafileData *file_data,
 static void    gimp_data_factory_load_data_recursive (const GimpDatafileData *file_data,
                                                       gpointer                data);
 
+static void    gimp_data_factory_add_data   (GimpDataFactory                  *factory,
+                                             const GimpDataFactoryLoaderEntry *loader,
+                                             const gchar                      *filename,
+                                             const gchar                      *dirname,
+                                             time_t                            mtime,
+                                             GList                            *data_list,
+                                             GError                          **error);
+
 G_DEFINE_TYPE (GimpDataFactory, gimp_data_factory, GIMP_TYPE_OBJECT)
 
 #define parent_class gimp_data_factory_parent_class
@@ -304,13 +315,160 @@ gimp_data_factory_data_foreach (GimpDataFactory     *factory,
     }
 }
 
+/*  A data file whose loading was deferred, so that it can be parsed
+ *  in a worker thread
+ */
+typedef struct
+{
+  const GimpDataFactoryLoaderEntry *loader;
+  gchar                            *filename;
+  gchar                            *dirname;
+  time_t                            mtime;
+
+  GList                            *data_list;
+  GError                           *error;
+  gboolean                          loaded;
+  gdouble                           seconds;
+} GimpDataLoadJob;
+
 typedef struct
 {
   GimpDataFactory *factory;
   GimpContext     *context;
   GHashTable      *cache;
+
+  /*  deferred files, in directory order, and the next one to parse  */
+  GQueue           jobs;
+  GList           *next_job;
+  GMutex          *mutex;
+  gint             n_threads;
+
+  /*  only used when profiling the startup  */
+  GTimer          *timer;
 } GimpDataLoadContext;
 
+#ifdef ENABLE_MP
+
+static void
+gimp_data_factory_load_thread (GimpDataLoadContext *load_context)
+{
+  GTimer *timer = NULL;
+
+  if (load_context->timer)
+    timer = g_timer_new ();
+
+  while (TRUE)
+    {
+      GimpDataLoadJob *job = NULL;
+
+      g_mutex_lock (load_context->mutex);
+
+      while (load_context->next_job && ! job)
+        {
+          GimpDataLoadJob *next = load_context->next_job->data;
+
+          load_context->next_job = g_list_next (load_context->next_job);
+
+          /*  the others are loaded by the main thread when adding them  */
+          if (next->loader->threadsafe)
+            job = next;
+        }
+
+      g_mutex_unlock (load_context->mutex);
+
+      if (! job)
+        break;
+
+      if (timer)
+        g_timer_start (timer);
+
+      job->data_list = job->loader->load_func (load_context->context,
+                                               job->filename,
+                                               &job->error);
+      job->loaded = TRUE;
+
+      if (timer)
+        job->seconds = g_timer_elapsed (timer, NULL);
+    }
+
+  if (timer)
+    g_timer_destroy (timer);
+}
+
+/*  Parses the deferred files in up to n_threads threads, then adds
+ *  their data in directory order, so the containers end up exactly
+ *  as if the files had been loaded one after the other.
+ */
+static void
+gimp_data_factory_load_jobs (GimpDataLoadContext *load_context)
+{
+  GimpDataFactory *factory   = load_context->factory;
+  gint             n_threads = MIN (load_context->n_threads,
+                                    load_context->jobs.length);
+  GThread        **threads;
+  GList           *list;
+  gint             i;
+
+  if (! load_context->jobs.head)
+    return;
+
+  load_context->next_job = load_context->jobs.head;
+  load_context->mutex    = g_mutex_new ();
+
+  threads = g_new0 (GThread *, n_threads);
+
+  for (i = 0; i < n_threads - 1; i++)
+    threads[i] = g_thread_create ((GThreadFunc) gimp_data_factory_load_thread,
+                                  load_context, TRUE, NULL);
+
+  /*  the calling thread helps, and does all the work if no thread
+   *  could be created
+   */
+  gimp_data_factory_load_thread (load_context);
+
+  for (i = 0; i < n_threads - 1; i++)
+    if (threads[i])
+      g_thread_join (threads[i]);
+
+  g_free (threads);
+  g_mutex_free (load_context->mutex);
+  load_context->mutex = NULL;
+
+  for (list = load_context->jobs.head; list; list = g_list_next (list))
+    {
+      GimpDataLoadJob *job = list->data;
+
+      if (! job->loaded)
+        {
+          if (load_context->timer)
+            g_timer_start (load_context->timer);
+
+          job->data_list = job->loader->load_func (load_context->context,
+                                                   job->filename,
+                                                   &job->error);
+
+          if (load_context->timer)
+            job->seconds = g_timer_elapsed (load_context->timer, NULL);
+        }
+
+      if (load_context->timer)
+        gimp_startup_profile_add_file (factory->priv->gimp,
+                                       job->filename, job->seconds);
+
+      gimp_data_factory_add_data (factory, job->loader,
+                                  job->filename, job->dirname, job->mtime,
+                                  job->data_list, &job->error);
+
+      g_free (job->filename);
+      g_free (job->dirname);
+      g_slice_free (GimpDataLoadJob, job);
+    }
+
+  g_queue_clear (&load_context->jobs);
+}
+
+#endif /* ENABLE_MP */
+
 static void
 gimp_data_factory_data_load (GimpDataFactory *factory,
                              GimpContext     *context,
@@ -330,9 +488,36 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
       gchar               *tmp;
       GimpDataLoadContext  load_context;
 
-      load_context.factory = factory;
-      load_context.context = context;
-      load_context.cache   = cache;
+      load_context.factory   = factory;
+      load_context.context   = context;
+      load_context.cache     = cache;
+      load_context.next_job  = NULL;
+      load_context.mutex     = NULL;
+      load_context.n_threads = 1;
+      load_context.timer     = NULL;
+
+      if (gimp_startup_profile_enabled (factory->priv->gimp))
+        load_context.timer = g_timer_new ();
+
+      g_queue_init (&load_context.jobs);
+
+#ifdef ENABLE_MP
+      /*  when refreshing, unchanged data is re-added right away, so
+       *  load serially to keep the order in which data is added
+       */
+      if (! cache)
+        {
+          gint i;
+
+          for (i = 0; i < factory->priv->n_loader_entries; i++)
+            if (factory->priv->loader_entries[i].threadsafe)
+              {
+                load_context.n_threads =
+                  GIMP_BASE_CONFIG (factory->priv->gimp->config)->num_processors;
+                break;
+              }
+        }
+#endif
 
       tmp = gimp_config_path_expand (path, TRUE, NULL);
       g_free (path);
@@ -358,11 +543,18 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
                                        gimp_data_factory_load_data_recursive,
                                        &load_context);
 
+#ifdef ENABLE_MP
+      gimp_data_factory_load_jobs (&load_context);
+#endif
+
       if (writable_path)
         {
           gimp_path_free (writable_list);
           g_object_set_data (G_OBJECT (factory), WRITABLE_PATH_KEY, NULL);
         }
+
+      if (load_context.timer)
+        g_timer_destroy (load_context.timer);
     }
 
   g_free (path);
@@ -855,8 +1047,46 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
         }
     }
 
+#ifdef ENABLE_MP
+  if (context->n_threads > 1)
+    {
+      GimpDataLoadJob *job = g_slice_new0 (GimpDataLoadJob);
+
+      job->loader   = loader;
+      job->filename = g_strdup (file_data->filename);
+      job->dirname  = g_strdup (file_data->dirname);
+      job->mtime    = file_data->mtime;
+
+      g_queue_push_tail (&context->jobs, job);
+
+      return;
+    }
+#endif
+
+  if (context->timer)
+    g_timer_start (context->timer);
+
   data_list = loader->load_func (context->context, file_data->filename, &error);
 
+  if (context->timer)
+    gimp_startup_profile_add_file (factory->priv->gimp, file_data->filename,
+                                   g_timer_elapsed (context->timer, NULL));
+
+  gimp_data_factory_add_data (factory, loader,
+                              file_data->filename, file_data->dirname,
+                              file_data->mtime,
+                              data_list, &error);
+}
+
+static void
+gimp_data_factory_add_data (GimpDataFactory                  *factory,
+                            const GimpDataFactoryLoaderEntry *loader,
+                            const gchar                      *filename,
+                            const gchar                      *dirname,
+                            time_t                            mtime,
+                            GList                            *data_list,
+                            GError                          **error)
+{
   if (G_LIKELY (data_list))
     {
       GList    *list;
@@ -864,8 +1094,7 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
       gboolean  writable  = FALSE;
       gboolean  deletable = FALSE;
 
-      obsolete = (strstr (file_data->dirname,
-                          GIMP_OBSOLETE_DATA_DIR_NAME) != 0);
+      obsolete = (strstr (dirname, GIMP_OBSOLETE_DATA_DIR_NAME) != 0);
 
       /* obsolete files are immutable, don't check their writability */
       if (! obsolete)
@@ -876,7 +1105,7 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
                                              WRITABLE_PATH_KEY);
 
           deletable = (g_list_length (data_list) == 1 &&
-                       gimp_data_factory_is_dir_writable (file_data->dirname,
+                       gimp_data_factory_is_dir_writable (dirname,
                                                           writable_list));
 
           writable = (deletable && loader->writable);
@@ -886,9 +1115,8 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
         {
           GimpData *data = list->data;
 
-          gimp_data_set_filename (data, file_data->filename,
-                                  writable, deletable);
-          gimp_data_set_mtime (data, file_data->mtime);
+          gimp_data_set_filename (data, filename, writable, deletable);
+          gimp_data_set_mtime (data, mtime);
 
           gimp_data_clean (data);
 
@@ -905,10 +1133,10 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
       g_list_free (data_list);
     }
 
-  if (G_UNLIKELY (error))
+  if (G_UNLIKELY (*error))
     {
       gimp_message (factory->priv->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    _("Failed to load data:\n\n%s"), error->message);
-      g_clear_error (&error);
+                    _("Failed to load data:\n\n%s"), (*error)->message);
+      g_clear_error (error);
     }
 }
@@ -23,6 +23,11 @@
 #include <cairo.h>
 #include <gegl.h>
 
+#if defined (USE_SSE) && defined (__SSE2__)
+#define USE_SSE2_BLEND
+#include <emmintrin.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 #include "libgimpcolor/gimpcolor.h"
@@ -47,6 +52,10 @@
 #include "gimp-intl.h"
 
 
+/*  the number of gradient samples the blend is looked up from  */
+#define GRADIENT_LUT_SIZE  4096
+
+
 typedef struct
 {
   GimpGradient     *gradient;
@@ -60,15 +69,16 @@ typedef struct
   gdouble           dist;
   gdouble           vec[2];
   GimpRepeatMode    repeat;
-  GRand            *seed;
+  gint              max_depth;
+  gdouble           threshold;
+  guint32           seed;
+  GimpRGB          *lut;        /*  the blended colors, by factor   */
+  guchar           *lut_pixels; /*  .. and as pixels of the region  */
 } RenderBlendData;
 
 typedef struct
 {
   PixelRegion *PR;
-  guchar      *row_data;
-  gint         bytes;
-  gint         width;
   GRand       *dither_rand;
 } PutPixelData;
 
@@ -123,10 +133,28 @@ static void     gradient_precalc_shapeburst (GimpImage        *image,
                                              gdouble           dist,
                                              GimpProgress     *progress);
 
+static gdouble  gradient_calc_factor        (RenderBlendData  *rbd,
+                                             gdouble           x,
+                                             gdouble           y);
+static void     gradient_calc_row_factors   (RenderBlendData  *rbd,
+                                             gint              x,
+                                             gint              y,
+                                             gint              width,
+                                             gdouble          *factors);
+static void     gradient_blend_color        (RenderBlendData  *rbd,
+                                             gdouble           factor,
+                                             GimpRGB          *color);
+static void     gradient_lut_init           (RenderBlendData  *rbd,
+                                             gint              bytes);
 static void     gradient_render_pixel       (gdouble           x,
                                              gdouble           y,
                                              GimpRGB          *color,
                                              gpointer          render_data);
+static void     gradient_render_row         (RenderBlendData  *rbd,
+                                             gint              x,
+                                             gint              y,
+                                             gint              width,
+                                             gint             *indices);
 static void     gradient_put_pixel          (gint              x,
                                              gint              y,
                                              GimpRGB          *color,
@@ -161,6 +189,8 @@ static void     gradient_fill_single_region_gray        (RenderBlendData *rbd,
                                                          PixelRegion     *PR);
 static void     gradient_fill_single_region_gray_dither (RenderBlendData *rbd,
                                                          PixelRegion     *PR);
+static void     gradient_fill_single_region_supersample (RenderBlendData *rbd,
+                                                         PixelRegion     *PR);
 
 
 /*  variables for the shapeburst algorithms  */
@@ -649,86 +679,261 @@ gradient_precalc_shapeburst (GimpImage    *image,
 }
 
 
-static void
-gradient_render_pixel (gdouble   x,
-                       gdouble   y,
-                       GimpRGB  *color,
-                       gpointer  render_data)
+static gdouble
+gradient_calc_factor (RenderBlendData *rbd,
+                      gdouble          x,
+                      gdouble          y)
 {
-  RenderBlendData *rbd = render_data;
-  gdouble          factor;
-
-  /* Calculate blending factor */
-
   switch (rbd->gradient_type)
     {
     case GIMP_GRADIENT_LINEAR:
-      factor = gradient_calc_linear_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_linear_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_BILINEAR:
-      factor = gradient_calc_bilinear_factor (rbd->dist,
-                                              rbd->vec, rbd->offset,
-                                              x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_bilinear_factor (rbd->dist,
+                                            rbd->vec, rbd->offset,
+                                            x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_RADIAL:
-      factor = gradient_calc_radial_factor (rbd->dist,
-                                            rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_radial_factor (rbd->dist,
+                                          rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_SQUARE:
-      factor = gradient_calc_square_factor (rbd->dist, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_square_factor (rbd->dist, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_CONICAL_SYMMETRIC:
-      factor = gradient_calc_conical_sym_factor (rbd->dist,
-                                                 rbd->vec, rbd->offset,
-                                                 x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_conical_sym_factor (rbd->dist,
+                                               rbd->vec, rbd->offset,
+                                               x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_CONICAL_ASYMMETRIC:
-      factor = gradient_calc_conical_asym_factor (rbd->dist,
-                                                  rbd->vec, rbd->offset,
-                                                  x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_conical_asym_factor (rbd->dist,
+                                                rbd->vec, rbd->offset,
+                                                x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
-      factor = gradient_calc_shapeburst_angular_factor (x, y);
-      break;
+      return gradient_calc_shapeburst_angular_factor (x, y);
 
     case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
-      factor = gradient_calc_shapeburst_spherical_factor (x, y);
-      break;
+      return gradient_calc_shapeburst_spherical_factor (x, y);
 
     case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
-      factor = gradient_calc_shapeburst_dimpled_factor (x, y);
-      break;
+      return gradient_calc_shapeburst_dimpled_factor (x, y);
 
     case GIMP_GRADIENT_SPIRAL_CLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, TRUE);
-      break;
+      return gradient_calc_spiral_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy, TRUE);
 
     case GIMP_GRADIENT_SPIRAL_ANTICLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, FALSE);
-      break;
+      return gradient_calc_spiral_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy, FALSE);
 
     default:
       g_assert_not_reached ();
+      return 0.0;
+    }
+}
+
+/*  Calculates the blending factors of a row of at most TILE_WIDTH
+ *  pixels, with the same results as the per-pixel functions.  The
+ *  linear, bilinear and radial gradients are evaluated with SSE2 two
+ *  pixels at a time where available; the vector code does the same
+ *  double operations in the same order, so it matches the scalar
+ *  loops exactly.
+ */
+static void
+gradient_calc_row_factors (RenderBlendData *rbd,
+                           gint             x,
+                           gint             y,
+                           gint             width,
+                           gdouble         *factors)
+{
+  const gdouble dy     = y - rbd->sy;
+  const gdouble offset = rbd->offset / 100.0;
+  gint          i      = 0;
+#ifdef USE_SSE2_BLEND
+  const __m128d zero   = _mm_setzero_pd ();
+  const __m128d voff   = _mm_set1_pd (offset);
+  const __m128d vsx    = _mm_set1_pd (rbd->sx);
+#endif
+
+  if (rbd->dist == 0.0)
+    {
+      switch (rbd->gradient_type)
+        {
+        case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
+        case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
+        case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
+          break;
+
+        default:
+          for (i = 0; i < width; i++)
+            factors[i] = 0.0;
+          return;
+        }
+    }
+
+  switch (rbd->gradient_type)
+    {
+    case GIMP_GRADIENT_LINEAR:
+      if (offset == 1.0)
+        break;
+
+      {
+        const gdouble scale = 1.0 / (1.0 - offset);
+        const gdouble vx    = rbd->vec[0] / rbd->dist;
+        const gdouble r0    = rbd->vec[1] * dy / rbd->dist;
+
+#ifdef USE_SSE2_BLEND
+        const __m128d vscale = _mm_set1_pd (scale);
+        const __m128d vvx    = _mm_set1_pd (vx);
+        const __m128d vr0    = _mm_set1_pd (r0);
+
+        for (; i + 2 <= width; i += 2)
+          {
+            __m128d vdx = _mm_sub_pd (_mm_set_pd (x + i + 1, x + i), vsx);
+            __m128d rat = _mm_add_pd (vr0, _mm_mul_pd (vvx, vdx));
+            __m128d neg = _mm_cmplt_pd (rat, zero);
+            __m128d pos = _mm_max_pd (_mm_sub_pd (rat, voff), zero);
+
+            rat = _mm_or_pd (_mm_and_pd (neg, rat), _mm_andnot_pd (neg, pos));
+
+            _mm_storeu_pd (factors + i, _mm_mul_pd (rat, vscale));
+          }
+#endif
+
+        for (; i < width; i++)
+          {
+            gdouble rat = r0 + vx * (x + i - rbd->sx);
+
+            factors[i] = (rat < 0.0 ? rat : MAX (rat - offset, 0.0)) * scale;
+          }
+      }
+      return;
+
+    case GIMP_GRADIENT_BILINEAR:
+      if (offset == 1.0)
+        break;
+
+      {
+        const gdouble scale = 1.0 / (1.0 - offset);
+        const gdouble vx    = rbd->vec[0] / rbd->dist;
+        const gdouble r0    = rbd->vec[1] * dy / rbd->dist;
+
+#ifdef USE_SSE2_BLEND
+        const __m128d vscale = _mm_set1_pd (scale);
+        const __m128d vvx    = _mm_set1_pd (vx);
+        const __m128d vr0    = _mm_set1_pd (r0);
+        const __m128d sign   = _mm_set1_pd (-0.0);
+
+        for (; i + 2 <= width; i += 2)
+          {
+            __m128d vdx = _mm_sub_pd (_mm_set_pd (x + i + 1, x + i), vsx);
+            __m128d rat = _mm_add_pd (vr0, _mm_mul_pd (vvx, vdx));
+
+            rat = _mm_andnot_pd (sign, rat);
+            rat = _mm_max_pd (_mm_sub_pd (rat, voff), zero);
+
+            _mm_storeu_pd (factors + i, _mm_mul_pd (rat, vscale));
+          }
+#endif
+
+        for (; i < width; i++)
+          {
+            gdouble rat = fabs (r0 + vx * (x + i - rbd->sx));
+
+            factors[i] = MAX (rat - offset, 0.0) * scale;
+          }
+      }
       return;
+
+    case GIMP_GRADIENT_RADIAL:
+      if (offset == 1.0)
+        break;
+
+      {
+        const gdouble scale = 1.0 / (1.0 - offset);
+        const gdouble dy2   = SQR (dy);
+
+#ifdef USE_SSE2_BLEND
+        const __m128d vscale = _mm_set1_pd (scale);
+        const __m128d vdy2   = _mm_set1_pd (dy2);
+        const __m128d vdist  = _mm_set1_pd (rbd->dist);
+
+        for (; i + 2 <= width; i += 2)
+          {
+            __m128d vdx = _mm_sub_pd (_mm_set_pd (x + i + 1, x + i), vsx);
+            __m128d rat = _mm_add_pd (_mm_mul_pd (vdx, vdx), vdy2);
+
+            rat = _mm_div_pd (_mm_sqrt_pd (rat), vdist);
+            rat = _mm_max_pd (_mm_sub_pd (rat, voff), zero);
+
+            _mm_storeu_pd (factors + i, _mm_mul_pd (rat, vscale));
+          }
+#endif
+
+        for (; i < width; i++)
+          {
+            gdouble dx  = x + i - rbd->sx;
+            gdouble rat = sqrt (SQR (dx) + dy2) / rbd->dist;
+
+            factors[i] = MAX (rat - offset, 0.0) * scale;
+          }
+      }
+      return;
+
+    case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
+    case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
+    case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
+      {
+        gfloat values[TILE_WIDTH];
+
+        tile_manager_read_pixel_data (distR.tiles,
+                                      x, y, x + width - 1, y,
+                                      (guchar *) values,
+                                      width * sizeof (gfloat));
+
+        for (i = 0; i < width; i++)
+          {
+            switch (rbd->gradient_type)
+              {
+              case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
+                factors[i] = 1.0 - values[i];
+                break;
+
+              case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
+                factors[i] = 1.0 - sin (0.5 * G_PI * values[i]);
+                break;
+
+              default:
+                factors[i] = cos (0.5 * G_PI * values[i]);
+                break;
+              }
+          }
+      }
+      return;
+
+    default:
+      break;
     }
 
+  for (i = 0; i < width; i++)
+    factors[i] = gradient_calc_factor (rbd, x + i, y);
+}
+
+static inline gint
+gradient_lut_index (GimpRepeatMode repeat,
+                    gdouble        factor)
+{
   /* Adjust for repeat */
 
-  switch (rbd->repeat)
+  switch (repeat)
     {
     case GIMP_REPEAT_NONE:
       factor = CLAMP (factor, 0.0, 1.0);
@@ -754,8 +959,15 @@ gradient_render_pixel (gdouble   x,
       break;
     }
 
-  /* Blend the colors */
+  return CLAMP (ROUND (factor * (GRADIENT_LUT_SIZE - 1)),
+                0, GRADIENT_LUT_SIZE - 1);
+}
 
+static void
+gradient_blend_color (RenderBlendData *rbd,
+                      gdouble          factor,
+                      GimpRGB         *color)
+{
   if (rbd->blend_mode == GIMP_CUSTOM_MODE)
     {
       gimp_gradient_get_color_at (rbd->gradient, rbd->context, NULL,
@@ -782,6 +994,68 @@ gradient_render_pixel (gdouble   x,
     }
 }
 
+/*  Samples the gradient once, all pixels are looked up from the
+ *  samples instead of evaluating the gradient segments.
+ */
+static void
+gradient_lut_init (RenderBlendData *rbd,
+                   gint             bytes)
+{
+  gint i;
+
+  rbd->lut        = g_new (GimpRGB, GRADIENT_LUT_SIZE);
+  rbd->lut_pixels = g_new (guchar, GRADIENT_LUT_SIZE * bytes);
+
+  for (i = 0; i < GRADIENT_LUT_SIZE; i++)
+    {
+      GimpRGB *color = &rbd->lut[i];
+      guchar  *pixel = rbd->lut_pixels + i * bytes;
+
+      gradient_blend_color (rbd, (gdouble) i / (GRADIENT_LUT_SIZE - 1), color);
+
+      if (bytes >= 3)
+        {
+          pixel[0] = ROUND (color->r * 255.0);
+          pixel[1] = ROUND (color->g * 255.0);
+          pixel[2] = ROUND (color->b * 255.0);
+          pixel[3] = ROUND (color->a * 255.0);
+        }
+      else
+        {
+          pixel[0] = gimp_rgb_luminance_uchar (color);
+          pixel[1] = ROUND (color->a * 255.0);
+        }
+    }
+}
+
+static void
+gradient_render_pixel (gdouble   x,
+                       gdouble   y,
+                       GimpRGB  *color,
+                       gpointer  render_data)
+{
+  RenderBlendData *rbd    = render_data;
+  gdouble          factor = gradient_calc_factor (rbd, x, y);
+
+  *color = rbd->lut[gradient_lut_index (rbd->repeat, factor)];
+}
+
+static void
+gradient_render_row (RenderBlendData *rbd,
+                     gint             x,
+                     gint             y,
+                     gint             width,
+                     gint            *indices)
+{
+  gdouble factors[TILE_WIDTH];
+  gint    i;
+
+  gradient_calc_row_factors (rbd, x, y, width, factors);
+
+  for (i = 0; i < width; i++)
+    indices[i] = gradient_lut_index (rbd->repeat, factors[i]);
+}
+
 static void
 gradient_put_pixel (gint      x,
                     gint      y,
@@ -789,50 +1063,40 @@ gradient_put_pixel (gint      x,
                     gpointer  put_pixel_data)
 {
   PutPixelData  *ppd  = put_pixel_data;
-  guchar        *dest = ppd->row_data + ppd->bytes * x;
+  PixelRegion   *PR   = ppd->PR;
+  guchar        *dest = (PR->data +
+                         (y - PR->y) * PR->rowstride +
+                         (x - PR->x) * PR->bytes);
 
-  if (ppd->bytes >= 3)
+  if (PR->bytes >= 3)
     {
-      if (ppd->dither_rand)
-        {
-          gint i = g_rand_int (ppd->dither_rand);
+      gint i = g_rand_int (ppd->dither_rand);
 
-          *dest++ = color->r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-        }
-      else
-        {
-          *dest++ = ROUND (color->r * 255.0);
-          *dest++ = ROUND (color->g * 255.0);
-          *dest++ = ROUND (color->b * 255.0);
-          *dest++ = ROUND (color->a * 255.0);
-        }
+      *dest++ = color->r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
     }
   else
     {
       /* Convert to grayscale */
       gdouble gray = gimp_rgb_luminance (color);
+      gint    i    = g_rand_int (ppd->dither_rand);
 
-      if (ppd->dither_rand)
-        {
-          gint i = g_rand_int (ppd->dither_rand);
-
-          *dest++ = gray     * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-        }
-      else
-        {
-          *dest++ = ROUND (gray     * 255.0);
-          *dest++ = ROUND (color->a * 255.0);
-        }
+      *dest++ = gray     * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
     }
+}
 
-  /* Paint whole row if we are on the rightmost pixel */
-
-  if (x == (ppd->width - 1))
-    pixel_region_set_row (ppd->PR, 0, y, ppd->width, ppd->row_data);
+/*  Every region gets its own random generator, seeded from the
+ *  region's position, GRand is not thread-safe.
+ */
+static GRand *
+gradient_region_rand_new (RenderBlendData *rbd,
+                          PixelRegion     *PR)
+{
+  return g_rand_new_with_seed (rbd->seed ^
+                               ((guint32) PR->y * 65599u + (guint32) PR->x));
 }
 
 static void
@@ -953,62 +1217,47 @@ gradient_fill_region (GimpImage        *image,
   rbd.blend_mode    = blend_mode;
   rbd.gradient_type = gradient_type;
   rbd.repeat        = repeat;
+  rbd.max_depth     = max_depth;
+  rbd.threshold     = threshold;
+  rbd.seed          = g_random_int ();
 
-  /* Render the gradient! */
+  gradient_lut_init (&rbd, PR->bytes);
 
-  if (supersample)
-    {
-      PutPixelData  ppd;
-
-      ppd.PR          = PR;
-      ppd.row_data    = g_malloc (width * PR->bytes);
-      ppd.bytes       = PR->bytes;
-      ppd.width       = width;
-      ppd.dither_rand = g_rand_new ();
-
-      gimp_adaptive_supersample_area (0, 0, (width - 1), (height - 1),
-                                      max_depth, threshold,
-                                      gradient_render_pixel, &rbd,
-                                      gradient_put_pixel, &ppd,
-                                      progress ?
-                                      gimp_progress_update_and_flush : NULL,
-                                      progress);
-
-      g_rand_free (ppd.dither_rand);
-      g_free (ppd.row_data);
-    }
-  else
-    {
-      PixelProcessorFunc          func;
-      PixelProcessorProgressFunc  progress_func = NULL;
+  /* Render the gradient! */
 
-      if (dither)
-        {
-          rbd.seed = g_rand_new ();
+  {
+    PixelProcessorFunc          func;
+    PixelProcessorProgressFunc  progress_func = NULL;
 
-          if (PR->bytes >= 3)
-            func = (PixelProcessorFunc) gradient_fill_single_region_rgb_dither;
-          else
-            func = (PixelProcessorFunc) gradient_fill_single_region_gray_dither;
-        }
-      else
-        {
-          if (PR->bytes >= 3)
-            func = (PixelProcessorFunc) gradient_fill_single_region_rgb;
-          else
-            func = (PixelProcessorFunc) gradient_fill_single_region_gray;
-        }
+    if (supersample)
+      {
+        func = (PixelProcessorFunc) gradient_fill_single_region_supersample;
+      }
+    else if (dither)
+      {
+        if (PR->bytes >= 3)
+          func = (PixelProcessorFunc) gradient_fill_single_region_rgb_dither;
+        else
+          func = (PixelProcessorFunc) gradient_fill_single_region_gray_dither;
+      }
+    else
+      {
+        if (PR->bytes >= 3)
+          func = (PixelProcessorFunc) gradient_fill_single_region_rgb;
+        else
+          func = (PixelProcessorFunc) gradient_fill_single_region_gray;
+      }
 
-      if (progress)
-        progress_func = (PixelProcessorProgressFunc) gimp_progress_set_value;
+    if (progress)
+      progress_func = (PixelProcessorProgressFunc) gimp_progress_set_value;
 
-      pixel_regions_process_parallel_progress (func, &rbd,
-                                               progress_func, progress,
-                                               1, PR);
+    pixel_regions_process_parallel_progress (func, &rbd,
+                                             progress_func, progress,
+                                             1, PR);
+  }
 
-      if (dither)
-        g_rand_free (rbd.seed);
-    }
+  g_free (rbd.lut_pixels);
+  g_free (rbd.lut);
 
   g_object_unref (rbd.gradient);
 }
@@ -1017,48 +1266,52 @@ static void
 gradient_fill_single_region_rgb (RenderBlendData *rbd,
                                  PixelRegion     *PR)
 {
-  guchar *dest = PR->data;
-  gint    endx = PR->x + PR->w;
-  gint    endy = PR->y + PR->h;
-  gint    x, y;
+  const guint32 *lut  = (const guint32 *) rbd->lut_pixels;
+  guchar        *dest = PR->data;
+  gint           indices[TILE_WIDTH];
+  gint           x, y;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
+  for (y = 0; y < PR->h; y++)
+    {
+      guint32 *d = (guint32 *) dest;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      gradient_render_row (rbd, PR->x, PR->y + y, PR->w, indices);
 
-        *dest++ = ROUND (color.r * 255.0);
-        *dest++ = ROUND (color.g * 255.0);
-        *dest++ = ROUND (color.b * 255.0);
-        *dest++ = ROUND (color.a * 255.0);
-      }
+      for (x = 0; x < PR->w; x++)
+        d[x] = lut[indices[x]];
+
+      dest += PR->rowstride;
+    }
 }
 
 static void
 gradient_fill_single_region_rgb_dither (RenderBlendData *rbd,
                                         PixelRegion     *PR)
 {
-  GRand  *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
+  GRand  *dither_rand = gradient_region_rand_new (rbd, PR);
   guchar *dest        = PR->data;
-  gint    endx        = PR->x + PR->w;
-  gint    endy        = PR->y + PR->h;
+  gint    indices[TILE_WIDTH];
   gint    x, y;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
-        gint     i = g_rand_int (dither_rand);
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *d = dest;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      gradient_render_row (rbd, PR->x, PR->y + y, PR->w, indices);
 
-        *dest++ = color.r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-      }
+      for (x = 0; x < PR->w; x++)
+        {
+          const GimpRGB *color = &rbd->lut[indices[x]];
+          gint           i     = g_rand_int (dither_rand);
+
+          *d++ = color->r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+          *d++ = color->g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+          *d++ = color->b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+          *d++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
+        }
+
+      dest += PR->rowstride;
+    }
 
   g_rand_free (dither_rand);
 }
@@ -1067,47 +1320,74 @@ static void
 gradient_fill_single_region_gray (RenderBlendData *rbd,
                                   PixelRegion     *PR)
 {
-  guchar *dest = PR->data;
-  gint    endx = PR->x + PR->w;
-  gint    endy = PR->y + PR->h;
-  gint    x, y;
+  const guint16 *lut  = (const guint16 *) rbd->lut_pixels;
+  guchar        *dest = PR->data;
+  gint           indices[TILE_WIDTH];
+  gint           x, y;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
+  for (y = 0; y < PR->h; y++)
+    {
+      guint16 *d = (guint16 *) dest;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      gradient_render_row (rbd, PR->x, PR->y + y, PR->w, indices);
 
-        *dest++ = gimp_rgb_luminance_uchar (&color);
-        *dest++ = ROUND (color.a * 255.0);
-      }
+      for (x = 0; x < PR->w; x++)
+        d[x] = lut[indices[x]];
+
+      dest += PR->rowstride;
+    }
 }
 
 static void
 gradient_fill_single_region_gray_dither (RenderBlendData *rbd,
                                          PixelRegion     *PR)
 {
-  GRand  *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
+  GRand  *dither_rand = gradient_region_rand_new (rbd, PR);
   guchar *dest        = PR->data;
-  gint    endx        = PR->x + PR->w;
-  gint    endy        = PR->y + PR->h;
+  gint    indices[TILE_WIDTH];
   gint    x, y;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
-        gdouble  gray;
-        gint     i = g_rand_int (dither_rand);
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *d = dest;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      gradient_render_row (rbd, PR->x, PR->y + y, PR->w, indices);
 
-        gray = gimp_rgb_luminance (&color);
+      for (x = 0; x < PR->w; x++)
+        {
+          const GimpRGB *color = &rbd->lut[indices[x]];
+          gdouble        gray  = gimp_rgb_luminance (color);
+          gint           i     = g_rand_int (dither_rand);
 
-        *dest++ = gray    * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-      }
+          *d++ = gray     * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+          *d++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
+        }
+
+      dest += PR->rowstride;
+    }
 
   g_rand_free (dither_rand);
 }
+
+/*  Neighbouring regions sample their shared pixel corners the same,
+ *  so supersampling them one by one gives the same result as doing
+ *  the whole area at once.
+ */
+static void
+gradient_fill_single_region_supersample (RenderBlendData *rbd,
+                                         PixelRegion     *PR)
+{
+  PutPixelData ppd;
+
+  ppd.PR          = PR;
+  ppd.dither_rand = gradient_region_rand_new (rbd, PR);
+
+  gimp_adaptive_supersample_area (PR->x, PR->y,
+                                  PR->x + PR->w - 1, PR->y + PR->h - 1,
+                                  rbd->max_depth, rbd->threshold,
+                                  gradient_render_pixel, rbd,
+                                  gradient_put_pixel, &ppd,
+                                  NULL, NULL);
+
+  g_rand_free (ppd.dither_rand);
+}
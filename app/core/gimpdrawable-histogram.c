@@ -31,19 +31,50 @@
 #include "gimpimage.h"
 
 
+static void   gimp_drawable_histogram (GimpDrawable  *drawable,
+                                       GimpHistogram *histogram,
+                                       gboolean       incremental);
+
+
 void
 gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
                                    GimpHistogram *histogram)
 {
-  GimpImage   *image;
-  PixelRegion  region;
-  PixelRegion  mask;
-  gint         x, y, width, height;
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
+  g_return_if_fail (histogram != NULL);
+
+  gimp_drawable_histogram (drawable, histogram, FALSE);
+}
 
+/*  like gimp_drawable_calculate_histogram(), but only recounts the
+ *  areas that were passed to gimp_histogram_invalidate() since the
+ *  last call
+ */
+void
+gimp_drawable_update_histogram (GimpDrawable  *drawable,
+                                GimpHistogram *histogram)
+{
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
   g_return_if_fail (histogram != NULL);
 
+  gimp_drawable_histogram (drawable, histogram, TRUE);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_histogram (GimpDrawable  *drawable,
+                         GimpHistogram *histogram,
+                         gboolean       incremental)
+{
+  GimpImage   *image;
+  PixelRegion  region;
+  PixelRegion  mask;
+  gint         x, y, width, height;
+
   if (! gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &width, &height))
     return;
 
@@ -65,10 +96,17 @@ gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
       pixel_region_init (&mask,
                          gimp_drawable_get_tiles (GIMP_DRAWABLE (sel_mask)),
                          x + off_x, y + off_y, width, height, FALSE);
-      gimp_histogram_calculate (histogram, &region, &mask);
+
+      if (incremental)
+        gimp_histogram_calculate_incremental (histogram, &region, &mask);
+      else
+        gimp_histogram_calculate (histogram, &region, &mask);
     }
   else
     {
-      gimp_histogram_calculate (histogram, &region, NULL);
+      if (incremental)
+        gimp_histogram_calculate_incremental (histogram, &region, NULL);
+      else
+        gimp_histogram_calculate (histogram, &region, NULL);
     }
 }
@@ -23,6 +23,8 @@
 
 void   gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
                                           GimpHistogram *histogram);
+void   gimp_drawable_update_histogram    (GimpDrawable  *drawable,
+                                          GimpHistogram *histogram);
 
 
 #endif /* __GIMP_HISTOGRAM_H__ */
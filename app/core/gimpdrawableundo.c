@@ -17,17 +17,23 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
 
 #include "core-types.h"
 
+#include "base/tile.h"
+#include "base/tile-delta.h"
 #include "base/tile-manager.h"
+#include "base/tile-rle.h"
 
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
+#include "gimpundojournal.h"
 
 
 enum
@@ -60,6 +66,16 @@ static void     gimp_drawable_undo_pop          (GimpUndo            *undo,
                                                  GimpUndoAccumulator *accum);
 static void     gimp_drawable_undo_free         (GimpUndo            *undo,
                                                  GimpUndoMode         undo_mode);
+static gint64   gimp_drawable_undo_spill        (GimpUndo            *undo,
+                                                 GimpUndoJournal     *journal);
+static gboolean gimp_drawable_undo_unspill      (GimpUndo            *undo);
+
+static void          gimp_drawable_undo_make_deltas (GimpDrawableUndo *drawable_undo);
+static TileManager * gimp_drawable_undo_get_tiles   (GimpDrawableUndo *drawable_undo);
+static gint64        gimp_drawable_undo_get_data_memsize
+                                                    (GimpDrawableUndo *drawable_undo);
+static gboolean      gimp_drawable_undo_read_journal
+                                                    (GimpDrawableUndo *drawable_undo);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -82,6 +98,8 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
 
   undo_class->pop                = gimp_drawable_undo_pop;
   undo_class->free               = gimp_drawable_undo_free;
+  undo_class->spill              = gimp_drawable_undo_spill;
+  undo_class->unspill            = gimp_drawable_undo_unspill;
 
   g_object_class_install_property (object_class, PROP_TILES,
                                    g_param_spec_boxed ("tiles", NULL, NULL,
@@ -135,6 +153,9 @@ gimp_drawable_undo_constructed (GObject *object)
 
   g_assert (GIMP_IS_DRAWABLE (GIMP_ITEM_UNDO (object)->item));
   g_assert (drawable_undo->tiles != NULL);
+
+  if (drawable_undo->sparse)
+    gimp_drawable_undo_make_deltas (drawable_undo);
 }
 
 static void
@@ -214,8 +235,7 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += tile_manager_get_memsize (drawable_undo->tiles,
-                                       drawable_undo->sparse);
+  memsize += gimp_drawable_undo_get_data_memsize (drawable_undo);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -227,16 +247,27 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
                         GimpUndoAccumulator *accum)
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  TileManager      *tiles;
+
+  /*  gimp_image_undo_pop_stack() reads spilled data back before  */
+  g_return_if_fail (drawable_undo->journal == NULL);
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
+  if (drawable_undo->deltas)
+    tiles = gimp_drawable_undo_get_tiles (drawable_undo);
+  else
+    tiles = tile_manager_ref (drawable_undo->tiles);
+
   gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
-                             drawable_undo->tiles,
+                             tiles,
                              drawable_undo->sparse,
                              drawable_undo->x,
                              drawable_undo->y,
                              drawable_undo->width,
                              drawable_undo->height);
+
+  tile_manager_unref (tiles);
 }
 
 static void
@@ -251,6 +282,28 @@ gimp_drawable_undo_free (GimpUndo     *undo,
       drawable_undo->tiles = NULL;
     }
 
+  if (drawable_undo->deltas)
+    {
+      gint i;
+
+      for (i = 0; i < drawable_undo->n_deltas; i++)
+        if (drawable_undo->deltas[i])
+          tile_delta_free (drawable_undo->deltas[i]);
+
+      g_free (drawable_undo->deltas);
+      drawable_undo->deltas   = NULL;
+      drawable_undo->n_deltas = 0;
+    }
+
+  if (drawable_undo->journal)
+    {
+      gimp_undo_journal_release (drawable_undo->journal,
+                                 drawable_undo->journal_offset,
+                                 drawable_undo->journal_size);
+      gimp_undo_journal_unref (drawable_undo->journal);
+      drawable_undo->journal = NULL;
+    }
+
   if (drawable_undo->src2_tiles)
     {
       tile_manager_unref (drawable_undo->src2_tiles);
@@ -259,3 +312,410 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static void
+gimp_drawable_undo_append_int (GByteArray *data,
+                               gint32      value)
+{
+  g_byte_array_append (data, (const guint8 *) &value, sizeof (gint32));
+}
+
+static gboolean
+gimp_drawable_undo_read_int (const guchar **data,
+                             const guchar  *end,
+                             gint32        *value)
+{
+  if (*data + sizeof (gint32) > end)
+    return FALSE;
+
+  memcpy (value, *data, sizeof (gint32));
+  *data += sizeof (gint32);
+
+  return TRUE;
+}
+
+/*  Writes the deltas of sparse undo, or the run length encoded tiles
+ *  of other undo, to the journal and frees them.
+ */
+static gint64
+gimp_drawable_undo_spill (GimpUndo        *undo,
+                          GimpUndoJournal *journal)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  GByteArray       *data;
+  gint64            memsize;
+  gint64            offset;
+  gint              i;
+
+  if (drawable_undo->journal)
+    return 0;
+
+  data = g_byte_array_new ();
+
+  if (drawable_undo->deltas)
+    {
+      for (i = 0; i < drawable_undo->n_deltas; i++)
+        {
+          const guchar *delta_data;
+          gint          size;
+
+          if (! drawable_undo->deltas[i])
+            continue;
+
+          delta_data = tile_delta_get_data (drawable_undo->deltas[i], &size);
+
+          gimp_drawable_undo_append_int (data, i);
+          gimp_drawable_undo_append_int (data, size);
+          g_byte_array_append (data, delta_data, size);
+        }
+    }
+  else if (drawable_undo->tiles)
+    {
+      TileManager *tiles  = drawable_undo->tiles;
+      gint         n_cols = (tile_manager_width  (tiles) + TILE_WIDTH  - 1) /
+                            TILE_WIDTH;
+      gint         n_rows = (tile_manager_height (tiles) + TILE_HEIGHT - 1) /
+                            TILE_HEIGHT;
+      guchar      *rle    = g_malloc (TILE_WIDTH * TILE_HEIGHT *
+                                      tile_manager_bpp (tiles));
+      gint         row, col;
+
+      gimp_drawable_undo_append_int (data, tile_manager_width  (tiles));
+      gimp_drawable_undo_append_int (data, tile_manager_height (tiles));
+      gimp_drawable_undo_append_int (data, tile_manager_bpp    (tiles));
+
+      for (row = 0; row < n_rows; row++)
+        for (col = 0; col < n_cols; col++)
+          {
+            Tile *tile = tile_manager_get_at (tiles, col, row, TRUE, FALSE);
+            gint  size = tile_rle_encode (tile_data_pointer (tile, 0, 0),
+                                          tile_bpp (tile),
+                                          tile_ewidth (tile) *
+                                          tile_eheight (tile),
+                                          rle, tile_size (tile));
+
+            /*  a negative size means the tile is stored as it is  */
+            if (size > 0)
+              {
+                gimp_drawable_undo_append_int (data, size);
+                g_byte_array_append (data, rle, size);
+              }
+            else
+              {
+                gimp_drawable_undo_append_int (data, - tile_size (tile));
+                g_byte_array_append (data, tile_data_pointer (tile, 0, 0),
+                                     tile_size (tile));
+              }
+
+            tile_release (tile, FALSE);
+          }
+
+      g_free (rle);
+    }
+
+  if (data->len == 0)
+    {
+      g_byte_array_free (data, TRUE);
+      return 0;
+    }
+
+  offset = gimp_undo_journal_append (journal, data->data, data->len);
+
+  if (offset < 0)
+    {
+      g_byte_array_free (data, TRUE);
+      return 0;
+    }
+
+  memsize = gimp_drawable_undo_get_data_memsize (drawable_undo);
+
+  drawable_undo->journal        = gimp_undo_journal_ref (journal);
+  drawable_undo->journal_offset = offset;
+  drawable_undo->journal_size   = data->len;
+
+  g_byte_array_free (data, TRUE);
+
+  if (drawable_undo->deltas)
+    {
+      for (i = 0; i < drawable_undo->n_deltas; i++)
+        if (drawable_undo->deltas[i])
+          tile_delta_free (drawable_undo->deltas[i]);
+
+      g_free (drawable_undo->deltas);
+      drawable_undo->deltas = NULL;
+    }
+
+  if (drawable_undo->tiles)
+    {
+      tile_manager_unref (drawable_undo->tiles);
+      drawable_undo->tiles = NULL;
+    }
+
+  return memsize - gimp_drawable_undo_get_data_memsize (drawable_undo);
+}
+
+static gboolean
+gimp_drawable_undo_unspill (GimpUndo *undo)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+
+  if (! drawable_undo->journal)
+    return TRUE;
+
+  return gimp_drawable_undo_read_journal (drawable_undo);
+}
+
+/*  Reads the data written by gimp_drawable_undo_spill() back.  */
+static gboolean
+gimp_drawable_undo_read_journal (GimpDrawableUndo *drawable_undo)
+{
+  guchar       *data = g_malloc (drawable_undo->journal_size);
+  const guchar *end  = data + drawable_undo->journal_size;
+  const guchar *p    = data;
+  gboolean      success;
+
+  success = gimp_undo_journal_read (drawable_undo->journal,
+                                    drawable_undo->journal_offset,
+                                    data, drawable_undo->journal_size);
+
+  if (success && drawable_undo->sparse)
+    {
+      TileDelta **deltas = g_new0 (TileDelta *, drawable_undo->n_deltas);
+      gint32      index;
+      gint32      size;
+
+      while (success && p < end)
+        {
+          success = (gimp_drawable_undo_read_int (&p, end, &index) &&
+                     gimp_drawable_undo_read_int (&p, end, &size)  &&
+                     index >= 0 && index < drawable_undo->n_deltas &&
+                     size > 0 && p + size <= end);
+
+          if (success)
+            {
+              deltas[index] = tile_delta_new_from_data (p, size);
+              success = (deltas[index] != NULL);
+              p += size;
+            }
+        }
+
+      if (success)
+        {
+          drawable_undo->deltas = deltas;
+        }
+      else
+        {
+          gint i;
+
+          for (i = 0; i < drawable_undo->n_deltas; i++)
+            if (deltas[i])
+              tile_delta_free (deltas[i]);
+
+          g_free (deltas);
+        }
+    }
+  else if (success)
+    {
+      TileManager *tiles = NULL;
+      gint32       width, height, bpp;
+      gint         n_cols, n_rows;
+      gint         row, col;
+
+      success = (gimp_drawable_undo_read_int (&p, end, &width)  &&
+                 gimp_drawable_undo_read_int (&p, end, &height) &&
+                 gimp_drawable_undo_read_int (&p, end, &bpp)    &&
+                 width > 0 && height > 0 && bpp > 0 && bpp <= 4);
+
+      if (success)
+        tiles = tile_manager_new (width, height, bpp);
+
+      n_cols = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
+      n_rows = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+      for (row = 0; success && row < n_rows; row++)
+        for (col = 0; success && col < n_cols; col++)
+          {
+            Tile   *tile = tile_manager_get_at (tiles, col, row, TRUE, TRUE);
+            guchar *dest = tile_data_pointer (tile, 0, 0);
+            gint32  size;
+
+            success = gimp_drawable_undo_read_int (&p, end, &size);
+
+            if (success && size < 0)
+              {
+                success = (- size == tile_size (tile) && p - size <= end);
+
+                if (success)
+                  memcpy (dest, p, - size);
+
+                p -= size;
+              }
+            else if (success)
+              {
+                success = (p + size <= end &&
+                           tile_rle_decode (p, size, tile_bpp (tile),
+                                            tile_ewidth (tile) *
+                                            tile_eheight (tile),
+                                            dest));
+                p += size;
+              }
+
+            tile_release (tile, TRUE);
+          }
+
+      if (success)
+        drawable_undo->tiles = tiles;
+      else if (tiles)
+        tile_manager_unref (tiles);
+    }
+
+  g_free (data);
+
+  if (! success)
+    return FALSE;
+
+  gimp_undo_journal_release (drawable_undo->journal,
+                             drawable_undo->journal_offset,
+                             drawable_undo->journal_size);
+  gimp_undo_journal_unref (drawable_undo->journal);
+  drawable_undo->journal = NULL;
+
+  return TRUE;
+}
+
+static gint64
+gimp_drawable_undo_get_data_memsize (GimpDrawableUndo *drawable_undo)
+{
+  gint64 memsize = 0;
+
+  memsize += tile_manager_get_memsize (drawable_undo->tiles,
+                                       drawable_undo->sparse);
+
+  if (drawable_undo->deltas)
+    {
+      gint i;
+
+      memsize += drawable_undo->n_deltas * sizeof (TileDelta *);
+
+      for (i = 0; i < drawable_undo->n_deltas; i++)
+        memsize += tile_delta_get_memsize (drawable_undo->deltas[i]);
+    }
+
+  return memsize;
+}
+
+/*  Sparse undo tiles are pushed after the drawable was changed. Tiles
+ *  that are still shared with the drawable didn't change and are
+ *  dropped, the others are replaced by their delta to the drawable's
+ *  tile, which is usually a small fraction of the tile's size.
+ */
+static void
+gimp_drawable_undo_make_deltas (GimpDrawableUndo *drawable_undo)
+{
+  GimpItem    *item  = GIMP_ITEM_UNDO (drawable_undo)->item;
+  TileManager *tiles = gimp_drawable_get_tiles (GIMP_DRAWABLE (item));
+  gint         n_cols;
+  gint         i, j;
+
+  n_cols = (gimp_item_get_width  (item) + TILE_WIDTH  - 1) / TILE_WIDTH;
+
+  drawable_undo->n_deltas = n_cols * ((gimp_item_get_height (item) +
+                                       TILE_HEIGHT - 1) / TILE_HEIGHT);
+  drawable_undo->deltas   = g_new0 (TileDelta *, drawable_undo->n_deltas);
+
+  for (i = drawable_undo->y;
+       i < (drawable_undo->y + drawable_undo->height);
+       i += (TILE_HEIGHT - (i % TILE_HEIGHT)))
+    {
+      for (j = drawable_undo->x;
+           j < (drawable_undo->x + drawable_undo->width);
+           j += (TILE_WIDTH - (j % TILE_WIDTH)))
+        {
+          Tile *undo_tile;
+          Tile *tile;
+
+          undo_tile = tile_manager_get_tile (drawable_undo->tiles,
+                                             j, i, FALSE, FALSE);
+
+          if (! tile_is_valid (undo_tile))
+            continue;
+
+          tile = tile_manager_get_tile (tiles, j, i, FALSE, FALSE);
+
+          /*  still shared, so unchanged  */
+          if (tile == undo_tile)
+            continue;
+
+          undo_tile = tile_manager_get_tile (drawable_undo->tiles,
+                                             j, i, TRUE, FALSE);
+          tile = tile_manager_get_tile (tiles, j, i, TRUE, FALSE);
+
+          drawable_undo->deltas[(i / TILE_HEIGHT) * n_cols + j / TILE_WIDTH] =
+            tile_delta_new (undo_tile, tile);
+
+          tile_release (tile, FALSE);
+          tile_release (undo_tile, FALSE);
+        }
+    }
+
+  tile_manager_unref (drawable_undo->tiles);
+  drawable_undo->tiles = NULL;
+}
+
+/*  Returns sparse tiles holding the other version of each changed
+ *  tile of the drawable, ready to be swapped in.
+ */
+static TileManager *
+gimp_drawable_undo_get_tiles (GimpDrawableUndo *drawable_undo)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (GIMP_ITEM_UNDO (drawable_undo)->item);
+  TileManager  *src      = gimp_drawable_get_tiles (drawable);
+  TileManager  *tiles;
+  gint          n_cols;
+  gint          i, j;
+
+  tiles = tile_manager_new (tile_manager_width  (src),
+                            tile_manager_height (src),
+                            tile_manager_bpp    (src));
+
+  n_cols = (tile_manager_width (src) + TILE_WIDTH - 1) / TILE_WIDTH;
+
+  for (i = drawable_undo->y;
+       i < (drawable_undo->y + drawable_undo->height);
+       i += (TILE_HEIGHT - (i % TILE_HEIGHT)))
+    {
+      for (j = drawable_undo->x;
+           j < (drawable_undo->x + drawable_undo->width);
+           j += (TILE_WIDTH - (j % TILE_WIDTH)))
+        {
+          TileDelta *delta;
+          Tile      *src_tile;
+          Tile      *dest_tile;
+
+          delta = drawable_undo->deltas[(i / TILE_HEIGHT) * n_cols +
+                                        j / TILE_WIDTH];
+
+          if (! delta)
+            continue;
+
+          src_tile  = tile_manager_get_tile (src,   j, i, TRUE, FALSE);
+          dest_tile = tile_manager_get_tile (tiles, j, i, TRUE, TRUE);
+
+          if (! tile_delta_apply (delta, src_tile, dest_tile))
+            {
+              g_warning ("%s: drawable was changed without undo, "
+                         "tile at %d,%d can't be restored",
+                         G_STRFUNC, j, i);
+
+              memcpy (tile_data_pointer (dest_tile, 0, 0),
+                      tile_data_pointer (src_tile, 0, 0),
+                      tile_size (src_tile));
+            }
+
+          tile_release (dest_tile, TRUE);
+          tile_release (src_tile, FALSE);
+        }
+    }
+
+  return tiles;
+}
@@ -43,6 +43,15 @@ struct _GimpDrawableUndo
   gint          width;
   gint          height;
 
+  /* sparse undo keeps only the changed tiles, as deltas */
+  TileDelta   **deltas;
+  gint          n_deltas;
+
+  /* where tiles or deltas are while they are spilled to the journal */
+  GimpUndoJournal *journal;
+  gint64           journal_offset;
+  gsize            journal_size;
+
   /* stuff for "Fade" */
   TileManager          *src2_tiles;
   GimpLayerModeEffects  paint_mode;
@@ -50,6 +50,69 @@ typedef struct
   guchar               color[MAX_CHANNELS];
 } ContinuousRegionData;
 
+typedef struct
+{
+  GimpImage           *image;
+  GimpImageType        src_type;
+  gboolean             indexed;
+  gint                 bytes;
+  gint                 col_bytes;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gint                 threshold;
+  guchar               col[MAX_CHANNELS];
+} ContiguousFill;
+
+/*  the src and mask tiles the scanline fill is currently working on  */
+typedef struct
+{
+  TileManager *src;
+  TileManager *mask;
+  Tile        *s_tile;
+  Tile        *m_tile;
+  gint         tile_col;
+  gint         tile_row;
+} FillCache;
+
+typedef struct
+{
+  gint y;
+  gint x1;
+  gint x2;
+} FillSpan;
+
+/*  per-tile result of the first labeling pass: the (tile-local)
+ *  component labels along the tile's edges
+ */
+typedef struct
+{
+  guint16 n_labels;
+  guint16 seed;
+  guint16 left[TILE_HEIGHT];
+  guint16 right[TILE_HEIGHT];
+  guint16 top[TILE_WIDTH];
+  guint16 bottom[TILE_WIDTH];
+} FillTile;
+
+typedef struct
+{
+  ContiguousFill *fill;
+  gint            n_cols;
+  gint            seed_x;
+  gint            seed_y;
+  FillTile       *tiles;
+  guint32        *base;
+  guint8         *selected;
+} FillLabeling;
+
+
+/*  A seed whose region grows beyond this many pixels is finished by
+ *  labeling all tiles in parallel instead of by the scanline fill.
+ */
+#define FILL_SERIAL_MAX_PIXELS (64 * TILE_WIDTH * TILE_HEIGHT)
+
 
 /*  local function prototypes  */
 
@@ -65,42 +128,31 @@ static gint pixel_difference              (const guchar        *col1,
                                            gboolean             has_alpha,
                                            gboolean             select_transparent,
                                            GimpSelectCriterion  select_criterion);
-static void ref_tiles                     (TileManager         *src,
-                                           TileManager         *mask,
-                                           Tile               **s_tile,
-                                           Tile               **m_tile,
-                                           gint                 x,
-                                           gint                 y,
-                                           guchar             **s,
-                                           guchar             **m);
-static gboolean find_contiguous_segment   (GimpImage           *image,
-                                           const guchar        *col,
-                                           PixelRegion         *src,
-                                           PixelRegion         *mask,
-                                           gint                 width,
-                                           gint                 bytes,
-                                           GimpImageType        src_type,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gint                 threshold,
-                                           gint                 initial,
-                                           gint                *start,
-                                           gint                *end);
-static void find_contiguous_region_helper (GimpImage           *image,
-                                           PixelRegion         *mask,
-                                           PixelRegion         *src,
-                                           GimpImageType        src_type,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gint                 threshold,
-                                           gint                 x,
-                                           gint                 y,
-                                           const guchar        *col);
-
+static guchar   contiguous_fill_difference (const ContiguousFill *fill,
+                                            const guchar         *s);
+static void     contiguous_fill            (ContiguousFill       *fill,
+                                            TileManager          *src,
+                                            TileManager          *mask,
+                                            gint                  x,
+                                            gint                  y);
+static gboolean contiguous_fill_scanline   (ContiguousFill       *fill,
+                                            TileManager          *src,
+                                            TileManager          *mask,
+                                            gint                  x,
+                                            gint                  y,
+                                            gint                  max_pixels);
+static void     contiguous_fill_labeled    (ContiguousFill       *fill,
+                                            TileManager          *src,
+                                            TileManager          *mask,
+                                            gint                  x,
+                                            gint                  y);
+static void     fill_label_tile            (FillLabeling         *labeling,
+                                            PixelRegion          *srcPR,
+                                            PixelRegion          *maskPR);
+static void     fill_select_tile           (FillLabeling         *labeling,
+                                            PixelRegion          *maskPR);
+static gint     fill_label_region          (const PixelRegion    *maskPR,
+                                            guint16              *labels);
 
 /*  public functions  */
 
@@ -155,8 +207,8 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
   tile = tile_manager_get_tile (srcPR.tiles, x, y, TRUE, FALSE);
   if (tile)
     {
-      const guchar *start;
-      guchar        start_col[MAX_CHANNELS];
+      ContiguousFill  fill;
+      const guchar   *start;
 
       start = tile_data_pointer (tile, x, y);
 
@@ -176,25 +228,34 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
           select_transparent = FALSE;
         }
 
-      if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
+      fill.image              = image;
+      fill.src_type           = src_type;
+      fill.indexed            = GIMP_IMAGE_TYPE_IS_INDEXED (src_type);
+      fill.bytes              = bytes;
+      fill.col_bytes          = bytes;
+      fill.has_alpha          = has_alpha;
+      fill.select_transparent = select_transparent;
+      fill.select_criterion   = select_criterion;
+      fill.antialias          = antialias;
+      fill.threshold          = threshold;
+
+      if (fill.indexed)
         {
-          gimp_image_get_color (image, src_type, start, start_col);
+          gimp_image_get_color (image, src_type, start, fill.col);
+
+          fill.col_bytes = has_alpha ? 4 : 3;
         }
       else
         {
           gint i;
 
           for (i = 0; i < bytes; i++)
-            start_col[i] = start[i];
+            fill.col[i] = start[i];
         }
 
-      find_contiguous_region_helper (image, &maskPR, &srcPR,
-                                     src_type, has_alpha,
-                                     select_transparent, select_criterion,
-                                     antialias, threshold,
-                                     x, y, start_col);
-
       tile_release (tile, FALSE);
+
+      contiguous_fill (&fill, srcPR.tiles, maskPR.tiles, x, y);
     }
 
   return mask;
@@ -444,225 +505,500 @@ pixel_difference (const guchar        *col1,
     }
 }
 
-static void
-ref_tiles (TileManager  *src,
-           TileManager  *mask,
-           Tile        **s_tile,
-           Tile        **m_tile,
-           gint          x,
-           gint          y,
-           guchar      **s,
-           guchar      **m)
+static inline guchar
+contiguous_fill_difference (const ContiguousFill *fill,
+                            const guchar         *s)
 {
-  if (*s_tile != NULL)
-    tile_release (*s_tile, FALSE);
-  if (*m_tile != NULL)
-    tile_release (*m_tile, TRUE);
+  guchar s_color[MAX_CHANNELS];
 
-  *s_tile = tile_manager_get_tile (src, x, y, TRUE, FALSE);
-  *m_tile = tile_manager_get_tile (mask, x, y, TRUE, TRUE);
+  if (fill->indexed)
+    {
+      gimp_image_get_color (fill->image, fill->src_type, s, s_color);
+      s = s_color;
+    }
 
-  *s = tile_data_pointer (*s_tile, x, y);
-  *m = tile_data_pointer (*m_tile, x, y);
+  return pixel_difference (fill->col, s,
+                           fill->antialias, fill->threshold,
+                           fill->col_bytes, fill->has_alpha,
+                           fill->select_transparent, fill->select_criterion);
 }
 
-static gboolean
-find_contiguous_segment (GimpImage           *image,
-                         const guchar        *col,
-                         PixelRegion         *src,
-                         PixelRegion         *mask,
-                         gint                 width,
-                         gint                 bytes,
-                         GimpImageType        src_type,
-                         gboolean             has_alpha,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gint                 threshold,
-                         gint                 initial,
-                         gint                *start,
-                         gint                *end)
+static void
+contiguous_fill (ContiguousFill *fill,
+                 TileManager    *src,
+                 TileManager    *mask,
+                 gint            x,
+                 gint            y)
 {
-  guchar *s;
-  guchar *m;
-  guchar  s_color[MAX_CHANNELS];
-  guchar  diff;
-  gint    col_bytes = bytes;
-  Tile   *s_tile    = NULL;
-  Tile   *m_tile    = NULL;
-
-  ref_tiles (src->tiles, mask->tiles,
-             &s_tile, &m_tile, src->x, src->y, &s, &m);
-
-  if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
+  if (! contiguous_fill_scanline (fill, src, mask, x, y,
+                                  FILL_SERIAL_MAX_PIXELS))
     {
-      col_bytes = has_alpha ? 4 : 3;
+      /*  the region is huge, throw away the partial result and label
+       *  the whole drawable tile by tile instead
+       */
+      contiguous_fill_labeled (fill, src, mask, x, y);
+    }
+}
 
-      gimp_image_get_color (image, src_type, s, s_color);
 
-      diff = pixel_difference (col, s_color, antialias, threshold,
-                               col_bytes, has_alpha, select_transparent,
-                               select_criterion);
-     }
-  else
-    {
-      diff = pixel_difference (col, s, antialias, threshold,
-                               col_bytes, has_alpha, select_transparent,
-                               select_criterion);
-    }
+/*  scanline fill  */
 
-  /* check the starting pixel */
-  if (! diff)
+static inline void
+fill_cache_ref (FillCache  *cache,
+                gint        x,
+                gint        y,
+                guchar    **s,
+                guchar    **m)
+{
+  const gint col = x / TILE_WIDTH;
+  const gint row = y / TILE_HEIGHT;
+
+  if (col != cache->tile_col || row != cache->tile_row)
     {
-      tile_release (s_tile, FALSE);
-      tile_release (m_tile, TRUE);
-      return FALSE;
+      if (cache->s_tile)
+        tile_release (cache->s_tile, FALSE);
+      if (cache->m_tile)
+        tile_release (cache->m_tile, TRUE);
+
+      cache->s_tile   = tile_manager_get_tile (cache->src,  x, y, TRUE, FALSE);
+      cache->m_tile   = tile_manager_get_tile (cache->mask, x, y, TRUE, TRUE);
+      cache->tile_col = col;
+      cache->tile_row = row;
     }
 
-  *m-- = diff;
-  s -= bytes;
-  *start = initial - 1;
+  *s = tile_data_pointer (cache->s_tile, x, y);
+  *m = tile_data_pointer (cache->m_tile, x, y);
+}
 
-  while (*start >= 0 && diff)
+/*  fills leftwards from x - 1 and returns the first filled column  */
+static gint
+fill_extend_left (ContiguousFill *fill,
+                  FillCache      *cache,
+                  gint            x,
+                  gint            y)
+{
+  while (x > 0)
     {
-      if (! ((*start + 1) % TILE_WIDTH))
-        ref_tiles (src->tiles, mask->tiles,
-                   &s_tile, &m_tile, *start, src->y, &s, &m);
+      const gint  first = (x - 1) - (x - 1) % TILE_WIDTH;
+      guchar     *s;
+      guchar     *m;
+      gint        i;
 
-      if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
-        {
-          gimp_image_get_color (image, src_type, s, s_color);
+      fill_cache_ref (cache, x - 1, y, &s, &m);
 
-          diff = pixel_difference (col, s_color, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
-      else
+      for (i = x - 1; i >= first; i--, s -= fill->bytes, m--)
         {
-          diff = pixel_difference (col, s, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
+          guchar diff;
+
+          if (*m)
+            return i + 1;
+
+          diff = contiguous_fill_difference (fill, s);
+
+          if (! diff)
+            return i + 1;
+
+          *m = diff;
         }
 
-      if ((*m-- = diff))
+      x = first;
+    }
+
+  return 0;
+}
+
+/*  fills rightwards from x and returns one past the last filled column  */
+static gint
+fill_extend_right (ContiguousFill *fill,
+                   FillCache      *cache,
+                   gint            x,
+                   gint            y,
+                   gint            width)
+{
+  while (x < width)
+    {
+      const gint  last = MIN (x - x % TILE_WIDTH + TILE_WIDTH, width);
+      guchar     *s;
+      guchar     *m;
+      gint        i;
+
+      fill_cache_ref (cache, x, y, &s, &m);
+
+      for (i = x; i < last; i++, s += fill->bytes, m++)
         {
-          s -= bytes;
-          (*start)--;
+          guchar diff;
+
+          if (*m)
+            return i;
+
+          diff = contiguous_fill_difference (fill, s);
+
+          if (! diff)
+            return i;
+
+          *m = diff;
         }
+
+      x = last;
     }
 
-  diff = 1;
-  *end = initial + 1;
+  return width;
+}
 
-  if (*end % TILE_WIDTH && *end < width)
-    ref_tiles (src->tiles, mask->tiles,
-               &s_tile, &m_tile, *end, src->y, &s, &m);
+/*  Iterative span fill.  Pending (row, x1, x2) spans live on an
+ *  explicit stack, and pixels are visited a tile row at a time
+ *  through the cached tiles.  Returns FALSE if more than max_pixels
+ *  were filled before the region was complete.
+ */
+static gboolean
+contiguous_fill_scanline (ContiguousFill *fill,
+                          TileManager    *src,
+                          TileManager    *mask,
+                          gint            x,
+                          gint            y,
+                          gint            max_pixels)
+{
+  FillCache  cache    = { src, mask, NULL, NULL, -1, -1 };
+  const gint width    = tile_manager_width  (src);
+  const gint height   = tile_manager_height (src);
+  GArray    *stack    = g_array_new (FALSE, FALSE, sizeof (FillSpan));
+  gint       n_pixels = 0;
+  gboolean   complete = TRUE;
+  FillSpan   span     = { y, x, x + 1 };
+
+  g_array_append_val (stack, span);
 
-  while (*end < width && diff)
+  while (complete && stack->len > 0)
     {
-      if (! (*end % TILE_WIDTH))
-        ref_tiles (src->tiles, mask->tiles,
-                   &s_tile, &m_tile, *end, src->y, &s, &m);
+      span = g_array_index (stack, FillSpan, stack->len - 1);
+      g_array_set_size (stack, stack->len - 1);
 
-      if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
+      for (x = span.x1; x < span.x2; x++)
         {
-          gimp_image_get_color (image, src_type, s, s_color);
+          FillSpan  next;
+          guchar   *s;
+          guchar   *m;
+          guchar    diff;
 
-          diff = pixel_difference (col, s_color, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
-      else
-        {
-          diff = pixel_difference (col, s, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
+          fill_cache_ref (&cache, x, span.y, &s, &m);
 
-      if ((*m++ = diff))
-        {
-          s += bytes;
-          (*end)++;
+          if (*m)
+            continue;
+
+          diff = contiguous_fill_difference (fill, s);
+
+          if (! diff)
+            continue;
+
+          *m = diff;
+
+          next.x1 = fill_extend_left  (fill, &cache, x, span.y);
+          next.x2 = fill_extend_right (fill, &cache, x + 1, span.y, width);
+
+          if (span.y + 1 < height)
+            {
+              next.y = span.y + 1;
+              g_array_append_val (stack, next);
+            }
+
+          if (span.y > 0)
+            {
+              next.y = span.y - 1;
+              g_array_append_val (stack, next);
+            }
+
+          n_pixels += next.x2 - next.x1;
+
+          if (max_pixels > 0 && n_pixels > max_pixels)
+            {
+              complete = FALSE;
+              break;
+            }
+
+          /*  the pixel at next.x2 ended the segment, skip it  */
+          x = next.x2;
         }
     }
 
-  tile_release (s_tile, FALSE);
-  tile_release (m_tile, TRUE);
+  if (cache.s_tile)
+    tile_release (cache.s_tile, FALSE);
+  if (cache.m_tile)
+    tile_release (cache.m_tile, TRUE);
+
+  g_array_free (stack, TRUE);
 
-  return TRUE;
+  return complete;
 }
 
+
+/*  parallel labeling  */
+
+static inline guint32
+fill_find (guint32 *parent,
+           guint32  label)
+{
+  while (parent[label] != label)
+    {
+      parent[label] = parent[parent[label]];
+      label = parent[label];
+    }
+
+  return label;
+}
+
+static inline void
+fill_union (guint32 *parent,
+            guint32  a,
+            guint32  b)
+{
+  a = fill_find (parent, a);
+  b = fill_find (parent, b);
+
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+/*  The drawable is labeled in three passes: every tile computes the
+ *  pixel differences into the mask and labels its own connected
+ *  components (in parallel), the components are merged across tile
+ *  edges with a union-find over the edge labels, and finally every
+ *  tile clears the pixels that are not in the seed's component (in
+ *  parallel again).
+ */
 static void
-find_contiguous_region_helper (GimpImage           *image,
-                               PixelRegion         *mask,
-                               PixelRegion         *src,
-                               GimpImageType        src_type,
-                               gboolean             has_alpha,
-                               gboolean             select_transparent,
-                               GimpSelectCriterion  select_criterion,
-                               gboolean             antialias,
-                               gint                 threshold,
-                               gint                 x,
-                               gint                 y,
-                               const guchar        *col)
+contiguous_fill_labeled (ContiguousFill *fill,
+                         TileManager    *src,
+                         TileManager    *mask,
+                         gint            x,
+                         gint            y)
+{
+  FillLabeling  labeling;
+  PixelRegion   srcPR;
+  PixelRegion   maskPR;
+  const gint    width   = tile_manager_width  (src);
+  const gint    height  = tile_manager_height (src);
+  const gint    n_cols  = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
+  const gint    n_rows  = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+  const gint    n_tiles = n_cols * n_rows;
+  guint32      *parent;
+  guint32       n_labels;
+  guint32       seed;
+  guint32       label;
+  gint          col, row, i;
+
+  labeling.fill     = fill;
+  labeling.n_cols   = n_cols;
+  labeling.seed_x   = x;
+  labeling.seed_y   = y;
+  labeling.tiles    = g_new0 (FillTile, n_tiles);
+  labeling.base     = g_new (guint32, n_tiles);
+  labeling.selected = NULL;
+
+  pixel_region_init (&srcPR,  src,  0, 0, width, height, FALSE);
+  pixel_region_init (&maskPR, mask, 0, 0, width, height, TRUE);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc) fill_label_tile,
+                                  &labeling, 2, &srcPR, &maskPR);
+
+  /*  label 0 is the background, tile labels follow each other  */
+  n_labels = 1;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      labeling.base[i] = n_labels - 1;
+      n_labels += labeling.tiles[i].n_labels;
+    }
+
+  parent = g_new (guint32, n_labels);
+
+  for (label = 0; label < n_labels; label++)
+    parent[label] = label;
+
+  for (row = 0; row < n_rows; row++)
+    for (col = 0; col < n_cols; col++)
+      {
+        const gint      t    = row * n_cols + col;
+        const FillTile *tile = &labeling.tiles[t];
+
+        if (col + 1 < n_cols)
+          {
+            const FillTile *next = &labeling.tiles[t + 1];
+
+            for (i = 0; i < TILE_HEIGHT; i++)
+              if (tile->right[i] && next->left[i])
+                fill_union (parent,
+                            labeling.base[t]     + tile->right[i],
+                            labeling.base[t + 1] + next->left[i]);
+          }
+
+        if (row + 1 < n_rows)
+          {
+            const FillTile *next = &labeling.tiles[t + n_cols];
+
+            for (i = 0; i < TILE_WIDTH; i++)
+              if (tile->bottom[i] && next->top[i])
+                fill_union (parent,
+                            labeling.base[t]          + tile->bottom[i],
+                            labeling.base[t + n_cols] + next->top[i]);
+          }
+      }
+
+  i    = (y / TILE_HEIGHT) * n_cols + x / TILE_WIDTH;
+  seed = labeling.tiles[i].seed;
+
+  if (seed)
+    seed = fill_find (parent, labeling.base[i] + seed);
+
+  labeling.selected = g_new (guint8, n_labels);
+  labeling.selected[0] = FALSE;
+
+  for (label = 1; label < n_labels; label++)
+    labeling.selected[label] = (seed && fill_find (parent, label) == seed);
+
+  g_free (parent);
+
+  pixel_region_init (&maskPR, mask, 0, 0, width, height, TRUE);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc) fill_select_tile,
+                                  &labeling, 1, &maskPR);
+
+  g_free (labeling.selected);
+  g_free (labeling.base);
+  g_free (labeling.tiles);
+}
+
+static FillTile *
+fill_labeling_get_tile (FillLabeling      *labeling,
+                        const PixelRegion *region)
 {
-  gint    start, end;
-  gint    new_start, new_end;
-  gint    val;
-  Tile   *tile;
-  GQueue *coord_stack;
-
-  coord_stack = g_queue_new ();
-
-  /* To avoid excessive memory allocation (y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [start1] [end1] [y2] [start2] [end2]
+  return &labeling->tiles[(region->y / TILE_HEIGHT) * labeling->n_cols +
+                          region->x / TILE_WIDTH];
+}
+
+static void
+fill_label_tile (FillLabeling *labeling,
+                 PixelRegion  *srcPR,
+                 PixelRegion  *maskPR)
+{
+  FillTile     *tile = fill_labeling_get_tile (labeling, maskPR);
+  const guchar *src  = srcPR->data;
+  guchar       *mask = maskPR->data;
+  guint16       labels[TILE_WIDTH * TILE_HEIGHT];
+  gint          x, y;
+
+  for (y = 0; y < srcPR->h; y++)
+    {
+      const guchar *s = src;
+
+      for (x = 0; x < srcPR->w; x++, s += srcPR->bytes)
+        mask[x] = contiguous_fill_difference (labeling->fill, s);
+
+      src  += srcPR->rowstride;
+      mask += maskPR->rowstride;
+    }
+
+  tile->n_labels = fill_label_region (maskPR, labels);
+
+  for (y = 0; y < maskPR->h; y++)
+    {
+      tile->left[y]  = labels[y * maskPR->w];
+      tile->right[y] = labels[y * maskPR->w + maskPR->w - 1];
+    }
+
+  for (x = 0; x < maskPR->w; x++)
+    {
+      tile->top[x]    = labels[x];
+      tile->bottom[x] = labels[(maskPR->h - 1) * maskPR->w + x];
+    }
+
+  x = labeling->seed_x - maskPR->x;
+  y = labeling->seed_y - maskPR->y;
+
+  if (x >= 0 && x < maskPR->w && y >= 0 && y < maskPR->h)
+    tile->seed = labels[y * maskPR->w + x];
+}
+
+static void
+fill_select_tile (FillLabeling *labeling,
+                  PixelRegion  *maskPR)
+{
+  const FillTile *tile = fill_labeling_get_tile (labeling, maskPR);
+  const guint32   base = labeling->base[tile - labeling->tiles];
+  guchar         *mask = maskPR->data;
+  guint16         labels[TILE_WIDTH * TILE_HEIGHT];
+  const guint16  *l    = labels;
+  gint            x, y;
+
+  /*  the labels are a function of the mask alone, so this reproduces
+   *  the ones of the first pass
    */
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (y));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x - 1));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x + 1));
+  fill_label_region (maskPR, labels);
 
-  do
+  for (y = 0; y < maskPR->h; y++)
     {
-      y     = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      start = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      end   = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
+      for (x = 0; x < maskPR->w; x++, l++)
+        if (! *l || ! labeling->selected[base + *l])
+          mask[x] = 0;
 
-      for (x = start + 1; x < end; x++)
-        {
-          tile = tile_manager_get_tile (mask->tiles, x, y, TRUE, FALSE);
-          val = *(const guchar *) tile_data_pointer (tile, x, y);
-          tile_release (tile, FALSE);
-          if (val != 0)
-            continue;
+      mask += maskPR->rowstride;
+    }
+}
 
-          src->x = x;
-          src->y = y;
+/*  Labels the 4-connected components of the non-zero pixels of a
+ *  tile-sized mask region.  Every pixel gets the smallest label of
+ *  its component, 0 for background.  Returns the number of labels
+ *  handed out.
+ */
+static gint
+fill_label_region (const PixelRegion *maskPR,
+                   guint16           *labels)
+{
+  guint32       parent[TILE_WIDTH * TILE_HEIGHT + 1];
+  const guchar *mask     = maskPR->data;
+  const gint    w        = maskPR->w;
+  gint          n_labels = 0;
+  gint          x, y, i;
 
-          if (! find_contiguous_segment (image, col, src, mask, src->w,
-                                         src->bytes, src_type, has_alpha,
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x,
-                                         &new_start, &new_end))
-            continue;
+  parent[0] = 0;
+
+  for (y = 0; y < maskPR->h; y++)
+    {
+      guint16 *l = labels + y * w;
+
+      for (x = 0; x < w; x++)
+        {
+          const guint16 left = (x > 0) ? l[x - 1] : 0;
+          const guint16 up   = (y > 0) ? l[x - w] : 0;
 
-          if (y + 1 < src->h)
+          if (! mask[x])
             {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y + 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
+              l[x] = 0;
             }
-
-          if (y - 1 >= 0)
+          else if (left && up)
+            {
+              fill_union (parent, left, up);
+              l[x] = MIN (left, up);
+            }
+          else if (left || up)
             {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y - 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
+              l[x] = left ? left : up;
+            }
+          else
+            {
+              n_labels++;
+              parent[n_labels] = n_labels;
+              l[x] = n_labels;
             }
         }
+
+      mask += maskPR->rowstride;
     }
-  while (! g_queue_is_empty (coord_stack));
 
-  g_queue_free (coord_stack);
+  for (i = 0; i < w * maskPR->h; i++)
+    if (labels[i])
+      labels[i] = fill_find (parent, labels[i]);
+
+  return n_labels;
 }
@@ -135,12 +135,18 @@
 #include <cairo.h>
 #include <gegl.h>
 
+#if defined (USE_SSE) && defined (__SSE2__)
+#define USE_SSE2_CONVERT
+#include <emmintrin.h>
+#endif
+
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
 #include "base/cpercep.h"
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
 #include "base/tile-manager.h"
 
@@ -479,6 +485,9 @@ struct _QuantizeObj
   int actual_number_of_colors;      /* Number of colors actually needed  */
   Color cmap[256];                  /* colormap created by quantization  */
   Color clin[256];                  /* .. converted back to linear space */
+  int   lin_red[256];               /* .. and scaled for distance search */
+  int   lin_green[256];
+  int   lin_blue[256];
   gulong index_used_count[256];     /* how many times an index was used */
   CFHistogram histogram;            /* holds the histogram               */
 
@@ -516,6 +525,49 @@ typedef struct
 } box, *boxptr;
 
 
+#ifdef ENABLE_MP
+#define NUM_SLOTS  (GIMP_MAX_NUM_THREADS + 1)  /* the workers and the caller */
+#else
+#define NUM_SLOTS  1
+#endif
+
+/*  state of the parallel histogram of one layer; every concurrent
+ *  caller counts into its own partial histogram, they are added up
+ *  at the end
+ */
+typedef struct
+{
+  gboolean       has_alpha;
+  gboolean       alpha_dither;
+  gint           offsetx;
+  gint           offsety;
+  GimpProgress  *progress;
+  gint           nth_layer;
+  gint           n_layers;
+#ifdef ENABLE_MP
+  volatile gint  busy[NUM_SLOTS];
+#endif
+  guint32       *partials[NUM_SLOTS];
+} HistogramData;
+
+/*  state of the parallel, non-dithered remapping of one layer  */
+typedef struct
+{
+  QuantizeObj   *quantobj;
+  gint           red_pix;
+  gint           green_pix;
+  gint           blue_pix;
+  gint           alpha_pix;
+  gboolean       has_alpha;
+  gboolean       alpha_dither;
+  gint           offsetx;
+  gint           offsety;
+#ifdef ENABLE_MP
+  GMutex        *mutex;
+#endif
+} RemapData;
+
+
 static void zero_histogram_gray     (CFHistogram   histogram);
 static void zero_histogram_rgb      (CFHistogram   histogram);
 static void generate_histogram_gray (CFHistogram   hostogram,
@@ -528,6 +580,17 @@ static void generate_histogram_rgb  (CFHistogram   histogram,
                                      GimpProgress *progress,
                                      gint          nth_layer,
                                      gint          n_layers);
+static void generate_histogram_rgb_sub_region
+                                    (HistogramData *data,
+                                     PixelRegion   *srcPR);
+static void generate_histogram_rgb_progress
+                                    (HistogramData *data,
+                                     gdouble        fraction);
+static gint count_histogram_cells_rgb
+                                    (CFHistogram   histogram);
+static void find_colors_rgb         (GimpLayer    *layer,
+                                     gint          col_limit,
+                                     gboolean      alpha_dither);
 
 static QuantizeObj * initialize_median_cut (GimpImageBaseType      old_type,
                                             gint                   num_cols,
@@ -1172,197 +1235,257 @@ generate_histogram_rgb (CFHistogram   histogram,
                         GimpProgress *progress,
                         gint          nth_layer,
                         gint          n_layers)
+{
+  HistogramData data = { 0, };
+  PixelRegion   srcPR;
+  gint          i, j;
+
+  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+
+  data.has_alpha    = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+  data.alpha_dither = alpha_dither;
+  data.progress     = progress;
+  data.nth_layer    = nth_layer;
+  data.n_layers     = n_layers;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
+
+  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
+                     0, 0,
+                     gimp_item_get_width  (GIMP_ITEM (layer)),
+                     gimp_item_get_height (GIMP_ITEM (layer)),
+                     FALSE);
+
+  if (progress)
+    gimp_progress_set_value (progress, 0.0);
+
+  pixel_regions_process_parallel_progress ((PixelProcessorFunc)
+                                           generate_histogram_rgb_sub_region,
+                                           &data,
+                                           progress ?
+                                           (PixelProcessorProgressFunc)
+                                           generate_histogram_rgb_progress :
+                                           NULL,
+                                           &data,
+                                           1, &srcPR);
+
+  for (i = 0; i < NUM_SLOTS; i++)
+    if (data.partials[i])
+      {
+        const guint32 *partial = data.partials[i];
+
+        for (j = 0; j < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; j++)
+          histogram[j] += partial[j];
+
+        g_free (data.partials[i]);
+      }
+
+  if (! needs_quantize)
+    {
+      /*  every histogram cell holds at least one distinct colour, so
+       *  there is no need to look for the exact colours if there are
+       *  more cells in use than colours allowed
+       */
+      if (count_histogram_cells_rgb (histogram) > col_limit)
+        needs_quantize = TRUE;
+      else
+        find_colors_rgb (layer, col_limit, alpha_dither);
+    }
+
+/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+}
+
+static void
+generate_histogram_rgb_sub_region (HistogramData *data,
+                                   PixelRegion   *srcPR)
+{
+  const guchar *src  = srcPR->data;
+  guint32      *partial;
+  gint          slot = 0;
+  gint          row, col;
+
+#ifdef ENABLE_MP
+  /*  there are never more concurrent callers than slots  */
+  while (! g_atomic_int_compare_and_exchange (&data->busy[slot], 0, 1))
+    slot = (slot + 1) % NUM_SLOTS;
+#endif
+
+  if (! data->partials[slot])
+    data->partials[slot] = g_new0 (guint32,
+                                   HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
+
+  partial = data->partials[slot];
+
+  for (row = 0; row < srcPR->h; row++)
+    {
+      const guchar *data_row = src;
+
+      for (col = 0; col < srcPR->w; col++, data_row += srcPR->bytes)
+        {
+          gint R, G, B;
+
+          if (data->has_alpha)
+            {
+              if (data->alpha_dither)
+                {
+                  /* if alpha-dithering,
+                     we need to be deterministic w.r.t. offsets */
+                  gint dither_x = (col + data->offsetx + srcPR->x) & DM_WIDTHMASK;
+                  gint dither_y = (row + data->offsety + srcPR->y) & DM_HEIGHTMASK;
+
+                  if (data_row[ALPHA] < DM[dither_x][dither_y])
+                    continue;
+                }
+              else if (data_row[ALPHA] <= 127)
+                {
+                  continue;
+                }
+            }
+
+          rgb_to_lin (data_row[RED], data_row[GREEN], data_row[BLUE],
+                      &R, &G, &B);
+
+          partial[REF_FUNC (R, G, B)]++;
+        }
+
+      src += srcPR->rowstride;
+    }
+
+#ifdef ENABLE_MP
+  g_atomic_int_set (&data->busy[slot], 0);
+#endif
+}
+
+static void
+generate_histogram_rgb_progress (HistogramData *data,
+                                 gdouble        fraction)
+{
+  gimp_progress_set_value (data->progress,
+                           (data->nth_layer + fraction) /
+                           (gdouble) data->n_layers);
+}
+
+static gint
+count_histogram_cells_rgb (CFHistogram histogram)
+{
+  gint n_cells = 0;
+  gint i;
+
+  for (i = 0; i < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; i++)
+    if (histogram[i])
+      n_cells++;
+
+  return n_cells;
+}
+
+/*  collects the distinct colours of a layer in found_cols, switches
+ *  to quantizing as soon as there are more than col_limit of them
+ */
+static void
+find_colors_rgb (GimpLayer *layer,
+                 gint       col_limit,
+                 gboolean   alpha_dither)
 {
   PixelRegion  srcPR;
   gpointer     pr;
-  ColorFreq   *colfreq;
   gint         nfc_iter;
   gint         row, col, coledge;
   gint         offsetx, offsety;
-  glong        layer_size;
-  glong        total_size = 0;
-  gint         count      = 0;
-  gboolean     has_alpha  = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+  gboolean     has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
 
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
-
   pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
                      0, 0,
                      gimp_item_get_width  (GIMP_ITEM (layer)),
                      gimp_item_get_height (GIMP_ITEM (layer)),
                      FALSE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
-  if (progress)
-    gimp_progress_set_value (progress, 0.0);
-
   for (pr = pixel_regions_register (1, &srcPR);
        pr != NULL;
-       pr = pixel_regions_process (pr), count++)
+       pr = pixel_regions_process (pr))
     {
       const guchar *data = srcPR.data;
       gint          size = srcPR.w * srcPR.h;
 
-      total_size += size;
-
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, srcPR.y, offsetx, offsety); */
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      col = srcPR.x + offsetx;
+      coledge = col + srcPR.w;
+      row = srcPR.y + offsety;
 
-      if (needs_quantize)
+      while (size--)
         {
-          if (alpha_dither)
-            {
-              /* if alpha-dithering,
-                 we need to be deterministic w.r.t. offsets */
+          gboolean transparent = FALSE;
 
-              col = srcPR.x + offsetx;
-              coledge = col + srcPR.w;
-              row = srcPR.y + offsety;
-
-              while (size--)
+          if (has_alpha)
+            {
+              if (alpha_dither)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (data[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
-
-                  if (! transparent)
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
-
-                  col++;
-                  if (col == coledge)
-                    {
-                      col = srcPR.x + offsetx;
-                      row++;
-                    }
-
-                  data += srcPR.bytes;
                 }
-            }
-          else
-            {
-              while (size--)
+              else
                 {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
-                  data += srcPR.bytes;
+                  if (data[ALPHA] <= 127)
+                    transparent = TRUE;
                 }
             }
-        }
-      else
-        {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = srcPR.x + offsetx;
-          coledge = col + srcPR.w;
-          row = srcPR.y + offsety;
 
-          while (size--)
+          if (! transparent)
             {
-	      gboolean transparent = FALSE;
-
-	      if (has_alpha)
-	        {
-		  if (alpha_dither)
-		    {
-		      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-		  	transparent = TRUE;
-		    }
-		  else
-		    {
-		      if (data[ALPHA] <= 127)
-			transparent = TRUE;
-		    }
-		}
-	      if (! transparent)
+              for (nfc_iter = 0;
+                   nfc_iter < num_found_cols;
+                   nfc_iter++)
                 {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
-
-                  if (!needs_quantize)
-                    {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if (
-                              (data[RED] == found_cols[nfc_iter][0])
-                              &&
-                              (data[GREEN] == found_cols[nfc_iter][1])
-                              &&
-                              (data[BLUE] == found_cols[nfc_iter][2])
-                              )
-                            goto already_found;
-                        }
+                  if (
+                      (data[RED] == found_cols[nfc_iter][0])
+                      &&
+                      (data[GREEN] == found_cols[nfc_iter][1])
+                      &&
+                      (data[BLUE] == found_cols[nfc_iter][2])
+                      )
+                    goto already_found;
+                }
 
-                      /* Colour was not in the table of
-                       * existing colours
-                       */
+              /* Colour was not in the table of
+               * existing colours
+               */
 
-                      num_found_cols++;
+              num_found_cols++;
 
-                      if (num_found_cols > col_limit)
-                        {
-                          /* There are more colours in the image
-                           *  than were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
-                           */
-                          needs_quantize = TRUE;
-                          /*                      g_print ("\nmax colours exceeded - needs quantize.\n");*/
-                          goto already_found;
-                        }
-                      else
-                        {
-                          /* Remember the new colour we just found.
-                           */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
-                        }
-                    }
+              if (num_found_cols > col_limit)
+                {
+                  /* There are more colours in the image
+                   *  than were allowed.  We switch to plain
+                   *  histogram calculation with a view to
+                   *  quantizing at a later stage.
+                   */
+                  needs_quantize = TRUE;
+                  pixel_regions_process_stop (pr);
+                  return;
                 }
-            already_found:
-
-              col++;
-              if (col == coledge)
+              else
                 {
-                  col = srcPR.x + offsetx;
-                  row++;
+                  /* Remember the new colour we just found.
+                   */
+                  found_cols[num_found_cols-1][0] = data[RED];
+                  found_cols[num_found_cols-1][1] = data[GREEN];
+                  found_cols[num_found_cols-1][2] = data[BLUE];
                 }
+            }
+        already_found:
 
-              data += srcPR.bytes;
+          col++;
+          if (col == coledge)
+            {
+              col = srcPR.x + offsetx;
+              row++;
             }
-        }
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (nth_layer + ((gdouble) total_size)/
-                                  layer_size) / (gdouble) n_layers);
+          data += srcPR.bytes;
+        }
     }
-
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
 }
 
 
@@ -2361,6 +2484,81 @@ select_colors_rgb (QuantizeObj *quantobj,
 #define BOX_B_SHIFT  (B_SHIFT + BOX_B_LOG)
 
 
+#if BOX_R_LOG == 0 && BOX_G_LOG == 0 && BOX_B_LOG == 0
+
+/*
+ * With an update box of a single cell there is nothing to gain from
+ * pruning the candidates first, a straight search over the scaled
+ * colormap is cheaper.  With SSE2 the distances are computed for four
+ * colormap entries at a time: the scaled coordinates are at most
+ * 255 * B_SCALE, so the differences fit 16 bits, and pmaddwd squares
+ * and sums them without overflowing 32 bits.
+ */
+
+static int
+find_nearest_color (QuantizeObj *quantobj,
+                    int          minR,
+                    int          minG,
+                    int          minB)
+{
+  const int *lin_red   = quantobj->lin_red;
+  const int *lin_green = quantobj->lin_green;
+  const int *lin_blue  = quantobj->lin_blue;
+  const int  n_colors  = quantobj->actual_number_of_colors;
+  const int  R         = minR * R_SCALE;
+  const int  G         = minG * G_SCALE;
+  const int  B         = minB * B_SCALE;
+  int        dist[MAXNUMCOLORS];
+  int        best      = 0;
+  int        i         = 0;
+
+#ifdef USE_SSE2_CONVERT
+  const __m128i vR   = _mm_set1_epi32 (R);
+  const __m128i vG   = _mm_set1_epi32 (G);
+  const __m128i vB   = _mm_set1_epi32 (B);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; i + 4 <= n_colors; i += 4)
+    {
+      __m128i dR = _mm_loadu_si128 ((const __m128i *) (lin_red   + i));
+      __m128i dG = _mm_loadu_si128 ((const __m128i *) (lin_green + i));
+      __m128i dB = _mm_loadu_si128 ((const __m128i *) (lin_blue  + i));
+      __m128i RB, G0, RG, B0;
+
+      dR = _mm_sub_epi32 (vR, dR);
+      dG = _mm_sub_epi32 (vG, dG);
+      dB = _mm_sub_epi32 (vB, dB);
+
+      RB = _mm_packs_epi32 (dR, dB);
+      G0 = _mm_packs_epi32 (dG, zero);
+      RG = _mm_unpacklo_epi16 (RB, G0);  /* R0 G0 R1 G1 R2 G2 R3 G3 */
+      B0 = _mm_unpackhi_epi16 (RB, G0);  /* B0 0  B1 0  B2 0  B3 0  */
+
+      _mm_storeu_si128 ((__m128i *) (dist + i),
+                        _mm_add_epi32 (_mm_madd_epi16 (RG, RG),
+                                       _mm_madd_epi16 (B0, B0)));
+    }
+#endif
+
+  for (; i < n_colors; i++)
+    {
+      const int dR = R - lin_red[i];
+      const int dG = G - lin_green[i];
+      const int dB = B - lin_blue[i];
+
+      dist[i] = dR * dR + dG * dG + dB * dB;
+    }
+
+  /* ties go to the lowest index, as in find_best_colors() */
+  for (i = 1; i < n_colors; i++)
+    if (dist[i] < dist[best])
+      best = i;
+
+  return best;
+}
+
+#else /* update box larger than one cell */
+
 /*
  * The next three routines implement inverse colormap filling.  They could
  * all be folded into one big routine, but splitting them up this way saves
@@ -2595,6 +2793,8 @@ find_best_colors (QuantizeObj *quantobj,
   }
 }
 
+#endif /* BOX_R_LOG == 0 && BOX_G_LOG == 0 && BOX_B_LOG == 0 */
+
 
 static void
 fill_inverse_cmap_gray (QuantizeObj *quantobj,
@@ -2641,6 +2841,17 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
 /* histogram cell R/G/B.  (Only that one cell MUST be filled, but */
 /* we can fill as many others as we wish.) */
 {
+#if BOX_R_LOG == 0 && BOX_G_LOG == 0 && BOX_B_LOG == 0
+  int minR, minG, minB; /* center of the cell */
+
+  minR = (R << R_SHIFT) + ((1 << R_SHIFT) >> 1);
+  minG = (G << G_SHIFT) + ((1 << G_SHIFT) >> 1);
+  minB = (B << B_SHIFT) + ((1 << B_SHIFT) >> 1);
+
+  /* Save the best color number (plus 1) in the main cache array */
+  *HIST_LIN(histogram, R, G, B) =
+    find_nearest_color (quantobj, minR, minG, minB) + 1;
+#else
   int minR, minG, minB; /* lower left corner of update box */
   int iR, iG, iB;
   int * cptr;           /* pointer into bestcolor[] array */
@@ -2684,6 +2895,7 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
       }
     }
   }
+#endif
 }
 
 
@@ -2758,26 +2970,137 @@ custompal_pass1 (QuantizeObj *quantobj)
  */
 
 static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 TileManager *new_tiles)
+remap_data_init (RemapData   *data,
+                 QuantizeObj *quantobj,
+                 GimpLayer   *layer)
 {
-  PixelRegion   srcPR, destPR;
+  data->quantobj     = quantobj;
+  data->red_pix      = RED;
+  data->green_pix    = GREEN;
+  data->blue_pix     = BLUE;
+  data->alpha_pix    = ALPHA;
+  data->has_alpha    = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+  data->alpha_dither = quantobj->want_alpha_dither;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data->offsetx, &data->offsety);
+
+#ifdef ENABLE_MP
+  data->mutex = g_mutex_new ();
+#endif
+}
+
+static void
+remap_data_free (RemapData *data)
+{
+#ifdef ENABLE_MP
+  g_mutex_free (data->mutex);
+#endif
+}
+
+/*  adds the index counts of one sub-region to the quantizer's  */
+static void
+remap_data_add_used (RemapData    *data,
+                     const gulong *used_count)
+{
+  gulong *index_used_count = data->quantobj->index_used_count;
+  gint    i;
+
+#ifdef ENABLE_MP
+  g_mutex_lock (data->mutex);
+#endif
+
+  for (i = 0; i < 256; i++)
+    index_used_count[i] += used_count[i];
+
+#ifdef ENABLE_MP
+  g_mutex_unlock (data->mutex);
+#endif
+}
+
+static gboolean
+remap_pixel_is_transparent (const RemapData *data,
+                            const guchar    *src,
+                            gint             x,
+                            gint             y)
+{
+  if (data->alpha_dither)
+    {
+      gint dither_x = (x + data->offsetx) & DM_WIDTHMASK;
+      gint dither_y = (y + data->offsety) & DM_HEIGHTMASK;
+
+      return src[data->alpha_pix] < DM[dither_x][dither_y];
+    }
+
+  return src[data->alpha_pix] <= 127;
+}
+
+/*  Several sub-regions may miss the same cache entry at once; they
+ *  all store the same colormap index, so the cache needs no lock.
+ */
+static void
+median_cut_pass2_no_dither_gray_sub_region (RemapData   *data,
+                                            PixelRegion *srcPR,
+                                            PixelRegion *destPR)
+{
+  QuantizeObj  *quantobj  = data->quantobj;
   CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
-  const guchar *src;
-  guchar       *dest;
+  const guchar *src       = srcPR->data;
+  guchar       *dest      = destPR->data;
+  gulong        used_count[256] = { 0, };
   gint          row, col;
-  gint          pixel;
-  gint          has_alpha;
-  gulong       *index_used_count = quantobj->index_used_count;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gpointer      pr;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  for (row = 0; row < srcPR->h; row++)
+    {
+      const guchar *s = src;
+      guchar       *d = dest;
 
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+      for (col = 0; col < srcPR->w; col++)
+        {
+          /* get pixel value and index into the cache */
+          gint       pixel  = s[GRAY];
+          ColorFreq *cachep = &histogram[pixel];
+
+          /* If we have not seen this color before, find nearest colormap entry */
+          /* and update the cache */
+          if (*cachep == 0)
+            fill_inverse_cmap_gray (quantobj, histogram, pixel);
+
+          if (data->has_alpha &&
+              remap_pixel_is_transparent (data, s,
+                                          srcPR->x + col, srcPR->y + row))
+            {
+              d[ALPHA_I] = 0;
+            }
+          else
+            {
+              if (data->has_alpha)
+                d[ALPHA_I] = 255;
+
+              /* Now emit the colormap index for this cell */
+              used_count[d[INDEXED] = *cachep - 1]++;
+            }
+
+          s += srcPR->bytes;
+          d += destPR->bytes;
+        }
+
+      src  += srcPR->rowstride;
+      dest += destPR->rowstride;
+    }
+
+  remap_data_add_used (data, used_count);
+}
+
+static void
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 TileManager *new_tiles)
+{
+  RemapData   data;
+  PixelRegion srcPR, destPR;
+
+  remap_data_init (&data, quantobj, layer);
+  data.alpha_pix = ALPHA_G;
 
   pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
                      0, 0,
@@ -2790,64 +3113,11 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
                      gimp_item_get_height (GIMP_ITEM (layer)),
                      TRUE);
 
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
-    {
-      src = srcPR.data;
-      dest = destPR.data;
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  median_cut_pass2_no_dither_gray_sub_region,
+                                  &data, 2, &srcPR, &destPR);
 
-      for (row = 0; row < srcPR.h; row++)
-        {
-          for (col = 0; col < srcPR.w; col++)
-            {
-              /* get pixel value and index into the cache */
-              pixel = src[GRAY];
-              cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest colormap entry */
-              /* and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
-
-              if (has_alpha)
-                {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      gint dither_x = (col + offsetx + srcPR.x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + srcPR.y) & DM_HEIGHTMASK;
-
-                      if ((src[ALPHA_G]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
-
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                      index_used_count[dest[INDEXED] = *cachep - 1]++;
-                    }
-                }
-              else
-                {
-                  /* Now emit the colormap index for this cell */
-                  index_used_count[dest[INDEXED] = *cachep - 1]++;
-                }
-
-              src += srcPR.bytes;
-              dest += destPR.bytes;
-            }
-        }
-    }
+  remap_data_free (&data);
 }
 
 static void
@@ -2996,46 +3266,90 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
     }
 }
 
+static void
+median_cut_pass2_no_dither_rgb_sub_region (RemapData   *data,
+                                           PixelRegion *srcPR,
+                                           PixelRegion *destPR)
+{
+  QuantizeObj  *quantobj  = data->quantobj;
+  CFHistogram   histogram = quantobj->histogram;
+  const guchar *src       = srcPR->data;
+  guchar       *dest      = destPR->data;
+  gulong        used_count[256] = { 0, };
+  gint          row, col;
+
+  for (row = 0; row < srcPR->h; row++)
+    {
+      const guchar *s = src;
+      guchar       *d = dest;
+
+      for (col = 0; col < srcPR->w; col++, s += srcPR->bytes, d += destPR->bytes)
+        {
+          ColorFreq *cachep;
+          gint       R, G, B;
+
+          if (data->has_alpha)
+            {
+              if (remap_pixel_is_transparent (data, s,
+                                              srcPR->x + col, srcPR->y + row))
+                {
+                  d[ALPHA_I] = 0;
+                  continue;
+                }
+
+              d[ALPHA_I] = 255;
+            }
+
+          /* get pixel value and index into the cache */
+          rgb_to_lin (s[data->red_pix], s[data->green_pix], s[data->blue_pix],
+                      &R, &G, &B);
+          cachep = HIST_LIN (histogram, R, G, B);
+          /* If we have not seen this color before, find nearest
+             colormap entry and update the cache */
+          if (*cachep == 0)
+            fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+
+          /* Now emit the colormap index for this cell */
+          used_count[d[INDEXED] = *cachep - 1]++;
+        }
+
+      src  += srcPR->rowstride;
+      dest += destPR->rowstride;
+    }
+
+  remap_data_add_used (data, used_count);
+}
+
+static void
+median_cut_pass2_no_dither_rgb_progress (RemapData *data,
+                                         gdouble    fraction)
+{
+  QuantizeObj *quantobj = data->quantobj;
+
+  gimp_progress_set_value (quantobj->progress,
+                           (quantobj->nth_layer + fraction) /
+                           (gdouble) quantobj->n_layers);
+}
+
 static void
 median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                                 GimpLayer   *layer,
                                 TileManager *new_tiles)
 {
-  PixelRegion   srcPR, destPR;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
-  const guchar *src;
-  guchar       *dest;
-  gint          R, G, B;
-  gint          row, col;
-  gboolean      has_alpha;
-  gpointer      pr;
-  gint          red_pix          = RED;
-  gint          green_pix        = GREEN;
-  gint          blue_pix         = BLUE;
-  gint          alpha_pix        = ALPHA;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gulong       *index_used_count = quantobj->index_used_count;
-  glong         total_size       = 0;
-  glong         layer_size;
-  gint          count            = 0;
-  gint          nth_layer        = quantobj->nth_layer;
-  gint          n_layers         = quantobj->n_layers;
+  RemapData   data;
+  PixelRegion srcPR, destPR;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  remap_data_init (&data, quantobj, layer);
 
   /*  In the case of web/mono palettes, we actually force
    *   grayscale drawables through the rgb pass2 functions
    */
   if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
     {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
+      data.red_pix = data.green_pix = data.blue_pix = GRAY;
+      data.alpha_pix = ALPHA_G;
     }
 
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
-
   pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
                      0, 0,
                      gimp_item_get_width  (GIMP_ITEM (layer)),
@@ -3047,74 +3361,17 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                      gimp_item_get_height (GIMP_ITEM (layer)),
                      TRUE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr), count++)
-    {
-      src = srcPR.data;
-      dest = destPR.data;
-
-      total_size += srcPR.h * srcPR.w;
-
-      for (row = 0; row < srcPR.h; row++)
-        {
-          for (col = 0; col < srcPR.w; col++)
-            {
-              if (has_alpha)
-                {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      gint dither_x = (col + offsetx + srcPR.x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + srcPR.y) & DM_HEIGHTMASK;
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
-
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
-                }
-
-              /* get pixel value and index into the cache */
-              rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
-                         &R, &G, &B);
-              cachep = HIST_LIN(histogram,R,G,B);
-              /* If we have not seen this color before, find nearest
-                 colormap entry and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
-
-            next_pixel:
-
-              src += srcPR.bytes;
-              dest += destPR.bytes;
-            }
-        }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (nth_layer + ((gdouble) total_size)/
-                                   layer_size) / (gdouble) n_layers);
-    }
+  pixel_regions_process_parallel_progress ((PixelProcessorFunc)
+                                           median_cut_pass2_no_dither_rgb_sub_region,
+                                           &data,
+                                           quantobj->progress ?
+                                           (PixelProcessorProgressFunc)
+                                           median_cut_pass2_no_dither_rgb_progress :
+                                           NULL,
+                                           &data,
+                                           2, &srcPR, &destPR);
+
+  remap_data_free (&data);
 }
 
 static void
@@ -3769,6 +4026,10 @@ median_cut_pass2_rgb_init (QuantizeObj *quantobj)
                            &quantobj->clin[i].red,
                            &quantobj->clin[i].green,
                            &quantobj->clin[i].blue);
+
+      quantobj->lin_red[i]   = quantobj->clin[i].red   * R_SCALE;
+      quantobj->lin_green[i] = quantobj->clin[i].green * G_SCALE;
+      quantobj->lin_blue[i]  = quantobj->clin[i].blue  * B_SCALE;
     }
 }
 
@@ -94,6 +94,7 @@ struct _GimpImagePrivate
   /*  Undo apparatus  */
   GimpUndoStack     *undo_stack;            /*  stack for undo operations    */
   GimpUndoStack     *redo_stack;            /*  stack for redo operations    */
+  GimpUndoJournal   *undo_journal;          /*  spilled undo data            */
   gint               group_count;           /*  nested undo groups           */
   GimpUndoType       pushing_undo_group;    /*  undo group status flag       */
 
@@ -31,16 +31,21 @@
 #include "gimpimage-undo.h"
 #include "gimpitem.h"
 #include "gimplist.h"
+#include "gimpundojournal.h"
 #include "gimpundostack.h"
 
+#include "gimp-intl.h"
+
 
 /*  local function prototypes  */
 
-static void          gimp_image_undo_pop_stack       (GimpImage     *image,
+static gboolean      gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *undo_stack,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static gboolean      gimp_image_undo_spill           (GimpImage     *image,
+                                                      gint          *index);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -123,12 +128,10 @@ gimp_image_undo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->undo_stack,
-                             private->redo_stack,
-                             GIMP_UNDO_MODE_UNDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->undo_stack,
+                                    private->redo_stack,
+                                    GIMP_UNDO_MODE_UNDO);
 }
 
 gboolean
@@ -143,12 +146,10 @@ gimp_image_redo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->redo_stack,
-                             private->undo_stack,
-                             GIMP_UNDO_MODE_REDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->redo_stack,
+                                    private->undo_stack,
+                                    GIMP_UNDO_MODE_REDO);
 }
 
 /*
@@ -484,7 +485,7 @@ gimp_image_undo_get_fadeable (GimpImage *image)
 
 /*  private functions  */
 
-static void
+static gboolean
 gimp_image_undo_pop_stack (GimpImage     *image,
                            GimpUndoStack *undo_stack,
                            GimpUndoStack *redo_stack,
@@ -493,6 +494,23 @@ gimp_image_undo_pop_stack (GimpImage     *image,
   GimpUndo            *undo;
   GimpUndoAccumulator  accum = { 0, };
 
+  undo = gimp_undo_stack_peek (undo_stack);
+
+  /*  the steps before this one build on it, so if its data is lost
+   *  none of them can be undone correctly any longer
+   */
+  if (undo && ! gimp_undo_unspill (undo))
+    {
+      gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            _("The undo data could not be read back from "
+                              "the undo journal. The undo history of this "
+                              "image has been discarded."));
+
+      gimp_image_undo_free (image);
+
+      return FALSE;
+    }
+
   g_object_freeze_notify (G_OBJECT (image));
 
   undo = gimp_undo_stack_pop_undo (undo_stack, undo_mode, &accum);
@@ -528,6 +546,8 @@ gimp_image_undo_pop_stack (GimpImage     *image,
     }
 
   g_object_thaw_notify (G_OBJECT (image));
+
+  return TRUE;
 }
 
 static void
@@ -538,6 +558,7 @@ gimp_image_undo_free_space (GimpImage *image)
   gint              min_undo_levels;
   gint              max_undo_levels;
   gint64            undo_size;
+  gint              spill_index;
 
   container = private->undo_stack->undos;
 
@@ -555,11 +576,23 @@ gimp_image_undo_free_space (GimpImage *image)
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
+  /*  the bottom step is spilled first  */
+  spill_index = gimp_container_get_n_children (container) - 1;
+
   while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
          (gimp_container_get_n_children (container) > max_undo_levels))
     {
-      GimpUndo *freed = gimp_undo_stack_free_bottom (private->undo_stack,
-                                                     GIMP_UNDO_MODE_UNDO);
+      GimpUndo *freed;
+
+      if (gimp_container_get_n_children (container) <= max_undo_levels &&
+          gimp_image_undo_spill (image, &spill_index))
+        continue;
+
+      freed = gimp_undo_stack_free_bottom (private->undo_stack,
+                                           GIMP_UNDO_MODE_UNDO);
+
+      spill_index = MIN (spill_index,
+                         gimp_container_get_n_children (container) - 1);
 
 #ifdef DEBUG_IMAGE_UNDO
       g_printerr ("freed one step: undo_steps: %d    undo_bytes: %ld\n",
@@ -577,6 +610,53 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+/*  Moves the data of the undo step at @index, or of the next step
+ *  above it that has data to move, to the image's undo journal.
+ *  Returns FALSE if no step could be spilled.
+ */
+static gboolean
+gimp_image_undo_spill (GimpImage *image,
+                       gint      *index)
+{
+  GimpImagePrivate *private   = GIMP_IMAGE_GET_PRIVATE (image);
+  GimpContainer    *container = private->undo_stack->undos;
+
+  if (! image->gimp->config->undo_journal)
+    return FALSE;
+
+  if (! private->undo_journal)
+    {
+      GimpBaseConfig *config = GIMP_BASE_CONFIG (image->gimp->config);
+
+      private->undo_journal = gimp_undo_journal_new (config->swap_path);
+
+      if (! private->undo_journal)
+        return FALSE;
+    }
+
+  /*  keep the newest step in memory, it's the one undone next  */
+  while (*index > 0)
+    {
+      GimpUndo *undo;
+      gint64    freed;
+
+      undo = GIMP_UNDO (gimp_container_get_child_by_index (container,
+                                                           *index));
+      (*index)--;
+
+      freed = gimp_undo_spill (undo, private->undo_journal);
+
+#ifdef DEBUG_IMAGE_UNDO
+      g_printerr ("spilled one step: %ld bytes\n", (glong) freed);
+#endif
+
+      if (freed > 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
@@ -65,6 +65,7 @@
 #include "gimpsamplepoint.h"
 #include "gimpselection.h"
 #include "gimptemplate.h"
+#include "gimpundojournal.h"
 #include "gimpundostack.h"
 
 #include "file/file-utils.h"
@@ -983,6 +984,11 @@ gimp_image_finalize (GObject *object)
       g_object_unref (private->redo_stack);
       private->redo_stack = NULL;
     }
+  if (private->undo_journal)
+    {
+      gimp_undo_journal_unref (private->undo_journal);
+      private->undo_journal = NULL;
+    }
 
   if (image->gimp && image->gimp->image_table)
     {
@@ -17,11 +17,14 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "core-types.h"
 
 #include "base/pixel-region.h"
+#include "base/tile.h"
 #include "base/tile-manager.h"
 
 #include "paint-funcs/paint-funcs.h"
@@ -35,22 +38,48 @@
 
 /*  local function prototypes  */
 
-static void   gimp_projection_construct_gegl   (GimpProjection *proj,
-                                                gint            x,
-                                                gint            y,
-                                                gint            w,
-                                                gint            h);
-static void   gimp_projection_construct_legacy (GimpProjection *proj,
-                                                gboolean        with_layers,
-                                                gint            x,
-                                                gint            y,
-                                                gint            w,
-                                                gint            h);
-static void   gimp_projection_initialize       (GimpProjection *proj,
-                                                gint            x,
-                                                gint            y,
-                                                gint            w,
-                                                gint            h);
+static void     gimp_projection_construct_gegl       (GimpProjection *proj,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            w,
+                                                      gint            h);
+static void     gimp_projection_construct_legacy     (GimpProjection *proj,
+                                                      gboolean        with_layers,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            w,
+                                                      gint            h);
+static gboolean gimp_projection_construct_items      (GimpProjection *proj,
+                                                      GList          *items,
+                                                      GList          *last,
+                                                      TileManager    *tiles,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            w,
+                                                      gint            h,
+                                                      gboolean        combine);
+static GList *  gimp_projection_construct_below      (GimpProjection *proj,
+                                                      GList          *layers,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            w,
+                                                      gint            h);
+static void     gimp_projection_construct_sync_stack (GimpProjection *proj,
+                                                      GList          *layers);
+static void     gimp_projection_validate_below       (TileManager    *tm,
+                                                      Tile           *tile,
+                                                      GimpProjection *proj);
+static void     gimp_projection_layer_update         (GimpDrawable   *drawable,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            width,
+                                                      gint            height,
+                                                      GimpProjection *proj);
+static void     gimp_projection_initialize           (GimpProjection *proj,
+                                                      gint            x,
+                                                      gint            y,
+                                                      gint            w,
+                                                      gint            h);
 
 
 /*  public functions  */
@@ -113,18 +142,18 @@ gimp_projection_construct (GimpProjection *proj,
     }
 #endif
 
-  /*  First, determine if the projection image needs to be
-   *  initialized--this is the case when there are no visible
-   *  layers that cover the entire canvas--either because layers
-   *  are offset or only a floating selection is visible
-   */
-  gimp_projection_initialize (proj, x, y, w, h);
-
   /*  call functions which process the list of layers and
    *  the list of channels
    */
   if (proj->use_gegl)
     {
+      /*  First, determine if the projection image needs to be
+       *  initialized--this is the case when there are no visible
+       *  layers that cover the entire canvas--either because layers
+       *  are offset or only a floating selection is visible
+       */
+      gimp_projection_initialize (proj, x, y, w, h);
+
       gimp_projection_construct_gegl (proj, x, y, w, h);
     }
   else
@@ -135,6 +164,81 @@ gimp_projection_construct (GimpProjection *proj,
     }
 }
 
+/**
+ * gimp_projection_construct_reset:
+ * @proj: A #GimpProjection.
+ *
+ * Forgets the layer stack remembered by the legacy projection code,
+ * together with the cached composite of the layers below the layer
+ * being painted.
+ */
+void
+gimp_projection_construct_reset (GimpProjection *proj)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+
+  for (list = proj->construct_layers; list; list = g_list_next (list))
+    {
+      g_signal_handlers_disconnect_by_func (list->data,
+                                            gimp_projection_layer_update,
+                                            proj);
+      g_object_unref (list->data);
+    }
+
+  g_list_free (proj->construct_layers);
+  proj->construct_layers = NULL;
+
+  proj->below_layer = NULL;
+
+  if (proj->below_tiles)
+    {
+      tile_manager_unref (proj->below_tiles);
+      proj->below_tiles = NULL;
+    }
+}
+
+/**
+ * gimp_projection_construct_invalidate:
+ * @proj: A #GimpProjection.
+ * @x:
+ * @y:
+ * @w:
+ * @h:
+ *
+ * Called for every invalidation of the projectable. Layer updates
+ * are tracked through the layers' own "update" signals, but an
+ * invalidation of the entire projectable can also mean that
+ * something all layers depend on changed, like the colormap or the
+ * visible components, so the cached composite is dropped then.
+ */
+void
+gimp_projection_construct_invalidate (GimpProjection *proj,
+                                      gint            x,
+                                      gint            y,
+                                      gint            w,
+                                      gint            h)
+{
+  gint off_x, off_y;
+  gint width, height;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+
+  if (! proj->below_tiles)
+    return;
+
+  gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+  gimp_projectable_get_size (proj->projectable, &width, &height);
+
+  if (x <= off_x && y <= off_y &&
+      x + w >= off_x + width && y + h >= off_y + height)
+    {
+      tile_manager_unref (proj->below_tiles);
+      proj->below_tiles = NULL;
+    }
+}
+
 
 /*  private functions  */
 
@@ -177,10 +281,10 @@ gimp_projection_construct_legacy (GimpProjection *proj,
                                   gint            w,
                                   gint            h)
 {
-  GList *list;
-  GList *reverse_list = NULL;
-  gint   proj_off_x;
-  gint   proj_off_y;
+  TileManager *tiles    = gimp_pickable_get_tiles (GIMP_PICKABLE (proj));
+  GList       *channels = NULL;
+  GList       *layers   = NULL;
+  GList       *list;
 
   for (list = gimp_projectable_get_channels (proj->projectable);
        list;
@@ -188,7 +292,7 @@ gimp_projection_construct_legacy (GimpProjection *proj,
     {
       if (gimp_item_get_visible (GIMP_ITEM (list->data)))
         {
-          reverse_list = g_list_prepend (reverse_list, list->data);
+          channels = g_list_prepend (channels, list->data);
         }
     }
 
@@ -206,14 +310,61 @@ gimp_projection_construct_legacy (GimpProjection *proj,
               /*  only add layers that are visible and not floating selections
                *  to the list
                */
-              reverse_list = g_list_prepend (reverse_list, layer);
+              layers = g_list_prepend (layers, layer);
             }
         }
+
+      gimp_projection_construct_sync_stack (proj, layers);
+
+      list = gimp_projection_construct_below (proj, layers, x, y, w, h);
+
+      if (list == layers)
+        {
+          /*  First, determine if the projection image needs to be
+           *  initialized--this is the case when there are no visible
+           *  layers that cover the entire canvas--either because layers
+           *  are offset or only a floating selection is visible
+           */
+          gimp_projection_initialize (proj, x, y, w, h);
+        }
+
+      proj->construct_flag =
+        gimp_projection_construct_items (proj, list, NULL, tiles,
+                                         x, y, w, h,
+                                         proj->construct_flag);
     }
 
+  proj->construct_flag =
+    gimp_projection_construct_items (proj, channels, NULL, tiles,
+                                     x, y, w, h,
+                                     proj->construct_flag);
+
+  g_list_free (layers);
+  g_list_free (channels);
+}
+
+/*  Projects @items, bottom first, up to but not including @last, onto
+ *  @tiles. Returns whether something was projected, which is the
+ *  @combine flag for the next item.
+ */
+static gboolean
+gimp_projection_construct_items (GimpProjection *proj,
+                                 GList          *items,
+                                 GList          *last,
+                                 TileManager    *tiles,
+                                 gint            x,
+                                 gint            y,
+                                 gint            w,
+                                 gint            h,
+                                 gboolean        combine)
+{
+  GList *list;
+  gint   proj_off_x;
+  gint   proj_off_y;
+
   gimp_projectable_get_offset (proj->projectable, &proj_off_x, &proj_off_y);
 
-  for (list = reverse_list; list; list = g_list_next (list))
+  for (list = items; list != last; list = g_list_next (list))
     {
       GimpItem    *item = list->data;
       PixelRegion  projPR;
@@ -236,8 +387,7 @@ gimp_projection_construct_legacy (GimpProjection *proj,
       x2 = CLAMP (off_x + gimp_item_get_width  (item), x, x + w);
       y2 = CLAMP (off_y + gimp_item_get_height (item), y, y + h);
 
-      pixel_region_init (&projPR,
-                         gimp_pickable_get_tiles (GIMP_PICKABLE (proj)),
+      pixel_region_init (&projPR, tiles,
                          x1, y1, x2 - x1, y2 - y1,
                          TRUE);
 
@@ -245,12 +395,142 @@ gimp_projection_construct_legacy (GimpProjection *proj,
                                     x1 - off_x, y1 - off_y,
                                     x2 - x1,    y2 - y1,
                                     &projPR,
-                                    proj->construct_flag);
+                                    combine);
+
+      combine = TRUE;  /*  something was projected  */
+    }
+
+  return combine;
+}
+
+/*  If the layer being painted has layers below it, copies their
+ *  cached composite into the projection and returns the painted
+ *  layer's link in @layers, so only it and the layers above it are
+ *  projected again. Returns @layers otherwise.
+ */
+static GList *
+gimp_projection_construct_below (GimpProjection *proj,
+                                 GList          *layers,
+                                 gint            x,
+                                 gint            y,
+                                 gint            w,
+                                 gint            h)
+{
+  GList       *pivot;
+  PixelRegion  srcPR;
+  PixelRegion  destPR;
+
+  if (! proj->below_layer)
+    return layers;
+
+  pivot = g_list_find (layers, proj->below_layer);
+
+  if (! pivot || pivot == layers)
+    return layers;
+
+  if (! proj->below_tiles)
+    {
+      TileManager *tiles = gimp_pickable_get_tiles (GIMP_PICKABLE (proj));
+
+      proj->below_tiles = tile_manager_new (tile_manager_width  (tiles),
+                                            tile_manager_height (tiles),
+                                            tile_manager_bpp    (tiles));
+
+      tile_manager_set_validate_proc (proj->below_tiles,
+                                      (TileValidateProc) gimp_projection_validate_below,
+                                      proj);
+    }
+
+  pixel_region_init (&srcPR, proj->below_tiles,
+                     x, y, w, h, FALSE);
+  pixel_region_init (&destPR, gimp_pickable_get_tiles (GIMP_PICKABLE (proj)),
+                     x, y, w, h, TRUE);
+
+  copy_region (&srcPR, &destPR);
+
+  /*  there is at least one layer below the pivot  */
+  proj->construct_flag = TRUE;
+
+  return pivot;
+}
 
-      proj->construct_flag = TRUE;  /*  something was projected  */
+/*  Remembers the visible layers, so we get to know which one is
+ *  being painted. The cached composite stays valid as long as the
+ *  stack doesn't change.
+ */
+static void
+gimp_projection_construct_sync_stack (GimpProjection *proj,
+                                      GList          *layers)
+{
+  GimpLayer *below_layer = proj->below_layer;
+  GList     *list;
+  GList     *old;
+
+  for (list = layers, old = proj->construct_layers;
+       list && old && list->data == old->data;
+       list = g_list_next (list), old = g_list_next (old));
+
+  if (! list && ! old)
+    return;
+
+  gimp_projection_construct_reset (proj);
+
+  proj->construct_layers = g_list_copy (layers);
+
+  for (list = proj->construct_layers; list; list = g_list_next (list))
+    {
+      g_object_ref (list->data);
+
+      g_signal_connect (list->data, "update",
+                        G_CALLBACK (gimp_projection_layer_update),
+                        proj);
+
+      if (list->data == below_layer)
+        proj->below_layer = below_layer;
     }
+}
 
-  g_list_free (reverse_list);
+static void
+gimp_projection_validate_below (TileManager    *tm,
+                                Tile           *tile,
+                                GimpProjection *proj)
+{
+  GList *pivot;
+  gint   x, y;
+
+  tile_manager_get_tile_coordinates (tm, tile, &x, &y);
+
+  memset (tile_data_pointer (tile, 0, 0), 0, tile_size (tile));
+
+  pivot = g_list_find (proj->construct_layers, proj->below_layer);
+
+  gimp_projection_construct_items (proj, proj->construct_layers, pivot, tm,
+                                   x, y, tile_ewidth (tile), tile_eheight (tile),
+                                   FALSE);
+}
+
+/*  The pivot follows the layer being painted. Updates of any other
+ *  layer move it there, which also drops the composite cached for
+ *  the old pivot.
+ */
+static void
+gimp_projection_layer_update (GimpDrawable   *drawable,
+                              gint            x,
+                              gint            y,
+                              gint            width,
+                              gint            height,
+                              GimpProjection *proj)
+{
+  if (GIMP_LAYER (drawable) == proj->below_layer)
+    return;
+
+  proj->below_layer = GIMP_LAYER (drawable);
+
+  if (proj->below_tiles)
+    {
+      tile_manager_unref (proj->below_tiles);
+      proj->below_tiles = NULL;
+    }
 }
 
 /**
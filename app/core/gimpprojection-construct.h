@@ -19,11 +19,17 @@
 #define __GIMP_PROJECTION_CONSTRUCT_H__
 
 
-void   gimp_projection_construct (GimpProjection *proj,
-                                  gint            x,
-                                  gint            y,
-                                  gint            w,
-                                  gint            h);
+void   gimp_projection_construct            (GimpProjection *proj,
+                                             gint            x,
+                                             gint            y,
+                                             gint            w,
+                                             gint            h);
+void   gimp_projection_construct_reset      (GimpProjection *proj);
+void   gimp_projection_construct_invalidate (GimpProjection *proj,
+                                             gint            x,
+                                             gint            y,
+                                             gint            w,
+                                             gint            h);
 
 
 #endif /* __GIMP_PROJECTION_CONSTRUCT_H__ */
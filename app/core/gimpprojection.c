@@ -40,6 +40,9 @@
 /*  halfway between G_PRIORITY_HIGH_IDLE and G_PRIORITY_DEFAULT_IDLE  */
 #define  GIMP_PROJECTION_IDLE_PRIORITY  150
 
+/*  rebuild the pyramid after the idle render is done  */
+#define  GIMP_PROJECTION_PYRAMID_IDLE_PRIORITY  (GIMP_PROJECTION_IDLE_PRIORITY + 1)
+
 
 enum
 {
@@ -48,6 +51,16 @@ enum
 };
 
 
+typedef struct
+{
+  gconstpointer  owner;
+  gint           x1;      /*  tile-pyramid coordinates  */
+  gint           y1;
+  gint           x2;
+  gint           y2;
+} GimpProjectionPriority;
+
+
 /*  local function prototypes  */
 
 static void   gimp_projection_pickable_iface_init (GimpPickableInterface  *iface);
@@ -79,7 +92,12 @@ static void        gimp_projection_flush_whenever        (GimpProjection  *proj,
                                                           gboolean         now);
 static void        gimp_projection_idle_render_init      (GimpProjection  *proj);
 static gboolean    gimp_projection_idle_render_callback  (gpointer         data);
+static void        gimp_projection_idle_render_requeue   (GimpProjection  *proj);
 static gboolean    gimp_projection_idle_render_next_area (GimpProjection  *proj);
+static void        gimp_projection_pyramid_idle_init     (GimpProjection  *proj);
+static gboolean    gimp_projection_pyramid_idle_callback (gpointer         data);
+static void        gimp_projection_pyramid_idle_stop     (GimpProjection  *proj);
+static void        gimp_projection_priority_free         (GimpProjectionPriority *priority);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
                                                           gboolean         now,
                                                           gint             x,
@@ -150,6 +168,15 @@ gimp_projection_init (GimpProjection *proj)
   proj->update_areas             = NULL;
   proj->idle_render.idle_id      = 0;
   proj->idle_render.update_areas = NULL;
+  proj->idle_render.priority_rects = NULL;
+  proj->pyramid_idle_id          = 0;
+  proj->pyramid_x1               = 0;
+  proj->pyramid_y1               = 0;
+  proj->pyramid_x2               = 0;
+  proj->pyramid_y2               = 0;
+  proj->construct_layers         = NULL;
+  proj->below_layer              = NULL;
+  proj->below_tiles              = NULL;
   proj->construct_flag           = FALSE;
 }
 
@@ -182,12 +209,21 @@ gimp_projection_finalize (GObject *object)
   gimp_area_list_free (proj->idle_render.update_areas);
   proj->idle_render.update_areas = NULL;
 
+  g_slist_foreach (proj->idle_render.priority_rects,
+                   (GFunc) gimp_projection_priority_free, NULL);
+  g_slist_free (proj->idle_render.priority_rects);
+  proj->idle_render.priority_rects = NULL;
+
+  gimp_projection_pyramid_idle_stop (proj);
+
   if (proj->pyramid)
     {
       tile_pyramid_destroy (proj->pyramid);
       proj->pyramid = NULL;
     }
 
+  gimp_projection_construct_reset (proj);
+
   if (proj->graph)
     {
       g_object_unref (proj->graph);
@@ -214,6 +250,9 @@ gimp_projection_get_memsize (GimpObject *object,
   if (projection->pyramid)
     memsize = tile_pyramid_get_memsize (projection->pyramid);
 
+  if (projection->below_tiles)
+    memsize += tile_manager_get_memsize (projection->below_tiles, FALSE);
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -457,6 +496,142 @@ gimp_projection_get_level (GimpProjection *proj,
   return tile_pyramid_get_level (width, height, MAX (scale_x, scale_y));
 }
 
+/**
+ * gimp_projection_get_valid_level:
+ * @proj:   pointer to a GimpProjection
+ * @level:  the pyramid level that should be displayed
+ * @x:      x coordinate of the area to display
+ * @y:      y coordinate of the area to display
+ * @width:  width of the area to display
+ * @height: height of the area to display
+ *
+ * Returns @level, or the closest finer pyramid level, that can be
+ * rendered in the given area (in image coordinates) without validating
+ * any tiles. If that is not @level itself, the pyramid is rebuilt in
+ * the background and the area is updated once the requested level is
+ * available.
+ *
+ * Return value: the pyramid level to render from.
+ **/
+gint
+gimp_projection_get_valid_level (GimpProjection *proj,
+                                 gint            level,
+                                 gint            x,
+                                 gint            y,
+                                 gint            width,
+                                 gint            height)
+{
+  gint off_x, off_y;
+  gint valid;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), level);
+
+  /*  make sure the level exists before asking for its tiles  */
+  gimp_projection_get_tiles_at_level (proj, level, NULL);
+
+  gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+
+  valid = tile_pyramid_get_valid_level (proj->pyramid, level,
+                                        MAX (x - off_x, 0),
+                                        MAX (y - off_y, 0),
+                                        width, height);
+
+  if (valid < level)
+    gimp_projection_pyramid_idle_init (proj);
+
+  return valid;
+}
+
+/**
+ * gimp_projection_set_priority_rect:
+ * @proj:   pointer to a GimpProjection
+ * @owner:  the view that shows the area
+ * @x:      x coordinate of the visible area
+ * @y:      y coordinate of the visible area
+ * @width:  width of the visible area
+ * @height: height of the visible area
+ *
+ * Tells the projection which area (in image coordinates) @owner is
+ * looking at. Flushed updates inside the areas of all views are
+ * rendered first and in small chunks, the rest is updated in one go
+ * afterwards. A view passes an empty area when it goes away; without
+ * any areas, all updates are rendered in the order they were flushed.
+ **/
+void
+gimp_projection_set_priority_rect (GimpProjection *proj,
+                                   gconstpointer   owner,
+                                   gint            x,
+                                   gint            y,
+                                   gint            width,
+                                   gint            height)
+{
+  GimpProjectionIdleRender *idle_render;
+  GimpProjectionPriority   *priority = NULL;
+  GSList                   *list;
+  gint                      off_x, off_y;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (owner != NULL);
+
+  idle_render = &proj->idle_render;
+
+  for (list = idle_render->priority_rects; list; list = g_slist_next (list))
+    {
+      if (((GimpProjectionPriority *) list->data)->owner == owner)
+        {
+          priority = list->data;
+          break;
+        }
+    }
+
+  if (width <= 0 || height <= 0)
+    {
+      if (! priority)
+        return;
+
+      idle_render->priority_rects = g_slist_remove (idle_render->priority_rects,
+                                                    priority);
+      gimp_projection_priority_free (priority);
+    }
+  else
+    {
+      gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+
+      x -= off_x;
+      y -= off_y;
+
+      if (! priority)
+        {
+          priority = g_slice_new0 (GimpProjectionPriority);
+          priority->owner = owner;
+
+          idle_render->priority_rects =
+            g_slist_prepend (idle_render->priority_rects, priority);
+        }
+      else if (priority->x1 == x          &&
+               priority->y1 == y          &&
+               priority->x2 == x + width  &&
+               priority->y2 == y + height)
+        {
+          return;
+        }
+
+      priority->x1 = x;
+      priority->y1 = y;
+      priority->x2 = x + width;
+      priority->y2 = y + height;
+    }
+
+  /*  drop what is left of the current area, it may have scrolled
+   *  out of view
+   */
+  if (idle_render->idle_id)
+    {
+      gimp_projection_idle_render_requeue (proj);
+      gimp_projection_idle_render_next_area (proj);
+    }
+}
+
 void
 gimp_projection_flush (GimpProjection *proj)
 {
@@ -596,17 +771,7 @@ gimp_projection_idle_render_init (GimpProjection *proj)
    */
   if (proj->idle_render.idle_id)
     {
-      GimpArea *area =
-        gimp_area_new (proj->idle_render.base_x,
-                       proj->idle_render.y,
-                       proj->idle_render.base_x + proj->idle_render.width,
-                       proj->idle_render.y + (proj->idle_render.height -
-                                               (proj->idle_render.y -
-                                                proj->idle_render.base_y)));
-
-      proj->idle_render.update_areas =
-        gimp_area_list_process (proj->idle_render.update_areas, area);
-
+      gimp_projection_idle_render_requeue (proj);
       gimp_projection_idle_render_next_area (proj);
     }
   else
@@ -658,8 +823,9 @@ gimp_projection_idle_render_callback (gpointer data)
       workh = proj->idle_render.base_y + proj->idle_render.height - worky;
     }
 
-  gimp_projection_paint_area (proj, TRUE /* sic! */,
-                              workx, worky, workw, workh);
+  if (workw > 0 && workh > 0)
+    gimp_projection_paint_area (proj, TRUE /* sic! */,
+                                workx, worky, workw, workh);
 
   proj->idle_render.x += CHUNK_WIDTH;
 
@@ -677,6 +843,8 @@ gimp_projection_idle_render_callback (gpointer data)
               /* FINISHED */
               proj->idle_render.idle_id = 0;
 
+              gimp_projection_pyramid_idle_init (proj);
+
               if (proj->invalidate_preview)
                 {
                   /* invalidate the preview here since it is constructed from
@@ -696,29 +864,244 @@ gimp_projection_idle_render_callback (gpointer data)
   return TRUE;
 }
 
+/*  puts the unrendered rest of the current area back into the list  */
+static void
+gimp_projection_idle_render_requeue (GimpProjection *proj)
+{
+  GimpProjectionIdleRender *idle_render = &proj->idle_render;
+  GimpArea                 *area;
+
+  if (idle_render->width <= 0 || idle_render->height <= 0)
+    return;
+
+  area = gimp_area_new (idle_render->base_x,
+                        idle_render->y,
+                        idle_render->base_x + idle_render->width,
+                        idle_render->y + (idle_render->height -
+                                          (idle_render->y -
+                                           idle_render->base_y)));
+
+  idle_render->update_areas =
+    gimp_area_list_process (idle_render->update_areas, area);
+
+  idle_render->width  = 0;
+  idle_render->height = 0;
+}
+
+/*  Picks the next area to render in chunks.  With priority rects
+ *  set, only the parts of the areas inside of one of them are picked,
+ *  the parts outside are put back.  Once nothing visible is left,
+ *  there is no point in chewing on the rest in chunks, it is updated
+ *  at once so that views without a priority rect don't miss it.
+ */
 static gboolean
 gimp_projection_idle_render_next_area (GimpProjection *proj)
 {
-  GimpArea *area;
+  GimpProjectionIdleRender *idle_render = &proj->idle_render;
+  GimpArea                 *area        = NULL;
 
-  if (! proj->idle_render.update_areas)
-    return FALSE;
+  if (idle_render->priority_rects)
+    {
+      GimpProjectionPriority *priority = NULL;
+      GSList                 *list;
 
-  area = proj->idle_render.update_areas->data;
+      for (list = idle_render->update_areas;
+           list && ! area;
+           list = g_slist_next (list))
+        {
+          GimpArea *candidate = list->data;
+          GSList   *rects;
+
+          for (rects = idle_render->priority_rects;
+               rects;
+               rects = g_slist_next (rects))
+            {
+              priority = rects->data;
+
+              if (candidate->x1 < priority->x2 &&
+                  candidate->x2 > priority->x1 &&
+                  candidate->y1 < priority->y2 &&
+                  candidate->y2 > priority->y1)
+                {
+                  area = candidate;
+                  break;
+                }
+            }
+        }
+
+      if (area)
+        {
+          const gint  px1 = priority->x1;
+          const gint  py1 = priority->y1;
+          const gint  px2 = priority->x2;
+          const gint  py2 = priority->y2;
+          GSList     *rest;
 
-  proj->idle_render.update_areas =
-    g_slist_remove (proj->idle_render.update_areas, area);
+          rest = g_slist_remove (idle_render->update_areas, area);
 
-  proj->idle_render.x      = proj->idle_render.base_x = area->x1;
-  proj->idle_render.y      = proj->idle_render.base_y = area->y1;
-  proj->idle_render.width  = area->x2 - area->x1;
-  proj->idle_render.height = area->y2 - area->y1;
+          /*  the pieces don't overlap, so they are not merged  */
+          if (area->y1 < py1)
+            {
+              rest = g_slist_prepend (rest, gimp_area_new (area->x1, area->y1,
+                                                           area->x2, py1));
+              area->y1 = py1;
+            }
+
+          if (area->y2 > py2)
+            {
+              rest = g_slist_prepend (rest, gimp_area_new (area->x1, py2,
+                                                           area->x2, area->y2));
+              area->y2 = py2;
+            }
+
+          if (area->x1 < px1)
+            {
+              rest = g_slist_prepend (rest, gimp_area_new (area->x1, area->y1,
+                                                           px1, area->y2));
+              area->x1 = px1;
+            }
+
+          if (area->x2 > px2)
+            {
+              rest = g_slist_prepend (rest, gimp_area_new (px2, area->y1,
+                                                           area->x2, area->y2));
+              area->x2 = px2;
+            }
+
+          idle_render->update_areas = rest;
+        }
+      else
+        {
+          for (list = idle_render->update_areas;
+               list;
+               list = g_slist_next (list))
+            {
+              GimpArea *rest = list->data;
+
+              gimp_projection_paint_area (proj, TRUE,
+                                          rest->x1, rest->y1,
+                                          rest->x2 - rest->x1,
+                                          rest->y2 - rest->y1);
+            }
+
+          gimp_area_list_free (idle_render->update_areas);
+          idle_render->update_areas = NULL;
+        }
+    }
+  else if (idle_render->update_areas)
+    {
+      area = idle_render->update_areas->data;
+
+      idle_render->update_areas =
+        g_slist_remove (idle_render->update_areas, area);
+    }
+
+  if (! area)
+    {
+      /*  makes a running idle render stop on its next call  */
+      idle_render->x      = idle_render->base_x;
+      idle_render->y      = idle_render->base_y;
+      idle_render->width  = 0;
+      idle_render->height = 0;
+
+      return FALSE;
+    }
+
+  idle_render->x      = idle_render->base_x = area->x1;
+  idle_render->y      = idle_render->base_y = area->y1;
+  idle_render->width  = area->x2 - area->x1;
+  idle_render->height = area->y2 - area->y1;
 
   gimp_area_free (area);
 
   return TRUE;
 }
 
+static void
+gimp_projection_pyramid_idle_init (GimpProjection *proj)
+{
+  /*  the idle render starts us when it is done  */
+  if (! proj->pyramid || proj->pyramid_idle_id || proj->idle_render.idle_id)
+    return;
+
+  proj->pyramid_idle_id =
+    g_idle_add_full (GIMP_PROJECTION_PYRAMID_IDLE_PRIORITY,
+                     gimp_projection_pyramid_idle_callback, proj,
+                     NULL);
+}
+
+/* Rebuilds one level of the pyramid's invalidated area per call, the
+ * tiles of each level are validated in parallel. The displays are
+ * updated once, when all levels are done.
+ */
+static gboolean
+gimp_projection_pyramid_idle_callback (gpointer data)
+{
+  GimpProjection *proj = data;
+  gint            x, y;
+  gint            width, height;
+
+  if (tile_pyramid_update (proj->pyramid, &x, &y, &width, &height))
+    {
+      if (proj->pyramid_x1 < proj->pyramid_x2)
+        {
+          proj->pyramid_x1 = MIN (proj->pyramid_x1, x);
+          proj->pyramid_y1 = MIN (proj->pyramid_y1, y);
+          proj->pyramid_x2 = MAX (proj->pyramid_x2, x + width);
+          proj->pyramid_y2 = MAX (proj->pyramid_y2, y + height);
+        }
+      else
+        {
+          proj->pyramid_x1 = x;
+          proj->pyramid_y1 = y;
+          proj->pyramid_x2 = x + width;
+          proj->pyramid_y2 = y + height;
+        }
+
+      return TRUE;
+    }
+
+  if (proj->pyramid_x1 < proj->pyramid_x2)
+    {
+      gint off_x, off_y;
+
+      gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+
+      g_signal_emit (proj, projection_signals[UPDATE], 0,
+                     FALSE,
+                     proj->pyramid_x1 + off_x,
+                     proj->pyramid_y1 + off_y,
+                     proj->pyramid_x2 - proj->pyramid_x1,
+                     proj->pyramid_y2 - proj->pyramid_y1);
+
+      proj->pyramid_x1 = proj->pyramid_x2 = 0;
+      proj->pyramid_y1 = proj->pyramid_y2 = 0;
+    }
+
+  proj->pyramid_idle_id = 0;
+
+  return FALSE;
+}
+
+static void
+gimp_projection_pyramid_idle_stop (GimpProjection *proj)
+{
+  if (proj->pyramid_idle_id)
+    {
+      g_source_remove (proj->pyramid_idle_id);
+      proj->pyramid_idle_id = 0;
+    }
+
+  proj->pyramid_x1 = proj->pyramid_x2 = 0;
+  proj->pyramid_y1 = proj->pyramid_y2 = 0;
+}
+
+static void
+gimp_projection_priority_free (GimpProjectionPriority *priority)
+{
+  g_slice_free (GimpProjectionPriority, priority);
+}
+
 static void
 gimp_projection_paint_area (GimpProjection *proj,
                             gboolean        now,
@@ -836,6 +1219,8 @@ gimp_projection_projectable_invalidate (GimpProjectable *projectable,
                                         gint             h,
                                         GimpProjection  *proj)
 {
+  gimp_projection_construct_invalidate (proj, x, y, w, h);
+
   gimp_projection_add_update_area (proj, x, y, w, h);
 }
 
@@ -866,12 +1251,16 @@ gimp_projection_projectable_changed (GimpProjectable *projectable,
   gimp_area_list_free (proj->update_areas);
   proj->update_areas = NULL;
 
+  gimp_projection_pyramid_idle_stop (proj);
+
   if (proj->pyramid)
     {
       tile_pyramid_destroy (proj->pyramid);
       proj->pyramid = NULL;
     }
 
+  gimp_projection_construct_reset (proj);
+
   gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
   gimp_projectable_get_size (projectable, &width, &height);
 
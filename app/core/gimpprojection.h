@@ -34,6 +34,8 @@ struct _GimpProjectionIdleRender
   gint    base_y;
   guint   idle_id;
   GSList *update_areas;   /*  flushed update areas */
+  GSList *priority_rects; /*  the areas to render first,   */
+                          /*  one per view                 */
 };
 
 
@@ -61,6 +63,15 @@ struct _GimpProjection
 
   GSList                   *update_areas;
   GimpProjectionIdleRender  idle_render;
+  guint                     pyramid_idle_id;
+  gint                      pyramid_x1;       /*  area rebuilt in this pass,    */
+  gint                      pyramid_y1;       /*  in tile-pyramid coordinates   */
+  gint                      pyramid_x2;
+  gint                      pyramid_y2;
+
+  GList                    *construct_layers; /*  visible layers, bottom first  */
+  GimpLayer                *below_layer;      /*  the layer being painted       */
+  TileManager              *below_tiles;      /*  composite of layers below it  */
 
   gboolean                  construct_flag;
   gboolean                  invalidate_preview;
@@ -94,6 +105,20 @@ TileManager    * gimp_projection_get_tiles_at_level
 gint             gimp_projection_get_level        (GimpProjection       *proj,
                                                    gdouble               scale_x,
                                                    gdouble               scale_y);
+gint             gimp_projection_get_valid_level  (GimpProjection       *proj,
+                                                   gint                  level,
+                                                   gint                  x,
+                                                   gint                  y,
+                                                   gint                  width,
+                                                   gint                  height);
+
+void             gimp_projection_set_priority_rect
+                                                  (GimpProjection       *proj,
+                                                   gconstpointer         owner,
+                                                   gint                  x,
+                                                   gint                  y,
+                                                   gint                  width,
+                                                   gint                  height);
 
 void             gimp_projection_flush            (GimpProjection       *proj);
 void             gimp_projection_flush_now        (GimpProjection       *proj);
@@ -87,6 +87,9 @@ static void      gimp_undo_real_pop            (GimpUndo            *undo,
                                                 GimpUndoAccumulator *accum);
 static void      gimp_undo_real_free           (GimpUndo            *undo,
                                                 GimpUndoMode         undo_mode);
+static gint64    gimp_undo_real_spill          (GimpUndo            *undo,
+                                                GimpUndoJournal     *journal);
+static gboolean  gimp_undo_real_unspill        (GimpUndo            *undo);
 
 static gboolean  gimp_undo_create_preview_idle (gpointer             data);
 static void   gimp_undo_create_preview_private (GimpUndo            *undo,
@@ -141,6 +144,8 @@ gimp_undo_class_init (GimpUndoClass *klass)
 
   klass->pop                       = gimp_undo_real_pop;
   klass->free                      = gimp_undo_real_free;
+  klass->spill                     = gimp_undo_real_spill;
+  klass->unspill                   = gimp_undo_real_unspill;
 
   g_object_class_install_property (object_class, PROP_IMAGE,
                                    g_param_spec_object ("image", NULL, NULL,
@@ -347,6 +352,19 @@ gimp_undo_real_free (GimpUndo     *undo,
 {
 }
 
+static gint64
+gimp_undo_real_spill (GimpUndo        *undo,
+                      GimpUndoJournal *journal)
+{
+  return 0;
+}
+
+static gboolean
+gimp_undo_real_unspill (GimpUndo *undo)
+{
+  return TRUE;
+}
+
 void
 gimp_undo_pop (GimpUndo            *undo,
                GimpUndoMode         undo_mode,
@@ -381,6 +399,31 @@ gimp_undo_free (GimpUndo     *undo,
   g_signal_emit (undo, undo_signals[FREE], 0, undo_mode);
 }
 
+/*  Moves the undo's data to @journal, it is read back when the undo
+ *  is popped.  Returns the number of bytes this freed.
+ */
+gint64
+gimp_undo_spill (GimpUndo        *undo,
+                 GimpUndoJournal *journal)
+{
+  g_return_val_if_fail (GIMP_IS_UNDO (undo), 0);
+  g_return_val_if_fail (journal != NULL, 0);
+
+  return GIMP_UNDO_GET_CLASS (undo)->spill (undo, journal);
+}
+
+/*  Reads the data moved to the journal by gimp_undo_spill() back, it
+ *  has to be called before the undo is popped.  Returns FALSE if the
+ *  data could not be read.
+ */
+gboolean
+gimp_undo_unspill (GimpUndo *undo)
+{
+  g_return_val_if_fail (GIMP_IS_UNDO (undo), FALSE);
+
+  return GIMP_UNDO_GET_CLASS (undo)->unspill (undo);
+}
+
 typedef struct _GimpUndoIdle GimpUndoIdle;
 
 struct _GimpUndoIdle
@@ -66,11 +66,15 @@ struct _GimpUndoClass
 {
   GimpViewableClass  parent_class;
 
-  void (* pop)  (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode,
-                 GimpUndoAccumulator *accum);
-  void (* free) (GimpUndo            *undo,
-                 GimpUndoMode         undo_mode);
+  void     (* pop)     (GimpUndo            *undo,
+                        GimpUndoMode         undo_mode,
+                        GimpUndoAccumulator *accum);
+  void     (* free)    (GimpUndo            *undo,
+                        GimpUndoMode         undo_mode);
+
+  gint64   (* spill)   (GimpUndo            *undo,
+                        GimpUndoJournal     *journal);
+  gboolean (* unspill) (GimpUndo            *undo);
 };
 
 
@@ -81,6 +85,9 @@ void          gimp_undo_pop             (GimpUndo            *undo,
                                          GimpUndoAccumulator *accum);
 void          gimp_undo_free            (GimpUndo            *undo,
                                          GimpUndoMode         undo_mode);
+gint64        gimp_undo_spill           (GimpUndo            *undo,
+                                         GimpUndoJournal     *journal);
+gboolean      gimp_undo_unspill         (GimpUndo            *undo);
 
 void          gimp_undo_create_preview  (GimpUndo            *undo,
                                          GimpContext         *context,
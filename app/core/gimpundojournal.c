@@ -0,0 +1,382 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#ifdef G_OS_WIN32
+#include <windows.h>
+#include "libgimpbase/gimpwin32-io.h"
+#endif
+
+#include "core-types.h"
+
+#include "base/base-utils.h"
+
+#include "gimpundojournal.h"
+
+#ifndef _O_BINARY
+#define _O_BINARY 0
+#endif
+#ifndef _O_TEMPORARY
+#define _O_TEMPORARY 0
+#endif
+
+#ifdef G_OS_WIN32
+#define LARGE_SEEK(f, o, w)  _lseeki64 (f, o, w)
+#define LARGE_TRUNCATE(f, s) _chsize_s (f, s)
+#else
+#define LARGE_SEEK(f, o, t)  lseek (f, o, t)
+#define LARGE_TRUNCATE(f, s) ftruncate (f, s)
+#endif
+
+
+typedef struct _GimpUndoJournalGap GimpUndoJournalGap;
+
+struct _GimpUndoJournal
+{
+  gint    ref_count;
+
+  gchar  *filename;
+  gint    fd;
+
+  gint64  end;     /*  the end of the file                    */
+  GList  *gaps;    /*  released ranges before end, sorted     */
+};
+
+struct _GimpUndoJournalGap
+{
+  gint64  start;
+  gint64  end;
+};
+
+
+static gint64  gimp_undo_journal_find_offset (GimpUndoJournal *journal,
+                                              gsize            size);
+static void    gimp_undo_journal_add_gap     (GimpUndoJournal *journal,
+                                              gint64           start,
+                                              gint64           end);
+
+
+GimpUndoJournal *
+gimp_undo_journal_new (const gchar *swap_path)
+{
+  static gint      journal_id = 0;
+  GimpUndoJournal *journal;
+  gchar           *dirname;
+  gchar           *basename;
+  gchar           *filename;
+  gint             fd;
+
+  g_return_val_if_fail (swap_path != NULL, NULL);
+
+  dirname = gimp_config_path_expand (swap_path, TRUE, NULL);
+
+  if (! dirname)
+    return NULL;
+
+  /*  stale journals are removed along with stale swap files,
+   *  see base_toast_old_swap_files()
+   */
+  basename = g_strdup_printf ("gimpundo.%lu.%d",
+                              (unsigned long) get_pid (), journal_id++);
+  filename = g_build_filename (dirname, basename, NULL);
+
+  g_free (basename);
+  g_free (dirname);
+
+  fd = g_open (filename,
+               O_CREAT | O_TRUNC | O_RDWR | _O_BINARY | _O_TEMPORARY,
+               S_IRUSR | S_IWUSR);
+
+  if (fd == -1)
+    {
+      g_message ("Unable to open undo journal file '%s': %s",
+                 gimp_filename_to_utf8 (filename), g_strerror (errno));
+      g_free (filename);
+
+      return NULL;
+    }
+
+  journal = g_slice_new0 (GimpUndoJournal);
+
+  journal->ref_count = 1;
+  journal->filename  = filename;
+  journal->fd        = fd;
+
+  return journal;
+}
+
+GimpUndoJournal *
+gimp_undo_journal_ref (GimpUndoJournal *journal)
+{
+  g_return_val_if_fail (journal != NULL, NULL);
+
+  journal->ref_count++;
+
+  return journal;
+}
+
+void
+gimp_undo_journal_unref (GimpUndoJournal *journal)
+{
+  g_return_if_fail (journal != NULL);
+
+  journal->ref_count--;
+
+  if (journal->ref_count < 1)
+    {
+      GList *list;
+
+      close (journal->fd);
+      g_unlink (journal->filename);
+
+      for (list = journal->gaps; list; list = g_list_next (list))
+        g_slice_free (GimpUndoJournalGap, list->data);
+
+      g_list_free (journal->gaps);
+      g_free (journal->filename);
+
+      g_slice_free (GimpUndoJournal, journal);
+    }
+}
+
+/*  Writes @size bytes of @data to the first released range they fit
+ *  in, or to the end of the journal.  Returns their offset in the
+ *  journal, or -1 on failure.
+ */
+gint64
+gimp_undo_journal_append (GimpUndoJournal *journal,
+                          const guchar    *data,
+                          gsize            size)
+{
+  gint64 offset;
+  gsize  n_written = 0;
+
+  g_return_val_if_fail (journal != NULL, -1);
+  g_return_val_if_fail (data != NULL || size == 0, -1);
+
+  if (size == 0)
+    return journal->end;
+
+  offset = gimp_undo_journal_find_offset (journal, size);
+
+  if (LARGE_SEEK (journal->fd, offset, SEEK_SET) != offset)
+    {
+      gimp_undo_journal_release (journal, offset, size);
+
+      return -1;
+    }
+
+  while (n_written < size)
+    {
+      gssize n = write (journal->fd, data + n_written, size - n_written);
+
+      if (n <= 0)
+        {
+          if (n < 0 && errno == EINTR)
+            continue;
+
+          g_message ("Unable to write to undo journal: %s",
+                     g_strerror (errno));
+
+          /*  drop what was written of it  */
+          gimp_undo_journal_release (journal, offset, size);
+
+          return -1;
+        }
+
+      n_written += n;
+    }
+
+  return offset;
+}
+
+gboolean
+gimp_undo_journal_read (GimpUndoJournal *journal,
+                        gint64           offset,
+                        guchar          *data,
+                        gsize            size)
+{
+  gsize n_read = 0;
+
+  g_return_val_if_fail (journal != NULL, FALSE);
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+  g_return_val_if_fail (offset >= 0 && offset + size <= journal->end, FALSE);
+
+  if (LARGE_SEEK (journal->fd, offset, SEEK_SET) != offset)
+    return FALSE;
+
+  while (n_read < size)
+    {
+      gssize n = read (journal->fd, data + n_read, size - n_read);
+
+      if (n <= 0)
+        {
+          if (n < 0 && errno == EINTR)
+            continue;
+
+          return FALSE;
+        }
+
+      n_read += n;
+    }
+
+  return TRUE;
+}
+
+/*  Tells the journal that the @size bytes at @offset are not needed
+ *  any longer, later data can be written there.
+ */
+void
+gimp_undo_journal_release (GimpUndoJournal *journal,
+                           gint64           offset,
+                           gsize            size)
+{
+  g_return_if_fail (journal != NULL);
+  g_return_if_fail (offset >= 0 && offset + size <= journal->end);
+
+  if (size == 0)
+    return;
+
+  gimp_undo_journal_add_gap (journal, offset, offset + size);
+
+  /*  give a released range at the end back to the file system  */
+  if (journal->gaps)
+    {
+      GList              *last = g_list_last (journal->gaps);
+      GimpUndoJournalGap *gap  = last->data;
+
+      if (gap->end == journal->end &&
+          LARGE_TRUNCATE (journal->fd, gap->start) == 0)
+        {
+          journal->end  = gap->start;
+          journal->gaps = g_list_delete_link (journal->gaps, last);
+
+          g_slice_free (GimpUndoJournalGap, gap);
+        }
+    }
+}
+
+
+/*  private functions  */
+
+/*  Hands out @size bytes of the first released range they fit in, or
+ *  of the end of the journal.
+ */
+static gint64
+gimp_undo_journal_find_offset (GimpUndoJournal *journal,
+                               gsize            size)
+{
+  GList  *list;
+  gint64  offset;
+
+  for (list = journal->gaps; list; list = g_list_next (list))
+    {
+      GimpUndoJournalGap *gap = list->data;
+
+      if (gap->end - gap->start >= size)
+        {
+          offset = gap->start;
+          gap->start += size;
+
+          if (gap->start == gap->end)
+            {
+              journal->gaps = g_list_delete_link (journal->gaps, list);
+              g_slice_free (GimpUndoJournalGap, gap);
+            }
+
+          return offset;
+        }
+    }
+
+  offset = journal->end;
+  journal->end += size;
+
+  return offset;
+}
+
+/*  Adds the range from @start to @end to the sorted list of released
+ *  ranges, merging it with its neighbours.
+ */
+static void
+gimp_undo_journal_add_gap (GimpUndoJournal *journal,
+                           gint64           start,
+                           gint64           end)
+{
+  GimpUndoJournalGap *gap;
+  GList              *list;
+  GList              *prev = NULL;
+
+  for (list = journal->gaps; list; list = g_list_next (list))
+    {
+      gap = list->data;
+
+      if (gap->start >= end)
+        break;
+
+      prev = list;
+    }
+
+  if (prev && ((GimpUndoJournalGap *) prev->data)->end == start)
+    {
+      gap = prev->data;
+      gap->end = end;
+
+      /*  it may close the hole to the next range  */
+      if (list && ((GimpUndoJournalGap *) list->data)->start == end)
+        {
+          GimpUndoJournalGap *next = list->data;
+
+          gap->end = next->end;
+
+          journal->gaps = g_list_delete_link (journal->gaps, list);
+          g_slice_free (GimpUndoJournalGap, next);
+        }
+    }
+  else if (list && ((GimpUndoJournalGap *) list->data)->start == end)
+    {
+      gap = list->data;
+      gap->start = start;
+    }
+  else
+    {
+      gap = g_slice_new (GimpUndoJournalGap);
+
+      gap->start = start;
+      gap->end   = end;
+
+      if (list)
+        journal->gaps = g_list_insert_before (journal->gaps, list, gap);
+      else
+        journal->gaps = g_list_append (journal->gaps, gap);
+    }
+}
@@ -0,0 +1,43 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_UNDO_JOURNAL_H__
+#define __GIMP_UNDO_JOURNAL_H__
+
+
+/*  A file in the swap folder that undo steps move their pixel data to
+ *  when the undo-size limit is reached.  Released ranges are reused
+ *  for later data, and the file shrinks when its end is released.
+ */
+
+GimpUndoJournal * gimp_undo_journal_new     (const gchar     *swap_path);
+GimpUndoJournal * gimp_undo_journal_ref     (GimpUndoJournal *journal);
+void              gimp_undo_journal_unref   (GimpUndoJournal *journal);
+
+gint64            gimp_undo_journal_append  (GimpUndoJournal *journal,
+                                             const guchar    *data,
+                                             gsize            size);
+gboolean          gimp_undo_journal_read    (GimpUndoJournal *journal,
+                                             gint64           offset,
+                                             guchar          *data,
+                                             gsize            size);
+void              gimp_undo_journal_release (GimpUndoJournal *journal,
+                                             gint64           offset,
+                                             gsize            size);
+
+
+#endif /* __GIMP_UNDO_JOURNAL_H__ */
@@ -27,16 +27,19 @@
 #include "gimpundostack.h"
 
 
-static void    gimp_undo_stack_finalize    (GObject             *object);
+static void     gimp_undo_stack_finalize    (GObject             *object);
 
-static gint64  gimp_undo_stack_get_memsize (GimpObject          *object,
-                                            gint64              *gui_size);
+static gint64   gimp_undo_stack_get_memsize (GimpObject          *object,
+                                             gint64              *gui_size);
 
-static void    gimp_undo_stack_pop         (GimpUndo            *undo,
-                                            GimpUndoMode         undo_mode,
-                                            GimpUndoAccumulator *accum);
-static void    gimp_undo_stack_free        (GimpUndo            *undo,
-                                            GimpUndoMode         undo_mode);
+static void     gimp_undo_stack_pop         (GimpUndo            *undo,
+                                             GimpUndoMode         undo_mode,
+                                             GimpUndoAccumulator *accum);
+static void     gimp_undo_stack_free        (GimpUndo            *undo,
+                                             GimpUndoMode         undo_mode);
+static gint64   gimp_undo_stack_spill       (GimpUndo            *undo,
+                                             GimpUndoJournal     *journal);
+static gboolean gimp_undo_stack_unspill     (GimpUndo            *undo);
 
 
 G_DEFINE_TYPE (GimpUndoStack, gimp_undo_stack, GIMP_TYPE_UNDO)
@@ -57,6 +60,8 @@ gimp_undo_stack_class_init (GimpUndoStackClass *klass)
 
   undo_class->pop                = gimp_undo_stack_pop;
   undo_class->free               = gimp_undo_stack_free;
+  undo_class->spill              = gimp_undo_stack_spill;
+  undo_class->unspill            = gimp_undo_stack_unspill;
 }
 
 static void
@@ -130,6 +135,45 @@ gimp_undo_stack_free (GimpUndo     *undo,
   gimp_container_clear (stack->undos);
 }
 
+static gint64
+gimp_undo_stack_spill (GimpUndo        *undo,
+                       GimpUndoJournal *journal)
+{
+  GimpUndoStack *stack = GIMP_UNDO_STACK (undo);
+  GList         *list;
+  gint64         freed = 0;
+
+  for (list = GIMP_LIST (stack->undos)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpUndo *child = list->data;
+
+      freed += gimp_undo_spill (child, journal);
+    }
+
+  return freed;
+}
+
+static gboolean
+gimp_undo_stack_unspill (GimpUndo *undo)
+{
+  GimpUndoStack *stack = GIMP_UNDO_STACK (undo);
+  GList         *list;
+
+  for (list = GIMP_LIST (stack->undos)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpUndo *child = list->data;
+
+      if (! gimp_undo_unspill (child))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 GimpUndoStack *
 gimp_undo_stack_new (GimpImage *image)
 {
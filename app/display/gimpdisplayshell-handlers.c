@@ -38,6 +38,7 @@
 #include "core/gimpimage-sample-points.h"
 #include "core/gimpitem.h"
 #include "core/gimpitemstack.h"
+#include "core/gimpprojection.h"
 #include "core/gimpsamplepoint.h"
 #include "core/gimptreehandler.h"
 
@@ -374,6 +375,10 @@ gimp_display_shell_disconnect (GimpDisplayShell *shell)
 
   gimp_display_shell_icon_update_stop (shell);
 
+  /*  the projection outlives us, don't let it render for us first  */
+  gimp_projection_set_priority_rect (gimp_image_get_projection (image),
+                                     shell, 0, 0, 0, 0);
+
   gimp_canvas_layer_boundary_set_layer (GIMP_CANVAS_LAYER_BOUNDARY (shell->layer_boundary),
                                         NULL);
 
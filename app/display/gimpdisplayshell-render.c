@@ -25,6 +25,8 @@
 
 #include "display-types.h"
 
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
 #include "base/tile-manager.h"
 #include "base/tile.h"
 
@@ -40,6 +42,7 @@
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-scroll.h"
+#include "gimpdisplayshell-transform.h"
 
 
 #define GIMP_DISPLAY_ZOOM_FAST     (1 << 0) /* use the fastest possible code
@@ -58,9 +61,11 @@ typedef void (* RenderFunc) (RenderInfo *info);
 
 struct _RenderInfo
 {
+  RenderFunc    render;
   TileManager  *src_tiles;
   const guchar *src;
   gboolean      src_is_premult;
+  guchar       *tile_buf;     /* a row of scaled src, one per thread      */
   guchar       *dest;
   gint          x, y;
   gint          w, h;
@@ -92,8 +97,6 @@ struct _RenderInfo
 };
 
 
-static guchar tile_buf[GIMP_DISPLAY_RENDER_BUF_WIDTH * MAX_CHANNELS];
-
 
 static void  gimp_display_shell_render_info_init (RenderInfo       *info,
                                                   GimpDisplayShell *shell,
@@ -105,6 +108,12 @@ static void  gimp_display_shell_render_info_init (RenderInfo       *info,
                                                   TileManager      *tiles,
                                                   gint              level,
                                                   gboolean          is_premult);
+static void  gimp_display_shell_render_info_start (RenderInfo       *info);
+static void  gimp_display_shell_render_info_run   (RenderInfo       *info,
+                                                   RenderFunc        render,
+                                                   gint              bytes);
+static void  gimp_display_shell_render_region     (const RenderInfo *info,
+                                                   PixelRegion      *destPR);
 
 /*  Render Image functions  */
 
@@ -149,6 +158,20 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   level = gimp_projection_get_level (projection,
                                      shell->scale_x, shell->scale_y);
 
+  /* if that level still needs to be rebuilt, render from a finer one
+   * that is ready; the projection updates us once the level is done
+   */
+  if (level > 0)
+    {
+      gint x1, y1, x2, y2;
+
+      gimp_display_shell_untransform_xy (shell, x, y, &x1, &y1, FALSE);
+      gimp_display_shell_untransform_xy (shell, x + w, y + h, &x2, &y2, TRUE);
+
+      level = gimp_projection_get_valid_level (projection, level,
+                                               x1, y1, x2 - x1, y2 - y1);
+    }
+
   tiles = gimp_projection_get_tiles_at_level (projection, level, &premult);
 
   gimp_display_shell_render_info_init (&info,
@@ -162,10 +185,10 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   switch (type)
     {
     case GIMP_RGBA_IMAGE:
-      render_image_rgb_a (&info);
+      gimp_display_shell_render_info_run (&info, render_image_rgb_a, 4);
       break;
     case GIMP_GRAYA_IMAGE:
-      render_image_gray_a (&info);
+      gimp_display_shell_render_info_run (&info, render_image_gray_a, 4);
       break;
     default:
       g_warning ("%s: unsupported projection type (%d)", G_STRFUNC, type);
@@ -197,7 +220,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                                            shell->mask_surface,
                                            tiles, 0, FALSE);
 
-      render_image_alpha (&info);
+      gimp_display_shell_render_info_run (&info, render_image_alpha, 1);
 
       cairo_surface_mark_dirty (shell->mask_surface);
     }
@@ -387,21 +410,11 @@ gimp_display_shell_render_info_init (RenderInfo       *info,
   info->x_dest_inc  = shell->x_dest_inc >> level;
   info->x_src_dec   = shell->x_src_dec;
 
-  info->dx_start    = ((gint64) info->x_dest_inc * info->x
-                       + info->x_dest_inc / 2);
-
-  info->src_x       = info->dx_start / info->x_src_dec;
-  info->dx_start    = info->dx_start % info->x_src_dec;
-
   /* same for y */
   info->y_dest_inc  = shell->y_dest_inc >> level;
   info->y_src_dec   = shell->y_src_dec;
 
-  info->dy_start    = ((gint64) info->y_dest_inc * info->y
-                       + info->y_dest_inc / 2);
-
-  info->src_y       = info->dy_start / info->y_src_dec;
-  info->dy_start    = info->dy_start % info->y_src_dec;
+  gimp_display_shell_render_info_start (info);
 
   /* make sure that the footprint is in the range 256..512 */
   info->footprint_x = info->x_src_dec;
@@ -442,6 +455,66 @@ gimp_display_shell_render_info_init (RenderInfo       *info,
     }
 }
 
+/*  calculates the source position of the first dest pixel, which
+ *  depends on nothing but info->x and info->y, so that any part of
+ *  the area can be rendered on its own
+ */
+static void
+gimp_display_shell_render_info_start (RenderInfo *info)
+{
+  info->dx_start    = ((gint64) info->x_dest_inc * info->x
+                       + info->x_dest_inc / 2);
+
+  info->src_x       = info->dx_start / info->x_src_dec;
+  info->dx_start    = info->dx_start % info->x_src_dec;
+
+  info->dy_start    = ((gint64) info->y_dest_inc * info->y
+                       + info->y_dest_inc / 2);
+
+  info->src_y       = info->dy_start / info->y_src_dec;
+  info->dy_start    = info->dy_start % info->y_src_dec;
+}
+
+/*  renders the area of info in parallel, split into tile sized parts
+ *  of the destination surface
+ */
+static void
+gimp_display_shell_render_info_run (RenderInfo *info,
+                                    RenderFunc  render,
+                                    gint        bytes)
+{
+  PixelRegion destPR;
+
+  info->render = render;
+
+  pixel_region_init_data (&destPR, info->dest, bytes, info->dest_bpl,
+                          0, 0, info->w, info->h);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_display_shell_render_region,
+                                  info, 1, &destPR);
+}
+
+static void
+gimp_display_shell_render_region (const RenderInfo *info,
+                                  PixelRegion      *destPR)
+{
+  RenderInfo part = *info;
+  guchar     tile_buf[GIMP_DISPLAY_RENDER_BUF_WIDTH * MAX_CHANNELS];
+
+  part.x        = info->x + destPR->x;
+  part.y        = info->y + destPR->y;
+  part.w        = destPR->w;
+  part.h        = destPR->h;
+  part.dest     = destPR->data;
+  part.dest_bpl = destPR->rowstride;
+  part.tile_buf = tile_buf;
+
+  gimp_display_shell_render_info_start (&part);
+
+  part.render (&part);
+}
+
 /* This version assumes that the src data is already pre-multiplied. */
 static inline void
 box_filter (const guint    left_weight,
@@ -712,7 +785,7 @@ render_image_tile_fault (RenderInfo *info)
                                    info->src_x - 1, info->src_y - 1,
                                    TRUE, FALSE);
 
-  g_return_val_if_fail (tile[4] != NULL, tile_buf);
+  g_return_val_if_fail (tile[4] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[4], info->src_x, info->src_y);
 
@@ -789,7 +862,7 @@ render_image_tile_fault (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -1053,7 +1126,7 @@ done:
     if (tile[dx])
       tile_release (tile[dx], FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 static const guchar *
@@ -1114,7 +1187,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
   tile[2] = tile_manager_get_tile (info->src_tiles,
                                    info->src_x - 1, info->src_y, TRUE, FALSE);
 
-  g_return_val_if_fail (tile[0] != NULL, tile_buf);
+  g_return_val_if_fail (tile[0] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[0], info->src_x, info->src_y);
   src[7] = tile_data_pointer (tile[0], info->src_x, info->src_y + 1);
@@ -1169,7 +1242,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -1346,7 +1419,7 @@ done:
     if (tile[dx])
       tile_release (tile[dx], FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 /* function to render a horizontal line of view data */
@@ -1365,7 +1438,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
   tile = tile_manager_get_tile (info->src_tiles,
                                 info->src_x, info->src_y, TRUE, FALSE);
 
-  g_return_val_if_fail (tile != NULL, tile_buf);
+  g_return_val_if_fail (tile != NULL, info->tile_buf);
 
   src = tile_data_pointer (tile, info->src_x, info->src_y);
 
@@ -1378,7 +1451,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
   src_x = info->src_x;
   tilex = info->src_x / TILE_WIDTH;
 
-  d     = tile_buf;
+  d     = info->tile_buf;
 
   do
     {
@@ -1450,7 +1523,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
               tile = tile_manager_get_tile (info->src_tiles,
                                             src_x, info->src_y, TRUE, FALSE);
               if (! tile)
-                return tile_buf;
+                return info->tile_buf;
 
               src = tile_data_pointer (tile, src_x, info->src_y);
             }
@@ -1460,5 +1533,5 @@ render_image_tile_fault_nearest (RenderInfo *info)
 
   tile_release (tile, FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
@@ -19,8 +19,8 @@
 #define __GIMP_DISPLAY_SHELL_RENDER_H__
 
 
-#define GIMP_DISPLAY_RENDER_BUF_WIDTH  256
-#define GIMP_DISPLAY_RENDER_BUF_HEIGHT 256
+#define GIMP_DISPLAY_RENDER_BUF_WIDTH  512
+#define GIMP_DISPLAY_RENDER_BUF_HEIGHT 512
 
 
 void  gimp_display_shell_render (GimpDisplayShell *shell,
@@ -158,6 +158,8 @@ static void   gimp_display_shell_transform_overlay (GimpDisplayShell *shell,
                                                     GtkWidget        *child,
                                                     gdouble          *x,
                                                     gdouble          *y);
+static void   gimp_display_shell_update_priority_rect
+                                                   (GimpDisplayShell *shell);
 
 
 G_DEFINE_TYPE_WITH_CODE (GimpDisplayShell, gimp_display_shell,
@@ -1152,6 +1154,24 @@ gimp_display_shell_transform_overlay (GimpDisplayShell *shell,
     }
 }
 
+/*  let the projection render what we show first  */
+static void
+gimp_display_shell_update_priority_rect (GimpDisplayShell *shell)
+{
+  GimpImage *image = gimp_display_get_image (shell->display);
+
+  if (image)
+    {
+      gint x, y, width, height;
+
+      gimp_display_shell_untransform_viewport (shell,
+                                               &x, &y, &width, &height);
+
+      gimp_projection_set_priority_rect (gimp_image_get_projection (image),
+                                         shell, x, y, width, height);
+    }
+}
+
 
 /*  public functions  */
 
@@ -1448,6 +1468,8 @@ gimp_display_shell_scaled (GimpDisplayShell *shell)
                                            child, x, y);
     }
 
+  gimp_display_shell_update_priority_rect (shell);
+
   g_signal_emit (shell, display_shell_signals[SCALED], 0);
 }
 
@@ -1469,6 +1491,8 @@ gimp_display_shell_scrolled (GimpDisplayShell *shell)
                                            child, x, y);
     }
 
+  gimp_display_shell_update_priority_rect (shell);
+
   g_signal_emit (shell, display_shell_signals[SCROLLED], 0);
 }
 
@@ -131,6 +131,7 @@ static gboolean            use_shm           = FALSE;
 static gboolean            use_cpu_accel     = TRUE;
 static gboolean            console_messages  = FALSE;
 static gboolean            use_debug_handler = FALSE;
+static gboolean            profile_startup   = FALSE;
 
 #ifdef GIMP_UNSTABLE
 static GimpStackTraceMode  stack_trace_mode  = GIMP_STACK_TRACE_QUERY;
@@ -244,6 +245,11 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_NONE, &use_debug_handler,
     N_("Enable non-fatal debugging signal handlers"), NULL
   },
+  {
+    "profile-startup", 0, 0,
+    G_OPTION_ARG_NONE, &profile_startup,
+    N_("Print how long each step of the startup takes"), NULL
+  },
   {
     "g-fatal-warnings", 0, G_OPTION_FLAG_NO_ARG,
     G_OPTION_ARG_CALLBACK, gimp_option_fatal_warnings,
@@ -412,7 +418,8 @@ main (int    argc,
       app_exit (EXIT_FAILURE);
     }
 
-  if (no_interface || be_verbose || console_messages || batch_commands != NULL)
+  if (no_interface || be_verbose || console_messages || profile_startup ||
+      batch_commands != NULL)
     gimp_open_console_window ();
 
   if (no_interface)
@@ -454,6 +461,7 @@ main (int    argc,
            use_cpu_accel,
            console_messages,
            use_debug_handler,
+           profile_startup,
            stack_trace_mode,
            pdb_compat_mode);
 
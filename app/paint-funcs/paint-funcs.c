@@ -2553,149 +2553,127 @@ rotate_pointers (guchar  **p,
 }
 
 
+/*  Returns the distance of a pixel with the given opacity whose
+ *  neighbour has the distance @from, which is zero for transparent
+ *  pixels and the outside of the region.  The fractional part is the
+ *  lowest opacity of the pixels on the way.
+ */
+static inline gfloat
+shapeburst_step (gfloat from,
+                 guchar opacity)
+{
+  gint distance;
+  gint fraction;
+
+  if (from < 1.0)
+    return 1.0 + opacity / 256.0;
+
+  distance = (gint) from;
+  fraction = (gint) ((from - distance) * 256.0 + 0.5);
+
+  return distance + 1.0 + MIN (fraction, opacity) / 256.0;
+}
+
+/*  Computes the Manhattan distance of every pixel in srcPR to the
+ *  nearest transparent pixel or to the outside of the region.  The
+ *  fractional part of a distance is the lowest opacity along the path
+ *  to that pixel, see shapeburst_step().
+ *
+ *  This is the usual two-pass distance transform: a forward pass
+ *  propagates the distances from the left and top neighbours, a
+ *  backward pass those from the right and bottom ones.  Apart from
+ *  the distance map itself only two rows of memory are needed.
+ */
 gfloat
 shapeburst_region (PixelRegion      *srcPR,
                    PixelRegion      *distPR,
                    GimpProgressFunc  progress_callback,
                    gpointer          progress_data)
 {
-  Tile   *tile;
-  guchar *tile_data;
-  gfloat  max_iterations = 0.0;
-  gfloat *distp_cur;
-  gfloat *distp_prev;
-  gfloat *memory;
-  gfloat *tmp;
-  gfloat  min_prev;
-  gfloat  float_tmp;
-  gint    min;
-  gint    min_left;
-  gint    length;
-  gint    i, j, k;
-  gint    fraction;
-  gint    prev_frac;
-  gint    x, y;
-  gint    end;
-  gint    boundary;
-  gint    inc;
-  gint    src          = 0;
-  gint    max_progress = srcPR->w * srcPR->h;
-  gint    progress     = 0;
-
-  length = distPR->w + 1;
-  memory = g_new (gfloat, length * 2);
-
-  distp_prev = memory;
-  for (i = 0; i < length; i++)
-    distp_prev[i] = 0.0;
-
-  distp_prev += 1;
-  distp_cur = distp_prev + length;
-
-  for (i = 0; i < srcPR->h; i++)
+  const gint  width        = srcPR->w;
+  const gint  height       = srcPR->h;
+  const gint  max_progress = 2 * height;
+  gfloat      max_distance = 0.0;
+  guchar     *src;
+  gfloat     *memory;
+  gfloat     *prev;
+  gfloat     *cur;
+  gint        x, y;
+
+  src    = g_new (guchar, width);
+  memory = g_new0 (gfloat, 2 * (width + 2));
+
+  /*  keep a zero at either end of the rows for the outside  */
+  prev = memory + 1;
+  cur  = prev + width + 2;
+
+  /*  forward pass  */
+  for (y = 0; y < height; y++)
     {
-      /*  set the current dist row to 0's  */
-      memset (distp_cur - 1, 0, sizeof (gfloat) * (length - 1));
-
-      for (j = 0; j < srcPR->w; j++)
-        {
-          min_prev = MIN (distp_cur[j-1], distp_prev[j]);
-          min_left = MIN ((srcPR->w - j - 1), (srcPR->h - i - 1));
-          min = (gint) MIN (min_left, min_prev);
-          fraction = 255;
-
-          /*  This might need to be changed to 0
-              instead of k = (min) ? (min - 1) : 0  */
-
-          for (k = (min) ? (min - 1) : 0; k <= min; k++)
-            {
-              x = j;
-              y = i + k;
-              end = y - k;
-
-              while (y >= end)
-                {
-                  gint width;
+      gfloat *tmp;
 
-                  tile = tile_manager_get_tile (srcPR->tiles,
-                                                x, y, TRUE, FALSE);
+      pixel_region_get_row (srcPR, srcPR->x, srcPR->y + y, width, src, 1);
 
-                  tile_data = tile_data_pointer (tile, x, y);
-                  width = tile_ewidth (tile);
-
-                  boundary = MIN (y % TILE_HEIGHT,
-                                  width - (x % TILE_WIDTH) - 1);
-                  boundary = MIN (boundary, y - end) + 1;
+      for (x = 0; x < width; x++)
+        {
+          if (src[x])
+            cur[x] = MIN (shapeburst_step (cur[x - 1], src[x]),
+                          shapeburst_step (prev[x],    src[x]));
+          else
+            cur[x] = 0.0;
+        }
 
-                  inc = 1 - width;
+      pixel_region_set_row (distPR, distPR->x, distPR->y + y, width,
+                            (guchar *) cur);
 
-                  while (boundary--)
-                    {
-                      src = *tile_data;
+      tmp  = prev;
+      prev = cur;
+      cur  = tmp;
 
-                      if (src == 0)
-                        {
-                          min = k;
-                          y = -1;
-                          break;
-                        }
+      if (progress_callback)
+        (* progress_callback) (0, max_progress, y + 1, progress_data);
+    }
 
-                      if (src < fraction)
-                        fraction = src;
+  /*  backward pass, prev is the row below now  */
+  memset (memory, 0, 2 * (width + 2) * sizeof (gfloat));
 
-                      x++;
-                      y--;
-                      tile_data += inc;
-                    }
+  for (y = height - 1; y >= 0; y--)
+    {
+      gfloat *tmp;
 
-                  tile_release (tile, FALSE);
-                }
-            }
+      pixel_region_get_row (srcPR, srcPR->x, srcPR->y + y, width, src, 1);
+      pixel_region_get_row (distPR, distPR->x, distPR->y + y, width,
+                            (guchar *) cur, 1);
 
-          if (src != 0)
+      for (x = width - 1; x >= 0; x--)
+        {
+          if (src[x])
             {
-              /*  If min_left != min_prev use the previous fraction
-               *   if it is less than the one found
-               */
-              if (min_left != min)
-                {
-                  prev_frac = (int) (255 * (min_prev - min));
-
-                  if (prev_frac == 255)
-                    prev_frac = 0;
+              gfloat d = MIN (shapeburst_step (cur[x + 1], src[x]),
+                              shapeburst_step (prev[x],    src[x]));
 
-                  fraction = MIN (fraction, prev_frac);
-                }
+              cur[x] = MIN (cur[x], d);
 
-              min++;
+              if (cur[x] > max_distance)
+                max_distance = cur[x];
             }
-
-          float_tmp = distp_cur[j] = min + fraction / 256.0;
-
-          if (float_tmp > max_iterations)
-            max_iterations = float_tmp;
         }
 
-      /*  set the dist row  */
-      pixel_region_set_row (distPR,
-                            distPR->x, distPR->y + i, distPR->w,
-                            (guchar *) distp_cur);
+      pixel_region_set_row (distPR, distPR->x, distPR->y + y, width,
+                            (guchar *) cur);
 
-      /*  swap pointers around  */
-      tmp = distp_prev;
-      distp_prev = distp_cur;
-      distp_cur = tmp;
+      tmp  = prev;
+      prev = cur;
+      cur  = tmp;
 
       if (progress_callback)
-        {
-          progress += srcPR->h;
-          (* progress_callback) (0, max_progress, progress, progress_data);
-        }
+        (* progress_callback) (0, max_progress, 2 * height - y, progress_data);
     }
 
   g_free (memory);
+  g_free (src);
 
-  return max_iterations;
+  return max_distance;
 }
 
 static void
@@ -21,12 +21,18 @@
 
 #include <glib-object.h>
 
+#if defined (USE_SSE) && defined (__SSE2__)
+#define USE_SSE2_SCALE
+#include <emmintrin.h>
+#endif
+
 #include "libgimpmath/gimpmath.h"
 
 #include "paint-funcs-types.h"
 
 #include "base/tile.h"
 #include "base/tile-manager.h"
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
 #include "base/pixel-surround.h"
 
@@ -40,6 +46,31 @@
                         (((h) + (TILE_HEIGHT - 1)) / TILE_HEIGHT))
 
 
+typedef struct
+{
+  gint    n_taps;
+  gint   *index;     /* clamped source positions, n_taps per destination */
+  gfloat *weight;    /* the matching (normalised) filter weights          */
+} ScaleWeights;
+
+typedef struct
+{
+  TileManager  *srcTM;
+  gint          bytes;
+  ScaleWeights  x;
+  ScaleWeights  y;
+} ScaleSeparable;
+
+typedef struct
+{
+  GimpProgressFunc  callback;
+  gpointer          data;
+  gint              base;
+  gint              n_tiles;
+  gint              max_progress;
+} ScaleProgress;
+
+
 static void           scale_determine_levels   (PixelRegion           *srcPR,
                                                 PixelRegion           *dstPR,
                                                 gint                  *levelx,
@@ -63,6 +94,22 @@ static void           scale                    (TileManager           *srcTM,
                                                 gpointer               progress_data,
                                                 gint                  *progress,
                                                 gint                   max_progress);
+static void           scale_separable          (TileManager           *srcTM,
+                                                TileManager           *dstTM,
+                                                GimpInterpolationType  interpolation,
+                                                GimpProgressFunc       progress_callback,
+                                                gpointer               progress_data,
+                                                gint                  *progress,
+                                                gint                   max_progress);
+static void           scale_weights_init       (ScaleWeights          *weights,
+                                                gint                   src_size,
+                                                gint                   dst_size,
+                                                GimpInterpolationType  interpolation,
+                                                const gfloat          *kernel_lookup);
+static void           scale_separable_region   (ScaleSeparable        *separable,
+                                                PixelRegion           *dest);
+static void           scale_separable_progress (ScaleProgress         *progress,
+                                                gdouble                fraction);
 static void           decimate_xy              (TileManager           *srcTM,
                                                 TileManager           *dstTM,
                                                 GimpInterpolationType  interpolation,
@@ -105,29 +152,7 @@ static void           interpolate_nearest      (TileManager   *srcTM,
                                                 const gdouble  xfrac,
                                                 const gdouble  yfrac,
                                                 guchar        *pixel);
-static void           interpolate_bilinear     (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static void           interpolate_cubic        (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel);
 static gfloat *       create_lanczos3_lookup   (void);
-static void           interpolate_lanczos3     (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel,
-                                                const gfloat  *kernel_lookup);
 static void           interpolate_bilinear_pr  (PixelRegion   *srcPR,
                                                 const gint     x0,
                                                 const gint     y0,
@@ -136,11 +161,6 @@ static void           interpolate_bilinear_pr  (PixelRegion   *srcPR,
                                                 const gdouble  xfrac,
                                                 const gdouble  yfrac,
                                                 guchar        *pixel);
-static inline gdouble cubic_spline_fit         (const gdouble  dx,
-                                                const gdouble  x1,
-                                                const gdouble  y1,
-                                                const gdouble  x2,
-                                                const gdouble  y2);
 static inline gdouble weighted_sum             (const gdouble  dx,
                                                 const gdouble  dy,
                                                 const gint     s00,
@@ -148,18 +168,6 @@ static inline gdouble weighted_sum             (const gdouble  dx,
                                                 const gint     s01,
                                                 const gint     s11);
 static inline gdouble sinc                     (const gdouble  x);
-static inline gdouble lanczos3_mul_alpha       (const guchar  *pixels,
-                                                const gdouble *x_kernel,
-                                                const gdouble *y_kernel,
-                                                const gint     stride,
-                                                const gint     bytes,
-                                                const gint     byte);
-static inline gdouble lanczos3_mul             (const guchar  *pixels,
-                                                const gdouble *x_kernel,
-                                                const gdouble *y_kernel,
-                                                const gint     stride,
-                                                const gint     bytes,
-                                                const gint     byte);
 
 
 
@@ -446,16 +454,13 @@ scale (TileManager           *srcTM,
        gint                   max_progress)
 {
   PixelRegion     region;
-  PixelSurround  *surround   = NULL;
   const guint     src_width  = tile_manager_width  (srcTM);
   const guint     src_height = tile_manager_height (srcTM);
-  const guint     bytes      = tile_manager_bpp    (dstTM);
   const guint     dst_width  = tile_manager_width  (dstTM);
   const guint     dst_height = tile_manager_height (dstTM);
   const gdouble   scaley     = (gdouble) src_height / (gdouble) dst_height;
   const gdouble   scalex     = (gdouble) src_width  / (gdouble) dst_width;
   gpointer        pr;
-  gfloat         *kernel_lookup = NULL;
 
   GIMP_LOG (SCALE, "scale: %dx%d -> %dx%d",
             src_width, src_height, dst_width, dst_height);
@@ -475,23 +480,12 @@ scale (TileManager           *srcTM,
         }
     }
 
-  switch (interpolation)
+  if (interpolation != GIMP_INTERPOLATION_NONE)
     {
-    case GIMP_INTERPOLATION_NONE:
-      break;
-
-    case GIMP_INTERPOLATION_LINEAR:
-      surround = pixel_surround_new (srcTM, 2, 2, PIXEL_SURROUND_SMEAR);
-      break;
-
-    case GIMP_INTERPOLATION_CUBIC:
-      surround = pixel_surround_new (srcTM, 4, 4, PIXEL_SURROUND_SMEAR);
-      break;
-
-    case GIMP_INTERPOLATION_LANCZOS:
-      surround = pixel_surround_new (srcTM, 6, 6, PIXEL_SURROUND_SMEAR);
-      kernel_lookup = create_lanczos3_lookup ();
-      break;
+      scale_separable (srcTM, dstTM, interpolation,
+                       progress_callback, progress_data,
+                       progress, max_progress);
+      return;
     }
 
   pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
@@ -521,28 +515,7 @@ scale (TileManager           *srcTM,
 
               xfrac = xfrac - sx;
 
-              switch (interpolation)
-                {
-                case GIMP_INTERPOLATION_NONE:
-                  interpolate_nearest (srcTM, sx, sy, xfrac, yfrac, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_LINEAR:
-                  interpolate_bilinear (surround,
-                                        sx, sy, xfrac, yfrac, bytes, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_CUBIC:
-                  interpolate_cubic (surround,
-                                     sx, sy, xfrac, yfrac, bytes, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_LANCZOS:
-                  interpolate_lanczos3 (surround,
-                                        sx, sy, xfrac, yfrac, bytes, pixel,
-                                        kernel_lookup);
-                  break;
-                }
+              interpolate_nearest (srcTM, sx, sy, xfrac, yfrac, pixel);
 
               pixel += region.bytes;
             }
@@ -558,12 +531,395 @@ scale (TileManager           *srcTM,
             progress_callback (0, max_progress, *progress, progress_data);
         }
     }
+}
 
-  if (kernel_lookup)
-    g_free (kernel_lookup);
+/*  The interpolating kernels are separable, so instead of evaluating
+ *  the full 2x2, 4x4 or 6x6 neighbourhood for every destination pixel
+ *  the filter is applied as a horizontal pass into a float buffer
+ *  followed by a vertical pass.  Source positions and weights only
+ *  depend on the destination column (or row), so they are computed
+ *  once per scale step.  Destination tiles are independent and are
+ *  handed to the pixel processor.
+ */
+static void
+scale_separable (TileManager           *srcTM,
+                 TileManager           *dstTM,
+                 GimpInterpolationType  interpolation,
+                 GimpProgressFunc       progress_callback,
+                 gpointer               progress_data,
+                 gint                  *progress,
+                 gint                   max_progress)
+{
+  ScaleSeparable  separable;
+  PixelRegion     region;
+  const gint      dst_width     = tile_manager_width  (dstTM);
+  const gint      dst_height    = tile_manager_height (dstTM);
+  gfloat         *kernel_lookup = NULL;
+
+  if (interpolation == GIMP_INTERPOLATION_LANCZOS)
+    kernel_lookup = create_lanczos3_lookup ();
+
+  separable.srcTM = srcTM;
+  separable.bytes = tile_manager_bpp (dstTM);
 
-  if (surround)
-    pixel_surround_destroy (surround);
+  scale_weights_init (&separable.x, tile_manager_width (srcTM), dst_width,
+                      interpolation, kernel_lookup);
+  scale_weights_init (&separable.y, tile_manager_height (srcTM), dst_height,
+                      interpolation, kernel_lookup);
+
+  g_free (kernel_lookup);
+
+  pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
+
+  if (progress_callback)
+    {
+      ScaleProgress scale_progress;
+
+      scale_progress.callback     = progress_callback;
+      scale_progress.data         = progress_data;
+      scale_progress.base         = *progress;
+      scale_progress.n_tiles      = NUM_TILES (dst_width, dst_height);
+      scale_progress.max_progress = max_progress;
+
+      pixel_regions_process_parallel_progress ((PixelProcessorFunc)
+                                               scale_separable_region,
+                                               &separable,
+                                               (PixelProcessorProgressFunc)
+                                               scale_separable_progress,
+                                               &scale_progress,
+                                               1, &region);
+
+      *progress += scale_progress.n_tiles;
+    }
+  else
+    {
+      pixel_regions_process_parallel ((PixelProcessorFunc)
+                                      scale_separable_region,
+                                      &separable, 1, &region);
+    }
+
+  g_free (separable.x.index);
+  g_free (separable.x.weight);
+  g_free (separable.y.index);
+  g_free (separable.y.weight);
+}
+
+static void
+scale_separable_progress (ScaleProgress *progress,
+                          gdouble        fraction)
+{
+  progress->callback (0, progress->max_progress,
+                      progress->base + fraction * progress->n_tiles,
+                      progress->data);
+}
+
+static void
+scale_weights_init (ScaleWeights          *weights,
+                    gint                   src_size,
+                    gint                   dst_size,
+                    GimpInterpolationType  interpolation,
+                    const gfloat          *kernel_lookup)
+{
+  const gdouble scale = (gdouble) src_size / (gdouble) dst_size;
+  gint          first;
+  gint          d, i;
+
+  switch (interpolation)
+    {
+    case GIMP_INTERPOLATION_CUBIC:
+      weights->n_taps = 4;
+      first           = -1;
+      break;
+
+    case GIMP_INTERPOLATION_LANCZOS:
+      weights->n_taps = 6;
+      first           = -2;
+      break;
+
+    default:
+      weights->n_taps = 2;
+      first           = 0;
+      break;
+    }
+
+  weights->index  = g_new (gint,   dst_size * weights->n_taps);
+  weights->weight = g_new (gfloat, dst_size * weights->n_taps);
+
+  for (d = 0; d < dst_size; d++)
+    {
+      gint    *index  = weights->index  + d * weights->n_taps;
+      gfloat  *weight = weights->weight + d * weights->n_taps;
+      gdouble  frac   = (d + 0.5) * scale - 0.5;
+      gint     s      = (gint) frac;
+
+      frac = frac - s;
+
+      switch (interpolation)
+        {
+        case GIMP_INTERPOLATION_CUBIC:
+          /*  Catmull-Rom spline, expanded into per-tap weights  */
+          weight[0] = ((-frac + 2.0) * frac - 1.0) * frac / 2.0;
+          weight[1] = ((3.0 * frac - 5.0) * frac * frac + 2.0) / 2.0;
+          weight[2] = ((-3.0 * frac + 4.0) * frac + 1.0) * frac / 2.0;
+          weight[3] = (frac - 1.0) * frac * frac / 2.0;
+          break;
+
+        case GIMP_INTERPOLATION_LANCZOS:
+          {
+            const gint shift  = (gint) (frac * LANCZOS_SPP + 0.5);
+            gdouble    kernel[6];
+            gdouble    sum    = 0.0;
+
+            for (i = 0; i < 6; i++)
+              {
+                kernel[i] = kernel_lookup[ABS (shift - (i - 2) * LANCZOS_SPP)];
+                sum += kernel[i];
+              }
+
+            for (i = 0; i < 6; i++)
+              weight[i] = kernel[i] / sum;
+          }
+          break;
+
+        default:
+          weight[0] = 1.0 - frac;
+          weight[1] = frac;
+          break;
+        }
+
+      for (i = 0; i < weights->n_taps; i++)
+        index[i] = CLAMP (s + first + i, 0, src_size - 1);
+    }
+}
+
+/*  convert a row of source pixels to floats, premultiplying the
+ *  color channels by alpha so that the filter doesn't bleed color
+ *  out of transparent areas
+ */
+static inline void
+scale_separable_load (const guchar *src,
+                      gfloat       *dest,
+                      const gint    width,
+                      const gint    bytes)
+{
+  gint x, b;
+
+  switch (bytes)
+    {
+    case 1:
+    case 3:
+      for (x = 0; x < width * bytes; x++)
+        dest[x] = src[x];
+      break;
+
+    case 2:
+    case 4:
+      for (x = 0; x < width; x++, src += bytes, dest += bytes)
+        {
+          const gfloat alpha = src[bytes - 1];
+
+          for (b = 0; b < bytes - 1; b++)
+            dest[b] = src[b] * alpha;
+
+          dest[bytes - 1] = alpha;
+        }
+      break;
+    }
+}
+
+/*  the horizontal pass; bytes and n_taps are constants after
+ *  inlining, which lets the compiler keep a whole pixel in one
+ *  vector register
+ */
+static inline void
+scale_separable_row (const gfloat *src,
+                     gfloat       *dest,
+                     const gint   *index,
+                     const gfloat *weight,
+                     const gint    offset,
+                     const gint    width,
+                     const gint    n_taps,
+                     const gint    bytes)
+{
+  gint x, t, b;
+
+  for (x = 0; x < width; x++, index += n_taps, weight += n_taps)
+    {
+      gfloat sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+      for (t = 0; t < n_taps; t++)
+        {
+          const gfloat *s = src + (index[t] - offset) * bytes;
+
+          for (b = 0; b < bytes; b++)
+            sum[b] += weight[t] * s[b];
+        }
+
+      for (b = 0; b < bytes; b++)
+        *dest++ = sum[b];
+    }
+}
+
+#define SCALE_SEPARABLE_ROW(taps)                                           \
+  switch (bytes)                                                            \
+    {                                                                       \
+    case 1: scale_separable_row (src, dest, index, weight, offset, width,   \
+                                 taps, 1); break;                           \
+    case 2: scale_separable_row (src, dest, index, weight, offset, width,   \
+                                 taps, 2); break;                           \
+    case 3: scale_separable_row (src, dest, index, weight, offset, width,   \
+                                 taps, 3); break;                           \
+    case 4: scale_separable_row (src, dest, index, weight, offset, width,   \
+                                 taps, 4); break;                           \
+    }
+
+static void
+scale_separable_row_n (const gfloat *src,
+                       gfloat       *dest,
+                       const gint   *index,
+                       const gfloat *weight,
+                       gint          offset,
+                       gint          width,
+                       gint          n_taps,
+                       gint          bytes)
+{
+  switch (n_taps)
+    {
+    case 2: SCALE_SEPARABLE_ROW (2); break;
+    case 4: SCALE_SEPARABLE_ROW (4); break;
+    case 6: SCALE_SEPARABLE_ROW (6); break;
+    }
+}
+
+#undef SCALE_SEPARABLE_ROW
+
+/*  the vertical pass, adds @width floats of a row times @weight to
+ *  @sum; the SSE2 version does four floats at a time
+ */
+static inline void
+scale_separable_accumulate (gfloat       *sum,
+                            const gfloat *src,
+                            const gfloat  weight,
+                            const gint    width)
+{
+  gint x = 0;
+
+#ifdef USE_SSE2_SCALE
+  const __m128 w = _mm_set1_ps (weight);
+
+  for (; x + 4 <= width; x += 4)
+    {
+      const __m128 s = _mm_loadu_ps (src + x);
+
+      _mm_storeu_ps (sum + x, _mm_add_ps (_mm_loadu_ps (sum + x),
+                                          _mm_mul_ps (w, s)));
+    }
+#endif
+
+  for (; x < width; x++)
+    sum[x] += weight * src[x];
+}
+
+/*  convert the filtered (premultiplied) floats back to pixels  */
+static inline void
+scale_separable_store (const gfloat *src,
+                       guchar       *dest,
+                       const gint    width,
+                       const gint    bytes)
+{
+  gint x, b;
+
+  switch (bytes)
+    {
+    case 1:
+    case 3:
+      for (x = 0; x < width * bytes; x++)
+        dest[x] = CLAMP (src[x], 0, 255);
+      break;
+
+    case 2:
+    case 4:
+      for (x = 0; x < width; x++, src += bytes, dest += bytes)
+        {
+          const gfloat alphasum = src[bytes - 1];
+
+          if (alphasum > 0)
+            {
+              for (b = 0; b < bytes - 1; b++)
+                {
+                  const gfloat sum = src[b] / alphasum;
+
+                  dest[b] = CLAMP (sum, 0, 255);
+                }
+
+              dest[bytes - 1] = CLAMP (alphasum, 0, 255);
+            }
+          else
+            {
+              for (b = 0; b < bytes; b++)
+                dest[b] = 0;
+            }
+        }
+      break;
+    }
+}
+
+static void
+scale_separable_region (ScaleSeparable *separable,
+                        PixelRegion    *dest)
+{
+  const gint    bytes   = separable->bytes;
+  const gint    x_taps  = separable->x.n_taps;
+  const gint    y_taps  = separable->y.n_taps;
+  const gint   *x_index = separable->x.index  + dest->x * x_taps;
+  const gfloat *x_wght  = separable->x.weight + dest->x * x_taps;
+  const gint   *y_index = separable->y.index  + dest->y * y_taps;
+  const gfloat *y_wght  = separable->y.weight + dest->y * y_taps;
+  /*  the tables are monotonic, so the first and last tap of the
+   *  region bound the source area it needs
+   */
+  const gint    sx1     = x_index[0];
+  const gint    sx2     = x_index[dest->w * x_taps - 1];
+  const gint    sy1     = y_index[0];
+  const gint    sy2     = y_index[dest->h * y_taps - 1];
+  const gint    src_w   = sx2 - sx1 + 1;
+  const gint    src_h   = sy2 - sy1 + 1;
+  const gint    stride  = dest->w * bytes;
+  guchar       *src     = g_new (guchar, src_w * src_h * bytes);
+  gfloat       *row     = g_new (gfloat, src_w * bytes);
+  gfloat       *tmp     = g_new (gfloat, src_h * stride);
+  gfloat       *sum     = g_new (gfloat, stride);
+  guchar       *d       = dest->data;
+  gint          x, y, t;
+
+  tile_manager_read_pixel_data (separable->srcTM, sx1, sy1, sx2, sy2,
+                                src, src_w * bytes);
+
+  for (y = 0; y < src_h; y++)
+    {
+      scale_separable_load (src + y * src_w * bytes, row, src_w, bytes);
+      scale_separable_row_n (row, tmp + y * stride, x_index, x_wght,
+                             sx1, dest->w, x_taps, bytes);
+    }
+
+  for (y = 0; y < dest->h; y++, y_index += y_taps, y_wght += y_taps)
+    {
+      for (x = 0; x < stride; x++)
+        sum[x] = 0.0;
+
+      for (t = 0; t < y_taps; t++)
+        scale_separable_accumulate (sum, tmp + (y_index[t] - sy1) * stride,
+                                    y_wght[t], stride);
+
+      scale_separable_store (sum, d, dest->w, bytes);
+
+      d += dest->rowstride;
+    }
+
+  g_free (sum);
+  g_free (tmp);
+  g_free (row);
+  g_free (src);
 }
 
 static void
@@ -1029,375 +1385,6 @@ weighted_sum (const gdouble dx,
           ((1 - dx) * s00 + dx * s10) + dy * ((1 - dx) * s01 + dx * s11));
 }
 
-static void
-interpolate_bilinear (PixelSurround *surround,
-                      const gint     x0,
-                      const gint     y0,
-                      const gdouble  xfrac,
-                      const gdouble  yfrac,
-                      const gint     bytes,
-                      guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0, y0, &stride);
-  const guchar *p1  = src;
-  const guchar *p2  = p1 + bytes;
-  const guchar *p3  = src + stride;
-  const guchar *p4  = p3 + bytes;
-  gdouble       sum;
-  gdouble       alphasum;
-  gint          b;
-
-  switch (bytes)
-    {
-    case 1:
-      sum = weighted_sum (xfrac, yfrac, p1[0], p2[0], p3[0], p4[0]);
-
-      pixel[0] = CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      alphasum = weighted_sum (xfrac, yfrac, p1[1], p2[1], p3[1], p4[1]);
-      if (alphasum > 0)
-        {
-          sum = weighted_sum (xfrac, yfrac,
-                              p1[0] * p1[1], p2[0] * p2[1],
-                              p3[0] * p3[1], p4[0] * p4[1]);
-          sum /= alphasum;
-
-          pixel[0] = CLAMP (sum, 0, 255);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          sum = weighted_sum (xfrac, yfrac, p1[b], p2[b], p3[b], p4[b]);
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      alphasum = weighted_sum (xfrac, yfrac, p1[3], p2[3], p3[3], p4[3]);
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              sum = weighted_sum (xfrac, yfrac,
-                                  p1[b] * p1[3], p2[b] * p2[3],
-                                  p3[b] * p3[3], p4[b] * p4[3]);
-              sum /= alphasum;
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
-/* Catmull-Rom spline - not bad
-  * basic intro http://www.mvps.org/directx/articles/catmull/
-  * This formula will calculate an interpolated point between pt1 and pt2
-  * dx=0 returns pt1; dx=1 returns pt2
-  */
-
-static inline gdouble
-cubic_spline_fit (const gdouble  dx,
-                  const gdouble  pt0,
-                  const gdouble  pt1,
-                  const gdouble  pt2,
-                  const gdouble  pt3)
-{
-  return (gdouble) ((( ( -pt0 + 3 * pt1 - 3 * pt2 + pt3 ) *   dx +
-                       ( 2 * pt0 - 5 * pt1 + 4 * pt2 - pt3 ) ) * dx +
-                     ( -pt0 + pt2 ) ) * dx + (pt1 + pt1) ) / 2.0;
-}
-
-static void
-interpolate_cubic (PixelSurround *surround,
-                   const gint     x0,
-                   const gint     y0,
-                   const gdouble  xfrac,
-                   const gdouble  yfrac,
-                   const gint     bytes,
-                   guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0 - 1, y0 - 1, &stride);
-  const guchar *s0  = src;
-  const guchar *s1  = s0 + stride;
-  const guchar *s2  = s1 + stride;
-  const guchar *s3  = s2 + stride;
-  gint          b;
-  gdouble       p0, p1, p2, p3;
-  gdouble       sum, alphasum;
-
-  switch (bytes)
-    {
-    case 1:
-      p0 = cubic_spline_fit (xfrac, s0[0], s0[1], s0[2], s0[3]);
-      p1 = cubic_spline_fit (xfrac, s1[0], s1[1], s1[2], s1[3]);
-      p2 = cubic_spline_fit (xfrac, s2[0], s2[1], s2[2], s2[3]);
-      p3 = cubic_spline_fit (xfrac, s3[0], s3[1], s3[2], s3[3]);
-
-      sum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-      pixel[0]= CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      p0 = cubic_spline_fit (xfrac, s0[1], s0[3], s0[5], s0[7]);
-      p1 = cubic_spline_fit (xfrac, s1[1], s1[3], s1[5], s1[7]);
-      p2 = cubic_spline_fit (xfrac, s2[1], s2[3], s2[5], s2[7]);
-      p3 = cubic_spline_fit (xfrac, s3[1], s3[3], s3[5], s3[7]);
-
-      alphasum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-      if (alphasum > 0)
-        {
-          p0 = cubic_spline_fit (xfrac,
-                                 s0[0] * s0[1], s0[2] * s0[3],
-                                 s0[4] * s0[5], s0[6] * s0[7]);
-          p1 = cubic_spline_fit (xfrac,
-                                 s1[0] * s1[1], s1[2] * s1[3],
-                                 s1[4] * s1[5], s1[6] * s1[7]);
-          p2 = cubic_spline_fit (xfrac,
-                                 s2[0] * s2[1], s2[2] * s2[3],
-                                 s2[4] * s2[5], s2[6] * s2[7]);
-          p3 = cubic_spline_fit (xfrac,
-                                 s3[0] * s3[1], s3[2] * s3[3],
-                                 s3[4] * s3[5], s3[6] * s3[7]);
-
-          sum  = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-          sum /= alphasum;
-
-          pixel[0] = CLAMP (sum, 0, 255);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          p0 = cubic_spline_fit (xfrac, s0[b], s0[3 + b], s0[6 + b], s0[9 + b]);
-          p1 = cubic_spline_fit (xfrac, s1[b], s1[3 + b], s1[6 + b], s1[9 + b]);
-          p2 = cubic_spline_fit (xfrac, s2[b], s2[3 + b], s2[6 + b], s2[9 + b]);
-          p3 = cubic_spline_fit (xfrac, s3[b], s3[3 + b], s3[6 + b], s3[9 + b]);
-
-          sum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      p0 = cubic_spline_fit (xfrac, s0[3], s0[7], s0[11], s0[15]);
-      p1 = cubic_spline_fit (xfrac, s1[3], s1[7], s1[11], s1[15]);
-      p2 = cubic_spline_fit (xfrac, s2[3], s2[7], s2[11], s2[15]);
-      p3 = cubic_spline_fit (xfrac, s3[3], s3[7], s3[11], s3[15]);
-
-      alphasum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              p0 = cubic_spline_fit (xfrac,
-                                     s0[0 + b] * s0[ 3], s0[ 4 + b] * s0[7],
-                                     s0[8 + b] * s0[11], s0[12 + b] * s0[15]);
-              p1 = cubic_spline_fit (xfrac,
-                                     s1[0 + b] * s1[ 3], s1[ 4 + b] * s1[7],
-                                     s1[8 + b] * s1[11], s1[12 + b] * s1[15]);
-              p2 = cubic_spline_fit (xfrac,
-                                     s2[0 + b] * s2[ 3], s2[ 4 + b] * s2[7],
-                                     s2[8 + b] * s2[11], s2[12 + b] * s2[15]);
-              p3 = cubic_spline_fit (xfrac,
-                                     s3[0 + b] * s3[ 3], s3[ 4 + b] * s3[7],
-                                     s3[8 + b] * s3[11], s3[12 + b] * s3[15]);
-
-              sum  = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-              sum /= alphasum;
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
-static gdouble inline
-lanczos3_mul_alpha (const guchar  *pixels,
-                    const gdouble *x_kernel,
-                    const gdouble *y_kernel,
-                    const gint     stride,
-                    const gint     bytes,
-                    const gint     byte)
-{
-  const guchar *row   = pixels;
-  const guchar  alpha = bytes - 1;
-  gdouble       sum   = 0.0;
-  gint          x, y;
-
-  for (y = 0; y < 6; y++, row += stride)
-    {
-      const guchar *p      = row;
-      gdouble       tmpsum = 0.0;
-
-      for (x = 0; x < 6; x++, p += bytes)
-        {
-          tmpsum += x_kernel[x] * p[byte] * p[alpha];
-        }
-
-      tmpsum *= y_kernel[y];
-      sum    += tmpsum;
-    }
-
-  return sum;
-}
-
-static gdouble inline
-lanczos3_mul (const guchar  *pixels,
-              const gdouble *x_kernel,
-              const gdouble *y_kernel,
-              const gint     stride,
-              const gint     bytes,
-              const gint     byte)
-{
-  const guchar *row = pixels;
-  gdouble       sum = 0.0;
-  gint          x, y;
-
-  for (y = 0; y < 6; y++, row += stride)
-    {
-      const guchar *p = row;
-      gdouble       tmpsum = 0.0;
-
-      for (x = 0; x < 6; x++, p += bytes)
-        {
-          tmpsum += x_kernel[x] * p[byte];
-        }
-
-      tmpsum *= y_kernel[y];
-      sum    += tmpsum;
-    }
-
-  return sum;
-}
-
-static void
-interpolate_lanczos3 (PixelSurround *surround,
-                      const gint     x0,
-                      const gint     y0,
-                      const gdouble  xfrac,
-                      const gdouble  yfrac,
-                      const gint     bytes,
-                      guchar        *pixel,
-                      const gfloat  *kernel_lookup)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0 - 2, y0 - 2, &stride);
-  const gint    x_shift    = (gint) (xfrac * LANCZOS_SPP + 0.5);
-  const gint    y_shift    = (gint) (yfrac * LANCZOS_SPP + 0.5);
-  gint          b, i;
-  gdouble       kx_sum, ky_sum;
-  gdouble       x_kernel[6];
-  gdouble       y_kernel[6];
-  gdouble       sum, alphasum;
-
-  kx_sum  = ky_sum = 0.0;
-
-  for (i = 3; i >= -2; i--)
-    {
-      gint pos = i * LANCZOS_SPP;
-
-      kx_sum += x_kernel[2 + i] = kernel_lookup[ABS (x_shift - pos)];
-      ky_sum += y_kernel[2 + i] = kernel_lookup[ABS (y_shift - pos)];
-    }
-
-  /* normalise the kernel arrays */
-  for (i = -2; i <= 3; i++)
-    {
-      x_kernel[2 + i] /= kx_sum;
-      y_kernel[2 + i] /= ky_sum;
-    }
-
-  switch (bytes)
-    {
-    case 1:
-      sum = lanczos3_mul (src, x_kernel, y_kernel, stride, 1, 0);
-
-      pixel[0] = CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      alphasum  = lanczos3_mul (src, x_kernel, y_kernel, stride, 2, 1);
-      if (alphasum > 0)
-        {
-          sum = lanczos3_mul_alpha (src, x_kernel, y_kernel, stride, 2, 0);
-          sum /= alphasum;
-
-          pixel[0] = CLAMP (sum, 0, 255);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          sum = lanczos3_mul (src, x_kernel, y_kernel, stride, 3, b);
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      alphasum = lanczos3_mul (src, x_kernel, y_kernel, stride, 4, 3);
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              sum = lanczos3_mul_alpha (src, x_kernel, y_kernel, stride, 4, b);
-              sum /= alphasum;
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
 static void
 scale_region_buffer (PixelRegion *srcPR,
                      PixelRegion *dstPR)
@@ -44,6 +44,7 @@
 #include "gimpplugin-cleanup.h"
 #include "gimpplugin-message.h"
 #include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
@@ -73,6 +74,10 @@ static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
                                                   GPProcUninstall *proc_uninstall);
 static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_tile_list        (GimpPlugIn      *plug_in,
+                                                  GPTileList      *tile_list);
+static gboolean gimp_plug_in_tile_list_ack       (GimpPlugIn      *plug_in);
+static gboolean gimp_plug_in_tile_list_wait      (GimpPlugIn      *plug_in);
 
 
 /*  public functions  */
@@ -158,6 +163,10 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_LIST:
+      gimp_plug_in_handle_tile_list (plug_in, msg->data);
+      break;
     }
 }
 
@@ -630,7 +639,10 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                                    proc_frame->return_vals);
     }
 
-  gimp_plug_in_close (plug_in, FALSE);
+  if (plug_in->resident)
+    gimp_plug_in_manager_add_resident (plug_in->manager, plug_in);
+  else
+    gimp_plug_in_close (plug_in, FALSE);
 }
 
 static void
@@ -926,3 +938,215 @@ gimp_plug_in_handle_has_init (GimpPlugIn *plug_in)
       gimp_plug_in_close (plug_in, TRUE);
     }
 }
+
+static void
+gimp_plug_in_handle_tile_list (GimpPlugIn *plug_in,
+                               GPTileList *tile_list)
+{
+  GimpDrawable *drawable;
+  TileManager  *tm;
+  guchar       *window;
+  gsize         window_size;
+  gsize         offset = 0;
+  gint          i;
+
+  if (! tile_list || ! plug_in->manager->shm)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a TILE_LIST message without a shared memory "
+                    "window (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (tile_list->n_tiles > GP_TILE_WINDOW_TILES)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a TILE_LIST message with %u tiles, more than "
+                    "the %d of the shared memory window (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    tile_list->n_tiles, GP_TILE_WINDOW_TILES);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   tile_list->drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    tile_list->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    tile_list->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (tile_list->shadow)
+    {
+      tm = gimp_drawable_get_shadow_tiles (drawable);
+
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+    }
+  else
+    {
+      if (tile_list->put)
+        {
+          if (gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+            {
+              gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            "Plug-In \"%s\"\n(%s)\n\n"
+                            "tried writing to a locked drawable %d (killing)",
+                            gimp_object_get_name (plug_in),
+                            gimp_filename_to_utf8 (plug_in->prog),
+                            tile_list->drawable_ID);
+              gimp_plug_in_close (plug_in, TRUE);
+              return;
+            }
+          else if (gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+            {
+              gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            "Plug-In \"%s\"\n(%s)\n\n"
+                            "tried writing to a group layer %d (killing)",
+                            gimp_object_get_name (plug_in),
+                            gimp_filename_to_utf8 (plug_in->prog),
+                            tile_list->drawable_ID);
+              gimp_plug_in_close (plug_in, TRUE);
+              return;
+            }
+        }
+
+      tm = gimp_drawable_get_tiles (drawable);
+    }
+
+  window      = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+  window_size = gimp_plug_in_shm_get_size (plug_in->manager->shm);
+
+  /*  the window is shared by all plug-ins, so hand it to this one and
+   *  don't serve any other until it has been filled
+   */
+  if (tile_list->put)
+    {
+      if (! gimp_plug_in_tile_list_ack (plug_in) ||
+          ! gimp_plug_in_tile_list_wait (plug_in))
+        return;
+    }
+
+  /*  the window holds GP_TILE_WINDOW_TILES full tiles of the deepest
+   *  format, and longer lists are rejected above, but check every tile
+   *  anyway, the drawable's format is not ours to trust
+   */
+  for (i = 0; i < tile_list->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, tile_list->tile_nums[i],
+                                     TRUE, tile_list->put);
+
+      if (! tile)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested invalid tile (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (tile_bpp (tile) != gimp_drawable_bytes (drawable) ||
+          offset + tile_size (tile) > window_size)
+        {
+          tile_release (tile, FALSE);
+
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested tiles which don't fit the shared "
+                        "memory window (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (tile_list->put)
+        memcpy (tile_data_pointer (tile, 0, 0), window + offset,
+                tile_size (tile));
+      else
+        memcpy (window + offset, tile_data_pointer (tile, 0, 0),
+                tile_size (tile));
+
+      offset += tile_size (tile);
+
+      tile_release (tile, tile_list->put);
+    }
+
+  if (! gimp_plug_in_tile_list_ack (plug_in))
+    return;
+
+  /*  likewise, keep the window until the tiles have been copied out  */
+  if (! tile_list->put)
+    gimp_plug_in_tile_list_wait (plug_in);
+}
+
+static gboolean
+gimp_plug_in_tile_list_ack (GimpPlugIn *plug_in)
+{
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  Blocks on the plug-in's channel, like the tile request handlers do,
+ *  until it acknowledges that it is done with the window.
+ */
+static gboolean
+gimp_plug_in_tile_list_wait (GimpPlugIn *plug_in)
+{
+  GimpWireMessage msg;
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  gimp_wire_destroy (&msg);
+
+  return TRUE;
+}
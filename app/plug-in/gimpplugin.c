@@ -93,6 +93,7 @@
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginmanager-resident.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
@@ -112,6 +113,8 @@ static gboolean   gimp_plug_in_recv_message  (GIOChannel   *channel,
                                               GIOCondition  cond,
                                               gpointer      data);
 
+static void       gimp_plug_in_add_input     (GimpPlugIn   *plug_in);
+
 #if !defined(G_OS_WIN32) && !defined (G_WITH_CYGWIN)
 static void       gimp_plug_in_prep_for_exec (gpointer      data);
 #else
@@ -148,6 +151,7 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->call_mode          = GIMP_PLUG_IN_CALL_NONE;
   plug_in->open               = FALSE;
   plug_in->hup                = FALSE;
+  plug_in->resident           = FALSE;
   plug_in->pid                = 0;
 
   plug_in->my_read            = NULL;
@@ -156,6 +160,7 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->his_write          = NULL;
 
   plug_in->input_id           = 0;
+  plug_in->idle_id            = 0;
   plug_in->write_buffer_index = 0;
 
   plug_in->temp_procedures    = NULL;
@@ -381,21 +386,7 @@ gimp_plug_in_open (GimpPlugIn         *plug_in,
   plug_in->his_write = NULL;
 
   if (! synchronous)
-    {
-      GSource *source;
-
-      source = g_io_create_watch (plug_in->my_read,
-                                  G_IO_IN  | G_IO_PRI | G_IO_ERR | G_IO_HUP);
-
-      g_source_set_callback (source,
-                             (GSourceFunc) gimp_plug_in_recv_message, plug_in,
-                             NULL);
-
-      g_source_set_can_recurse (source, TRUE);
-
-      plug_in->input_id = g_source_attach (source, NULL);
-      g_source_unref (source);
-    }
+    gimp_plug_in_add_input (plug_in);
 
   plug_in->open      = TRUE;
   plug_in->call_mode = call_mode;
@@ -578,9 +569,67 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
   while (plug_in->temp_procedures)
     gimp_plug_in_remove_temp_proc (plug_in, plug_in->temp_procedures->data);
 
+  if (plug_in->idle_id)
+    gimp_plug_in_manager_remove_resident (plug_in->manager, plug_in);
+
   gimp_plug_in_manager_remove_open_plug_in (plug_in->manager, plug_in);
 }
 
+/**
+ * gimp_plug_in_make_resident:
+ * @plug_in: a #GimpPlugIn which has just returned from its procedure
+ *
+ * Moves the process of @plug_in, which was told to stay alive after
+ * returning, over to a new #GimpPlugIn and closes @plug_in without
+ * terminating the process.  @plug_in's procedure frame stays intact,
+ * so its caller can still collect the return values.
+ *
+ * Return value: the new, open #GimpPlugIn, which is not running any
+ *               procedure.
+ **/
+GimpPlugIn *
+gimp_plug_in_make_resident (GimpPlugIn *plug_in)
+{
+  GimpPlugIn *resident;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), NULL);
+  g_return_val_if_fail (plug_in->open, NULL);
+  g_return_val_if_fail (plug_in->resident, NULL);
+  g_return_val_if_fail (plug_in->call_mode == GIMP_PLUG_IN_CALL_RUN, NULL);
+
+  resident = gimp_plug_in_new (plug_in->manager,
+                               plug_in->main_proc_frame.main_context,
+                               NULL, NULL, plug_in->prog);
+
+  resident->pid      = plug_in->pid;
+  resident->my_read  = plug_in->my_read;
+  resident->my_write = plug_in->my_write;
+
+  plug_in->pid       = 0;
+  plug_in->my_read   = NULL;
+  plug_in->my_write  = NULL;
+
+  if (plug_in->input_id)
+    {
+      g_source_remove (plug_in->input_id);
+      plug_in->input_id = 0;
+    }
+
+  gimp_plug_in_close (plug_in, FALSE);
+
+  gimp_plug_in_add_input (resident);
+
+  resident->open      = TRUE;
+  resident->call_mode = GIMP_PLUG_IN_CALL_RUN;
+
+  gimp_plug_in_manager_add_open_plug_in (resident->manager, resident);
+
+  /*  the list of open plug-ins holds the reference now  */
+  g_object_unref (resident);
+
+  return resident;
+}
+
 static gboolean
 gimp_plug_in_recv_message (GIOChannel   *channel,
                            GIOCondition  cond,
@@ -588,6 +637,7 @@ gimp_plug_in_recv_message (GIOChannel   *channel,
 {
   GimpPlugIn *plug_in     = data;
   gboolean    got_message = FALSE;
+  gboolean    idle        = (plug_in->idle_id != 0);
 
 #ifdef G_OS_WIN32
   /* Workaround for GLib bug #137968: sometimes we are called for no
@@ -629,7 +679,8 @@ gimp_plug_in_recv_message (GIOChannel   *channel,
         gimp_plug_in_close (plug_in, TRUE);
     }
 
-  if (! got_message)
+  /*  an idle resident plug-in going away is no crash  */
+  if (! got_message && ! idle)
     {
       GimpPlugInProcFrame *frame    = gimp_plug_in_get_proc_frame (plug_in);
       GimpProgress        *progress = frame ? frame->progress : NULL;
@@ -738,6 +789,24 @@ gimp_plug_in_flush (GIOChannel *channel,
   return TRUE;
 }
 
+static void
+gimp_plug_in_add_input (GimpPlugIn *plug_in)
+{
+  GSource *source;
+
+  source = g_io_create_watch (plug_in->my_read,
+                              G_IO_IN  | G_IO_PRI | G_IO_ERR | G_IO_HUP);
+
+  g_source_set_callback (source,
+                         (GSourceFunc) gimp_plug_in_recv_message, plug_in,
+                         NULL);
+
+  g_source_set_can_recurse (source, TRUE);
+
+  plug_in->input_id = g_source_attach (source, NULL);
+  g_source_unref (source);
+}
+
 #if !defined(G_OS_WIN32) && !defined (G_WITH_CYGWIN)
 
 static void
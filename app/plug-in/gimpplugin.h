@@ -47,6 +47,7 @@ struct _GimpPlugIn
   GimpPlugInCallMode   call_mode;       /*  QUERY, INIT or RUN                */
   guint                open : 1;        /*  Is the plug-in open?              */
   guint                hup : 1;         /*  Did we receive a G_IO_HUP         */
+  guint                resident : 1;    /*  Does it stay after returning?     */
   GPid                 pid;             /*  Plug-in's process id              */
 
   GIOChannel          *my_read;         /*  App's read and write channels     */
@@ -55,6 +56,7 @@ struct _GimpPlugIn
   GIOChannel          *his_write;
 
   guint                input_id;        /*  Id of input proc                  */
+  guint                idle_id;         /*  Timeout while resident and idle   */
 
   gchar                write_buffer[WRITE_BUFFER_SIZE]; /* Buffer for writing */
   gint                 write_buffer_index;              /* Buffer index       */
@@ -89,6 +91,7 @@ gboolean      gimp_plug_in_open              (GimpPlugIn             *plug_in,
                                               gboolean                synchronous);
 void          gimp_plug_in_close             (GimpPlugIn             *plug_in,
                                               gboolean                kill_it);
+GimpPlugIn  * gimp_plug_in_make_resident     (GimpPlugIn             *plug_in);
 
 GimpPlugInProcFrame *
               gimp_plug_in_get_proc_frame    (GimpPlugIn             *plug_in);
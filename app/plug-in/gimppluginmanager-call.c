@@ -45,6 +45,7 @@
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
+#include "gimppluginmanager-resident.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
@@ -65,6 +66,24 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
   g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
   g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
 
+  plug_in = gimp_plug_in_manager_call_query_start (manager, context,
+                                                   plug_in_def);
+
+  if (plug_in)
+    gimp_plug_in_manager_call_query_finish (manager, plug_in);
+}
+
+GimpPlugIn *
+gimp_plug_in_manager_call_query_start (GimpPlugInManager *manager,
+                                       GimpContext       *context,
+                                       GimpPlugInDef     *plug_in_def)
+{
+  GimpPlugIn *plug_in;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def), NULL);
+
   plug_in = gimp_plug_in_new (manager, context, NULL,
                               NULL, plug_in_def->prog);
 
@@ -72,26 +91,39 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
     {
       plug_in->plug_in_def = plug_in_def;
 
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
         {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
+          g_object_unref (plug_in);
+          plug_in = NULL;
         }
+    }
 
-      g_object_unref (plug_in);
+  return plug_in;
+}
+
+void
+gimp_plug_in_manager_call_query_finish (GimpPlugInManager *manager,
+                                        GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  while (plug_in->open)
+    {
+      GimpWireMessage msg;
+
+      if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+        {
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+      else
+        {
+          gimp_plug_in_handle_message (plug_in, &msg);
+          gimp_wire_destroy (&msg);
+        }
     }
+
+  g_object_unref (plug_in);
 }
 
 void
@@ -153,7 +185,11 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
 
-  plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
+  plug_in = gimp_plug_in_manager_take_resident (manager, context, progress,
+                                                procedure);
+
+  if (! plug_in)
+    plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
 
   if (plug_in)
     {
@@ -165,7 +201,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       gint               display_ID;
       gint               monitor;
 
-      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
+      if (! plug_in->open &&
+          ! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
         {
           const gchar *name  = gimp_object_get_name (plug_in);
           GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
@@ -194,7 +231,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       config.show_help_button = (gui_config->use_help &&
                                  gui_config->show_help_button);
       config.use_cpu_accel    = gimp_composite_use_cpu_accel ();
-      config.gimp_reserved_5  = 0;
+      config.resident         = gimp_plug_in_manager_resident_allowed (manager,
+                                                                       procedure);
       config.gimp_reserved_6  = 0;
       config.gimp_reserved_7  = 0;
       config.gimp_reserved_8  = 0;
@@ -209,6 +247,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       config.monitor_number   = monitor;
       config.timestamp        = gimp_get_user_time (manager->gimp);
 
+      plug_in->resident = config.resident;
+
       proc_run.name    = GIMP_PROCEDURE (procedure)->original_name;
       proc_run.nparams = args->n_values;
       proc_run.params  = plug_in_args_to_params (args, FALSE);
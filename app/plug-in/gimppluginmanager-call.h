@@ -31,6 +31,16 @@ void          gimp_plug_in_manager_call_query    (GimpPlugInManager      *manage
                                                   GimpContext            *context,
                                                   GimpPlugInDef          *plug_in_def);
 
+/*  Start the plug-in's query() function and return the running
+ *  plug-in, so several plug-ins can be queried at the same time.
+ *  gimp_plug_in_manager_call_query_finish() handles its messages.
+ */
+GimpPlugIn  * gimp_plug_in_manager_call_query_start  (GimpPlugInManager      *manager,
+                                                      GimpContext            *context,
+                                                      GimpPlugInDef          *plug_in_def);
+void          gimp_plug_in_manager_call_query_finish (GimpPlugInManager      *manager,
+                                                      GimpPlugIn             *plug_in);
+
 /*  Call the plug-in's init() function
  */
 void          gimp_plug_in_manager_call_init     (GimpPlugInManager      *manager,
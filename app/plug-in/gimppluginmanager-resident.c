@@ -0,0 +1,175 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmanager-resident.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Resident plug-ins don't exit after returning from their procedure.
+ *  They wait for the next GP_CONFIG / GP_PROC_RUN instead, so calling
+ *  the same plug-in over and over doesn't spawn a new process each
+ *  time.  Idle resident plug-ins are kept on manager->resident_plug_ins,
+ *  most recently used first, and are told to quit after a timeout or
+ *  when the list grows beyond the configured maximum.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "plug-in-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+
+#include "gimpplugin.h"
+#include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
+#include "gimppluginprocedure.h"
+
+
+static gboolean   gimp_plug_in_manager_resident_timeout (GimpPlugIn *plug_in);
+
+
+/*  public functions  */
+
+gboolean
+gimp_plug_in_manager_resident_allowed (GimpPlugInManager   *manager,
+                                       GimpPlugInProcedure *procedure)
+{
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), FALSE);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), FALSE);
+
+  /*  extensions stay around anyway, and a debug wrapper expects
+   *  the plug-in to exit
+   */
+  return (manager->gimp->config->plug_in_resident_max > 0 &&
+          GIMP_PROCEDURE (procedure)->proc_type == GIMP_PLUGIN &&
+          manager->debug == NULL);
+}
+
+GimpPlugIn *
+gimp_plug_in_manager_take_resident (GimpPlugInManager   *manager,
+                                    GimpContext         *context,
+                                    GimpProgress        *progress,
+                                    GimpPlugInProcedure *procedure)
+{
+  const gchar *prog;
+  GSList      *list;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+
+  prog = gimp_plug_in_procedure_get_progname (procedure);
+
+  for (list = manager->resident_plug_ins; list; list = g_slist_next (list))
+    {
+      GimpPlugIn *plug_in = list->data;
+
+      if (! strcmp (plug_in->prog, prog))
+        {
+          g_object_ref (plug_in);
+
+          gimp_plug_in_manager_remove_resident (manager, plug_in);
+
+          gimp_plug_in_proc_frame_dispose (&plug_in->main_proc_frame,
+                                           plug_in);
+          gimp_plug_in_proc_frame_init (&plug_in->main_proc_frame,
+                                        context, progress, procedure);
+
+          return plug_in;
+        }
+    }
+
+  return NULL;
+}
+
+void
+gimp_plug_in_manager_add_resident (GimpPlugInManager *manager,
+                                   GimpPlugIn        *plug_in)
+{
+  GimpCoreConfig *config;
+  GimpPlugIn     *resident;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  config = manager->gimp->config;
+
+  /*  the plug-in is waiting for the next call, so it has to be told
+   *  to quit if it can't stay
+   */
+  if (config->plug_in_resident_max < 1)
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  while (g_slist_length (manager->resident_plug_ins) >=
+         config->plug_in_resident_max)
+    {
+      GSList *last = g_slist_last (manager->resident_plug_ins);
+
+      gimp_plug_in_close (last->data, TRUE);
+    }
+
+  resident = gimp_plug_in_make_resident (plug_in);
+
+  resident->idle_id =
+    g_timeout_add_seconds (config->plug_in_resident_timeout,
+                           (GSourceFunc) gimp_plug_in_manager_resident_timeout,
+                           resident);
+
+  manager->resident_plug_ins = g_slist_prepend (manager->resident_plug_ins,
+                                                resident);
+}
+
+void
+gimp_plug_in_manager_remove_resident (GimpPlugInManager *manager,
+                                      GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  manager->resident_plug_ins = g_slist_remove (manager->resident_plug_ins,
+                                               plug_in);
+
+  if (plug_in->idle_id)
+    {
+      g_source_remove (plug_in->idle_id);
+      plug_in->idle_id = 0;
+    }
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_plug_in_manager_resident_timeout (GimpPlugIn *plug_in)
+{
+  /*  the source is destroyed by returning FALSE  */
+  plug_in->idle_id = 0;
+
+  gimp_plug_in_manager_remove_resident (plug_in->manager, plug_in);
+
+  gimp_plug_in_close (plug_in, TRUE);
+
+  return FALSE;
+}
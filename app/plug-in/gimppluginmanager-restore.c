@@ -31,11 +31,13 @@
 #include "config/gimpcoreconfig.h"
 
 #include "core/gimp.h"
+#include "core/gimp-startup-profile.h"
 
 #include "pdb/gimppdb.h"
 #include "pdb/gimppdbcontext.h"
 
 #include "gimpinterpreterdb.h"
+#include "gimpplugin.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
@@ -49,6 +51,14 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpPlugInDef *plug_in_def;
+  GimpPlugIn    *plug_in;
+  GTimer        *timer;        /*  stopped while the query is queued  */
+} GimpPlugInQuery;
+
+
 static void    gimp_plug_in_manager_search            (GimpPlugInManager      *manager,
                                                        GimpInitStatusFunc      status_callback);
 static gchar * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager      *manager);
@@ -58,6 +68,8 @@ static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager      *m
 static void    gimp_plug_in_manager_query_new         (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
                                                        GimpInitStatusFunc      status_callback);
+static void    gimp_plug_in_manager_query_finish      (GimpPlugInManager      *manager,
+                                                       GimpPlugInQuery        *query);
 static void    gimp_plug_in_manager_init_plug_ins     (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
                                                        GimpInitStatusFunc      status_callback);
@@ -106,10 +118,14 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
   gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
+  gimp_startup_profile_begin (gimp, "Querying");
   gimp_plug_in_manager_query_new (manager, context, status_callback);
+  gimp_startup_profile_end (gimp);
 
   /* initialize the plug-ins */
+  gimp_startup_profile_begin (gimp, "Initializing");
   gimp_plug_in_manager_init_plug_ins (manager, context, status_callback);
+  gimp_startup_profile_end (gimp);
 
   /* add the procedures to manager->plug_in_procedures */
   for (list = manager->plug_in_defs; list; list = list->next)
@@ -329,17 +345,26 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GQueue queries = G_QUEUE_INIT;
+      gint   n_queries;
+      gint   nth;
 
       manager->write_pluginrc = TRUE;
 
+      /*  every plug-in answers its query in its own process, so keep
+       *  up to one plug-in per processor running and handle their
+       *  messages in the order of plug_in_defs
+       */
+      n_queries = MAX (1, GIMP_BASE_CONFIG (manager->gimp->config)->num_processors);
+
       for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
         {
           GimpPlugInDef *plug_in_def = list->data;
 
           if (plug_in_def->needs_query)
             {
-              gchar *basename;
+              GimpPlugInQuery *query;
+              gchar           *basename;
 
               basename = g_filename_display_basename (plug_in_def->prog);
               status_callback (NULL, basename,
@@ -350,14 +375,51 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
                 g_print ("Querying plug-in: '%s'\n",
                          gimp_filename_to_utf8 (plug_in_def->prog));
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+              query = g_slice_new (GimpPlugInQuery);
+
+              query->plug_in_def = plug_in_def;
+              query->timer       = g_timer_new ();
+              query->plug_in     =
+                gimp_plug_in_manager_call_query_start (manager, context,
+                                                       plug_in_def);
+
+              /*  only count the time spent on this plug-in, not the
+               *  time its answers wait for the queries before it
+               */
+              g_timer_stop (query->timer);
+
+              g_queue_push_tail (&queries, query);
+
+              if (g_queue_get_length (&queries) >= n_queries)
+                gimp_plug_in_manager_query_finish (manager,
+                                                   g_queue_pop_head (&queries));
             }
         }
+
+      while (! g_queue_is_empty (&queries))
+        gimp_plug_in_manager_query_finish (manager,
+                                           g_queue_pop_head (&queries));
     }
 
   status_callback (NULL, "", 1.0);
 }
 
+static void
+gimp_plug_in_manager_query_finish (GimpPlugInManager *manager,
+                                   GimpPlugInQuery   *query)
+{
+  g_timer_continue (query->timer);
+
+  if (query->plug_in)
+    gimp_plug_in_manager_call_query_finish (manager, query->plug_in);
+
+  gimp_startup_profile_add_file (manager->gimp, query->plug_in_def->prog,
+                                 g_timer_elapsed (query->timer, NULL));
+
+  g_timer_destroy (query->timer);
+  g_slice_free (GimpPlugInQuery, query);
+}
+
 /* initialize the plug-ins */
 static void
 gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
@@ -379,7 +441,8 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GTimer *timer = g_timer_new ();
+      gint    nth;
 
       for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
         {
@@ -398,9 +461,16 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
                 g_print ("Initializing plug-in: '%s'\n",
                          gimp_filename_to_utf8 (plug_in_def->prog));
 
+              g_timer_start (timer);
+
               gimp_plug_in_manager_call_init (manager, context, plug_in_def);
+
+              gimp_startup_profile_add_file (manager->gimp, plug_in_def->prog,
+                                             g_timer_elapsed (timer, NULL));
             }
         }
+
+      g_timer_destroy (timer);
     }
 
   status_callback (NULL, "", 1.0);
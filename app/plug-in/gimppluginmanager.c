@@ -149,6 +149,7 @@ gimp_plug_in_manager_init (GimpPlugInManager *manager)
 
   manager->current_plug_in    = NULL;
   manager->open_plug_ins      = NULL;
+  manager->resident_plug_ins  = NULL;
   manager->plug_in_stack      = NULL;
   manager->history            = NULL;
 
@@ -61,6 +61,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "base/base-utils.h"
@@ -71,7 +74,7 @@
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4)
+#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4 * GP_TILE_WINDOW_TILES)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -299,3 +302,11 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return TILE_MAP_SIZE;
+}
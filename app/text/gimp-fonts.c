@@ -39,11 +39,34 @@
 
 #define CONF_FNAME "fonts.conf"
 
+/*  fontconfig is thread-safe since 2.10.91  */
+#if defined(ENABLE_MP) && FC_VERSION >= 21091
+#define GIMP_FONTS_SCAN_THREAD 1
+#endif
 
-static gboolean gimp_fonts_load_fonts_conf (FcConfig    *config,
-                                            gchar       *fonts_conf);
-static void     gimp_fonts_add_directories (FcConfig    *config,
-                                            const gchar *path_str);
+
+typedef struct _GimpFontsScan GimpFontsScan;
+
+struct _GimpFontsScan
+{
+  gchar *personal_conf;
+  gchar *system_conf;
+  gchar *path;
+};
+
+
+static GimpFontsScan * gimp_fonts_scan_new        (Gimp          *gimp);
+static void            gimp_fonts_scan_free       (GimpFontsScan *scan);
+static FcConfig      * gimp_fonts_scan            (GimpFontsScan *scan);
+static gboolean        gimp_fonts_load_fonts_conf (FcConfig      *config,
+                                                   const gchar   *fonts_conf);
+static void            gimp_fonts_add_directories (FcConfig      *config,
+                                                   const gchar   *path_str);
+
+
+#ifdef GIMP_FONTS_SCAN_THREAD
+static GThread *fonts_scan_thread = NULL;
+#endif
 
 
 void
@@ -58,12 +81,39 @@ gimp_fonts_init (Gimp *gimp)
                             G_CALLBACK (gimp_fonts_load), gimp);
 }
 
+/**
+ * gimp_fonts_scan_start:
+ * @gimp: a #Gimp object
+ *
+ * Starts building the fontconfig configuration in a separate thread,
+ * so the font directories are scanned while the rest of the startup
+ * goes on. The next call of gimp_fonts_load() waits for the scan to
+ * finish. Does nothing if fontconfig is not thread-safe or if GIMP
+ * was built without multi-processor support.
+ **/
+void
+gimp_fonts_scan_start (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+#ifdef GIMP_FONTS_SCAN_THREAD
+  if (! fonts_scan_thread)
+    {
+      GimpFontsScan *scan = gimp_fonts_scan_new (gimp);
+
+      fonts_scan_thread = g_thread_create ((GThreadFunc) gimp_fonts_scan,
+                                           scan, TRUE, NULL);
+
+      if (! fonts_scan_thread)
+        gimp_fonts_scan_free (scan);
+    }
+#endif
+}
+
 void
 gimp_fonts_load (Gimp *gimp)
 {
-  FcConfig *config;
-  gchar    *fonts_conf;
-  gchar    *path;
+  FcConfig *config = NULL;
 
   g_return_if_fail (GIMP_IS_FONT_LIST (gimp->fonts));
 
@@ -76,29 +126,21 @@ gimp_fonts_load (Gimp *gimp)
 
   gimp_container_clear (GIMP_CONTAINER (gimp->fonts));
 
-  config = FcInitLoadConfig ();
+#ifdef GIMP_FONTS_SCAN_THREAD
+  if (fonts_scan_thread)
+    {
+      config = g_thread_join (fonts_scan_thread);
+      fonts_scan_thread = NULL;
+    }
+  else
+#endif
+    {
+      config = gimp_fonts_scan (gimp_fonts_scan_new (gimp));
+    }
 
   if (! config)
     goto cleanup;
 
-  fonts_conf = gimp_personal_rc_file (CONF_FNAME);
-  if (! gimp_fonts_load_fonts_conf (config, fonts_conf))
-    goto cleanup;
-
-  fonts_conf = g_build_filename (gimp_sysconf_directory (), CONF_FNAME, NULL);
-  if (! gimp_fonts_load_fonts_conf (config, fonts_conf))
-    goto cleanup;
-
-  path = gimp_config_path_expand (gimp->config->font_path, TRUE, NULL);
-  gimp_fonts_add_directories (config, path);
-  g_free (path);
-
-  if (! FcConfigBuildFonts (config))
-    {
-      FcConfigDestroy (config);
-      goto cleanup;
-    }
-
   FcConfigSetCurrent (config);
 
   gimp_font_list_restore (GIMP_FONT_LIST (gimp->fonts));
@@ -122,21 +164,76 @@ gimp_fonts_reset (Gimp *gimp)
   FcConfigSetCurrent (NULL);
 }
 
-static gboolean
-gimp_fonts_load_fonts_conf (FcConfig *config,
-                            gchar    *fonts_conf)
+static GimpFontsScan *
+gimp_fonts_scan_new (Gimp *gimp)
 {
-  gboolean ret = TRUE;
+  GimpFontsScan *scan = g_slice_new (GimpFontsScan);
 
-  if (! FcConfigParseAndLoad (config, (const guchar *) fonts_conf, FcFalse))
+  /*  resolve everything that needs gimp or libgimpbase here, so that
+   *  gimp_fonts_scan() only calls into fontconfig
+   */
+  scan->personal_conf = gimp_personal_rc_file (CONF_FNAME);
+  scan->system_conf   = g_build_filename (gimp_sysconf_directory (),
+                                          CONF_FNAME, NULL);
+  scan->path          = gimp_config_path_expand (gimp->config->font_path,
+                                                 TRUE, NULL);
+
+  return scan;
+}
+
+static void
+gimp_fonts_scan_free (GimpFontsScan *scan)
+{
+  g_free (scan->personal_conf);
+  g_free (scan->system_conf);
+  g_free (scan->path);
+
+  g_slice_free (GimpFontsScan, scan);
+}
+
+/*  builds a fontconfig configuration and frees @scan, may be called
+ *  from a thread
+ */
+static FcConfig *
+gimp_fonts_scan (GimpFontsScan *scan)
+{
+  FcConfig *config = FcInitLoadConfig ();
+
+  if (! config)
+    goto cleanup;
+
+  if (! gimp_fonts_load_fonts_conf (config, scan->personal_conf) ||
+      ! gimp_fonts_load_fonts_conf (config, scan->system_conf))
+    {
+      config = NULL;
+      goto cleanup;
+    }
+
+  gimp_fonts_add_directories (config, scan->path);
+
+  if (! FcConfigBuildFonts (config))
     {
       FcConfigDestroy (config);
-      ret = FALSE;
+      config = NULL;
     }
 
-  g_free (fonts_conf);
+ cleanup:
+  gimp_fonts_scan_free (scan);
+
+  return config;
+}
+
+static gboolean
+gimp_fonts_load_fonts_conf (FcConfig    *config,
+                            const gchar *fonts_conf)
+{
+  if (! FcConfigParseAndLoad (config, (const guchar *) fonts_conf, FcFalse))
+    {
+      FcConfigDestroy (config);
+      return FALSE;
+    }
 
-  return ret;
+  return TRUE;
 }
 
 static void
@@ -19,9 +19,10 @@
 #define __GIMP_FONTS_H__
 
 
-void   gimp_fonts_init  (Gimp *gimp);
-void   gimp_fonts_load  (Gimp *gimp);
-void   gimp_fonts_reset (Gimp *gimp);
+void   gimp_fonts_init       (Gimp *gimp);
+void   gimp_fonts_scan_start (Gimp *gimp);
+void   gimp_fonts_load       (Gimp *gimp);
+void   gimp_fonts_reset      (Gimp *gimp);
 
 
 #endif  /* __GIMP_FONTS_H__ */
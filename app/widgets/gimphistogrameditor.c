@@ -55,6 +55,14 @@ static void     gimp_histogram_editor_layer_changed (GimpImage           *image,
 static void     gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
                                                      const GParamSpec    *pspec);
 static void     gimp_histogram_editor_update        (GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_drawable_update
+                                                    (GimpDrawable        *drawable,
+                                                     gint                 x,
+                                                     gint                 y,
+                                                     gint                 width,
+                                                     gint                 height,
+                                                     GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_invalidate    (GimpHistogramEditor *editor);
 
 static gboolean gimp_histogram_editor_idle_update   (GimpHistogramEditor *editor);
 static gboolean gimp_histogram_menu_sensitivity     (gint                 value,
@@ -289,7 +297,7 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
                                G_CALLBACK (gimp_histogram_editor_layer_changed),
                                editor, 0);
       g_signal_connect_object (image, "mask-changed",
-                               G_CALLBACK (gimp_histogram_editor_update),
+                               G_CALLBACK (gimp_histogram_editor_invalidate),
                                editor, G_CONNECT_SWAPPED);
     }
 
@@ -325,7 +333,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                             gimp_histogram_editor_menu_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_drawable_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
                                             gimp_histogram_editor_frozen_update,
@@ -344,8 +352,8 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_frozen_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "update",
-                               G_CALLBACK (gimp_histogram_editor_update),
-                               editor, G_CONNECT_SWAPPED);
+                               G_CALLBACK (gimp_histogram_editor_drawable_update),
+                               editor, 0);
       g_signal_connect_object (editor->drawable, "alpha-changed",
                                G_CALLBACK (gimp_histogram_editor_menu_update),
                                editor, G_CONNECT_SWAPPED);
@@ -353,7 +361,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_name_update),
                                editor, G_CONNECT_SWAPPED);
 
-      gimp_histogram_editor_update (editor);
+      gimp_histogram_editor_invalidate (editor);
     }
   else if (editor->histogram)
     {
@@ -371,7 +379,7 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
   if (! editor->valid && editor->histogram)
     {
       if (editor->drawable)
-        gimp_drawable_calculate_histogram (editor->drawable, editor->histogram);
+        gimp_drawable_update_histogram (editor->drawable, editor->histogram);
       else
         gimp_histogram_calculate (editor->histogram, NULL, NULL);
 
@@ -429,6 +437,32 @@ gimp_histogram_editor_update (GimpHistogramEditor *editor)
                         NULL);
 }
 
+static void
+gimp_histogram_editor_drawable_update (GimpDrawable        *drawable,
+                                       gint                 x,
+                                       gint                 y,
+                                       gint                 width,
+                                       gint                 height,
+                                       GimpHistogramEditor *editor)
+{
+  /*  only the changed area is counted again  */
+  if (editor->histogram)
+    gimp_histogram_invalidate (editor->histogram, x, y, width, height);
+
+  gimp_histogram_editor_update (editor);
+}
+
+static void
+gimp_histogram_editor_invalidate (GimpHistogramEditor *editor)
+{
+  if (editor->histogram && editor->drawable)
+    gimp_histogram_invalidate (editor->histogram, 0, 0,
+                               gimp_item_get_width  (GIMP_ITEM (editor->drawable)),
+                               gimp_item_get_height (GIMP_ITEM (editor->drawable)));
+
+  gimp_histogram_editor_update (editor);
+}
+
 static gboolean
 gimp_histogram_editor_idle_update (GimpHistogramEditor *editor)
 {
@@ -0,0 +1,583 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#endif
+
+#ifndef _O_BINARY
+#define _O_BINARY 0
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#undef G_DISABLE_DEPRECATED /* GStaticMutex */
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "base/tile.h"
+#include "base/tile-manager.h"
+#include "base/tile-manager-private.h"
+#include "base/tile-rle.h"
+
+#include "xcf-private.h"
+#include "xcf-lazy.h"
+
+#include "gimp-intl.h"
+
+
+/*  An XCF file mapped into memory. The tile managers of the drawables
+ *  loaded from it remember the offsets of their tiles, and decode a
+ *  tile only when it is first locked.
+ *
+ *  Touching a page of the mapping after the file was truncated raises
+ *  SIGBUS, so the file is kept open, and its size and modification
+ *  time are checked before each tile is decoded.
+ */
+struct _XcfLazyFile
+{
+  volatile gint  ref_count;
+  GMappedFile   *mapped;
+  const guchar  *data;
+  gsize          size;
+  gint           fd;
+  dev_t          dev;
+  ino_t          ino;
+  time_t         mtime;
+  gboolean       lazy;
+  volatile gint  n_corrupt;
+  volatile gint  changed;
+};
+
+typedef struct _XcfLazyLevel XcfLazyLevel;
+
+struct _XcfLazyLevel
+{
+  XcfLazyFile        *file;
+  TileManager        *tiles;
+  XcfCompressionType  compression;
+  guint32            *offsets;     /*  n_tiles + 1, the last one is 0  */
+  gint                n_tiles;
+};
+
+typedef struct _XcfLazyLoad XcfLazyLoad;
+
+struct _XcfLazyLoad
+{
+  GList  *tiles;                   /*  the next tile manager to load   */
+#ifdef ENABLE_MP
+  GMutex *mutex;
+#endif
+};
+
+
+static XcfLazyFile * xcf_lazy_file_ref          (XcfLazyFile  *file);
+static gboolean      xcf_lazy_file_check        (XcfLazyFile  *file);
+static void          xcf_lazy_level_free        (XcfLazyLevel *level);
+static void          xcf_lazy_validate_tile     (TileManager  *tm,
+                                                 Tile         *tile,
+                                                 XcfLazyLevel *level);
+static void          xcf_lazy_load_tile_manager (TileManager  *tm);
+static gpointer      xcf_lazy_load_thread       (XcfLazyLoad  *load);
+
+
+/*  all levels that still refer to a mapped file  */
+static GStaticMutex  lazy_mutex  = G_STATIC_MUTEX_INIT;
+static GList        *lazy_levels = NULL;
+
+
+XcfLazyFile *
+xcf_lazy_file_new (const gchar  *filename,
+                   gboolean      lazy,
+                   GError      **error)
+{
+  XcfLazyFile *file;
+  GMappedFile *mapped;
+  struct stat  st;
+  gint         fd;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  fd = g_open (filename, O_RDONLY | _O_BINARY, 0);
+
+  if (fd == -1 || fstat (fd, &st) != 0)
+    {
+      int save_errno = errno;
+
+      if (fd != -1)
+        close (fd);
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+                   _("Could not open '%s' for reading: %s"),
+                   gimp_filename_to_utf8 (filename), g_strerror (save_errno));
+      return NULL;
+    }
+
+  mapped = g_mapped_file_new (filename, FALSE, error);
+
+  if (! mapped)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  file = g_slice_new0 (XcfLazyFile);
+
+  file->ref_count = 1;
+  file->mapped    = mapped;
+  file->data      = (const guchar *) g_mapped_file_get_contents (mapped);
+  file->size      = g_mapped_file_get_length (mapped);
+  file->fd        = fd;
+  file->dev       = st.st_dev;
+  file->ino       = st.st_ino;
+  file->mtime     = st.st_mtime;
+  file->lazy      = lazy;
+
+  return file;
+}
+
+void
+xcf_lazy_file_unref (XcfLazyFile *file)
+{
+  g_return_if_fail (file != NULL);
+
+  if (g_atomic_int_dec_and_test (&file->ref_count))
+    {
+      g_mapped_file_unref (file->mapped);
+      close (file->fd);
+
+      g_slice_free (XcfLazyFile, file);
+    }
+}
+
+/*  Makes @tiles decode its tiles from @file when they are first
+ *  locked. @offsets are the file offsets of the level's @n_tiles
+ *  tiles. Returns FALSE if the level can't be loaded lazily, the
+ *  caller should read its tiles right away then.
+ */
+gboolean
+xcf_lazy_file_add_level (XcfLazyFile        *file,
+                         TileManager        *tiles,
+                         XcfCompressionType  compression,
+                         const guint32      *offsets,
+                         gint                n_tiles)
+{
+  XcfLazyLevel *level;
+  gint          i;
+
+  g_return_val_if_fail (file != NULL, FALSE);
+  g_return_val_if_fail (tiles != NULL, FALSE);
+  g_return_val_if_fail (offsets != NULL, FALSE);
+  g_return_val_if_fail (n_tiles == tiles->ntile_rows * tiles->ntile_cols,
+                        FALSE);
+
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+    case COMPRESS_RLE:
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+#endif
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  /*  don't take over tile managers that validate their tiles already  */
+  if (tiles->validate_proc)
+    return FALSE;
+
+  for (i = 0; i < n_tiles; i++)
+    if (offsets[i] >= file->size)
+      return FALSE;
+
+  level = g_slice_new0 (XcfLazyLevel);
+
+  level->file        = xcf_lazy_file_ref (file);
+  level->tiles       = tiles;
+  level->compression = compression;
+  level->offsets     = g_new (guint32, n_tiles + 1);
+  level->n_tiles     = n_tiles;
+
+  memcpy (level->offsets, offsets, n_tiles * sizeof (guint32));
+  level->offsets[n_tiles] = 0;
+
+  tile_manager_set_validate_proc_full (tiles,
+                                       (TileValidateProc) xcf_lazy_validate_tile,
+                                       level,
+                                       (GDestroyNotify) xcf_lazy_level_free);
+
+  /*  tiles are decoded from the read-only mapping only  */
+  tile_manager_set_validate_threadsafe (tiles, TRUE);
+
+  g_static_mutex_lock (&lazy_mutex);
+  lazy_levels = g_list_prepend (lazy_levels, level);
+  g_static_mutex_unlock (&lazy_mutex);
+
+  return TRUE;
+}
+
+/*  Returns the number of tiles of @file that could not be decoded,
+ *  and were cleared instead.
+ */
+gint
+xcf_lazy_file_get_n_corrupt (XcfLazyFile *file)
+{
+  g_return_val_if_fail (file != NULL, 0);
+
+  return g_atomic_int_get (&file->n_corrupt);
+}
+
+/*  Decodes all tiles of @tile_managers, which were passed to
+ *  xcf_lazy_file_add_level(), in up to @n_threads threads, one tile
+ *  manager per thread at a time. The tile managers don't refer to
+ *  their file any longer afterwards.
+ */
+void
+xcf_lazy_load_tiles (GList *tile_managers,
+                     gint   n_threads)
+{
+  XcfLazyLoad load;
+
+  load.tiles = tile_managers;
+
+#ifdef ENABLE_MP
+  n_threads = MIN (n_threads, g_list_length (tile_managers));
+
+  if (n_threads > 1)
+    {
+      GThread **threads = g_new0 (GThread *, n_threads - 1);
+      gint      i;
+
+      load.mutex = g_mutex_new ();
+
+      for (i = 0; i < n_threads - 1; i++)
+        threads[i] = g_thread_create ((GThreadFunc) xcf_lazy_load_thread,
+                                      &load, TRUE, NULL);
+
+      /*  the calling thread helps, and does all the work if no
+       *  thread could be created
+       */
+      xcf_lazy_load_thread (&load);
+
+      for (i = 0; i < n_threads - 1; i++)
+        if (threads[i])
+          g_thread_join (threads[i]);
+
+      g_free (threads);
+      g_mutex_free (load.mutex);
+
+      return;
+    }
+
+  load.mutex = NULL;
+#endif
+
+  xcf_lazy_load_thread (&load);
+}
+
+/*  Decodes all tiles that are still read lazily from @filename, so
+ *  the file can be overwritten.
+ */
+void
+xcf_lazy_release (const gchar *filename,
+                  gint         n_threads)
+{
+  GList       *tiles = NULL;
+  GList       *list;
+  struct stat  st;
+
+  g_return_if_fail (filename != NULL);
+
+  if (g_stat (filename, &st) != 0)
+    return;
+
+  g_static_mutex_lock (&lazy_mutex);
+
+  for (list = lazy_levels; list; list = g_list_next (list))
+    {
+      XcfLazyLevel *level = list->data;
+
+      if (level->file->dev == st.st_dev &&
+          level->file->ino == st.st_ino)
+        {
+          tiles = g_list_prepend (tiles, tile_manager_ref (level->tiles));
+        }
+    }
+
+  g_static_mutex_unlock (&lazy_mutex);
+
+  if (tiles)
+    {
+      xcf_lazy_load_tiles (tiles, n_threads);
+
+      g_list_free_full (tiles, (GDestroyNotify) tile_manager_unref);
+    }
+}
+
+
+/*  private functions  */
+
+static XcfLazyFile *
+xcf_lazy_file_ref (XcfLazyFile *file)
+{
+  g_atomic_int_inc (&file->ref_count);
+
+  return file;
+}
+
+/*  Returns FALSE if @file was changed since it was mapped, by anything
+ *  that didn't call xcf_lazy_release() first. Its mapping must not be
+ *  read from then, the remaining tiles are cleared instead. This can't
+ *  catch a change between the check and the read, but it stops a file
+ *  that was truncated or rewritten in place from crashing every later
+ *  tile fault.
+ */
+static gboolean
+xcf_lazy_file_check (XcfLazyFile *file)
+{
+  struct stat st;
+
+  if (g_atomic_int_get (&file->changed))
+    return FALSE;
+
+  if (fstat (file->fd, &st) == 0 &&
+      (gsize) st.st_size == file->size &&
+      st.st_mtime        == file->mtime)
+    return TRUE;
+
+  if (g_atomic_int_exchange_and_add (&file->changed, 1) == 0)
+    g_warning ("XCF: the file was changed by another program, "
+               "the pixel data not read yet has been cleared");
+
+  return FALSE;
+}
+
+static void
+xcf_lazy_level_free (XcfLazyLevel *level)
+{
+  g_static_mutex_lock (&lazy_mutex);
+  lazy_levels = g_list_remove (lazy_levels, level);
+  g_static_mutex_unlock (&lazy_mutex);
+
+  xcf_lazy_file_unref (level->file);
+
+  g_free (level->offsets);
+
+  g_slice_free (XcfLazyLevel, level);
+}
+
+#ifdef HAVE_ZLIB
+static gboolean
+xcf_lazy_inflate (const guchar *src,
+                  gsize         src_size,
+                  guchar       *dest,
+                  gsize         dest_size)
+{
+  z_stream strm = { 0, };
+  gint     status;
+
+  strm.next_in   = (Bytef *) src;
+  strm.avail_in  = src_size;
+  strm.next_out  = dest;
+  strm.avail_out = dest_size;
+
+  if (inflateInit (&strm) != Z_OK)
+    return FALSE;
+
+  status = inflate (&strm, Z_FINISH);
+
+  inflateEnd (&strm);
+
+  return (status == Z_STREAM_END && strm.avail_out == 0);
+}
+#endif
+
+static void
+xcf_lazy_validate_tile (TileManager  *tm,
+                        Tile         *tile,
+                        XcfLazyLevel *level)
+{
+  XcfLazyFile *file    = level->file;
+  guchar      *dest    = tile_data_pointer (tile, 0, 0);
+  gint         size    = tile_size (tile);
+  gboolean     success = FALSE;
+  gsize        start;
+  gsize        end;
+  gint         col, row;
+  gint         i;
+
+  if (! xcf_lazy_file_check (file))
+    {
+      memset (dest, 0, size);
+      g_atomic_int_inc (&file->n_corrupt);
+      return;
+    }
+
+  tile_manager_get_tile_col_row (tm, tile, &col, &row);
+
+  i = row * tm->ntile_cols + col;
+
+  start = level->offsets[i];
+  end   = level->offsets[i + 1];
+
+  /*  the size of the last tile is unknown, allow for negative
+   *  compression like xcf_load_level() does
+   */
+  if (end == 0)
+    end = start + TILE_RLE_MAX_SIZE (size);
+
+  end = MIN (end, file->size);
+
+  if (start < end)
+    {
+      const guchar *src      = file->data + start;
+      gsize         src_size = end - start;
+
+      switch (level->compression)
+        {
+        case COMPRESS_NONE:
+          if (src_size >= size)
+            {
+              memcpy (dest, src, size);
+              success = TRUE;
+            }
+          break;
+
+        case COMPRESS_RLE:
+          success = tile_rle_decode (src, src_size,
+                                     tile_bpp (tile),
+                                     tile_ewidth (tile) * tile_eheight (tile),
+                                     dest);
+          break;
+
+#ifdef HAVE_ZLIB
+        case COMPRESS_ZLIB:
+          success = xcf_lazy_inflate (src, src_size, dest, size);
+          break;
+#endif
+
+        default:
+          break;
+        }
+    }
+
+  if (! success)
+    {
+      memset (dest, 0, size);
+
+      if (g_atomic_int_exchange_and_add (&file->n_corrupt, 1) == 0 &&
+          file->lazy)
+        {
+          g_warning ("XCF: corrupt tile data, it has been cleared");
+        }
+    }
+}
+
+/*  To potentially save memory, identical neighbouring tiles are
+ *  mapped copy-on-write onto each other, like xcf_load_level() does.
+ */
+static void
+xcf_lazy_load_tile_manager (TileManager *tm)
+{
+  Tile *previous = NULL;
+  gint  n_tiles  = tm->ntile_rows * tm->ntile_cols;
+  gint  i;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, i, TRUE, FALSE);
+
+      if (previous != NULL)
+        {
+          tile_lock (previous);
+
+          if (tile_ewidth (tile) == tile_ewidth (previous) &&
+              tile_eheight (tile) == tile_eheight (previous) &&
+              tile_bpp (tile) == tile_bpp (previous) &&
+              memcmp (tile_data_pointer (tile, 0, 0),
+                      tile_data_pointer (previous, 0, 0),
+                      tile_size (tile)) == 0)
+            tile_manager_map (tm, i, previous);
+
+          tile_release (previous, FALSE);
+        }
+
+      tile_release (tile, FALSE);
+
+      previous = tile_manager_get (tm, i, FALSE, FALSE);
+    }
+
+  if (tm->validate_proc == (TileValidateProc) xcf_lazy_validate_tile)
+    {
+      tile_manager_set_validate_threadsafe (tm, FALSE);
+      tile_manager_set_validate_proc (tm, NULL, NULL);
+    }
+}
+
+static gpointer
+xcf_lazy_load_thread (XcfLazyLoad *load)
+{
+  while (TRUE)
+    {
+      TileManager *tm = NULL;
+
+#ifdef ENABLE_MP
+      if (load->mutex)
+        g_mutex_lock (load->mutex);
+#endif
+
+      if (load->tiles)
+        {
+          tm = load->tiles->data;
+          load->tiles = g_list_next (load->tiles);
+        }
+
+#ifdef ENABLE_MP
+      if (load->mutex)
+        g_mutex_unlock (load->mutex);
+#endif
+
+      if (! tm)
+        break;
+
+      xcf_lazy_load_tile_manager (tm);
+    }
+
+  return NULL;
+}
@@ -0,0 +1,40 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __XCF_LAZY_H__
+#define __XCF_LAZY_H__
+
+
+XcfLazyFile * xcf_lazy_file_new           (const gchar        *filename,
+                                           gboolean            lazy,
+                                           GError            **error);
+void          xcf_lazy_file_unref         (XcfLazyFile        *file);
+
+gboolean      xcf_lazy_file_add_level     (XcfLazyFile        *file,
+                                           TileManager        *tiles,
+                                           XcfCompressionType  compression,
+                                           const guint32      *offsets,
+                                           gint                n_tiles);
+gint          xcf_lazy_file_get_n_corrupt (XcfLazyFile        *file);
+
+void          xcf_lazy_load_tiles         (GList              *tile_managers,
+                                           gint                n_threads);
+void          xcf_lazy_release            (const gchar        *filename,
+                                           gint                n_threads);
+
+
+#endif  /* __XCF_LAZY_H__ */
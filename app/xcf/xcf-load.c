@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 
@@ -64,6 +68,7 @@
 #include "vectors/gimpvectors-compat.h"
 
 #include "xcf-private.h"
+#include "xcf-lazy.h"
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
@@ -107,6 +112,11 @@ static gboolean        xcf_load_tile          (XcfInfo      *info,
 static gboolean        xcf_load_tile_rle      (XcfInfo      *info,
                                                Tile         *tile,
                                                gint          data_length);
+#ifdef HAVE_ZLIB
+static gboolean        xcf_load_tile_zlib     (XcfInfo      *info,
+                                               Tile         *tile,
+                                               gint          data_length);
+#endif
 static GimpParasite  * xcf_load_parasite      (XcfInfo      *info);
 static gboolean        xcf_load_old_paths     (XcfInfo      *info,
                                                GimpImage    *image);
@@ -1360,7 +1370,7 @@ static gboolean
 xcf_load_level (XcfInfo     *info,
                 TileManager *tiles)
 {
-  guint32 saved_pos;
+  guint32 *offsets;
   guint32 offset, offset2;
   guint ntiles;
   gint  width;
@@ -1385,31 +1395,63 @@ xcf_load_level (XcfInfo     *info,
   if (offset == 0)
     return TRUE;
 
-  /* Initialise the reference for the in-memory tile-compression
+  ntiles = tiles->ntile_rows * tiles->ntile_cols;
+
+  /* read in the whole offset table, so the tiles can be read
+   *  without seeking back and forth, or later from the mapped file.
    */
-  previous = NULL;
+  offsets = g_new (guint32, ntiles + 1);
 
-  ntiles = tiles->ntile_rows * tiles->ntile_cols;
   for (i = 0; i < ntiles; i++)
     {
-      fail = FALSE;
-
       if (offset == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
 				GIMP_MESSAGE_ERROR,
 				"not enough tiles found in level");
+          g_free (offsets);
           return FALSE;
         }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
+      offsets[i] = offset;
 
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+      /* read in the offset of the next tile */
+      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+    }
+
+  offsets[ntiles] = 0;
+
+  if (offset != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %d", offset);
+      g_free (offsets);
+      return FALSE;
+    }
+
+  /* let the tiles be decoded from the mapped file when they are
+   *  first used, or in parallel once all drawables are created.
+   */
+  if (info->lazy_file &&
+      xcf_lazy_file_add_level (info->lazy_file, tiles, info->compression,
+                               offsets, ntiles))
+    {
+      info->lazy_tiles = g_list_prepend (info->lazy_tiles,
+                                         tile_manager_ref (tiles));
+      g_free (offsets);
+      return TRUE;
+    }
+
+  /* Initialise the reference for the in-memory tile-compression
+   */
+  previous = NULL;
+
+  for (i = 0; i < ntiles; i++)
+    {
+      fail = FALSE;
+
+      offset  = offsets[i];
+      offset2 = offsets[i + 1];
 
       /* if the offset is 0 then we need to read in the maximum possible
          allowing for negative compression */
@@ -1420,7 +1462,10 @@ xcf_load_level (XcfInfo     *info,
 
       /* seek to the tile offset */
       if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+        {
+          g_free (offsets);
+          return FALSE;
+        }
 
       /* get the tile from the tile manager */
       tile = tile_manager_get (tiles, i, TRUE, TRUE);
@@ -1437,8 +1482,15 @@ xcf_load_level (XcfInfo     *info,
             fail = TRUE;
           break;
         case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
+#ifdef HAVE_ZLIB
+          if (!xcf_load_tile_zlib (info, tile, offset2 - offset))
+            fail = TRUE;
+#else
+          gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                                GIMP_MESSAGE_ERROR,
+                                "xcf: zlib compression unsupported");
           fail = TRUE;
+#endif
           break;
         case COMPRESS_FRACTAL:
           g_error ("xcf: fractal compression unimplemented");
@@ -1449,6 +1501,7 @@ xcf_load_level (XcfInfo     *info,
       if (fail)
         {
           tile_release (tile, TRUE);
+          g_free (offsets);
           return FALSE;
         }
 
@@ -1471,23 +1524,9 @@ xcf_load_level (XcfInfo     *info,
         }
       tile_release (tile, TRUE);
       previous = tile_manager_get (tiles, i, FALSE, FALSE);
-
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
-
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
     }
 
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
-      return FALSE;
-    }
+  g_free (offsets);
 
   return TRUE;
 }
@@ -1633,6 +1672,57 @@ xcf_load_tile_rle (XcfInfo *info,
   return FALSE;
 }
 
+#ifdef HAVE_ZLIB
+static gboolean
+xcf_load_tile_zlib (XcfInfo *info,
+                    Tile    *tile,
+                    gint     data_length)
+{
+  z_stream  strm = { 0, };
+  guchar   *xcfdata;
+  gint      nmemb_read_successfully;
+  gint      status;
+
+  /* skip empty tiles, like xcf_load_tile_rle() does */
+  if (data_length <= 0)
+    return TRUE;
+
+  xcfdata = g_malloc (data_length);
+
+  /* we have to use fread instead of xcf_read_* because we may be
+     reading past the end of the file here */
+  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
+                                   data_length, info->fp);
+  info->cp += nmemb_read_successfully;
+
+  strm.next_in   = xcfdata;
+  strm.avail_in  = nmemb_read_successfully;
+  strm.next_out  = tile_data_pointer (tile, 0, 0);
+  strm.avail_out = tile_size (tile);
+
+  if (inflateInit (&strm) != Z_OK)
+    {
+      g_free (xcfdata);
+      return FALSE;
+    }
+
+  status = inflate (&strm, Z_FINISH);
+
+  inflateEnd (&strm);
+  g_free (xcfdata);
+
+  if (status != Z_STREAM_END || strm.avail_out != 0)
+    {
+      gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                            GIMP_MESSAGE_ERROR,
+                            "xcf: corrupt zlib compressed tile");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+#endif
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
@@ -59,7 +59,7 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
+  COMPRESS_ZLIB              =  2,
   COMPRESS_FRACTAL           =  3   /* unused */
 } XcfCompressionType;
 
@@ -80,7 +80,8 @@ typedef enum
   XCF_GROUP_ITEM_EXPANDED      = 1
 } XcfGroupItemFlagsType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo     XcfInfo;
+typedef struct _XcfLazyFile XcfLazyFile;
 
 struct _XcfInfo
 {
@@ -99,6 +100,8 @@ struct _XcfInfo
   gint               *ref_count;
   XcfCompressionType  compression;
   gint                file_version;
+  XcfLazyFile        *lazy_file;
+  GList              *lazy_tiles;
 };
 
 
@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 
@@ -31,6 +35,9 @@
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
+#include "base/tile-rle.h"
+
+#include "config/gimpcoreconfig.h"
 
 #include "core/gimp.h"
 #include "core/gimpcontainer.h"
@@ -68,6 +75,46 @@
 #include "gimp-intl.h"
 
 
+/*  The tiles of a level are compressed into a window of memory
+ *  buffers, by worker threads if there are several processors, and
+ *  written to the file in order by the thread saving the image. The
+ *  level's tile offset table is written after the tiles.
+ */
+
+#define XCF_SAVE_WINDOW_PER_THREAD  16
+
+typedef struct _XcfTileBuffer  XcfTileBuffer;
+typedef struct _XcfLevelSave   XcfLevelSave;
+
+struct _XcfTileBuffer
+{
+  guchar   *data;
+  gint      size;       /*  -1 if the tile could not be compressed  */
+  gboolean  done;
+};
+
+struct _XcfLevelSave
+{
+  TileManager        *level;
+  XcfCompressionType  compression;
+  gint                n_tiles;
+
+  XcfTileBuffer      *window;
+  gint                window_size;
+  gint                buffer_size;
+
+  gint                next_tile;  /*  the next tile to compress        */
+  gint                n_written;  /*  the number of tiles written      */
+  gboolean            abort;
+
+#ifdef ENABLE_MP
+  GMutex             *mutex;
+  GCond              *compressed; /*  a tile was compressed            */
+  GCond              *written;    /*  a tile's buffer was written out  */
+#endif
+};
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -98,12 +145,18 @@ static gboolean xcf_save_hierarchy     (XcfInfo           *info,
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         TileManager       *tiles,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
-                                        Tile              *tile,
+static gboolean xcf_save_level_tiles   (XcfInfo           *info,
+                                        TileManager       *level,
+                                        guint32           *offsets,
                                         GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
+static gint     xcf_save_compress_tile (XcfLevelSave      *save,
+                                        Tile              *tile,
+                                        guchar            *dest);
+#ifdef ENABLE_MP
+static gpointer xcf_save_level_thread  (XcfLevelSave      *save);
+#endif
+static gboolean xcf_save_tile          (XcfInfo           *info,
                                         Tile              *tile,
-                                        guchar            *rlebuf,
                                         GError           **error);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
@@ -211,6 +264,10 @@ xcf_save_choose_format (XcfInfo   *info,
         save_version = MAX (3, save_version);
     }
 
+  /* need version 4 for zlib compressed tiles */
+  if (info->compression == COMPRESS_ZLIB)
+    save_version = MAX (4, save_version);
+
   info->file_version = save_version;
 }
 
@@ -1379,18 +1436,243 @@ xcf_save_hierarchy (XcfInfo      *info,
   return TRUE;
 }
 
+static gint
+xcf_save_compress_tile (XcfLevelSave  *save,
+                        Tile          *tile,
+                        guchar        *dest)
+{
+  gint size = -1;
+
+  tile_lock (tile);
+
+  switch (save->compression)
+    {
+    case COMPRESS_RLE:
+      size = tile_rle_encode (tile_data_pointer (tile, 0, 0),
+                              tile_bpp (tile),
+                              tile_ewidth (tile) * tile_eheight (tile),
+                              dest, save->buffer_size);
+      break;
+
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+      {
+        uLongf len = save->buffer_size;
+
+        if (compress2 (dest, &len,
+                       tile_data_pointer (tile, 0, 0), tile_size (tile),
+                       Z_DEFAULT_COMPRESSION) == Z_OK)
+          size = len;
+      }
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  tile_release (tile, FALSE);
+
+  return size;
+}
+
+#ifdef ENABLE_MP
+static gpointer
+xcf_save_level_thread (XcfLevelSave *save)
+{
+  g_mutex_lock (save->mutex);
+
+  while (! save->abort && save->next_tile < save->n_tiles)
+    {
+      XcfTileBuffer *buffer;
+      gint           i = save->next_tile;
+
+      /*  wait until the tile's buffer has been written out  */
+      if (i >= save->n_written + save->window_size)
+        {
+          g_cond_wait (save->written, save->mutex);
+          continue;
+        }
+
+      save->next_tile++;
+
+      buffer = &save->window[i % save->window_size];
+
+      g_mutex_unlock (save->mutex);
+
+      buffer->size = xcf_save_compress_tile (save, save->level->tiles[i],
+                                             buffer->data);
+
+      g_mutex_lock (save->mutex);
+
+      buffer->done = TRUE;
+      g_cond_broadcast (save->compressed);
+    }
+
+  g_mutex_unlock (save->mutex);
+
+  return NULL;
+}
+#endif
+
+static gboolean
+xcf_save_level_tiles (XcfInfo       *info,
+                      TileManager   *level,
+                      guint32       *offsets,
+                      GError       **error)
+{
+  XcfLevelSave  save      = { 0, };
+  GThread     **threads   = NULL;
+  gint          n_threads = 0;
+  gboolean      success   = TRUE;
+  gint          i;
+
+  save.level       = level;
+  save.compression = info->compression;
+  save.n_tiles     = level->ntile_rows * level->ntile_cols;
+  save.buffer_size = TILE_RLE_MAX_SIZE (TILE_WIDTH * TILE_HEIGHT *
+                                        tile_manager_bpp (level));
+
+#ifdef ENABLE_MP
+  n_threads = MIN (GIMP_BASE_CONFIG (info->gimp->config)->num_processors,
+                   save.n_tiles);
+
+  /*  not worth a thread  */
+  if (n_threads < 2)
+    n_threads = 0;
+#endif
+
+  save.window_size = MAX (1, n_threads * XCF_SAVE_WINDOW_PER_THREAD);
+  save.window      = g_new0 (XcfTileBuffer, save.window_size);
+
+  for (i = 0; i < save.window_size; i++)
+    save.window[i].data = g_malloc (save.buffer_size);
+
+#ifdef ENABLE_MP
+  if (n_threads)
+    {
+      save.mutex      = g_mutex_new ();
+      save.compressed = g_cond_new ();
+      save.written    = g_cond_new ();
+
+      threads = g_new0 (GThread *, n_threads);
+
+      for (i = 0; i < n_threads; i++)
+        {
+          threads[i] = g_thread_create ((GThreadFunc) xcf_save_level_thread,
+                                        &save, TRUE, NULL);
+
+          if (! threads[i])
+            break;
+        }
+
+      n_threads = i;
+
+      /*  couldn't create any thread, compress here  */
+      if (! n_threads)
+        {
+          g_free (threads);
+          threads = NULL;
+        }
+    }
+#endif
+
+  for (i = 0; i < save.n_tiles; i++)
+    {
+      XcfTileBuffer *buffer = &save.window[i % save.window_size];
+      GError        *tmp_error = NULL;
+
+      if (threads)
+        {
+#ifdef ENABLE_MP
+          g_mutex_lock (save.mutex);
+
+          while (! buffer->done)
+            g_cond_wait (save.compressed, save.mutex);
+
+          g_mutex_unlock (save.mutex);
+#endif
+        }
+      else
+        {
+          buffer->size = xcf_save_compress_tile (&save, level->tiles[i],
+                                                 buffer->data);
+        }
+
+      if (buffer->size < 0)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error compressing tile %d"), i);
+          success = FALSE;
+          break;
+        }
+
+      offsets[i] = info->cp;
+
+      info->cp += xcf_write_int8 (info->fp, buffer->data, buffer->size,
+                                  &tmp_error);
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          success = FALSE;
+          break;
+        }
+
+      if (threads)
+        {
+#ifdef ENABLE_MP
+          g_mutex_lock (save.mutex);
+
+          buffer->done = FALSE;
+          save.n_written++;
+          g_cond_broadcast (save.written);
+
+          g_mutex_unlock (save.mutex);
+#endif
+        }
+    }
+
+#ifdef ENABLE_MP
+  if (threads)
+    {
+      g_mutex_lock (save.mutex);
+
+      save.abort = TRUE;
+      g_cond_broadcast (save.written);
+
+      g_mutex_unlock (save.mutex);
+
+      for (i = 0; i < n_threads; i++)
+        g_thread_join (threads[i]);
+
+      g_free (threads);
+
+      g_mutex_free (save.mutex);
+      g_cond_free (save.compressed);
+      g_cond_free (save.written);
+    }
+#endif
+
+  for (i = 0; i < save.window_size; i++)
+    g_free (save.window[i].data);
+
+  g_free (save.window);
+
+  return success;
+}
+
 static gboolean
 xcf_save_level (XcfInfo      *info,
                 TileManager  *level,
                 GError      **error)
 {
   guint32  saved_pos;
-  guint32  offset;
   guint32  width;
   guint32  height;
-  guint    ntiles;
+  guint32 *offsets;
+  guint    ntiles = 0;
   gint     i;
-  guchar  *rlebuf;
 
   GError *tmp_error = NULL;
 
@@ -1402,70 +1684,76 @@ xcf_save_level (XcfInfo      *info,
 
   saved_pos = info->cp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-     written to disk */
-  rlebuf =
-    g_malloc (TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (level) * 1.5);
-
   if (level->tiles)
+    ntiles = level->ntile_rows * level->ntile_cols;
+
+  /*  the tile offsets, and a '0' offset to indicate their end  */
+  offsets = g_new0 (guint32, ntiles + 1);
+
+  if (ntiles)
     {
-      ntiles = level->ntile_rows * level->ntile_cols;
+      gboolean success;
+
       xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
 
-      for (i = 0; i < ntiles; i++)
+      switch (info->compression)
         {
-          /* save the start offset of where we are writing
-           *  out the next tile.
-           */
-          offset = info->cp;
-
-          /* write out the tile. */
-          switch (info->compression)
+        case COMPRESS_NONE:
+          for (i = 0; i < ntiles; i++)
             {
-            case COMPRESS_NONE:
-              xcf_check_error (xcf_save_tile (info, level->tiles[i], error));
-              break;
-            case COMPRESS_RLE:
-              xcf_check_error (xcf_save_tile_rle (info, level->tiles[i],
-                               rlebuf, error));
-              break;
-            case COMPRESS_ZLIB:
-              g_error ("xcf: zlib compression unimplemented");
-              break;
-            case COMPRESS_FRACTAL:
-              g_error ("xcf: fractal compression unimplemented");
-              break;
+              offsets[i] = info->cp;
+
+              if (! xcf_save_tile (info, level->tiles[i], error))
+                break;
             }
 
-          /* seek back to where we are to write out the next
-           *  tile offset and write it out.
-           */
-          xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-          xcf_write_int32_check_error (info, &offset, 1);
+          success = (i == ntiles);
+          break;
 
-          /* increment the location we are to write out the
-           *  next offset.
-           */
-          saved_pos = info->cp;
+        case COMPRESS_RLE:
+        case COMPRESS_ZLIB:
+          success = xcf_save_level_tiles (info, level, offsets, error);
+          break;
 
-          /* seek to the end of the file which is where
-           *  we will write out the next tile.
-           */
-          xcf_check_error (xcf_seek_end (info, error));
+        case COMPRESS_FRACTAL:
+        default:
+          g_error ("xcf: fractal compression unimplemented");
+          success = FALSE;
+          break;
+        }
+
+      if (! success)
+        {
+          g_free (offsets);
+          return FALSE;
         }
     }
 
-  g_free (rlebuf);
+  /* seek back to where we are to write out the tile offsets
+   *  and write them out.
+   */
+  if (! xcf_seek_pos (info, saved_pos, error))
+    {
+      g_free (offsets);
+      return FALSE;
+    }
 
-  /* write out a '0' offset position to indicate the end
-   *  of the level offsets.
+  info->cp += xcf_write_int32 (info->fp, offsets, ntiles + 1, &tmp_error);
+
+  g_free (offsets);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  /* seek to the end of the file which is where
+   *  we will write out the next level.
    */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_check_error (xcf_seek_end (info, error));
 
   return TRUE;
-
 }
 
 static gboolean
@@ -1476,128 +1764,16 @@ xcf_save_tile (XcfInfo  *info,
   GError *tmp_error = NULL;
 
   tile_lock (tile);
-  xcf_write_int8_check_error (info, tile_data_pointer (tile, 0, 0),
-                              tile_size (tile));
+  info->cp += xcf_write_int8 (info->fp, tile_data_pointer (tile, 0, 0),
+                              tile_size (tile), &tmp_error);
   tile_release (tile, FALSE);
 
-  return TRUE;
-}
-
-static gboolean
-xcf_save_tile_rle (XcfInfo  *info,
-                   Tile     *tile,
-                   guchar   *rlebuf,
-                   GError  **error)
-{
-  GError *tmp_error = NULL;
-  gint    len       = 0;
-  gint    bpp;
-  gint    i, j;
-
-  tile_lock (tile);
-
-  bpp = tile_bpp (tile);
-
-  for (i = 0; i < bpp; i++)
+  if (tmp_error)
     {
-      const guchar *data = (const guchar *) tile_data_pointer (tile, 0, 0) + i;
-
-      gint  state  = 0;
-      gint  length = 0;
-      gint  count  = 0;
-      gint  size   = tile_ewidth (tile) * tile_eheight (tile);
-      guint last   = -1;
-
-      while (size > 0)
-        {
-          switch (state)
-            {
-            case 0:
-              /* in state 0 we try to find a long sequence of
-               *  matching values.
-               */
-              if ((length == 32768) ||
-                  ((size - length) <= 0) ||
-                  ((length > 1) && (last != *data)))
-                {
-                  count += length;
-
-                  if (length >= 128)
-                    {
-                      rlebuf[len++] = 127;
-                      rlebuf[len++] = (length >> 8);
-                      rlebuf[len++] = length & 0x00FF;
-                      rlebuf[len++] = last;
-                    }
-                  else
-                    {
-                      rlebuf[len++] = length - 1;
-                      rlebuf[len++] = last;
-                    }
-
-                  size -= length;
-                  length = 0;
-                }
-              else if ((length == 1) && (last != *data))
-                {
-                  state = 1;
-                }
-              break;
-
-            case 1:
-              /* in state 1 we try and find a long sequence of
-               *  non-matching values.
-               */
-              if ((length == 32768) ||
-                  ((size - length) == 0) ||
-                  ((length > 0) && (last == *data) &&
-                   ((size - length) == 1 || last == data[bpp])))
-                {
-                  const guchar *t;
-
-                  count += length;
-                  state = 0;
-
-                  if (length >= 128)
-                    {
-                      rlebuf[len++] = 255 - 127;
-                      rlebuf[len++] = (length >> 8);
-                      rlebuf[len++] = length & 0x00FF;
-                    }
-                  else
-                    {
-                      rlebuf[len++] = 255 - (length - 1);
-                    }
-
-                  t = data - length * bpp;
-
-                  for (j = 0; j < length; j++)
-                    {
-                      rlebuf[len++] = *t;
-                      t += bpp;
-                    }
-
-                  size -= length;
-                  length = 0;
-                }
-              break;
-            }
-
-          if (size > 0)
-            {
-              length += 1;
-              last = *data;
-              data += bpp;
-            }
-        }
-
-      if (count != (tile_ewidth (tile) * tile_eheight (tile)))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+      g_propagate_error (error, tmp_error);
+      return FALSE;
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
-  tile_release (tile, FALSE);
-
   return TRUE;
 }
 
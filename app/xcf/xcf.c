@@ -28,6 +28,10 @@
 
 #include "core/core-types.h"
 
+#include "base/tile-manager.h"
+
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -38,6 +42,7 @@
 
 #include "xcf.h"
 #include "xcf-private.h"
+#include "xcf-lazy.h"
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
@@ -69,7 +74,8 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 0 */
   xcf_load_image,   /* version 1 */
   xcf_load_image,   /* version 2 */
-  xcf_load_image    /* version 3 */
+  xcf_load_image,   /* version 3 */
+  xcf_load_image    /* version 4 */
 };
 
 
@@ -264,6 +270,14 @@ xcf_load_invoker (GimpProcedure      *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_NONE;
+      info.lazy_tiles            = NULL;
+
+      /*  read the tiles from a mapping of the file, falls back
+       *  to reading them with the file pointer if that fails
+       */
+      info.lazy_file = xcf_lazy_file_new (filename,
+                                          gimp->config->xcf_lazy_load,
+                                          NULL);
 
       if (progress)
         {
@@ -318,6 +332,33 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
       fclose (info.fp);
 
+      if (info.lazy_file)
+        {
+          /*  unless tiles are to be decoded on demand, decode them
+           *  now, one drawable per processor
+           */
+          if (image && ! gimp->config->xcf_lazy_load)
+            {
+              gint n_corrupt;
+
+              xcf_lazy_load_tiles (info.lazy_tiles,
+                                   GIMP_BASE_CONFIG (gimp->config)->num_processors);
+
+              n_corrupt = xcf_lazy_file_get_n_corrupt (info.lazy_file);
+
+              if (n_corrupt > 0)
+                gimp_message (gimp, G_OBJECT (progress), GIMP_MESSAGE_WARNING,
+                              _("XCF warning: %d corrupt tiles were cleared "
+                                "while loading '%s'."),
+                              n_corrupt, gimp_filename_to_utf8 (filename));
+            }
+
+          g_list_free_full (info.lazy_tiles,
+                            (GDestroyNotify) tile_manager_unref);
+
+          xcf_lazy_file_unref (info.lazy_file);
+        }
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -360,6 +401,9 @@ xcf_save_invoker (GimpProcedure      *procedure,
   image    = gimp_value_get_image (&args->values[1], gimp);
   filename = g_value_get_string (&args->values[3]);
 
+  /*  images loaded lazily from the file still read their tiles from it  */
+  xcf_lazy_release (filename, GIMP_BASE_CONFIG (gimp->config)->num_processors);
+
   info.fp = g_fopen (filename, "wb");
 
   if (info.fp)
@@ -376,6 +420,13 @@ xcf_save_invoker (GimpProcedure      *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_RLE;
+      info.lazy_file             = NULL;
+      info.lazy_tiles            = NULL;
+
+#ifdef HAVE_ZLIB
+      if (gimp->config->xcf_zlib_compression)
+        info.compression = COMPRESS_ZLIB;
+#endif
 
       if (progress)
         {
@@ -115,7 +115,7 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 4)
+#define TILE_MAP_SIZE (_tile_width * _tile_height * 4 * GP_TILE_WINDOW_TILES)
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -193,6 +193,7 @@ static gchar         *_wm_class          = NULL;
 static gchar         *_display_name      = NULL;
 static gint           _monitor_number    = 0;
 static guint32        _timestamp         = 0;
+static gboolean       _resident          = FALSE;
 static const gchar   *progname           = NULL;
 
 static gchar          write_buffer[WRITE_BUFFER_SIZE];
@@ -1819,11 +1820,17 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_LIST:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
         case GP_PROC_RUN:
           gimp_proc_run (msg.data);
+
+          /*  a resident plug-in waits for the next call, or GP_QUIT  */
+          if (_resident)
+            break;
+
           gimp_wire_destroy (&msg);
           gimp_close ();
           return;
@@ -1885,17 +1892,23 @@ gimp_config (GPConfig *config)
   _show_help_button = config->show_help_button ? TRUE : FALSE;
   _min_colors       = config->min_colors;
   _gdisp_ID         = config->gdisp_ID;
-  _wm_class         = g_strdup (config->wm_class);
-  _display_name     = g_strdup (config->display_name);
   _monitor_number   = config->monitor_number;
   _timestamp        = config->timestamp;
+  _resident         = config->resident         ? TRUE : FALSE;
+
+  /*  a resident plug-in gets a new config with every call  */
+  g_free (_wm_class);
+  g_free (_display_name);
+
+  _wm_class         = g_strdup (config->wm_class);
+  _display_name     = g_strdup (config->display_name);
 
   if (config->app_name)
     g_set_application_name (config->app_name);
 
   gimp_cpu_accel_set_use (config->use_cpu_accel);
 
-  if (_shm_ID != -1)
+  if (_shm_ID != -1 && ! _shm_addr)
     {
 #if defined(USE_SYSV_SHM)
 
@@ -2043,6 +2056,7 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_LIST:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -23,6 +23,11 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "gimp.h"
 
 
@@ -68,6 +73,35 @@ static gint     gimp_get_portion_height   (GimpPixelRgnIterator *pri);
 static gpointer gimp_pixel_rgns_configure (GimpPixelRgnIterator *pri);
 static void     gimp_pixel_rgn_configure  (GimpPixelRgnHolder   *prh,
                                            GimpPixelRgnIterator *pri);
+static void     gimp_pixel_rgn_prefetch   (GimpPixelRgnHolder   *prh,
+                                           GimpPixelRgnIterator *pri);
+
+static gboolean gimp_pixel_rgn_window_rect (GimpPixelRgn        *pr,
+                                            guchar              *buf,
+                                            gint                 x,
+                                            gint                 y,
+                                            gint                 width,
+                                            gint                 height,
+                                            gboolean             put);
+static void     gimp_pixel_rgn_window_flush (GimpPixelRgn       *pr,
+                                            GimpTile           **tiles,
+                                            guint32             *tile_nums,
+                                            gint                 n_tiles,
+                                            guchar              *buf,
+                                            gint                 x,
+                                            gint                 y,
+                                            gint                 width,
+                                            gint                 height,
+                                            gboolean             put);
+static void     gimp_pixel_rgn_copy_tile   (GimpPixelRgn        *pr,
+                                            GimpTile            *tile,
+                                            guchar              *data,
+                                            guchar              *buf,
+                                            gint                 x,
+                                            gint                 y,
+                                            gint                 width,
+                                            gint                 height,
+                                            gboolean             put);
 
 /**
  * gimp_pixel_rgn_init:
@@ -365,6 +399,9 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
+  if (gimp_pixel_rgn_window_rect (pr, buf, x, y, width, height, FALSE))
+    return;
+
   bpp = pr->bpp;
   bufstride = bpp * width;
 
@@ -599,6 +636,10 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
+  if (gimp_pixel_rgn_window_rect (pr, (guchar *) buf, x, y, width, height,
+                                  TRUE))
+    return;
+
   bpp = pr->bpp;
   bufstride = bpp * width;
 
@@ -942,6 +983,10 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
                                       prh->pr->shadow,
                                       prh->pr->x,
                                       prh->pr->y);
+
+      if (! tile->data)
+        gimp_pixel_rgn_prefetch (prh, pri);
+
       gimp_tile_ref (tile);
 
       offx = prh->pr->x % TILE_WIDTH;
@@ -961,3 +1006,199 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
   prh->pr->w = pri->portion_width;
   prh->pr->h = pri->portion_height;
 }
+
+/*  Fetches the tiles the iterator is going to visit next in this
+ *  region, in its row-major order, with a single request, as many as
+ *  the tile cache has room for.
+ */
+static void
+gimp_pixel_rgn_prefetch (GimpPixelRgnHolder   *prh,
+                         GimpPixelRgnIterator *pri)
+{
+  GimpPixelRgn *pr = prh->pr;
+  GimpTile     *tiles[GP_TILE_WINDOW_TILES];
+  gint          n_tiles = 0;
+  gint          max_tiles;
+  gint          first_col, last_col, last_row;
+  gint          row, col;
+
+  if (! gimp_shm_addr ())
+    return;
+
+  /*  share the free cache space between all regions, so that
+   *  prefetching for one doesn't evict the tiles of another
+   */
+  max_tiles = _gimp_tile_cache_room () / g_slist_length (pri->pixel_regions);
+  max_tiles = MIN (max_tiles, GP_TILE_WINDOW_TILES);
+
+  if (max_tiles < 2)
+    return;
+
+  first_col = prh->startx / TILE_WIDTH;
+  last_col  = (prh->startx + pri->region_width  - 1) / TILE_WIDTH;
+  last_row  = (prh->starty + pri->region_height - 1) / TILE_HEIGHT;
+
+  row = pr->y / TILE_HEIGHT;
+  col = pr->x / TILE_WIDTH;
+
+  while (row <= last_row && n_tiles < max_tiles)
+    {
+      GimpTile *tile = gimp_drawable_get_tile (pr->drawable, pr->shadow,
+                                               row, col);
+
+      if (! tile->data)
+        tiles[n_tiles++] = tile;
+
+      if (++col > last_col)
+        {
+          col = first_col;
+          row++;
+        }
+    }
+
+  if (n_tiles > 1)
+    _gimp_tile_prefetch (pr->drawable, pr->shadow, tiles, n_tiles);
+}
+
+/*  Transfers a rectangle through the shared memory window, up to
+ *  GP_TILE_WINDOW_TILES tiles per round trip to the core.  Tiles which
+ *  are resident in the plug-in's tile cache are accessed directly so
+ *  that the cache stays coherent, and tiles only partially covered by
+ *  a put go through the cache as before, because the core's pixels
+ *  outside the rectangle must be preserved.  Returns FALSE if there is
+ *  no shared memory and the caller has to fall back to tile requests.
+ */
+static gboolean
+gimp_pixel_rgn_window_rect (GimpPixelRgn *pr,
+                            guchar       *buf,
+                            gint          x,
+                            gint          y,
+                            gint          width,
+                            gint          height,
+                            gboolean      put)
+{
+  GimpTile *tiles[GP_TILE_WINDOW_TILES];
+  guint32   tile_nums[GP_TILE_WINDOW_TILES];
+  gint      n_tiles = 0;
+  gint      row, col;
+
+  if (! gimp_shm_addr ())
+    return FALSE;
+
+  if (width == 0 || height == 0)
+    return TRUE;
+
+  for (row = y / TILE_HEIGHT; row <= (y + height - 1) / TILE_HEIGHT; row++)
+    for (col = x / TILE_WIDTH; col <= (x + width - 1) / TILE_WIDTH; col++)
+      {
+        GimpTile *tile = gimp_drawable_get_tile (pr->drawable, pr->shadow,
+                                                 row, col);
+        gint      tx   = col * TILE_WIDTH;
+        gint      ty   = row * TILE_HEIGHT;
+        gboolean  partial;
+
+        partial = (tx < x || tx + tile->ewidth  > x + width ||
+                   ty < y || ty + tile->eheight > y + height);
+
+        if (tile->data)
+          {
+            gimp_tile_ref (tile);
+            gimp_pixel_rgn_copy_tile (pr, tile, tile->data,
+                                      buf, x, y, width, height, put);
+            gimp_tile_unref (tile, put);
+            continue;
+          }
+
+        if (put && partial)
+          {
+            gimp_tile_ref (tile);
+            gimp_pixel_rgn_copy_tile (pr, tile, tile->data,
+                                      buf, x, y, width, height, TRUE);
+            gimp_tile_unref (tile, TRUE);
+            continue;
+          }
+
+        tiles[n_tiles]     = tile;
+        tile_nums[n_tiles] = tile->tile_num;
+        n_tiles++;
+
+        if (n_tiles == GP_TILE_WINDOW_TILES)
+          {
+            gimp_pixel_rgn_window_flush (pr, tiles, tile_nums, n_tiles,
+                                         buf, x, y, width, height, put);
+            n_tiles = 0;
+          }
+      }
+
+  if (n_tiles > 0)
+    gimp_pixel_rgn_window_flush (pr, tiles, tile_nums, n_tiles,
+                                 buf, x, y, width, height, put);
+
+  return TRUE;
+}
+
+static void
+gimp_pixel_rgn_window_flush (GimpPixelRgn  *pr,
+                             GimpTile     **tiles,
+                             guint32       *tile_nums,
+                             gint           n_tiles,
+                             guchar        *buf,
+                             gint           x,
+                             gint           y,
+                             gint           width,
+                             gint           height,
+                             gboolean       put)
+{
+  guchar *window;
+  gint    i;
+
+  window = _gimp_tile_list_begin (pr->drawable, pr->shadow, put,
+                                  tile_nums, n_tiles);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      gimp_pixel_rgn_copy_tile (pr, tiles[i], window,
+                                buf, x, y, width, height, put);
+
+      window += tiles[i]->ewidth * tiles[i]->eheight * tiles[i]->bpp;
+    }
+
+  _gimp_tile_list_end (put);
+}
+
+/*  Copies the part of @tile which lies inside the rectangle between
+ *  @buf and @data, which holds the tile's pixels in tile layout.
+ */
+static void
+gimp_pixel_rgn_copy_tile (GimpPixelRgn *pr,
+                          GimpTile     *tile,
+                          guchar       *data,
+                          guchar       *buf,
+                          gint          x,
+                          gint          y,
+                          gint          width,
+                          gint          height,
+                          gboolean      put)
+{
+  gint   col       = tile->tile_num % pr->drawable->ntile_cols;
+  gint   row       = tile->tile_num / pr->drawable->ntile_cols;
+  gint   x1        = MAX (x, col * TILE_WIDTH);
+  gint   y1        = MAX (y, row * TILE_HEIGHT);
+  gint   x2        = MIN (x + width,  col * TILE_WIDTH  + tile->ewidth);
+  gint   y2        = MIN (y + height, row * TILE_HEIGHT + tile->eheight);
+  gulong bufstride = pr->bpp * width;
+  gint   ty;
+
+  for (ty = y1; ty < y2; ty++)
+    {
+      guchar *t = (data +
+                   tile->bpp * (tile->ewidth * (ty % TILE_HEIGHT) +
+                                (x1 % TILE_WIDTH)));
+      guchar *b = buf + bufstride * (ty - y) + pr->bpp * (x1 - x);
+
+      if (put)
+        memcpy (t, b, (x2 - x1) * pr->bpp);
+      else
+        memcpy (b, t, (x2 - x1) * pr->bpp);
+    }
+}
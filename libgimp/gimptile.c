@@ -54,6 +54,7 @@ static void  gimp_tile_get          (GimpTile        *tile);
 static void  gimp_tile_put          (GimpTile        *tile);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
+static void  gimp_tile_cache_evict  (gint             n_tiles);
 
 
 /*  private variables  */
@@ -154,6 +155,11 @@ gimp_tile_cache_size (gulong kilobytes)
  * row-by-row, it should set the tile cache large enough to hold the
  * number of tiles per row. Double this size if your plug-in uses
  * shadow tiles.
+ *
+ * The pixel region iterator fetches the tiles it is going to visit
+ * next in batches, but only into free space of this cache. With the
+ * default size of 0, which a plug-in gets unless it calls this
+ * function or gimp_tile_cache_size(), tiles are fetched one at a time.
  **/
 void
 gimp_tile_cache_ntiles (gulong ntiles)
@@ -182,6 +188,150 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
     }
 }
 
+/*  Returns how many more tiles fit into the cache without evicting any.
+ */
+gint
+_gimp_tile_cache_room (void)
+{
+  gulong tile_size = gimp_tile_width () * gimp_tile_height () * 4;
+
+  if (cur_cache_size >= max_cache_size)
+    return 0;
+
+  return (max_cache_size - cur_cache_size) / tile_size;
+}
+
+/*  Fetches all of @tiles which are not resident yet with one
+ *  GP_TILE_LIST request per GP_TILE_WINDOW_TILES tiles and puts them
+ *  into the cache, so that the following gimp_tile_ref() calls don't
+ *  have to talk to the core.  Tiles which don't fit into the cache are
+ *  dropped again.  Room is made before each request and the tiles are
+ *  only inserted after it, because writing back an evicted dirty tile
+ *  must not happen while the core waits for the transfer to end.
+ */
+void
+_gimp_tile_prefetch (GimpDrawable  *drawable,
+                     gboolean       shadow,
+                     GimpTile     **tiles,
+                     gint           n_tiles)
+{
+  GimpTile *fetch[GP_TILE_WINDOW_TILES];
+  guint32   tile_nums[GP_TILE_WINDOW_TILES];
+  gint      n_fetch = 0;
+  gint      i;
+
+  g_return_if_fail (drawable != NULL);
+  g_return_if_fail (tiles != NULL || n_tiles == 0);
+
+  if (! gimp_shm_addr ())
+    return;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      if (! tiles[i]->data)
+        {
+          fetch[n_fetch]     = tiles[i];
+          tile_nums[n_fetch] = tiles[i]->tile_num;
+          n_fetch++;
+        }
+
+      if (n_fetch > 0 && (n_fetch == GP_TILE_WINDOW_TILES || i == n_tiles - 1))
+        {
+          const guchar *window;
+          gint          j;
+
+          gimp_tile_cache_evict (n_fetch);
+
+          window = _gimp_tile_list_begin (drawable, shadow, FALSE,
+                                          tile_nums, n_fetch);
+
+          for (j = 0; j < n_fetch; j++)
+            {
+              GimpTile *tile = fetch[j];
+              gsize     size = tile->ewidth * tile->eheight * tile->bpp;
+
+              tile->data = g_memdup (window, size);
+
+              window += size;
+            }
+
+          _gimp_tile_list_end (FALSE);
+
+          for (j = 0; j < n_fetch; j++)
+            {
+              GimpTile *tile = fetch[j];
+
+              tile->ref_count++;
+              tile->dirty = FALSE;
+
+              gimp_tile_cache_insert (tile);
+              gimp_tile_unref (tile, FALSE);
+            }
+
+          n_fetch = 0;
+        }
+    }
+}
+
+/*  Starts moving @n_tiles tiles of @drawable between the core and the
+ *  shared memory window, see GPTileList.  The tiles are packed back to
+ *  back in the returned window; for a get they are there already, for
+ *  a put the caller fills it.  Either way, the window is the caller's
+ *  only until _gimp_tile_list_end(), which must follow without any
+ *  other request to the core in between, and the caller must not let
+ *  more than GP_TILE_WINDOW_TILES tiles be in flight.
+ */
+guchar *
+_gimp_tile_list_begin (GimpDrawable *drawable,
+                       gboolean      shadow,
+                       gboolean      put,
+                       guint32      *tile_nums,
+                       gint          n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileList       tile_list;
+  GimpWireMessage  msg;
+
+  g_return_val_if_fail (drawable != NULL, NULL);
+  g_return_val_if_fail (n_tiles <= GP_TILE_WINDOW_TILES, NULL);
+  g_return_val_if_fail (gimp_shm_addr () != NULL, NULL);
+
+  tile_list.drawable_ID = drawable->drawable_id;
+  tile_list.shadow      = shadow;
+  tile_list.put         = put;
+  tile_list.n_tiles     = n_tiles;
+  tile_list.tile_nums   = tile_nums;
+
+  if (! gp_tile_list_write (_writechannel, &tile_list, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+
+  return gimp_shm_addr ();
+}
+
+/*  Hands the window back to the core, after copying the tiles out of
+ *  it or into it, and for a put waits until they arrived.
+ */
+void
+_gimp_tile_list_end (gboolean put)
+{
+  extern GIOChannel *_writechannel;
+
+  if (! gp_tile_ack_write (_writechannel, NULL))
+    gimp_quit ();
+
+  if (put)
+    {
+      GimpWireMessage msg;
+
+      gimp_read_expect_msg (&msg, GP_TILE_ACK);
+      gimp_wire_destroy (&msg);
+    }
+}
+
 
 /*  private functions  */
 
@@ -363,6 +513,21 @@ gimp_tile_cache_insert (GimpTile *tile)
     }
 }
 
+/*  Evicts tiles until @n_tiles more tiles fit into the cache, or the
+ *  cache is empty.
+ */
+static void
+gimp_tile_cache_evict (gint n_tiles)
+{
+  gulong tile_size = gimp_tile_width () * gimp_tile_height () * 4;
+
+  while (tile_list_head &&
+         (cur_cache_size + n_tiles * tile_size) > max_cache_size)
+    {
+      gimp_tile_cache_flush ((GimpTile *) tile_list_head->data);
+    }
+}
+
 static void
 gimp_tile_cache_flush (GimpTile *tile)
 {
@@ -56,7 +56,18 @@ void    gimp_tile_cache_ntiles (gulong     ntiles);
 
 /*  private function  */
 
-G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable  *drawable);
+G_GNUC_INTERNAL gint _gimp_tile_cache_room           (void);
+G_GNUC_INTERNAL void _gimp_tile_prefetch             (GimpDrawable  *drawable,
+                                                      gboolean       shadow,
+                                                      GimpTile     **tiles,
+                                                      gint           n_tiles);
+G_GNUC_INTERNAL guchar * _gimp_tile_list_begin       (GimpDrawable  *drawable,
+                                                      gboolean       shadow,
+                                                      gboolean       put,
+                                                      guint32       *tile_nums,
+                                                      gint           n_tiles);
+G_GNUC_INTERNAL void _gimp_tile_list_end             (gboolean       put);
 
 
 G_END_DECLS
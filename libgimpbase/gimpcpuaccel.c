@@ -123,7 +123,14 @@ enum
 
 enum
 {
-  ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0
+  ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0,
+  ARCH_X86_INTEL_FEATURE_OSXSAVE  = 1 << 27,
+  ARCH_X86_INTEL_FEATURE_AVX      = 1 << 28
+};
+
+enum
+{
+  ARCH_X86_INTEL_FEATURE_AVX2     = 1 << 5
 };
 
 #if !defined(ARCH_X86_64) && (defined(PIC) || defined(__PIC__))
@@ -136,6 +143,15 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx)  \
+  __asm__ ("movl %%ebx, %%esi\n\t"             \
+           "cpuid\n\t"                         \
+           "xchgl %%ebx,%%esi"                 \
+           : "=a" (eax),                       \
+             "=S" (ebx),                       \
+             "=c" (ecx),                       \
+             "=d" (edx)                        \
+           : "0" (op), "2" (count))
 #else
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("cpuid"                 \
@@ -144,6 +160,13 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx)  \
+  __asm__ ("cpuid"                             \
+           : "=a" (eax),                       \
+             "=b" (ebx),                       \
+             "=c" (ecx),                       \
+             "=d" (edx)                        \
+           : "0" (op), "2" (count))
 #endif
 
 
@@ -220,6 +243,24 @@ arch_get_vendor (void)
   return ARCH_X86_VENDOR_UNKNOWN;
 }
 
+#ifdef USE_AVX2
+/*  The ymm registers are only usable if the OS saves them across
+ *  context switches, which it announces in XCR0.
+ */
+static gboolean
+arch_accel_avx_os_support (void)
+{
+  guint32 xcr0_lo, xcr0_hi;
+
+  __asm__ (".byte 0x0f, 0x01, 0xd0"  /* xgetbv */
+           : "=a" (xcr0_lo),
+             "=d" (xcr0_hi)
+           : "c" (0));
+
+  return (xcr0_lo & 0x6) == 0x6;
+}
+#endif /* USE_AVX2 */
+
 static guint32
 arch_accel_intel (void)
 {
@@ -245,6 +286,23 @@ arch_accel_intel (void)
 
     if (ecx & ARCH_X86_INTEL_FEATURE_PNI)
       caps |= GIMP_CPU_ACCEL_X86_SSE3;
+
+#ifdef USE_AVX2
+    if ((ecx & ARCH_X86_INTEL_FEATURE_OSXSAVE) &&
+        (ecx & ARCH_X86_INTEL_FEATURE_AVX)     &&
+        arch_accel_avx_os_support ())
+      {
+        cpuid (0, eax, ebx, ecx, edx);
+
+        if (eax >= 7)
+          {
+            cpuid_count (7, 0, eax, ebx, ecx, edx);
+
+            if (ebx & ARCH_X86_INTEL_FEATURE_AVX2)
+              caps |= GIMP_CPU_ACCEL_X86_AVX2;
+          }
+      }
+#endif /* USE_AVX2 */
 #endif /* USE_SSE */
   }
 #endif /* USE_MMX */
@@ -410,7 +468,8 @@ arch_accel (void)
 
 #ifdef USE_SSE
   if ((caps & GIMP_CPU_ACCEL_X86_SSE) && !arch_accel_sse_os_support ())
-    caps &= ~(GIMP_CPU_ACCEL_X86_SSE | GIMP_CPU_ACCEL_X86_SSE2);
+    caps &= ~(GIMP_CPU_ACCEL_X86_SSE | GIMP_CPU_ACCEL_X86_SSE2 |
+              GIMP_CPU_ACCEL_X86_AVX2);
 #endif
 
   return caps;
@@ -77,19 +77,23 @@ void
 gimp_pixpipe_params_parse (const gchar       *string,
                            GimpPixPipeParams *params)
 {
-  gchar *copy;
-  gchar *p, *q, *r;
-  gint   i;
+  gchar **tokens;
+  gchar  *p, *r;
+  gint    i, j;
 
   g_return_if_fail (string != NULL);
   g_return_if_fail (params != NULL);
 
-  copy = g_strdup (string);
+  /*  not strtok(), brush pipes are loaded from several threads  */
+  tokens = g_strsplit_set (string, " \r\n", -1);
 
-  q = copy;
-  while ((p = strtok (q, " \r\n")) != NULL)
+  for (j = 0; tokens[j]; j++)
     {
-      q = NULL;
+      p = tokens[j];
+
+      if (! *p)
+        continue;
+
       r = strchr (p, ':');
       if (r)
         *r = 0;
@@ -161,11 +165,9 @@ gimp_pixpipe_params_parse (const gchar       *string,
                 }
             }
         }
-      if (r)
-        *r = ':';
     }
 
-  g_free (copy);
+  g_strfreev (tokens);
 }
 
 gchar *
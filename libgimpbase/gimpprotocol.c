@@ -140,6 +140,14 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_tile_list_read           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_list_write          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_list_destroy        (GimpWireMessage  *msg);
+
 
 
 void
@@ -197,6 +205,10 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_LIST,
+                      _gp_tile_list_read,
+                      _gp_tile_list_write,
+                      _gp_tile_list_destroy);
 }
 
 gboolean
@@ -442,6 +454,25 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_list_write (GIOChannel *channel,
+                    GPTileList *tile_list,
+                    gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_LIST;
+  msg.data = tile_list;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -499,7 +530,7 @@ _gp_config_read (GIOChannel      *channel,
                               user_data))
     goto cleanup;
   if (! _gimp_wire_read_int8 (channel,
-                              (guint8 *) &config->gimp_reserved_5, 1,
+                              (guint8 *) &config->resident, 1,
                               user_data))
     goto cleanup;
   if (! _gimp_wire_read_int8 (channel,
@@ -591,7 +622,7 @@ _gp_config_write (GIOChannel      *channel,
                                user_data))
     return;
   if (! _gimp_wire_write_int8 (channel,
-                               (const guint8 *) &config->gimp_reserved_5, 1,
+                               (const guint8 *) &config->resident, 1,
                                user_data))
     return;
   if (! _gimp_wire_write_int8 (channel,
@@ -1863,3 +1894,106 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/* tile_list */
+
+static void
+_gp_tile_list_read (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+  GPTileList *tile_list = g_slice_new0 (GPTileList);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_list->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_list->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_list->put, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_list->n_tiles, 1, user_data))
+    goto cleanup;
+
+  /*  don't trust the length of a list the window can't hold, but
+   *  consume it, so the next message is read from the right place;
+   *  the core rejects the list by its n_tiles
+   */
+  if (tile_list->n_tiles > GP_TILE_WINDOW_TILES)
+    {
+      guint32 discard[GP_TILE_WINDOW_TILES];
+      guint32 left = tile_list->n_tiles;
+
+      while (left > 0)
+        {
+          guint32 n = MIN (left, GP_TILE_WINDOW_TILES);
+
+          if (! _gimp_wire_read_int32 (channel, discard, n, user_data))
+            goto cleanup;
+
+          left -= n;
+        }
+    }
+  else if (tile_list->n_tiles > 0)
+    {
+      tile_list->tile_nums = g_new (guint32, tile_list->n_tiles);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tile_list->tile_nums, tile_list->n_tiles,
+                                   user_data))
+        goto cleanup;
+    }
+
+  msg->data = tile_list;
+  return;
+
+ cleanup:
+  g_free (tile_list->tile_nums);
+  g_slice_free (GPTileList, tile_list);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_list_write (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTileList *tile_list = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_list->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_list->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_list->put, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_list->n_tiles, 1, user_data))
+    return;
+
+  if (tile_list->n_tiles > 0)
+    {
+      if (! _gimp_wire_write_int32 (channel,
+                                    tile_list->tile_nums, tile_list->n_tiles,
+                                    user_data))
+        return;
+    }
+}
+
+static void
+_gp_tile_list_destroy (GimpWireMessage *msg)
+{
+  GPTileList *tile_list = msg->data;
+
+  if (tile_list)
+    {
+      g_free (tile_list->tile_nums);
+      g_slice_free (GPTileList, tile_list);
+    }
+}
@@ -26,7 +26,14 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0014
+#define GIMP_PROTOCOL_VERSION  0x0016
+
+
+/* The shared memory segment between the core and a plug-in holds
+ * this many tiles, so that a whole row of tiles (or more) can be
+ * transferred with a single GP_TILE_LIST request.
+ */
+#define GP_TILE_WINDOW_TILES   64
 
 
 enum
@@ -43,7 +50,8 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_LIST
 };
 
 
@@ -51,6 +59,7 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTileList      GPTileList;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -69,7 +78,7 @@ struct _GPConfig
   gint8    check_type;
   gint8    show_help_button;
   gint8    use_cpu_accel;
-  gint8    gimp_reserved_5;
+  gint8    resident;
   gint8    gimp_reserved_6;
   gint8    gimp_reserved_7;
   gint8    gimp_reserved_8;
@@ -103,6 +112,30 @@ struct _GPTileData
   guchar  *data;
 };
 
+/*  A batch of tiles transferred through the shared memory window.  The
+ *  tiles are packed back to back in the order of tile_nums, each one
+ *  taking exactly width * height * bpp bytes.  The window is shared by
+ *  all plug-ins, so the core serves nothing else until the transfer is
+ *  complete:
+ *
+ *  If put is zero the core copies the tiles into the window and replies
+ *  with GP_TILE_ACK; the plug-in copies them out and replies with
+ *  GP_TILE_ACK in turn.
+ *
+ *  Otherwise the core replies with GP_TILE_ACK once the window is the
+ *  plug-in's to fill; the plug-in fills it and replies with GP_TILE_ACK,
+ *  and the core copies the tiles into the drawable and sends a final
+ *  GP_TILE_ACK.
+ */
+struct _GPTileList
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  put;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -224,6 +257,9 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_tile_list_write        (GIOChannel      *channel,
+                                     GPTileList      *tile_list,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
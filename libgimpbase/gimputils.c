@@ -211,14 +211,21 @@ gimp_filename_to_utf8 (const gchar *filename)
    * return filename as is. Could perhaps (re)use a suitably large
    * cyclic buffer, but then would have to verify that all calls
    * really need the return value just for a "short" time.
+   *
+   * The table is locked because the core loads data files from
+   * several threads.  Entries are never removed, so the returned
+   * string stays valid after the lock is released.
    */
 
   static GHashTable *ht = NULL;
+  G_LOCK_DEFINE_STATIC (ht_lock);
   gchar             *filename_utf8;
 
   if (! filename)
     return NULL;
 
+  G_LOCK (ht_lock);
+
   if (! ht)
     ht = g_hash_table_new (g_str_hash, g_str_equal);
 
@@ -230,6 +237,8 @@ gimp_filename_to_utf8 (const gchar *filename)
       g_hash_table_insert (ht, g_strdup (filename), filename_utf8);
     }
 
+  G_UNLOCK (ht_lock);
+
   return filename_utf8;
 }
 